@@ -0,0 +1,103 @@
+#include "alloc.h"
+#include "threads.h"
+
+static Alloc_Stats alloc_stats[ALLOC_TAG_COUNT] = {0};
+
+static void alloc_stats_record(Alloc_Tag tag, isize delta, i64* count)
+{
+	assert(0 <= tag && tag < ALLOC_TAG_COUNT);
+	Alloc_Stats* stats = &alloc_stats[tag];
+	i64 live = atomic_add64(&stats->live_bytes, delta) + delta;
+	atomic_max64(&stats->peak_bytes, live);
+	atomic_add64(count, 1);
+}
+
+void* sure_realloc(void* old, isize new_size, isize old_size, Alloc_Tag tag)
+{
+	assert(0 <= tag && tag < ALLOC_TAG_COUNT);
+	Alloc_Stats* stats = &alloc_stats[tag];
+	if(new_size == 0)
+	{
+		if(old != NULL)
+			alloc_stats_record(tag, -old_size, &stats->frees);
+
+		free(old);
+		return NULL;
+	}
+	else
+	{
+		void* out = realloc(old, new_size);
+		if(out == NULL)
+		{
+			printf("OUT OF MEMORY! ABORTING!\n");
+			abort();
+		}
+
+		alloc_stats_record(tag, new_size - old_size, old == NULL ? &stats->allocations : &stats->reallocations);
+		return out;
+	}
+}
+
+void alloc_stats_add(Alloc_Tag tag, isize delta)
+{
+	if(delta == 0)
+		return;
+
+	Alloc_Stats* stats = &alloc_stats[tag];
+	alloc_stats_record(tag, delta, delta > 0 ? &stats->allocations : &stats->frees);
+}
+
+Alloc_Stats alloc_get_stats(Alloc_Tag tag)
+{
+	assert(0 <= tag && tag < ALLOC_TAG_COUNT);
+	Alloc_Stats* stats = &alloc_stats[tag];
+	Alloc_Stats out = {0};
+	out.live_bytes = atomic_load64(&stats->live_bytes);
+	out.peak_bytes = atomic_load64(&stats->peak_bytes);
+	out.allocations = atomic_load64(&stats->allocations);
+	out.reallocations = atomic_load64(&stats->reallocations);
+	out.frees = atomic_load64(&stats->frees);
+	return out;
+}
+
+Alloc_Stats alloc_get_total_stats()
+{
+	Alloc_Stats total = {0};
+	for(i32 i = 0; i < ALLOC_TAG_COUNT; i++)
+	{
+		Alloc_Stats stats = alloc_get_stats((Alloc_Tag) i);
+		total.live_bytes += stats.live_bytes;
+		total.peak_bytes += stats.peak_bytes;
+		total.allocations += stats.allocations;
+		total.reallocations += stats.reallocations;
+		total.frees += stats.frees;
+	}
+	return total;
+}
+
+void alloc_reset_peaks()
+{
+	//Not exact if someone allocates meanwhile but we only need it between workloads
+	for(i32 i = 0; i < ALLOC_TAG_COUNT; i++)
+	{
+		Alloc_Stats* stats = &alloc_stats[i];
+		atomic_store64(&stats->peak_bytes, atomic_load64(&stats->live_bytes));
+	}
+}
+
+const char* alloc_tag_to_string(Alloc_Tag tag)
+{
+	switch(tag)
+	{
+		case ALLOC_TAG_CHUNKS: return "chunks";
+		case ALLOC_TAG_CHUNK_META: return "chunk meta";
+		case ALLOC_TAG_HASH: return "hash";
+		case ALLOC_TAG_STEP: return "step";
+		case ALLOC_TAG_HASHLIFE: return "hashlife";
+		case ALLOC_TAG_FILE: return "file";
+		case ALLOC_TAG_RENDER: return "render";
+		case ALLOC_TAG_PERF: return "perf";
+		case ALLOC_TAG_SEARCH: return "search";
+		default: return "unknown";
+	}
+}
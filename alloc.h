@@ -6,29 +6,55 @@
 #include <stdlib.h>
 #include <string.h>
 
-//acts like realloc except when new_size == 0 performs free (instead of unspecified).
-//If memory allocation fails panics (aborts program with an error message)
-static void* sure_realloc(void* old, isize new_size, isize old_size)
+// This file provides our allocation function and tracks how much memory is used by what.
+//
+// Every allocation is given a tag saying which subsystem it belongs to. For each tag we keep
+// the live bytes, the peak of live bytes and the number of allocations, reallocations and frees.
+// The stats are updated with a few atomic adds so allocating from multiple threads is fine
+// and there is no I/O on the allocation path. They can be read through alloc_get_stats
+// (like perf_get_counters in perf.h).
+//
+// Memory not obtained through sure_realloc (committed virtual memory) is reported with alloc_stats_add.
+
+typedef enum Alloc_Tag
+{
+	ALLOC_TAG_CHUNKS = 0,	//the chunk arrays (of Chunk_Hash and of the step workers)
+	ALLOC_TAG_CHUNK_META,	//Chunk_Meta next to the chunks of Chunk_Hash
+	ALLOC_TAG_HASH,			//hash slots of Chunk_Hash
+	ALLOC_TAG_STEP,			//scratch of the generation step
+	ALLOC_TAG_HASHLIFE,		//hashlife nodes, leaves and their hashes
+	ALLOC_TAG_FILE,			//file buffers and scratch of the pattern loaders
+	ALLOC_TAG_RENDER,		//render buffers
+	ALLOC_TAG_PERF,			//profiler buffers (see perf.h)
+	ALLOC_TAG_SEARCH,		//cells and census of the soup search (see soup_search.h)
+	ALLOC_TAG_COUNT,
+} Alloc_Tag;
+
+typedef struct Alloc_Stats
 {
-	static isize total_memory = 0;
-	isize delta = new_size - old_size;
-	total_memory += delta;
-	printf("realloc called to get: %-16lld B total memory usage: %-16lld\n", (lld) delta, (lld) total_memory);
-
-	if(new_size == 0)
-	{
-		free(old);
-		return NULL;
-	}
-	else
-	{
-		void* out = realloc(old, new_size);
-		if(out == NULL)
-		{
-			printf("OUT OF MEMORY! ABORTING!\n");
-			abort();
-		}
-
-		return out;
-	}
-}
\ No newline at end of file
+	i64 live_bytes;
+	i64 peak_bytes; //the most live_bytes ever were (since alloc_reset_peaks)
+	i64 allocations;
+	i64 reallocations;
+	i64 frees;
+} Alloc_Stats;
+
+//Acts like realloc except when new_size == 0 performs free (instead of unspecified).
+//old_size has to be the size old was allocated with (0 for NULL) so that the stats stay correct.
+//If memory allocation fails panics (aborts program with an error message)
+void* sure_realloc(void* old, isize new_size, isize old_size, Alloc_Tag tag);
+
+//Records memory obtained some other way. Negative delta means it was given back.
+//Counts as an allocation (positive) or a free (negative).
+void alloc_stats_add(Alloc_Tag tag, isize delta);
+
+//Returns the stats of the tag at this moment
+Alloc_Stats alloc_get_stats(Alloc_Tag tag);
+
+//Returns the sum of all tags. The peak is the sum of the peaks of all tags (not necessarily at the same moment).
+Alloc_Stats alloc_get_total_stats();
+
+//Sets the peaks of all tags to the current live bytes. Used to measure the peak of some part of the program.
+void alloc_reset_peaks();
+
+const char* alloc_tag_to_string(Alloc_Tag tag);
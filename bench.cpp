@@ -0,0 +1,1338 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+// A headless benchmark of the generation step. Does not need SDL.
+//
+// Runs game_of_life_generation_step (or the hashlife engine) for a number of generations on a set of built in
+// workloads and writes the results as JSON so that they can be compared across commits.
+// For every workload we report the load time, generations/s, chunk updates/s, cells/s, peak memory usage
+// (of the whole process and per alloc tag, see alloc.h) and the breakdown of all PERF_COUNTER scopes hit
+// during the run of that workload. The chunk engine also reports the time of chunk hash inserts and lookups
+// on the positions of the final universe, next to the same for the older linear probing table as a baseline.
+//
+// With --soup-search it instead runs the batch soup search (see soup_search.h) and writes its throughput and census.
+//
+// Usage: bench [options]
+//  --workload NAME     runs only the given workload (can be repeated). One of:
+//                      square, r_pentomino, acorn, gosper_gun, soup, map, snapshot
+//                      (snapshot is not run by default)
+//  --generations N     number of generations to run each workload for (default 1000). For --soup-search the generations
+//                      after which a soup counts as unstable (default SOUP_SEARCH_MAX_GENERATIONS)
+//  --threads N         threads used by the step. 0 means one per hardware thread, 1 runs the serial step (default 0)
+//  --sort-period N     generations between sorting the chunks into Morton order (see chunk_hash_sort). 0 never sorts
+//                      (default CHUNK_HASH_SORT_PERIOD like the symulation)
+//  --step-generations N generations advanced per chunk visit by the step, 1 to LIFE_WIDE_MARGIN
+//                      (temporal blocking, see game_of_life_generation_step_multi) (default 1, SOUP_SEARCH_STEP_GENERATIONS
+//                      for --soup-search)
+//  --kernel NAME       life kernel to use: adder, adder_avx2, adder_avx512 or the older scalar, avx2, avx512
+//                      (default is the fastest supported)
+//  --rule RULE         rule in the B/S notation, for example B36/S23 (default B3/S23)
+//  --engine NAME       chunk or hashlife. Hashlife advances all generations at once (default chunk)
+//  --hashlife-memory N memory budget of the hashlife engine in MB (default 1024)
+//  --seed N            seed of the random soup (default 1)
+//  --soup-size N       width and height of the random soup in cells (default 512, SOUP_SEARCH_SIZE for --soup-search)
+//  --soup-density N    percentage of alive cells in the random soup (default 50)
+//  --map PATH          pattern file loaded by the map workload. Any format of parse_pattern_into_chunks (default map.txt)
+//  --snapshot PATH     snapshot loaded by the snapshot workload (default bench_snapshot.gols)
+//  --save-snapshot PATH saves the final universe of every workload run by the chunk engine there (last one wins)
+//  --max-period N      stops a workload run by the chunk engine once its universe repeats (possibly moved) with a period
+//                      of at most N generations (see universe_hash.h). 0 never stops (default 0). For --soup-search the
+//                      longest period found, at most SOUP_SEARCH_MAX_PERIOD (default SOUP_SEARCH_MAX_PERIOD)
+//  --soup-search N     runs the soup search on N soups instead of the workloads
+//  --verify N          instead of benchmarking checks every supported kernel against a cell by cell reference on N random
+//                      blocks of each of several densities for every specialized rule and a few runtime ones
+//                      the soup search census on objects with known codes, loading into a full chunk hash and
+//                      the density mipmaps (see lod.h) and a soup loaded, stepped by both engines and snapshotted
+//                      with the CHUNK_LAYOUT of the build.
+//                      Exits with 1 on any difference
+//  --stats PATH        writes the Step_Stats of every step of every workload run by the chunk engine there as a binary
+//                      time series (see stats_log.h, last one wins)
+//  --trace PATH        records every PERF_COUNTER run of every workload and writes it there in the Chrome trace format
+//                      (last one wins). Slows the run down
+//  --out PATH          where to write the JSON. "-" means stdout (default bench_output.json)
+
+#include "chunk_hash.h"
+#include "step.h"
+#include "life.h"
+#include "hashlife.h"
+#include "load.h"
+#include "snapshot.h"
+#include "stats_log.h"
+#include "universe_hash.h"
+#include "soup_search.h"
+#include "lod.h"
+#include "perf.h"
+#include "time.h"
+#include "alloc.h"
+
+#if defined(_WIN32) || defined(_WIN64) || defined(__CYGWIN__)
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+#define DEF_GENERATIONS		1000
+#define DEF_THREADS			0
+#define DEF_SEED			1
+#define DEF_SOUP_SIZE		512
+#define DEF_SOUP_DENSITY	50
+#define DEF_MAP_PATH		"map.txt"
+#define DEF_SNAPSHOT_PATH	"bench_snapshot.gols"
+#define DEF_OUT_PATH		"bench_output.json"
+#define DEF_ENGINE			"chunk"
+#define DEF_HASHLIFE_MEMORY	1024
+
+#define DEF_TRACE_EVENTS	(1 << 22)
+
+#define MAX_WORKLOADS		32
+
+typedef struct Bench_Options
+{
+	const char* workloads[MAX_WORKLOADS];
+	i32 workload_count;
+
+	i64 generations;
+	i32 threads;
+	i64 sort_period;
+	i32 step_generations;
+	i64 max_period;
+	i64 soup_search;
+	i64 verify;
+	u64 seed;
+	i32 soup_size;
+	i32 soup_density;
+	const char* map_path;
+	const char* snapshot_path;
+	const char* save_snapshot_path;
+	const char* stats_path;
+	const char* trace_path;
+	const char* out_path;
+	const char* kernel;
+	const char* rule;
+	const char* engine;
+	i64 hashlife_memory_mb;
+} Bench_Options;
+
+//Patterns in the format of parse_text_into_chunks
+static const char* R_PENTOMINO_PATTERN =
+	"3\n3\n"
+	"-XX\n"
+	"XX-\n"
+	"-X-\n";
+
+static const char* ACORN_PATTERN =
+	"7\n3\n"
+	"-X-----\n"
+	"---X---\n"
+	"XX--XXX\n";
+
+static const char* GOSPER_GUN_PATTERN =
+	"36\n9\n"
+	"------------------------X-----------\n"
+	"----------------------X-X-----------\n"
+	"------------XX------XX------------XX\n"
+	"-----------X---X----XX------------XX\n"
+	"XX--------X-----X---XX--------------\n"
+	"XX--------X---X-XX----X-X-----------\n"
+	"----------X-----X-------X-----------\n"
+	"-----------X---X--------------------\n"
+	"------------XX----------------------\n";
+
+static const char* ALL_WORKLOADS[] = {"square", "r_pentomino", "acorn", "gosper_gun", "soup", "map"};
+
+static u64 random_u64(u64* state)
+{
+	//splitmix64
+	u64 z = (*state += (u64) 0x9e3779b97f4a7c15);
+	z = (z ^ (z >> 30)) * (u64) 0xbf58476d1ce4e5b9;
+	z = (z ^ (z >> 27)) * (u64) 0x94d049bb133111eb;
+	return z ^ (z >> 31);
+}
+
+static i32 popcount64(u64 val)
+{
+	#ifdef _MSC_VER
+	return (i32) __popcnt64(val);
+	#else
+	return __builtin_popcountll(val);
+	#endif
+}
+
+static i64 chunk_hash_population(const Chunk_Hash* chunk_hash)
+{
+	i64 population = 0;
+	for(i32 i = 0; i < chunk_hash->chunk_size; i++)
+		for(i32 y = 0; y < CHUNK_SIZE; y++)
+			for(i32 w = 0; w < CHUNK_ROW_WORDS; w++)
+				population += popcount64(chunk_row(&chunk_hash->chunks[i], y)[w]);
+
+	return population;
+}
+
+//The linear probing table the chunk hash used before the tag groups, kept as a baseline for bench_chunk_hash.
+//It has the same hash and fullness (at most half, grows 4x the size) but only maps positions to indices.
+typedef struct Baseline_Hash
+{
+	Hash_Slot* slots;
+	i32 capacity; //power of two
+	i32 size;
+} Baseline_Hash;
+
+//The same hash as chunk_hash.cpp
+static u64 baseline_hash_pos(Vec2i pos)
+{
+	u64 hash = (u64) (u32) pos.y << 32 | (u32) pos.x;
+	hash = (hash ^ (hash >> 30)) * (u64) 0xbf58476d1ce4e5b9;
+	hash = (hash ^ (hash >> 27)) * (u64) 0x94d049bb133111eb;
+	return hash ^ (hash >> 31);
+}
+
+static void baseline_hash_rehash(Baseline_Hash* table, i32 min_capacity)
+{
+	i32 new_capacity = 16;
+	while(new_capacity < min_capacity)
+		new_capacity *= 2;
+
+	Hash_Slot* new_slots = (Hash_Slot*) sure_realloc(NULL, new_capacity * sizeof(Hash_Slot), 0, ALLOC_TAG_STEP);
+	memset(new_slots, 0, new_capacity * sizeof(Hash_Slot));
+
+	u64 mask = (u64) new_capacity - 1;
+	for(i32 i = 0; i < table->capacity; i++)
+	{
+		if(table->slots[i].chunk == 0)
+			continue;
+
+		u64 k = baseline_hash_pos(table->slots[i].pos) & mask;
+		while(new_slots[k].chunk > 0)
+			k = (k + 1) & mask;
+		new_slots[k] = table->slots[i];
+	}
+
+	sure_realloc(table->slots, 0, table->capacity * sizeof(Hash_Slot), ALLOC_TAG_STEP);
+	table->slots = new_slots;
+	table->capacity = new_capacity;
+}
+
+static i32 baseline_hash_insert(Baseline_Hash* table, Vec2i pos)
+{
+	if(table->size * 2 >= table->capacity)
+		baseline_hash_rehash(table, table->size * 4);
+
+	u64 mask = (u64) table->capacity - 1;
+	u64 i = baseline_hash_pos(pos) & mask;
+	for(; table->slots[i].chunk > 0; i = (i + 1) & mask)
+		if(vec_equal(table->slots[i].pos, pos))
+			return (i32) table->slots[i].chunk - 1;
+
+	table->slots[i].chunk = (u32) table->size + 1;
+	table->slots[i].pos = pos;
+	return table->size++;
+}
+
+static i32 baseline_hash_find(const Baseline_Hash* table, Vec2i pos)
+{
+	if(table->capacity == 0)
+		return -1;
+
+	u64 mask = (u64) table->capacity - 1;
+	for(u64 i = baseline_hash_pos(pos) & mask; table->slots[i].chunk > 0; i = (i + 1) & mask)
+		if(vec_equal(table->slots[i].pos, pos))
+			return (i32) table->slots[i].chunk - 1;
+
+	return -1;
+}
+
+typedef struct Hash_Bench
+{
+	f64 insert_ns; //per chunk_hash_insert_unlinked of a new position
+	f64 find_ns; //per chunk_hash_find
+
+	//the same for Baseline_Hash. Its insert does not push a chunk and its meta so it is not quite comparable
+	f64 baseline_insert_ns;
+	f64 baseline_find_ns;
+} Hash_Bench;
+
+//Times the chunk hash and Baseline_Hash on the chunk positions of a real universe. Every position is inserted into
+//an empty hash and then the 8 neighbours of every position are looked up (a mix of hits and misses, the same as linking does).
+//Small universes are repeated so that there are enough operations to time. Every position is also added once more moved far
+//into negative x so that the hashing of negative coordinates is timed as well even if the universe has none.
+static Hash_Bench bench_chunk_hash(const Chunk_Hash* universe)
+{
+	Hash_Bench result = {0};
+	i32 count = universe->chunk_size * 2;
+	if(count == 0)
+		return result;
+
+	Vec2i* positions = (Vec2i*) sure_realloc(NULL, count * sizeof(Vec2i), 0, ALLOC_TAG_STEP);
+	for(i32 i = 0; i < universe->chunk_size; i++)
+	{
+		Vec2i pos = universe->positions[i];
+		positions[2*i] = pos;
+		Vec2i moved = {pos.x - (1 << 30), pos.y};
+		positions[2*i + 1] = moved;
+	}
+
+	Chunk_Hash chunk_hash = {};
+	chunk_hash_init(&chunk_hash);
+
+	i32 repeats = 1 + (1 << 18) / count;
+	i64 found = 0;
+	f64 insert_s = 0;
+	f64 find_s = 0;
+	for(i32 repeat = 0; repeat < repeats; repeat++)
+	{
+		chunk_hash_clear(&chunk_hash);
+		f64 insert_start = clock_s();
+		for(i32 i = 0; i < count; i++)
+			chunk_hash_insert_unlinked(&chunk_hash, positions[i]);
+
+		f64 find_start = clock_s();
+		for(i32 i = 0; i < count; i++)
+			for(i32 dir = 0; dir < DIRECTION_COUNT; dir++)
+				found += chunk_hash_find(&chunk_hash, vec_add(positions[i], chunk_directions[dir])) != -1;
+
+		f64 find_end = clock_s();
+		insert_s += find_start - insert_start;
+		find_s += find_end - find_start;
+	}
+
+	Baseline_Hash baseline = {0};
+	f64 baseline_insert_s = 0;
+	f64 baseline_find_s = 0;
+	for(i32 repeat = 0; repeat < repeats; repeat++)
+	{
+		if(baseline.slots != NULL)
+			memset(baseline.slots, 0, baseline.capacity * sizeof(Hash_Slot));
+		baseline.size = 0;
+
+		f64 insert_start = clock_s();
+		for(i32 i = 0; i < count; i++)
+			baseline_hash_insert(&baseline, positions[i]);
+
+		f64 find_start = clock_s();
+		for(i32 i = 0; i < count; i++)
+			for(i32 dir = 0; dir < DIRECTION_COUNT; dir++)
+				found += baseline_hash_find(&baseline, vec_add(positions[i], chunk_directions[dir])) != -1;
+
+		f64 find_end = clock_s();
+		baseline_insert_s += find_start - insert_start;
+		baseline_find_s += find_end - find_start;
+	}
+
+	//so that the finds cannot be optimized away (the baseline ones are inlined)
+	volatile i64 found_sink = found;
+	(void) found_sink;
+
+	result.insert_ns = insert_s * 1e9 / ((f64) count * repeats);
+	result.find_ns = find_s * 1e9 / ((f64) count * DIRECTION_COUNT * repeats);
+	result.baseline_insert_ns = baseline_insert_s * 1e9 / ((f64) count * repeats);
+	result.baseline_find_ns = baseline_find_s * 1e9 / ((f64) count * DIRECTION_COUNT * repeats);
+	sure_realloc(baseline.slots, 0, baseline.capacity * sizeof(Hash_Slot), ALLOC_TAG_STEP);
+	chunk_hash_deinit(&chunk_hash);
+	sure_realloc(positions, 0, count * sizeof(Vec2i), ALLOC_TAG_STEP);
+	return result;
+}
+
+//Returns the peak memory usage of the whole process so far
+static i64 peak_memory_bytes()
+{
+	#if defined(_WIN32) || defined(_WIN64) || defined(__CYGWIN__)
+	PROCESS_MEMORY_COUNTERS counters = {0};
+	if(GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof counters) == false)
+		return 0;
+	return (i64) counters.PeakWorkingSetSize;
+	#else
+	struct rusage usage = {0};
+	if(getrusage(RUSAGE_SELF, &usage) != 0)
+		return 0;
+	return (i64) usage.ru_maxrss * 1024; //is in kilobytes
+	#endif
+}
+
+static bool load_pattern(Chunk_Hash* chunk_hash, const char* pattern)
+{
+	return parse_pattern_into_chunks(chunk_hash, pattern) == PARSE_ERROR_NONE;
+}
+
+static bool load_workload(Chunk_Hash* chunk_hash, const char* name, const Bench_Options* options)
+{
+	if(strcmp(name, "square") == 0)
+	{
+		//The same square as the one in main
+		for(i32 x = -250; x < 250; x++)
+			for(i32 y = -250; y < 250; y++)
+				set_cell_at(chunk_hash, vec(x, y), true);
+		return true;
+	}
+
+	if(strcmp(name, "soup") == 0)
+	{
+		u64 state = options->seed;
+		i32 size = options->soup_size;
+		for(i32 y = 0; y < size; y++)
+			for(i32 x = 0; x < size; x++)
+				if(random_u64(&state) % 100 < (u64) options->soup_density)
+					set_cell_at(chunk_hash, vec(x - size/2, y - size/2), true);
+		return true;
+	}
+
+	if(strcmp(name, "map") == 0)
+	{
+		char* text = NULL;
+		isize text_size = 0;
+		if(read_whole_file_alloc(options->map_path, &text, &text_size) == false)
+			return false;
+
+		bool state = load_pattern(chunk_hash, text);
+		sure_realloc(text, 0, text_size, ALLOC_TAG_FILE);
+		return state;
+	}
+
+	if(strcmp(name, "snapshot") == 0)
+	{
+		Snapshot_Error error = snapshot_load(chunk_hash, NULL, options->snapshot_path);
+		if(error != SNAPSHOT_ERROR_NONE)
+			fprintf(stderr, "snapshot '%s': %s\n", options->snapshot_path, snapshot_error_to_string(error));
+		return error == SNAPSHOT_ERROR_NONE;
+	}
+
+	if(strcmp(name, "r_pentomino") == 0)
+		return load_pattern(chunk_hash, R_PENTOMINO_PATTERN);
+	if(strcmp(name, "acorn") == 0)
+		return load_pattern(chunk_hash, ACORN_PATTERN);
+	if(strcmp(name, "gosper_gun") == 0)
+		return load_pattern(chunk_hash, GOSPER_GUN_PATTERN);
+
+	return false;
+}
+
+static void json_write_string(FILE* file, const char* str)
+{
+	fputc('"', file);
+	for(const char* c = str ? str : ""; *c != '\0'; c++)
+	{
+		if(*c == '"' || *c == '\\')
+			fprintf(file, "\\%c", *c);
+		else if((u8) *c < 0x20)
+			fprintf(file, "\\u%04x", (u32) (u8) *c);
+		else
+			fputc(*c, file);
+	}
+	fputc('"', file);
+}
+
+//Runs a single workload and writes its JSON object into file.
+//If the workload cannot be loaded writes nothing.
+static bool run_workload(FILE* file, const char* name, const Bench_Options* options, Parallel_Step* parallel_step, bool is_first)
+{
+	Chunk_Hash chunk_hashes[3] = {};
+	Chunk_Hash sorted_chunk_hash = {}; //curr is sorted into it and then swapped with it
+
+	//Same for the memory stats. The peaks are reset so that they are the peaks of this workload.
+	Alloc_Stats memory_before[ALLOC_TAG_COUNT] = {};
+	alloc_reset_peaks();
+	for(i32 i = 0; i < ALLOC_TAG_COUNT; i++)
+		memory_before[i] = alloc_get_stats((Alloc_Tag) i);
+
+	f64 load_start = clock_s();
+	bool loaded = load_workload(&chunk_hashes[0], name, options);
+	f64 load_s = clock_s() - load_start;
+	if(loaded == false)
+	{
+		fprintf(stderr, "failed to load workload '%s'\n", name);
+		chunk_hash_deinit(&chunk_hashes[0]);
+		return false;
+	}
+
+	//Report only what happened during this workload
+	perf_reset();
+	if(options->trace_path != NULL)
+		perf_trace_start(DEF_TRACE_EVENTS);
+
+	//Hashlife does not update any chunks so chunk_updates and final_chunks stay 0 for it.
+	//We also dont export its result since after many generations it can easily be too big for Chunk_Hash.
+	i64 chunk_updates = 0;
+	i64 steps = 0; //the final universe is in chunk_hashes[steps % 3]
+	i64 final_chunks = 0;
+	i64 population = 0;
+	i64 generations_run = options->generations; //less when the universe became periodic
+	Cycle_Detector cycle = {0};
+	f64 start = clock_s();
+	if(strcmp(options->engine, "hashlife") == 0)
+	{
+		Hashlife hashlife = {0};
+		hashlife_init(&hashlife, (isize) options->hashlife_memory_mb << 20);
+		hashlife_import(&hashlife, &chunk_hashes[0]);
+		hashlife_advance(&hashlife, options->generations);
+		population = (i64) hashlife_population(&hashlife);
+		hashlife_deinit(&hashlife);
+	}
+	else
+	{
+		Stats_Log stats_log = {0};
+		if(options->stats_path != NULL && stats_log_open(&stats_log, options->stats_path) == false)
+			fprintf(stderr, "could not open stats '%s'\n", options->stats_path);
+
+		//Gathering the stats slows the step down a bit so only when they are needed
+		Step_Stats stats = {0};
+		Step_Stats* gathered_stats = stats_log.file != NULL || options->max_period > 0 ? &stats : NULL;
+		i64 sorted_generation = 0;
+		for(i64 generation = 0; generation < options->generations; steps++)
+		{
+			Chunk_Hash* prev_chunk_hash = &chunk_hashes[(steps + 2) % 3];
+			Chunk_Hash* curr_chunk_hash = &chunk_hashes[(steps + 0) % 3];
+			Chunk_Hash* next_chunk_hash = &chunk_hashes[(steps + 1) % 3];
+			//The last step advances only by the generations that are left
+			i64 left = options->generations - generation;
+			i32 generations = left < options->step_generations ? (i32) left : options->step_generations;
+
+			if(options->sort_period > 0 && generation >= sorted_generation + options->sort_period)
+			{
+				sorted_generation = generation;
+				if(chunk_hash_sort(curr_chunk_hash, &sorted_chunk_hash))
+				{
+					Chunk_Hash sorted = sorted_chunk_hash;
+					sorted_chunk_hash = *curr_chunk_hash;
+					*curr_chunk_hash = sorted;
+				}
+			}
+
+			f64 step_start = clock_s();
+			chunk_hash_clear(next_chunk_hash);
+			if(parallel_step != NULL)
+				game_of_life_generation_step_multi_parallel(parallel_step, prev_chunk_hash, curr_chunk_hash, next_chunk_hash, generations, gathered_stats);
+			else
+				game_of_life_generation_step_multi(prev_chunk_hash, curr_chunk_hash, next_chunk_hash, generations, gathered_stats);
+			stats_log_write(&stats_log, generation + generations, &stats, clock_s() - step_start);
+
+			if(next_chunk_hash->full)
+			{
+				fprintf(stderr, "workload '%s' ran out of chunks in generation %lld, the results are wrong\n", name, (lld) generation);
+				break;
+			}
+
+			//counted after the step which can insert into curr_chunk_hash
+			chunk_updates += (i64) curr_chunk_hash->chunk_size * generations;
+			generation += generations;
+
+			if(options->max_period > 0 && cycle_detector_push(&cycle, generation, &stats, options->max_period))
+			{
+				steps++;
+				generations_run = generation;
+				fprintf(stderr, "workload '%s' became periodic in generation %lld (period %lld moving by %d %d)\n",
+					name, (lld) cycle.generation, (lld) cycle.period, cycle.offset.x, cycle.offset.y);
+				break;
+			}
+		}
+
+		if(stats_log_close(&stats_log) == false)
+			fprintf(stderr, "could not write stats '%s'\n", options->stats_path);
+	}
+	f64 total_s = clock_s() - start;
+	if(options->trace_path != NULL)
+	{
+		perf_trace_stop();
+		if(perf_trace_export(options->trace_path) == false)
+			fprintf(stderr, "could not write trace '%s'\n", options->trace_path);
+	}
+	f64 safe_total_s = total_s > 0 ? total_s : 1e-9;
+
+	if(strcmp(options->engine, "chunk") == 0)
+	{
+		Chunk_Hash* final_chunk_hash = &chunk_hashes[steps % 3];
+		final_chunks = final_chunk_hash->chunk_size;
+		population = chunk_hash_population(final_chunk_hash);
+
+		if(options->save_snapshot_path != NULL)
+		{
+			Snapshot_Error error = snapshot_save(final_chunk_hash, generations_run, options->save_snapshot_path);
+			if(error != SNAPSHOT_ERROR_NONE)
+				fprintf(stderr, "snapshot '%s': %s\n", options->save_snapshot_path, snapshot_error_to_string(error));
+		}
+	}
+
+	i64 peak_memory = peak_memory_bytes();
+
+	fprintf(stderr, "%-12s %10.2lf gens/s %14.0lf cells/s (%.3lf s)\n", name,
+		generations_run / safe_total_s, chunk_updates * (f64) (CHUNK_SIZE * CHUNK_SIZE) / safe_total_s, total_s);
+
+	if(is_first == false)
+		fprintf(file, ",\n");
+
+	fprintf(file, "    {\n");
+	fprintf(file, "      \"name\": "); json_write_string(file, name); fprintf(file, ",\n");
+	fprintf(file, "      \"generations\": %lld,\n", (lld) generations_run);
+	fprintf(file, "      \"load_seconds\": %.9lf,\n", load_s);
+	fprintf(file, "      \"seconds\": %.9lf,\n", total_s);
+	fprintf(file, "      \"generations_per_s\": %.3lf,\n", generations_run / safe_total_s);
+	fprintf(file, "      \"chunk_updates\": %lld,\n", (lld) chunk_updates);
+	fprintf(file, "      \"chunk_updates_per_s\": %.3lf,\n", chunk_updates / safe_total_s);
+	fprintf(file, "      \"cells_per_s\": %.3lf,\n", chunk_updates * (f64) (CHUNK_SIZE * CHUNK_SIZE) / safe_total_s);
+	fprintf(file, "      \"final_chunks\": %lld,\n", (lld) final_chunks);
+	fprintf(file, "      \"final_population\": %lld,\n", (lld) population);
+	fprintf(file, "      \"period\": %lld,\n", (lld) cycle.period);
+	fprintf(file, "      \"period_offset\": [%d, %d],\n", cycle.offset.x, cycle.offset.y);
+	fprintf(file, "      \"peak_memory_bytes\": %lld,\n", (lld) peak_memory);
+	fprintf(file, "      \"memory\": [");
+	for(i32 i = 0; i < ALLOC_TAG_COUNT; i++)
+	{
+		Alloc_Stats stats = alloc_get_stats((Alloc_Tag) i);
+		fprintf(file, "%s\n        {\"tag\": ", i == 0 ? "" : ",");
+		json_write_string(file, alloc_tag_to_string((Alloc_Tag) i));
+		fprintf(file, ", \"peak_bytes\": %lld, \"allocations\": %lld, \"reallocations\": %lld, \"frees\": %lld}",
+			(lld) stats.peak_bytes,
+			(lld) (stats.allocations - memory_before[i].allocations),
+			(lld) (stats.reallocations - memory_before[i].reallocations),
+			(lld) (stats.frees - memory_before[i].frees));
+	}
+	fprintf(file, "\n      ],\n");
+	fprintf(file, "      \"counters\": [");
+
+	//Counters are nested. parent is the index of the parent counter (-1 for top level ones).
+	bool first = true;
+	i64 counter_count = 0;
+	const Perf_Counter* counters = perf_get_counters(&counter_count);
+	for(i64 i = 0; i < counter_count; i++)
+	{
+		const Perf_Counter* counter = &counters[i];
+		if(counter->runs == 0)
+			continue;
+
+		fprintf(file, "%s\n        {\"index\": %lld, \"parent\": %d, \"name\": ", first ? "" : ",", (lld) i, (int) counter->parent);
+		json_write_string(file, counter->name);
+		fprintf(file, ", \"function\": ");
+		json_write_string(file, counter->function);
+		fprintf(file, ", \"file\": ");
+		json_write_string(file, counter->file);
+		fprintf(file, ", \"line\": %lld, \"threads\": %d, \"runs\": %lld, \"total_s\": %.9lf, \"mean_s\": %.12lf, \"p50_s\": %.12lf, \"p99_s\": %.12lf, \"max_s\": %.12lf}",
+			(lld) counter->line, (int) counter->threads, (lld) counter->runs,
+			perf_counter_get_total_running_time_s(counter),
+			perf_counter_get_average_running_time_s(counter),
+			perf_counter_get_percentile_running_time_s(counter, 0.5),
+			perf_counter_get_percentile_running_time_s(counter, 0.99),
+			perf_counter_get_max_running_time_s(counter));
+		first = false;
+	}
+	fprintf(file, "\n      ]");
+
+	//After the counters were written so that it does not show up in them
+	if(strcmp(options->engine, "chunk") == 0)
+	{
+		Hash_Bench hash_bench = bench_chunk_hash(&chunk_hashes[steps % 3]);
+		fprintf(file, ",\n      \"hash_insert_ns\": %.3lf,\n", hash_bench.insert_ns);
+		fprintf(file, "      \"hash_find_ns\": %.3lf,\n", hash_bench.find_ns);
+		fprintf(file, "      \"hash_baseline_insert_ns\": %.3lf,\n", hash_bench.baseline_insert_ns);
+		fprintf(file, "      \"hash_baseline_find_ns\": %.3lf", hash_bench.baseline_find_ns);
+		fprintf(stderr, "%-12s %10.2lf ns/insert %10.2lf ns/find (chunk hash on the final universe)\n", name, hash_bench.insert_ns, hash_bench.find_ns);
+		fprintf(stderr, "%-12s %10.2lf ns/insert %10.2lf ns/find (linear probing baseline)\n", "", hash_bench.baseline_insert_ns, hash_bench.baseline_find_ns);
+	}
+
+	fprintf(file, "\n    }");
+
+	chunk_hash_deinit(&chunk_hashes[0]);
+	chunk_hash_deinit(&chunk_hashes[1]);
+	chunk_hash_deinit(&chunk_hashes[2]);
+	chunk_hash_deinit(&sorted_chunk_hash);
+	return true;
+}
+
+static bool run_soup_search(FILE* file, const Bench_Options* options)
+{
+	Soup_Search_Options search_options = {0};
+	soup_search_default_options(&search_options);
+	search_options.seed = options->seed;
+	search_options.soup_count = options->soup_search;
+	search_options.soup_size = options->soup_size;
+	search_options.soup_density = options->soup_density;
+	search_options.threads = options->threads;
+	search_options.step_generations = options->step_generations;
+	search_options.max_generations = options->generations;
+	search_options.max_period = (i32) options->max_period;
+
+	Soup_Search_Result result = {0};
+	soup_search_run(&search_options, &result);
+
+	f64 safe_s = result.seconds > 0 ? result.seconds : 1e-9;
+	fprintf(stderr, "%lld soups (%lld stable) %10.2lf soups/s %14.0lf gens/s %lld objects of %d kinds (%.3lf s)\n",
+		(lld) result.soups, (lld) result.stable_soups, result.soups / safe_s, result.generations / safe_s,
+		(lld) result.objects, result.census.size, result.seconds);
+	for(i32 i = 0; i < result.census.size && i < 10; i++)
+	{
+		const char* object_name = soup_object_name(result.census.entries[i].code);
+		fprintf(stderr, "%12lld %s %s\n", (lld) result.census.entries[i].count, result.census.entries[i].code, object_name ? object_name : "");
+	}
+
+	fprintf(file, "{\n");
+	fprintf(file, "  \"mode\": \"soup_search\",\n");
+	fprintf(file, "  \"kernel\": "); json_write_string(file, life_kernel_name(life_kernel_get())); fprintf(file, ",\n");
+	char rule_string[LIFE_RULE_STRING_SIZE] = {0};
+	life_rule_format(life_rule_get(), rule_string, sizeof rule_string);
+	fprintf(file, "  \"rule\": "); json_write_string(file, rule_string); fprintf(file, ",\n");
+	fprintf(file, "  \"threads\": %d,\n", result.threads);
+	fprintf(file, "  \"chunk_size\": %d,\n", CHUNK_SIZE);
+	fprintf(file, "  \"seed\": %llu,\n", (unsigned long long) search_options.seed);
+	fprintf(file, "  \"soup_size\": %d,\n", search_options.soup_size);
+	fprintf(file, "  \"soup_density\": %d,\n", search_options.soup_density);
+	fprintf(file, "  \"step_generations\": %d,\n", search_options.step_generations);
+	fprintf(file, "  \"max_generations\": %lld,\n", (lld) search_options.max_generations);
+	fprintf(file, "  \"max_period\": %d,\n", search_options.max_period);
+	fprintf(file, "  \"soups\": %lld,\n", (lld) result.soups);
+	fprintf(file, "  \"stable_soups\": %lld,\n", (lld) result.stable_soups);
+	fprintf(file, "  \"seconds\": %.9lf,\n", result.seconds);
+	fprintf(file, "  \"soups_per_s\": %.3lf,\n", result.soups / safe_s);
+	fprintf(file, "  \"generations\": %lld,\n", (lld) result.generations);
+	fprintf(file, "  \"generations_per_s\": %.3lf,\n", result.generations / safe_s);
+	fprintf(file, "  \"objects\": %lld,\n", (lld) result.objects);
+	fprintf(file, "  \"peak_memory_bytes\": %lld,\n", (lld) peak_memory_bytes());
+	fprintf(file, "  \"census\": [");
+	for(i32 i = 0; i < result.census.size; i++)
+	{
+		const char* object_name = soup_object_name(result.census.entries[i].code);
+		fprintf(file, "%s\n    {\"code\": ", i == 0 ? "" : ",");
+		json_write_string(file, result.census.entries[i].code);
+		fprintf(file, ", \"name\": ");
+		if(object_name != NULL)
+			json_write_string(file, object_name);
+		else
+			fprintf(file, "null");
+		fprintf(file, ", \"count\": %lld}", (lld) result.census.entries[i].count);
+	}
+	fprintf(file, "\n  ]\n");
+	fprintf(file, "}\n");
+
+	bool ok = result.stable_soups == result.soups;
+	soup_search_result_deinit(&result);
+	return ok;
+}
+
+//Rules checked by --verify: all that have a specialized kernel (see life.cpp) and some that run on the runtime one
+static const char* VERIFY_RULES[] = {
+	"B3/S23", "B36/S23", "B3678/S34678", "B2/S", "B3/S012345678", "B36/S125", "B3/S12345", "B368/S245",
+	"B35678/S5678", "B1357/S1357", "B1/S8",
+};
+static const i32 VERIFY_DENSITIES[] = {3, 25, 50, 75, 97};
+
+//Objects whose census codes are checked by --verify: block, beehive, blinker, glider and a traffic light crossing a chunk border
+static const char* VERIFY_CENSUS_PATTERN =
+	"64\n7\n"
+	"XX-----XX----XXX----X--------------------------------------XXX--\n"
+	"XX----X--X-----------X------------------------------------------\n"
+	"-------XX----------XXX-----------------------------------X-----X\n"
+	"---------------------------------------------------------X-----X\n"
+	"---------------------------------------------------------X-----X\n"
+	"----------------------------------------------------------------\n"
+	"-----------------------------------------------------------XXX--\n";
+
+//A T-tetromino which becomes a traffic light after VERIFY_T_GENERATIONS
+static const char* VERIFY_T_PATTERN =
+	"3\n2\n"
+	"XXX\n"
+	"-X-\n";
+#define VERIFY_T_GENERATIONS 20
+
+#define VERIFY_TRAFFIC_LIGHT "xp2_s01110szw222"
+
+//Returns the word and the bit (in bit) of the cell (x, y) from -1 to CHUNK_SIZE of an assembled block (see life.h)
+static u64* assembled_cell(u64* assembled, i32 x, i32 y, u64* bit)
+{
+	#if CHUNK_HALO
+	*bit = (u64) 1 << (x + 1);
+	return &assembled[y + 1];
+	#else
+	//the left border word holds x = -1 in its last bit
+	i32 index = x + 64;
+	*bit = (u64) 1 << (index % 64);
+	return &assembled[(y + 1) * LIFE_ASSEMBLED_ROW_WORDS + index / 64];
+	#endif
+}
+
+//Returns true if the census of chunk_hash is exactly the expected codes (each once)
+static bool verify_census(const char* name, const Chunk_Hash* chunk_hash, const char* const* expected, i32 expected_count)
+{
+	Soup_Census census = {0};
+	soup_census_take(chunk_hash, SOUP_SEARCH_MAX_PERIOD, &census);
+
+	bool ok = census.size == expected_count;
+	for(i32 i = 0; i < expected_count && ok; i++)
+	{
+		bool found = false;
+		for(i32 j = 0; j < census.size; j++)
+			found = found || (strcmp(census.entries[j].code, expected[i]) == 0 && census.entries[j].count == 1);
+		ok = found;
+	}
+
+	fprintf(stderr, "census %-22s %s (", name, ok ? "ok" : "FAILED");
+	for(i32 i = 0; i < census.size; i++)
+		fprintf(stderr, "%s%s x%lld", i == 0 ? "" : ", ", census.entries[i].code, (lld) census.entries[i].count);
+	fprintf(stderr, ")\n");
+
+	soup_census_deinit(&census);
+	return ok;
+}
+
+//Checks the census of the soup search on objects with known codes
+static bool run_verify_census()
+{
+	Life_Rule rule_before = life_rule_get();
+	life_rule_set(LIFE_RULE_CONWAY);
+
+	Chunk_Hash chunk_hashes[3] = {};
+	for(i32 i = 0; i < 3; i++)
+		chunk_hash_init(&chunk_hashes[i]);
+
+	bool ok = true;
+	{
+		const char* expected[] = {"xs4_33", "xs6_696", "xp2_7", "xq4_153", VERIFY_TRAFFIC_LIGHT};
+		ok = load_pattern(&chunk_hashes[0], VERIFY_CENSUS_PATTERN) && ok;
+		ok = verify_census("hand placed objects", &chunk_hashes[0], expected, (i32) (sizeof expected / sizeof *expected)) && ok;
+	}
+
+	{
+		const char* expected[] = {VERIFY_TRAFFIC_LIGHT};
+		chunk_hash_clear(&chunk_hashes[0]);
+		ok = load_pattern(&chunk_hashes[0], VERIFY_T_PATTERN) && ok;
+		for(i32 generation = 0; generation < VERIFY_T_GENERATIONS; generation++)
+		{
+			chunk_hash_clear(&chunk_hashes[(generation + 1) % 3]);
+			game_of_life_generation_step_multi(&chunk_hashes[(generation + 2) % 3], &chunk_hashes[generation % 3], &chunk_hashes[(generation + 1) % 3], 1, NULL);
+		}
+		ok = verify_census("T-tetromino", &chunk_hashes[VERIFY_T_GENERATIONS % 3], expected, 1) && ok;
+	}
+
+	for(i32 i = 0; i < 3; i++)
+		chunk_hash_deinit(&chunk_hashes[i]);
+	life_rule_set(rule_before);
+	return ok;
+}
+
+//Checks life_kernel_run of every supported kernel and every rule of VERIFY_RULES against a naive count of the neighbours
+static bool run_verify_kernels(i64 blocks)
+{
+	Life_Kernel kernel_before = life_kernel_get();
+	Life_Rule rule_before = life_rule_get();
+	bool all_ok = true;
+	u64 random_state = DEF_SEED;
+
+	static u64 assembled[LIFE_ASSEMBLED_WORDS];
+	static Chunk expected;
+	static Chunk next;
+	for(i32 r = 0; r < (i32) (sizeof VERIFY_RULES / sizeof *VERIFY_RULES); r++)
+	{
+		Life_Rule rule = {0};
+		bool parsed = life_rule_parse(&rule, VERIFY_RULES[r]);
+		assert(parsed);
+		life_rule_set(rule);
+
+		i64 wrong_blocks[LIFE_KERNEL_COUNT] = {0};
+		for(i32 d = 0; d < (i32) (sizeof VERIFY_DENSITIES / sizeof *VERIFY_DENSITIES); d++)
+		{
+			for(i64 b = 0; b < blocks; b++)
+			{
+				memset(assembled, 0, sizeof assembled);
+				for(i32 y = -1; y <= CHUNK_SIZE; y++)
+					for(i32 x = -1; x <= CHUNK_SIZE; x++)
+						if(random_u64(&random_state) % 100 < (u64) VERIFY_DENSITIES[d])
+						{
+							u64 bit = 0;
+							*assembled_cell(assembled, x, y, &bit) |= bit;
+						}
+
+				memset(&expected, 0, sizeof expected);
+				for(i32 y = 0; y < CHUNK_SIZE; y++)
+					for(i32 x = 0; x < CHUNK_SIZE; x++)
+					{
+						u32 count = 0;
+						for(i32 i = 0; i < DIRECTION_COUNT; i++)
+						{
+							u64 bit = 0;
+							count += (*assembled_cell(assembled, x + chunk_directions[i].x, y + chunk_directions[i].y, &bit) & bit) != 0;
+						}
+
+						u64 bit = 0;
+						bool alive = (*assembled_cell(assembled, x, y, &bit) & bit) != 0;
+						u32 mask = alive ? rule.survive : rule.birth;
+						chunk_set_cell(&expected, vec(x, y), (mask >> count) & 1);
+					}
+
+				for(i32 k = 0; k < LIFE_KERNEL_COUNT; k++)
+				{
+					if(life_kernel_set((Life_Kernel) k) == false)
+						continue;
+
+					memset(&next, 0, sizeof next);
+					life_kernel_run(assembled, next.data);
+
+					bool same = true;
+					for(i32 y = 0; y < CHUNK_SIZE && same; y++)
+						for(i32 x = 0; x < CHUNK_SIZE && same; x++)
+							same = chunk_get_cell(&next, vec(x, y)) == chunk_get_cell(&expected, vec(x, y));
+
+					wrong_blocks[k] += same == false;
+				}
+			}
+		}
+
+		for(i32 k = 0; k < LIFE_KERNEL_COUNT; k++)
+		{
+			if(life_kernel_is_supported((Life_Kernel) k) == false)
+				continue;
+
+			char rule_string[LIFE_RULE_STRING_SIZE] = {0};
+			life_rule_format(rule, rule_string, sizeof rule_string);
+			fprintf(stderr, "%-14s %-13s %-11s %s (%lld of %lld blocks wrong)\n", rule_string, life_kernel_name((Life_Kernel) k),
+				life_rule_is_specialized(rule) ? "specialized" : "runtime", wrong_blocks[k] == 0 ? "ok" : "FAILED",
+				(lld) wrong_blocks[k], (lld) (blocks * (i64) (sizeof VERIFY_DENSITIES / sizeof *VERIFY_DENSITIES)));
+			all_ok = all_ok && wrong_blocks[k] == 0;
+		}
+	}
+
+	life_rule_set(rule_before);
+	life_kernel_set(kernel_before);
+	return all_ok;
+}
+
+//A pattern of VERIFY_FULL_WIDTH x VERIFY_FULL_HEIGHT alive cells loaded into a hash limited to VERIFY_FULL_CHUNKS
+#define VERIFY_FULL_WIDTH	2600
+#define VERIFY_FULL_HEIGHT	600
+#define VERIFY_FULL_CHUNKS	64
+
+//Checks that loading a pattern into a hash that runs out of space loads only what fits and reports it
+static bool run_verify_load_full()
+{
+	//RLE with every row a single run
+	char line[32] = {0};
+	snprintf(line, sizeof line, "%do$", VERIFY_FULL_WIDTH);
+	isize line_size = (isize) strlen(line);
+	isize pattern_size = 64 + VERIFY_FULL_HEIGHT * line_size;
+	char* pattern = (char*) sure_realloc(NULL, pattern_size, 0, ALLOC_TAG_FILE);
+	isize written = snprintf(pattern, 64, "x = %d, y = %d\n", VERIFY_FULL_WIDTH, VERIFY_FULL_HEIGHT);
+	for(i32 y = 0; y < VERIFY_FULL_HEIGHT; y++, written += line_size)
+		memcpy(pattern + written, line, line_size);
+	pattern[written - 1] = '!';
+	pattern[written] = '\0';
+
+	Chunk_Hash chunk_hash = {};
+	chunk_hash_init(&chunk_hash);
+	chunk_hash.chunk_limit = VERIFY_FULL_CHUNKS;
+	Parse_Error error = parse_pattern_into_chunks(&chunk_hash, pattern);
+
+	//Whatever got loaded has to be a part of the pattern. RLE patterns are centered (see parse_rle_into_chunks).
+	i32 origin_x = -VERIFY_FULL_WIDTH/2 + CHUNK_SIZE/2;
+	i32 origin_y = -VERIFY_FULL_HEIGHT/2 + CHUNK_SIZE/2;
+	bool inside = true;
+	for(i32 i = 0; i < chunk_hash.chunk_size; i++)
+		for(i32 y = 0; y < CHUNK_SIZE; y++)
+			for(i32 x = 0; x < CHUNK_SIZE; x++)
+			{
+				i32 cell_x = chunk_hash.positions[i].x * CHUNK_SIZE + x - origin_x;
+				i32 cell_y = chunk_hash.positions[i].y * CHUNK_SIZE + y - origin_y;
+				bool in_pattern = 0 <= cell_x && cell_x < VERIFY_FULL_WIDTH && 0 <= cell_y && cell_y < VERIFY_FULL_HEIGHT;
+				inside = inside && (chunk_get_cell(&chunk_hash.chunks[i], vec(x, y)) == false || in_pattern);
+			}
+
+	bool ok = error == PARSE_ERROR_FULL && chunk_hash.full && chunk_hash.chunk_size <= VERIFY_FULL_CHUNKS && inside;
+	fprintf(stderr, "load into full hash          %s (%s, %d chunks)\n", ok ? "ok" : "FAILED", parse_error_to_string(error), chunk_hash.chunk_size);
+
+	chunk_hash_deinit(&chunk_hash);
+	sure_realloc(pattern, 0, pattern_size, ALLOC_TAG_FILE);
+	return ok;
+}
+
+//Random cells of a VERIFY_LOD_SIZE square around the origin and a few far away ones so that there are many levels
+#define VERIFY_LOD_SIZE		400
+#define VERIFY_LOD_DENSITY	30
+
+//Checks that every level of the density mipmaps sums to the population of the universe
+static bool run_verify_lod()
+{
+	Chunk_Hash chunk_hash = {};
+	chunk_hash_init(&chunk_hash);
+
+	u64 random_state = DEF_SEED;
+	for(i32 y = -VERIFY_LOD_SIZE/2; y < VERIFY_LOD_SIZE/2; y++)
+		for(i32 x = -VERIFY_LOD_SIZE/2; x < VERIFY_LOD_SIZE/2; x++)
+			if(random_u64(&random_state) % 100 < VERIFY_LOD_DENSITY)
+				set_cell_at(&chunk_hash, vec(x, y), true);
+
+	const Vec2i far_cells[] = {{100000, -70000}, {-123457, 98765}, {-3, -250000}};
+	for(i32 i = 0; i < (i32) (sizeof far_cells / sizeof *far_cells); i++)
+		set_cell_at(&chunk_hash, far_cells[i], true);
+
+	Lod lod = {0};
+	lod_init(&lod);
+	lod_build(&lod, &chunk_hash);
+
+	i64 population = chunk_hash_population(&chunk_hash);
+	bool ok = lod.level_count > 1;
+	for(i32 level = 0; level < lod.level_count; level++)
+	{
+		i64 sum = 0;
+		const Lod_Level* lod_level = &lod.levels[level];
+		for(i32 i = 0; i < lod_level->size; i++)
+			for(i32 t = 0; t < LOD_TILE * LOD_TILE; t++)
+				sum += lod_level->tiles[i].counts[t];
+
+		ok = ok && sum == population;
+	}
+
+	fprintf(stderr, "lod levels sum to population  %s (%d levels, population %lld)\n", ok ? "ok" : "FAILED", lod.level_count, (lld) population);
+
+	//The picked level has texels of at most a pixel and the one above it would not (unless it is level 0 or the last)
+	bool picked_ok = true;
+	const f64 cell_pixels[] = {0.3, 0.1, 0.05, 0.01, 1e-3, 1e-5};
+	for(i32 i = 0; i < (i32) (sizeof cell_pixels / sizeof *cell_pixels); i++)
+	{
+		i32 level = lod_pick_level(&lod, cell_pixels[i]);
+		f64 texel_pixels = cell_pixels[i] * (f64) ((i64) CHUNK_SIZE << level) / LOD_TILE;
+		picked_ok = picked_ok && (texel_pixels <= 1.0 || level == 0);
+		picked_ok = picked_ok && (texel_pixels * 2 > 1.0 || level + 1 == lod.level_count);
+	}
+	fprintf(stderr, "lod level texels about a pixel %s\n", picked_ok ? "ok" : "FAILED");
+	ok = ok && picked_ok;
+	lod_deinit(&lod);
+	chunk_hash_deinit(&chunk_hash);
+	return ok;
+}
+
+//Random soup of VERIFY_ENGINES_SIZE x VERIFY_ENGINES_SIZE cells run for VERIFY_ENGINES_GENERATIONS by both engines
+#define VERIFY_ENGINES_SIZE			200
+#define VERIFY_ENGINES_DENSITY		35
+#define VERIFY_ENGINES_GENERATIONS	300
+#define VERIFY_ENGINES_SNAPSHOT		"bench_verify.gols"
+
+//Returns true if both universes have the same alive cells
+static bool same_cells(const Chunk_Hash* a, Chunk_Hash* b)
+{
+	if(chunk_hash_population(a) != chunk_hash_population(b))
+		return false;
+
+	for(i32 i = 0; i < a->chunk_size; i++)
+	{
+		i32 found = chunk_hash_find(b, a->positions[i]);
+		for(i32 y = 0; y < CHUNK_SIZE; y++)
+			for(i32 x = 0; x < CHUNK_SIZE; x++)
+				if(chunk_get_cell(&a->chunks[i], vec(x, y)) && (found == -1 || chunk_get_cell(&b->chunks[found], vec(x, y)) == false))
+					return false;
+	}
+
+	return true;
+}
+
+//Checks the parts that depend on the chunk layout against each other: a soup loaded from RLE against the same cells set
+//one by one, the chunk engine (stepping by all sizes up to LIFE_WIDE_MARGIN and sorting the chunks on the way) against HashLife
+//and the result against itself saved into a snapshot and loaded back.
+static bool run_verify_engines()
+{
+	Life_Rule rule_before = life_rule_get();
+	life_rule_set(LIFE_RULE_CONWAY);
+
+	Chunk_Hash chunk_hashes[3] = {};
+	Chunk_Hash expected = {};
+	Chunk_Hash sorted = {};
+	for(i32 i = 0; i < 3; i++)
+		chunk_hash_init(&chunk_hashes[i]);
+	chunk_hash_init(&expected);
+	chunk_hash_init(&sorted);
+
+	//RLE patterns are centered (see parse_rle_into_chunks)
+	isize pattern_size = 64 + VERIFY_ENGINES_SIZE * (VERIFY_ENGINES_SIZE + 1) + 1;
+	char* pattern = (char*) sure_realloc(NULL, pattern_size, 0, ALLOC_TAG_FILE);
+	isize written = snprintf(pattern, 64, "x = %d, y = %d\n", VERIFY_ENGINES_SIZE, VERIFY_ENGINES_SIZE);
+	u64 random_state = DEF_SEED;
+	i32 origin = -VERIFY_ENGINES_SIZE/2 + CHUNK_SIZE/2;
+	for(i32 y = 0; y < VERIFY_ENGINES_SIZE; y++)
+	{
+		for(i32 x = 0; x < VERIFY_ENGINES_SIZE; x++)
+		{
+			bool alive = random_u64(&random_state) % 100 < VERIFY_ENGINES_DENSITY;
+			pattern[written++] = alive ? 'o' : 'b';
+			if(alive)
+				set_cell_at(&expected, vec(origin + x, origin + y), true);
+		}
+		pattern[written++] = y + 1 < VERIFY_ENGINES_SIZE ? '$' : '!';
+	}
+	pattern[written] = '\0';
+
+	bool loaded = load_pattern(&chunk_hashes[0], pattern);
+	bool load_ok = loaded && same_cells(&expected, &chunk_hashes[0]);
+	fprintf(stderr, "layout %-3d load rle          %s (population %lld)\n", CHUNK_LAYOUT, load_ok ? "ok" : "FAILED", (lld) chunk_hash_population(&expected));
+
+	Hashlife hashlife = {0};
+	hashlife_init(&hashlife, 0);
+	hashlife_import(&hashlife, &chunk_hashes[0]);
+	hashlife_advance(&hashlife, VERIFY_ENGINES_GENERATIONS);
+	hashlife_export(&hashlife, &expected);
+	hashlife_deinit(&hashlife);
+
+	i64 steps = 0;
+	for(i64 generation = 0; generation < VERIFY_ENGINES_GENERATIONS; steps++)
+	{
+		Chunk_Hash* prev_chunk_hash = &chunk_hashes[(steps + 2) % 3];
+		Chunk_Hash* curr_chunk_hash = &chunk_hashes[(steps + 0) % 3];
+		Chunk_Hash* next_chunk_hash = &chunk_hashes[(steps + 1) % 3];
+		i64 left = VERIFY_ENGINES_GENERATIONS - generation;
+		i32 generations = 1 + (i32) (steps % LIFE_WIDE_MARGIN);
+		if(generations > left)
+			generations = (i32) left;
+
+		if(steps % 16 == 15 && chunk_hash_sort(curr_chunk_hash, &sorted))
+		{
+			Chunk_Hash swapped = sorted;
+			sorted = *curr_chunk_hash;
+			*curr_chunk_hash = swapped;
+		}
+
+		chunk_hash_clear(next_chunk_hash);
+		game_of_life_generation_step_multi(prev_chunk_hash, curr_chunk_hash, next_chunk_hash, generations, NULL);
+		generation += generations;
+	}
+
+	Chunk_Hash* stepped = &chunk_hashes[steps % 3];
+	bool step_ok = stepped->full == false && same_cells(&expected, stepped);
+	fprintf(stderr, "layout %-3d chunk vs hashlife %s (population %lld after %d generations)\n", CHUNK_LAYOUT, step_ok ? "ok" : "FAILED",
+		(lld) chunk_hash_population(stepped), VERIFY_ENGINES_GENERATIONS);
+
+	//Loaded into sorted which is not needed anymore
+	Snapshot_Error error = snapshot_save(stepped, VERIFY_ENGINES_GENERATIONS, VERIFY_ENGINES_SNAPSHOT);
+	i64 snapshot_generation = 0;
+	if(error == SNAPSHOT_ERROR_NONE)
+		error = snapshot_load(&sorted, &snapshot_generation, VERIFY_ENGINES_SNAPSHOT);
+	bool snapshot_ok = error == SNAPSHOT_ERROR_NONE && snapshot_generation == VERIFY_ENGINES_GENERATIONS && same_cells(stepped, &sorted);
+	fprintf(stderr, "layout %-3d snapshot          %s (%s)\n", CHUNK_LAYOUT, snapshot_ok ? "ok" : "FAILED", snapshot_error_to_string(error));
+
+	//Unmaps the snapshot before it is removed
+	for(i32 i = 0; i < 3; i++)
+		chunk_hash_deinit(&chunk_hashes[i]);
+	chunk_hash_deinit(&expected);
+	chunk_hash_deinit(&sorted);
+	remove(VERIFY_ENGINES_SNAPSHOT);
+	sure_realloc(pattern, 0, pattern_size, ALLOC_TAG_FILE);
+	life_rule_set(rule_before);
+	return load_ok && step_ok && snapshot_ok;
+}
+
+static bool run_verify(i64 blocks)
+{
+	bool ok = run_verify_kernels(blocks);
+	ok = run_verify_census() && ok;
+	ok = run_verify_load_full() && ok;
+	ok = run_verify_lod() && ok;
+	ok = run_verify_engines() && ok;
+	return ok;
+}
+
+static bool parse_options(Bench_Options* options, int argc, char *argv[])
+{
+	//The ones left at 0 have different defaults for the soup search and are filled in below
+	options->threads = DEF_THREADS;
+	options->seed = DEF_SEED;
+	options->soup_density = DEF_SOUP_DENSITY;
+	options->map_path = DEF_MAP_PATH;
+	options->snapshot_path = DEF_SNAPSHOT_PATH;
+	options->out_path = DEF_OUT_PATH;
+	options->engine = DEF_ENGINE;
+	options->hashlife_memory_mb = DEF_HASHLIFE_MEMORY;
+	options->sort_period = CHUNK_HASH_SORT_PERIOD;
+
+	for(int i = 1; i < argc; i++)
+	{
+		const char* arg = argv[i];
+		const char* value = i + 1 < argc ? argv[i + 1] : NULL;
+		if(value == NULL)
+		{
+			fprintf(stderr, "missing value for '%s'\n", arg);
+			return false;
+		}
+
+		i++;
+		if(strcmp(arg, "--workload") == 0 && options->workload_count < MAX_WORKLOADS)
+			options->workloads[options->workload_count++] = value;
+		else if(strcmp(arg, "--generations") == 0)
+			options->generations = atoll(value);
+		else if(strcmp(arg, "--threads") == 0)
+			options->threads = atoi(value);
+		else if(strcmp(arg, "--kernel") == 0)
+			options->kernel = value;
+		else if(strcmp(arg, "--rule") == 0)
+			options->rule = value;
+		else if(strcmp(arg, "--engine") == 0)
+			options->engine = value;
+		else if(strcmp(arg, "--hashlife-memory") == 0)
+			options->hashlife_memory_mb = atoll(value);
+		else if(strcmp(arg, "--sort-period") == 0)
+			options->sort_period = atoll(value);
+		else if(strcmp(arg, "--step-generations") == 0)
+			options->step_generations = atoi(value);
+		else if(strcmp(arg, "--seed") == 0)
+			options->seed = (u64) strtoull(value, NULL, 10);
+		else if(strcmp(arg, "--soup-size") == 0)
+			options->soup_size = atoi(value);
+		else if(strcmp(arg, "--soup-density") == 0)
+			options->soup_density = atoi(value);
+		else if(strcmp(arg, "--map") == 0)
+			options->map_path = value;
+		else if(strcmp(arg, "--snapshot") == 0)
+			options->snapshot_path = value;
+		else if(strcmp(arg, "--save-snapshot") == 0)
+			options->save_snapshot_path = value;
+		else if(strcmp(arg, "--max-period") == 0)
+			options->max_period = atoll(value);
+		else if(strcmp(arg, "--soup-search") == 0)
+			options->soup_search = atoll(value);
+		else if(strcmp(arg, "--verify") == 0)
+			options->verify = atoll(value);
+		else if(strcmp(arg, "--stats") == 0)
+			options->stats_path = value;
+		else if(strcmp(arg, "--trace") == 0)
+			options->trace_path = value;
+		else if(strcmp(arg, "--out") == 0)
+			options->out_path = value;
+		else
+		{
+			fprintf(stderr, "unknown option '%s'\n", arg);
+			return false;
+		}
+	}
+
+	if(strcmp(options->engine, "chunk") != 0 && strcmp(options->engine, "hashlife") != 0)
+	{
+		fprintf(stderr, "engine '%s' is unknown\n", options->engine);
+		return false;
+	}
+
+	if(options->soup_search > 0)
+	{
+		Soup_Search_Options defaults = {0};
+		soup_search_default_options(&defaults);
+		if(options->generations == 0)
+			options->generations = defaults.max_generations;
+		if(options->soup_size == 0)
+			options->soup_size = defaults.soup_size;
+		if(options->step_generations == 0)
+			options->step_generations = defaults.step_generations;
+		if(options->max_period == 0)
+			options->max_period = defaults.max_period;
+
+		if(options->max_period < 1 || options->max_period > SOUP_SEARCH_MAX_PERIOD)
+		{
+			fprintf(stderr, "max period of the soup search must be between 1 and %d\n", SOUP_SEARCH_MAX_PERIOD);
+			return false;
+		}
+	}
+	else
+	{
+		if(options->generations == 0)
+			options->generations = DEF_GENERATIONS;
+		if(options->soup_size == 0)
+			options->soup_size = DEF_SOUP_SIZE;
+		if(options->step_generations == 0)
+			options->step_generations = 1;
+	}
+
+	if(options->step_generations < 1 || options->step_generations > LIFE_WIDE_MARGIN)
+	{
+		fprintf(stderr, "step generations must be between 1 and %d\n", LIFE_WIDE_MARGIN);
+		return false;
+	}
+
+	if(options->workload_count == 0)
+	{
+		for(i32 i = 0; i < (i32) (sizeof ALL_WORKLOADS / sizeof *ALL_WORKLOADS); i++)
+			options->workloads[options->workload_count++] = ALL_WORKLOADS[i];
+	}
+
+	return true;
+}
+
+int main(int argc, char *argv[])
+{
+	Bench_Options options = {0};
+	if(parse_options(&options, argc, argv) == false)
+		return 1;
+
+	if(options.kernel != NULL)
+	{
+		bool found = false;
+		for(i32 i = 0; i < LIFE_KERNEL_COUNT; i++)
+			if(strcmp(options.kernel, life_kernel_name((Life_Kernel) i)) == 0)
+				found = life_kernel_set((Life_Kernel) i);
+
+		if(found == false)
+		{
+			fprintf(stderr, "kernel '%s' is unknown or not supported\n", options.kernel);
+			return 1;
+		}
+	}
+
+	if(options.rule != NULL)
+	{
+		Life_Rule rule = {0};
+		if(life_rule_parse(&rule, options.rule) == false || life_rule_set(rule) == false)
+		{
+			fprintf(stderr, "rule '%s' is invalid or not supported\n", options.rule);
+			return 1;
+		}
+	}
+
+	if(options.verify > 0)
+		return run_verify(options.verify) ? 0 : 1;
+
+	FILE* file = stdout;
+	if(strcmp(options.out_path, "-") != 0)
+		file = fopen(options.out_path, "wb");
+
+	if(file == NULL)
+	{
+		fprintf(stderr, "could not open '%s'\n", options.out_path);
+		return 1;
+	}
+
+	if(options.soup_search > 0)
+	{
+		bool ok = run_soup_search(file, &options);
+		if(file != stdout)
+			fclose(file);
+		return ok ? 0 : 1;
+	}
+
+	Parallel_Step parallel_step = {};
+	Parallel_Step* used_parallel_step = NULL;
+	if(options.threads != 1)
+	{
+		parallel_step_init(&parallel_step, options.threads);
+		used_parallel_step = &parallel_step;
+	}
+
+	fprintf(file, "{\n");
+	fprintf(file, "  \"engine\": "); json_write_string(file, options.engine); fprintf(file, ",\n");
+	fprintf(file, "  \"kernel\": "); json_write_string(file, life_kernel_name(life_kernel_get())); fprintf(file, ",\n");
+	char rule_string[LIFE_RULE_STRING_SIZE] = {0};
+	life_rule_format(life_rule_get(), rule_string, sizeof rule_string);
+	fprintf(file, "  \"rule\": "); json_write_string(file, rule_string); fprintf(file, ",\n");
+	fprintf(file, "  \"rule_specialized\": %s,\n", life_rule_is_specialized(life_rule_get()) ? "true" : "false");
+	fprintf(file, "  \"threads\": %d,\n", used_parallel_step ? parallel_step.pool.thread_count : 1);
+	fprintf(file, "  \"chunk_size\": %d,\n", CHUNK_SIZE);
+	fprintf(file, "  \"sort_period\": %lld,\n", (lld) options.sort_period);
+	fprintf(file, "  \"step_generations\": %d,\n", options.step_generations);
+	fprintf(file, "  \"max_period\": %lld,\n", (lld) options.max_period);
+	fprintf(file, "  \"seed\": %llu,\n", (unsigned long long) options.seed);
+	fprintf(file, "  \"workloads\": [\n");
+
+	bool all_ok = true;
+	bool first = true;
+	for(i32 i = 0; i < options.workload_count; i++)
+	{
+		bool ok = run_workload(file, options.workloads[i], &options, used_parallel_step, first);
+		all_ok = all_ok && ok;
+		first = first && ok == false;
+	}
+
+	fprintf(file, "\n  ]\n");
+	fprintf(file, "}\n");
+
+	if(file != stdout)
+		fclose(file);
+
+	parallel_step_deinit(&parallel_step);
+	return all_ok ? 0 : 1;
+}
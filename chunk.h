@@ -1,37 +1,156 @@
 #pragma once
 #include "types.h"
 
-#define CHUNK_SIZE 61
+// The geometry of a chunk is chosen at compile time by defining CHUNK_LAYOUT
+// (for example -DCHUNK_LAYOUT=128 or in the project settings) to one of:
+//
+// CHUNK_LAYOUT_61  - the original. 61x61 cells stored inside a 64x64 bit field (one u64 per row).
+//                    The remaining cells around the content form a 1 cell halo which the step fills
+//                    from the neighbouring chunks so the whole block can be computed in place.
+// CHUNK_LAYOUT_64  - 64x64 cells, one u64 per row, no halo. The step gathers the halo out of band.
+// CHUNK_LAYOUT_128 - 128x128 cells, rows of 2 u64s, no halo.
+// CHUNK_LAYOUT_256 - 256x256 cells, rows of 4 u64s, no halo.
+//
+// Bigger chunks mean less per chunk overhead (hashing, linking, assembling) but coarser skipping of
+// stable and empty areas. Which one wins depends on the pattern so just benchmark them.
+//
+// Everything outside of step.cpp and life.cpp should access the cells only through the functions below.
+#define CHUNK_LAYOUT_61  61
+#define CHUNK_LAYOUT_64  64
+#define CHUNK_LAYOUT_128 128
+#define CHUNK_LAYOUT_256 256
+
+#ifndef CHUNK_LAYOUT
+#define CHUNK_LAYOUT CHUNK_LAYOUT_61
+#endif
+
+#if CHUNK_LAYOUT == CHUNK_LAYOUT_61
+	#define CHUNK_SIZE 61      /* cells in each row and column of content */
+	#define CHUNK_HALO 1       /* cells of halo stored on each side of the content */
+	#define CHUNK_ROW_WORDS 1  /* u64s per stored row */
+	#define CHUNK_ROWS 64      /* stored rows (content + halo + padding) */
+#elif CHUNK_LAYOUT == CHUNK_LAYOUT_64
+	#define CHUNK_SIZE 64
+	#define CHUNK_HALO 0
+	#define CHUNK_ROW_WORDS 1
+	#define CHUNK_ROWS 64
+#elif CHUNK_LAYOUT == CHUNK_LAYOUT_128
+	#define CHUNK_SIZE 128
+	#define CHUNK_HALO 0
+	#define CHUNK_ROW_WORDS 2
+	#define CHUNK_ROWS 128
+#elif CHUNK_LAYOUT == CHUNK_LAYOUT_256
+	#define CHUNK_SIZE 256
+	#define CHUNK_HALO 0
+	#define CHUNK_ROW_WORDS 4
+	#define CHUNK_ROWS 256
+#else
+	#error "CHUNK_LAYOUT must be one of CHUNK_LAYOUT_61, CHUNK_LAYOUT_64, CHUNK_LAYOUT_128 or CHUNK_LAYOUT_256"
+#endif
+
+//Layouts without halo have to fill their rows exactly (the step relies on it)
+static_assert(CHUNK_HALO != 0 || CHUNK_SIZE == CHUNK_ROW_WORDS * 64, "rows without halo must be fully used");
+static_assert(CHUNK_SIZE + 2*CHUNK_HALO <= CHUNK_ROW_WORDS * 64 && CHUNK_SIZE + 2*CHUNK_HALO <= CHUNK_ROWS, "content and halo must fit");
+
+//Only the cells of a chunk. Its position is kept separately (see Chunk_Hash::positions) so that
+//chunks are a whole number of cache lines and stay aligned to them in the (page aligned) chunk arrays.
 typedef struct Chunk
 {
-	Vec2i pos;
-
-	//contains 64x64 bit field of cells
-	//Only the cells starting at index (1,1) and 
-	//ending at (61,61) are considered a part of the chunk
-	//the rest is from neighbouring chunks during loading 
-	u64 data[64]; 
+	//CHUNK_ROWS rows of CHUNK_ROW_WORDS u64 each. Cell (x, y) is the bit x + CHUNK_HALO
+	//(counting from the lowest bit of the first word) of the row y + CHUNK_HALO.
+	//Only the cells from (0, 0) to (CHUNK_SIZE, CHUNK_SIZE) (exclusive) are a part of the chunk,
+	//the halo around is from the neighbouring chunks during the step and otherwise zero.
+	u64 data[CHUNK_ROWS * CHUNK_ROW_WORDS]; 
 } Chunk;
 
+static_assert(sizeof(Chunk) % 64 == 0, "chunks must be whole cache lines");
+
+//Directions to the 8 neighbouring chunks
+typedef enum Chunk_Direction
+{
+	DIRECTION_TOP_L = 0,
+	DIRECTION_TOP,
+	DIRECTION_TOP_R,
+	DIRECTION_LEFT,
+	DIRECTION_RIGHT,
+	DIRECTION_BOT_L,
+	DIRECTION_BOT,
+	DIRECTION_BOT_R,
+	DIRECTION_COUNT,
+} Chunk_Direction;
+
+//Offsets of the neighbouring chunks indexed by Chunk_Direction.
+//The opposite direction of dir is always DIRECTION_COUNT - 1 - dir
+static const Vec2i chunk_directions[DIRECTION_COUNT] = {
+	{-1, -1},{0, -1},{1, -1},
+	{-1, 0}, /* X */ {1,  0},
+	{-1,  1},{0,  1},{1,  1},
+};
+
+//Returns the CHUNK_ROW_WORDS words of the row y
+static u64* chunk_row(Chunk* chunk, i32 y)
+{
+	assert(-CHUNK_HALO <= y && y < CHUNK_SIZE + CHUNK_HALO);
+	return &chunk->data[(y + CHUNK_HALO) * CHUNK_ROW_WORDS];
+}
+
+static const u64* chunk_row(const Chunk* chunk, i32 y)
+{
+	assert(-CHUNK_HALO <= y && y < CHUNK_SIZE + CHUNK_HALO);
+	return &chunk->data[(y + CHUNK_HALO) * CHUNK_ROW_WORDS];
+}
+
+//Returns count cells (at most 64) of a row starting at x as bits (bit 0 is x).
+//The row has to be in the format of chunk_row.
+static u64 chunk_row_get_bits(const u64* row, i32 x, i32 count)
+{
+	assert(0 < count && count <= 64 && -CHUNK_HALO <= x && x + count <= CHUNK_SIZE + CHUNK_HALO);
+	i32 index = x + CHUNK_HALO;
+	i32 word = index / 64;
+	i32 shift = index % 64;
+
+	u64 bits = row[word] >> shift;
+	if(shift != 0 && word + 1 < CHUNK_ROW_WORDS)
+		bits |= row[word + 1] << (64 - shift);
+	if(count < 64)
+		bits &= ((u64) 1 << count) - 1;
+	return bits;
+}
+
+//Sets the cells of a row starting at x which correspond to the set bits of cells (bit 0 is x).
+//All set bits have to land inside the row.
+static void chunk_row_or_bits(u64* row, i32 x, u64 cells)
+{
+	assert(-CHUNK_HALO <= x && x < CHUNK_SIZE + CHUNK_HALO);
+	i32 index = x + CHUNK_HALO;
+	i32 word = index / 64;
+	i32 shift = index % 64;
+
+	row[word] |= cells << shift;
+	if(shift != 0 && word + 1 < CHUNK_ROW_WORDS)
+		row[word + 1] |= cells >> (64 - shift);
+}
+
 static bool chunk_get_cell(const Chunk* chunk, Vec2i pos)
 {
-	assert(-1 <= pos.x && pos.x < CHUNK_SIZE + 1);
-	assert(-1 <= pos.y && pos.y < CHUNK_SIZE + 1);
+	assert(-CHUNK_HALO <= pos.x && pos.x < CHUNK_SIZE + CHUNK_HALO);
 	
-	u64 bit = (u64) 1 << (pos.x + 1);
+	i32 index = pos.x + CHUNK_HALO;
+	u64 bit = (u64) 1 << (index % 64);
 	
-	return (chunk->data[pos.y + 1] & bit) > 0;
+	return (chunk_row(chunk, pos.y)[index / 64] & bit) > 0;
 }
 
 static void chunk_set_cell(Chunk* chunk, Vec2i pos, bool to)
 {
-	assert(-1 <= pos.x && pos.x < CHUNK_SIZE + 1);
-	assert(-1 <= pos.y && pos.y < CHUNK_SIZE + 1);
+	assert(-CHUNK_HALO <= pos.x && pos.x < CHUNK_SIZE + CHUNK_HALO);
 
-	u64 bit = (u64) 1 << (pos.x + 1);
+	i32 index = pos.x + CHUNK_HALO;
+	u64 bit = (u64) 1 << (index % 64);
+	u64* word = &chunk_row(chunk, pos.y)[index / 64];
 	
 	if(to)
-		chunk->data[pos.y + 1] |= bit;
+		*word |= bit;
 	else
-		chunk->data[pos.y + 1] &= ~bit;
+		*word &= ~bit;
 }	
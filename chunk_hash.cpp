@@ -1,6 +1,17 @@
 #include "chunk_hash.h"
 #include "perf.h"
 #include "alloc.h"
+#include "threads.h"
+#include "virtual_memory.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#define CHUNK_HASH_SSE2
+	#include <emmintrin.h>
+#endif
+
+#ifdef _MSC_VER
+	#include <intrin.h>
+#endif
 
 u64 hash64(u64 value) 
 {
@@ -14,7 +25,8 @@ u64 hash64(u64 value)
 
 u64 splat_vec2i_bits(Vec2i pos)
 {
-	return (u64) pos.y << 32 | (u64) pos.x;
+	//x goes through u32 so that a negative one is not sign extended over y
+	return (u64) (u32) pos.y << 32 | (u32) pos.x;
 }
 
 bool is_power_of_two(i64 n) 
@@ -24,10 +36,122 @@ bool is_power_of_two(i64 n)
 
 enum
 {
-	CHUNK_EMPTY = 0,
 	CHUNK_HASH_FLAG_OFFSET = 1
 };
 
+//Marks the keys that are yet to be moved to their new place while growing. Like empty it has the top bit clear.
+#define CHUNK_HASH_TAG_MOVING 1
+
+//enough slots for CHUNK_HASH_MAX_CHUNKS at CHUNK_HASH_MAX_FULLNESS
+#define CHUNK_HASH_MAX_CAPACITY ((i64) CHUNK_HASH_MAX_CHUNKS * 2)
+
+static u8 tag_of_hash(u64 hash)
+{
+	return (u8) (0x80 | (hash >> 57));
+}
+
+u8 chunk_hash_tag(Vec2i pos)
+{
+	return tag_of_hash(hash64(splat_vec2i_bits(pos)));
+}
+
+static bool chunk_hash_fits(i64 count, i64 capacity)
+{
+	return count <= (i64) ((f64) capacity * CHUNK_HASH_MAX_FULLNESS);
+}
+
+//Bit i is set if the tag of the i-th slot of the group is tag
+static u32 group_match(const u8* group, u8 tag)
+{
+	#ifdef CHUNK_HASH_SSE2
+	__m128i tags = _mm_loadu_si128((const __m128i*) group);
+	return (u32) _mm_movemask_epi8(_mm_cmpeq_epi8(tags, _mm_set1_epi8((char) tag)));
+	#else
+	u32 mask = 0;
+	for(i32 i = 0; i < CHUNK_HASH_GROUP; i++)
+		mask |= (u32) (group[i] == tag) << i;
+	return mask;
+	#endif
+}
+
+//Bit i is set if the i-th slot of the group is not used (empty or moving)
+static u32 group_match_free(const u8* group)
+{
+	#ifdef CHUNK_HASH_SSE2
+	__m128i tags = _mm_loadu_si128((const __m128i*) group);
+	return (u32) ~_mm_movemask_epi8(tags) & 0xFFFF;
+	#else
+	u32 mask = 0;
+	for(i32 i = 0; i < CHUNK_HASH_GROUP; i++)
+		mask |= (u32) (group[i] < 0x80) << i;
+	return mask;
+	#endif
+}
+
+static i32 lowest_set_bit(u32 mask)
+{
+	#ifdef _MSC_VER
+	unsigned long index = 0;
+	_BitScanForward(&index, mask);
+	return (i32) index;
+	#else
+	return __builtin_ctz(mask);
+	#endif
+}
+
+//The groups are probed in the order home, home + 1, home + 3, home + 6 ... (triangular numbers)
+//which visits every group exactly once since the number of groups is a power of two.
+static u64 probe_next(u64 group, u64 step, u64 group_mask)
+{
+	return (group + step) & group_mask;
+}
+
+//Returns the slot holding pos or -1. If not found writes the first free slot along the way into free_slot.
+static i64 chunk_hash_find_slot(const Chunk_Hash* chunk_hash, Vec2i pos, u64 hash, u64* free_slot)
+{
+	u8 tag = tag_of_hash(hash);
+	u64 group_mask = (u64) chunk_hash->hash_capacity / CHUNK_HASH_GROUP - 1;
+	u64 group = hash & group_mask;
+	for(u64 step = 1; ; step++)
+	{
+		u64 first = group * CHUNK_HASH_GROUP;
+		const u8* tags = chunk_hash->tags + first;
+		for(u32 match = group_match(tags, tag); match != 0; match &= match - 1)
+		{
+			u64 slot = first + lowest_set_bit(match);
+			if(vec_equal(chunk_hash->hash[slot].pos, pos))
+				return (i64) slot;
+		}
+
+		u32 free = group_match_free(tags);
+		if(free != 0)
+		{
+			if(free_slot)
+				*free_slot = first + lowest_set_bit(free);
+			return -1;
+		}
+
+		assert(step <= group_mask + 1 && "there must be an empty slot!");
+		group = probe_next(group, step, group_mask);
+	}
+}
+
+//Returns the first free (empty or moving) slot in the probe sequence of hash
+static u64 chunk_hash_first_free(const Chunk_Hash* chunk_hash, u64 hash)
+{
+	u64 group_mask = (u64) chunk_hash->hash_capacity / CHUNK_HASH_GROUP - 1;
+	u64 group = hash & group_mask;
+	for(u64 step = 1; ; step++)
+	{
+		u32 free = group_match_free(chunk_hash->tags + group * CHUNK_HASH_GROUP);
+		if(free != 0)
+			return group * CHUNK_HASH_GROUP + lowest_set_bit(free);
+
+		assert(step <= group_mask + 1 && "there must be an empty slot!");
+		group = probe_next(group, step, group_mask);
+	}
+}
+
 void chunk_hash_init(Chunk_Hash* chunk_hash)
 {
 	//1: deinit as of custom
@@ -36,17 +160,234 @@ void chunk_hash_init(Chunk_Hash* chunk_hash)
 	//2: there is nothing to init here
 }
 
+static const isize CHUNKS_RESERVED_BYTES = (isize) CHUNK_HASH_MAX_CHUNKS * sizeof(Chunk);
+static const isize POSITIONS_RESERVED_BYTES = (isize) CHUNK_HASH_MAX_CHUNKS * sizeof(Vec2i);
+static const isize META_RESERVED_BYTES = (isize) CHUNK_HASH_MAX_CHUNKS * sizeof(Chunk_Meta);
+static const isize HASH_RESERVED_BYTES = (isize) CHUNK_HASH_MAX_CAPACITY * sizeof(Hash_Slot);
+static const isize TAGS_RESERVED_BYTES = (isize) CHUNK_HASH_MAX_CAPACITY;
+
+//Commits the reserved range up to to bytes. committed is how much of it is already committed.
+static bool chunk_hash_commit_range(void* reserved, isize* committed, isize to, Alloc_Tag tag)
+{
+	if(to <= *committed)
+		return true;
+
+	if(virtual_memory_commit((u8*) reserved + *committed, to - *committed) == false)
+		return false;
+
+	alloc_stats_add(tag, to - *committed);
+	*committed = to;
+	return true;
+}
+
+static void chunk_hash_release_range(void* reserved, isize reserved_size, isize* committed, Alloc_Tag tag)
+{
+	virtual_memory_release(reserved, reserved_size);
+	alloc_stats_add(tag, -*committed);
+	*committed = 0;
+}
+
 void chunk_hash_deinit(Chunk_Hash* chunk_hash)
 {
-	sure_realloc(chunk_hash->chunks, 0, chunk_hash->chunk_capacity*sizeof(Chunk));
-	sure_realloc(chunk_hash->hash, 0, chunk_hash->hash_capacity*sizeof(Hash_Slot));
+	if(chunk_hash->mapped.data != NULL)
+		mapped_file_close(&chunk_hash->mapped);
+	else
+	{
+		chunk_hash_release_range(chunk_hash->chunks, CHUNKS_RESERVED_BYTES, &chunk_hash->committed_chunk_bytes, ALLOC_TAG_CHUNKS);
+		chunk_hash_release_range(chunk_hash->positions, POSITIONS_RESERVED_BYTES, &chunk_hash->committed_position_bytes, ALLOC_TAG_CHUNKS);
+		chunk_hash_release_range(chunk_hash->hash, HASH_RESERVED_BYTES, &chunk_hash->committed_hash_bytes, ALLOC_TAG_HASH);
+		chunk_hash_release_range(chunk_hash->tags, TAGS_RESERVED_BYTES, &chunk_hash->committed_tag_bytes, ALLOC_TAG_HASH);
+	}
+
+	chunk_hash_release_range(chunk_hash->meta, META_RESERVED_BYTES, &chunk_hash->committed_meta_bytes, ALLOC_TAG_CHUNK_META);
 	memset(chunk_hash, 0, sizeof *chunk_hash);
 }
 
+//Whole pages since thats what gets committed anyways
+static isize round_to_pages(isize bytes)
+{
+	isize page_size = virtual_memory_page_size();
+	return (bytes + page_size - 1) / page_size * page_size;
+}
+
+static i32 chunk_hash_max_chunks(const Chunk_Hash* chunk_hash)
+{
+	if(chunk_hash->chunk_limit > 0 && chunk_hash->chunk_limit < CHUNK_HASH_MAX_CHUNKS)
+		return chunk_hash->chunk_limit;
+	return CHUNK_HASH_MAX_CHUNKS;
+}
+
+//Reserves and commits the chunks, positions and meta to at least min_capacity.
+//Chunks and positions are only touched when not mapped.
+static bool chunk_hash_commit(Chunk_Hash* chunk_hash, i32 min_capacity)
+{
+	i32 max_chunks = chunk_hash_max_chunks(chunk_hash);
+	if(min_capacity > max_chunks)
+		return false;
+
+	if(chunk_hash->meta == NULL)
+	{
+		chunk_hash->meta = (Chunk_Meta*) virtual_memory_reserve(META_RESERVED_BYTES, false);
+		if(chunk_hash->meta == NULL)
+			return false;
+	}
+
+	if(chunk_hash->chunks == NULL)
+	{
+		chunk_hash->chunks = (Chunk*) virtual_memory_reserve(CHUNKS_RESERVED_BYTES, CHUNK_HASH_HUGE_PAGES);
+		if(chunk_hash->chunks == NULL)
+			return false;
+	}
+
+	if(chunk_hash->positions == NULL)
+	{
+		chunk_hash->positions = (Vec2i*) virtual_memory_reserve(POSITIONS_RESERVED_BYTES, false);
+		if(chunk_hash->positions == NULL)
+			return false;
+	}
+
+	//Round up to whole commit steps
+	isize old_capacity = chunk_hash->chunk_capacity;
+	isize new_bytes = ((isize) min_capacity * sizeof(Chunk) + CHUNK_HASH_COMMIT_BYTES - 1) / CHUNK_HASH_COMMIT_BYTES * CHUNK_HASH_COMMIT_BYTES;
+	isize new_capacity = new_bytes / (isize) sizeof(Chunk);
+	if(new_capacity > max_chunks)
+		new_capacity = max_chunks;
+	if(new_capacity <= old_capacity)
+		return true;
+
+	if(chunk_hash->mapped.data == NULL)
+	{
+		if(chunk_hash_commit_range(chunk_hash->chunks, &chunk_hash->committed_chunk_bytes, new_capacity * sizeof(Chunk), ALLOC_TAG_CHUNKS) == false)
+			return false;
+		if(chunk_hash_commit_range(chunk_hash->positions, &chunk_hash->committed_position_bytes, round_to_pages(new_capacity * sizeof(Vec2i)), ALLOC_TAG_CHUNKS) == false)
+			return false;
+	}
+
+	if(chunk_hash_commit_range(chunk_hash->meta, &chunk_hash->committed_meta_bytes, new_capacity * sizeof(Chunk_Meta), ALLOC_TAG_CHUNK_META) == false)
+		return false;
+
+	chunk_hash->chunk_capacity = (i32) new_capacity;
+	return true;
+}
+
+//Commits the slots and tags of the (reserved on first use) hash up to capacity
+static bool chunk_hash_commit_hash(Chunk_Hash* chunk_hash, i64 capacity)
+{
+	if(capacity > CHUNK_HASH_MAX_CAPACITY)
+		return false;
+
+	if(chunk_hash->hash == NULL)
+	{
+		chunk_hash->hash = (Hash_Slot*) virtual_memory_reserve(HASH_RESERVED_BYTES, false);
+		if(chunk_hash->hash == NULL)
+			return false;
+	}
+
+	if(chunk_hash->tags == NULL)
+	{
+		chunk_hash->tags = (u8*) virtual_memory_reserve(TAGS_RESERVED_BYTES, false);
+		if(chunk_hash->tags == NULL)
+			return false;
+	}
+
+	return chunk_hash_commit_range(chunk_hash->hash, &chunk_hash->committed_hash_bytes, round_to_pages(capacity * sizeof(Hash_Slot)), ALLOC_TAG_HASH)
+		&& chunk_hash_commit_range(chunk_hash->tags, &chunk_hash->committed_tag_bytes, round_to_pages(capacity), ALLOC_TAG_HASH);
+}
+
+//Moves the chunks, positions and the hash out of the mapped snapshot into our own memory
+//so that they can grow (only the first chunk_size chunks are copied).
+static bool chunk_hash_unmap(Chunk_Hash* chunk_hash)
+{
+	if(chunk_hash->mapped.data == NULL)
+		return true;
+
+	PERF_COUNTER("unmap");
+	Chunk_Hash moved = {0};
+	bool ok = true;
+	moved.chunks = (Chunk*) virtual_memory_reserve(CHUNKS_RESERVED_BYTES, CHUNK_HASH_HUGE_PAGES);
+	ok = ok && moved.chunks != NULL;
+	ok = ok && chunk_hash_commit_range(moved.chunks, &moved.committed_chunk_bytes, chunk_hash->chunk_capacity*sizeof(Chunk), ALLOC_TAG_CHUNKS);
+	moved.positions = (Vec2i*) virtual_memory_reserve(POSITIONS_RESERVED_BYTES, false);
+	ok = ok && moved.positions != NULL;
+	ok = ok && chunk_hash_commit_range(moved.positions, &moved.committed_position_bytes, round_to_pages(chunk_hash->chunk_capacity*sizeof(Vec2i)), ALLOC_TAG_CHUNKS);
+	ok = ok && chunk_hash_commit_hash(&moved, chunk_hash->hash_capacity);
+	if(ok == false)
+	{
+		chunk_hash_release_range(moved.chunks, CHUNKS_RESERVED_BYTES, &moved.committed_chunk_bytes, ALLOC_TAG_CHUNKS);
+		chunk_hash_release_range(moved.positions, POSITIONS_RESERVED_BYTES, &moved.committed_position_bytes, ALLOC_TAG_CHUNKS);
+		chunk_hash_release_range(moved.hash, HASH_RESERVED_BYTES, &moved.committed_hash_bytes, ALLOC_TAG_HASH);
+		chunk_hash_release_range(moved.tags, TAGS_RESERVED_BYTES, &moved.committed_tag_bytes, ALLOC_TAG_HASH);
+		return false;
+	}
+
+	memcpy(moved.chunks, chunk_hash->chunks, chunk_hash->chunk_size*sizeof(Chunk));
+	memcpy(moved.positions, chunk_hash->positions, chunk_hash->chunk_size*sizeof(Vec2i));
+	memcpy(moved.hash, chunk_hash->hash, chunk_hash->hash_capacity*sizeof(Hash_Slot));
+	memcpy(moved.tags, chunk_hash->tags, chunk_hash->hash_capacity);
+
+	mapped_file_close(&chunk_hash->mapped);
+	chunk_hash->chunks = moved.chunks;
+	chunk_hash->positions = moved.positions;
+	chunk_hash->hash = moved.hash;
+	chunk_hash->tags = moved.tags;
+	chunk_hash->committed_chunk_bytes = moved.committed_chunk_bytes;
+	chunk_hash->committed_position_bytes = moved.committed_position_bytes;
+	chunk_hash->committed_hash_bytes = moved.committed_hash_bytes;
+	chunk_hash->committed_tag_bytes = moved.committed_tag_bytes;
+	return true;
+}
+
+bool chunk_hash_map(Chunk_Hash* chunk_hash, Mapped_File mapped, Chunk* chunks, Vec2i* positions, i32 chunk_count, Hash_Slot* hash, u8* tags, i32 hash_capacity)
+{
+	chunk_hash_deinit(chunk_hash);
+	if(chunk_hash_commit(chunk_hash, chunk_count) == false)
+	{
+		mapped_file_close(&mapped);
+		chunk_hash_deinit(chunk_hash);
+		return false;
+	}
+
+	//The chunks and positions were reserved by chunk_hash_commit since nothing was mapped yet. We dont need them.
+	chunk_hash_release_range(chunk_hash->chunks, CHUNKS_RESERVED_BYTES, &chunk_hash->committed_chunk_bytes, ALLOC_TAG_CHUNKS);
+	chunk_hash_release_range(chunk_hash->positions, POSITIONS_RESERVED_BYTES, &chunk_hash->committed_position_bytes, ALLOC_TAG_CHUNKS);
+	chunk_hash->chunks = chunks;
+	chunk_hash->positions = positions;
+	chunk_hash->hash = hash;
+	chunk_hash->tags = tags;
+	chunk_hash->chunk_size = chunk_count;
+	chunk_hash->chunk_capacity = chunk_count;
+	chunk_hash->hash_capacity = hash_capacity;
+	chunk_hash->mapped = mapped;
+
+	for(i32 i = 0; i < chunk_count; i++)
+	{
+		Chunk_Meta* meta = &chunk_hash->meta[i];
+		meta->prev = CHUNK_LINK_UNKNOWN;
+		meta->flags = 0;
+		meta->next = -1;
+		meta->next_flags = 0;
+	}
+
+	for(i32 i = 0; i < chunk_count; i++)
+		chunk_hash_link(chunk_hash, i);
+
+	return true;
+}
+
 void chunk_hash_clear(Chunk_Hash* chunk_hash)
 {
-	memset(chunk_hash->hash, 0, chunk_hash->hash_capacity*sizeof(Hash_Slot));
+	//no point in keeping the snapshot around when nothing from it is used
+	chunk_hash->chunk_size = 0;
+	if(chunk_hash_unmap(chunk_hash) == false)
+		chunk_hash_deinit(chunk_hash);
+
+	//the slots of empty tags are never looked at so they dont need clearing
+	if(chunk_hash->tags != NULL)
+		memset(chunk_hash->tags, CHUNK_HASH_TAG_EMPTY, chunk_hash->hash_capacity);
 	chunk_hash->chunk_size = 0;
+	chunk_hash->unneeded_count = 0;
+	chunk_hash->step_generations = 0;
+	chunk_hash->full = false;
 }
 
 Chunk* chunk_hash_at(Chunk_Hash* chunk_hash, i32 index)
@@ -55,124 +396,351 @@ Chunk* chunk_hash_at(Chunk_Hash* chunk_hash, i32 index)
 	return &chunk_hash->chunks[index];
 }
 
-i32 chunk_hash_insert(Chunk_Hash* chunk_hash, Vec2i pos)
+//Grows the hash so that min_count keys fit. The capacity is doubled in place: we commit more of the reserved
+//slots and tags, mark all old keys as moving and then move each to the first free slot of its new probe sequence.
+//If that is a moving slot the two keys are swapped and we continue with the other one.
+//Keys that already are in the right group stay where they are.
+static bool chunk_hash_grow_hash(Chunk_Hash* chunk_hash, i64 min_count)
 {
-	PERF_COUNTER("insert");
-	//if is overfull rehash
-	if(chunk_hash->chunk_size * 2 >= chunk_hash->hash_capacity)
-	{
-		PERF_COUNTER("rehash");
-		
-		//Calculate size to which we rehash
-		i32 new_capacity = 16;
-		i32 max = chunk_hash->chunk_size * 4;
-		while(new_capacity < max)
-			new_capacity *= 2;
-		
-		assert(is_power_of_two(new_capacity));
-
-		//Allocate new slots 
-		Hash_Slot* new_hash = (Hash_Slot*) sure_realloc(NULL, new_capacity * sizeof(Hash_Slot), 0);
-		memset(new_hash, 0, new_capacity * sizeof(Hash_Slot));
-
-		//Go through all items and add them to the new hash
-		for(i32 i = 0; i < chunk_hash->hash_capacity; i++)
+	PERF_COUNTER("rehash");
+	if(chunk_hash_unmap(chunk_hash) == false)
+		return false;
+
+	i64 old_capacity = chunk_hash->hash_capacity;
+	i64 new_capacity = old_capacity > 0 ? old_capacity : CHUNK_HASH_GROUP;
+	while(chunk_hash_fits(min_count, new_capacity) == false)
+		new_capacity *= 2;
+
+	if(new_capacity == old_capacity)
+		return true;
+
+	if(chunk_hash_commit_hash(chunk_hash, new_capacity) == false)
+		return false;
+
+	assert(is_power_of_two(new_capacity));
+	u8* tags = chunk_hash->tags;
+	Hash_Slot* slots = chunk_hash->hash;
+	memset(tags + old_capacity, CHUNK_HASH_TAG_EMPTY, new_capacity - old_capacity);
+	chunk_hash->hash_capacity = (i32) new_capacity;
+
+	for(i64 i = 0; i < old_capacity; i++)
+		if(tags[i] != CHUNK_HASH_TAG_EMPTY)
+			tags[i] = CHUNK_HASH_TAG_MOVING;
+
+	for(i64 i = 0; i < old_capacity; i++)
+	{
+		while(tags[i] == CHUNK_HASH_TAG_MOVING)
+		{
+			u64 hash = hash64(splat_vec2i_bits(slots[i].pos));
+			u64 to = chunk_hash_first_free(chunk_hash, hash);
+			if(to / CHUNK_HASH_GROUP == (u64) i / CHUNK_HASH_GROUP)
+			{
+				tags[i] = tag_of_hash(hash);
+				break;
+			}
+
+			bool was_empty = tags[to] == CHUNK_HASH_TAG_EMPTY;
+			Hash_Slot moved = slots[to];
+			slots[to] = slots[i];
+			tags[to] = tag_of_hash(hash);
+			if(was_empty)
+			{
+				tags[i] = CHUNK_HASH_TAG_EMPTY;
+				break;
+			}
+
+			//tags[i] stays moving for the key that was at to
+			slots[i] = moved;
+		}
+	}
+
+	return true;
+}
+
+static bool chunk_hash_grow_chunks(Chunk_Hash* chunk_hash, i32 min_capacity)
+{
+	PERF_COUNTER("grow");
+	if(chunk_hash_unmap(chunk_hash) == false)
+		return false;
+
+	return chunk_hash_commit(chunk_hash, min_capacity);
+}
+
+bool chunk_hash_reserve(Chunk_Hash* chunk_hash, i32 chunk_count)
+{
+	bool ok = chunk_count <= chunk_hash_max_chunks(chunk_hash);
+
+	//keep the same fullness as insert would
+	if(ok && chunk_hash_fits(chunk_count, chunk_hash->hash_capacity) == false)
+		ok = chunk_hash_grow_hash(chunk_hash, chunk_count);
+
+	if(ok && chunk_count > chunk_hash->chunk_capacity)
+		ok = chunk_hash_grow_chunks(chunk_hash, chunk_count);
+
+	if(ok == false)
+		chunk_hash->full = true;
+	return ok;
+}
+
+void chunk_hash_link_concurrent(Chunk_Hash* chunk_hash, i32 index)
+{
+	assert(0 <= index && index < chunk_hash->chunk_size);
+	assert(chunk_hash_fits(chunk_hash->chunk_size, chunk_hash->hash_capacity) && "must be reserved up front!");
+
+	Vec2i pos = chunk_hash->positions[index];
+	u64 hash = hash64(splat_vec2i_bits(pos));
+	u8 tag = tag_of_hash(hash);
+	u64 group_mask = (u64) chunk_hash->hash_capacity / CHUNK_HASH_GROUP - 1;
+	u64 group = hash & group_mask;
+
+	//Claim the first empty tag. Because all linked positions are unique
+	//we dont need to compare the positions along the way which means nobody
+	//ever reads the slot we write after claiming it.
+	volatile u8* tags = chunk_hash->tags;
+	for(u64 step = 1; ; step++)
+	{
+		u64 first = group * CHUNK_HASH_GROUP;
+		for(u64 slot = first; slot < first + CHUNK_HASH_GROUP; slot++)
 		{
-			//skip empty or dead
-			Hash_Slot* curr = &chunk_hash->hash[i];
-			if(curr->chunk < CHUNK_HASH_FLAG_OFFSET)
-				continue;
-            
-			//hash the non empty entry
-			u64 at = curr->chunk - CHUNK_HASH_FLAG_OFFSET;
-			u64 curr_splat = splat_vec2i_bits(curr->pos);
-			u64 hash = hash64(curr_splat);
-
-			//find an empty slot in the new array to place the entry
-			//we use & instead of % because its faster and we know that 
-			// new_capacity is always power of two
-			u64 mask = (u64) new_capacity - 1; 
-			u64 k = hash & mask;
-			i32 counter = 0;
-			for(; new_hash[k].chunk > 0; k = (k + 1) & mask)
-				assert(counter ++ < chunk_hash->hash_capacity && "there must be an empty slot!");
-
-			//place it there
-			new_hash[k] = chunk_hash->hash[i];
+			if(tags[slot] == CHUNK_HASH_TAG_EMPTY && atomic_cas8(&tags[slot], CHUNK_HASH_TAG_EMPTY, tag))
+			{
+				chunk_hash->hash[slot].pos = pos;
+				chunk_hash->hash[slot].chunk = (u32) index + CHUNK_HASH_FLAG_OFFSET;
+				return;
+			}
 		}
 
-		//Reassign the newly created hash to the structure cleaning old mess
-		sure_realloc(chunk_hash->hash, 0, chunk_hash->hash_capacity * sizeof(Hash_Slot));
-		chunk_hash->hash = new_hash;
-		chunk_hash->hash_capacity = new_capacity;
+		assert(step <= group_mask + 1 && "there must be an empty slot!");
+		group = probe_next(group, step, group_mask);
 	}
+}
 
-	//If has too little size for new entry grow twice the original size
-	if(chunk_hash->chunk_size >= chunk_hash->chunk_capacity)
+bool chunk_hash_copy_index(Chunk_Hash* into, const Chunk_Hash* from)
+{
+	PERF_COUNTER("copy index");
+	assert(into->chunk_size == 0 && into != from);
+	if(chunk_hash_unmap(into) == false || chunk_hash_commit_hash(into, from->hash_capacity) == false)
+		return false;
+	if(from->chunk_size > into->chunk_capacity && chunk_hash_commit(into, from->chunk_size) == false)
+		return false;
+
+	memcpy(into->tags, from->tags, from->hash_capacity);
+	memcpy(into->hash, from->hash, from->hash_capacity * sizeof(Hash_Slot));
+	memcpy(into->positions, from->positions, from->chunk_size * sizeof(Vec2i));
+	into->hash_capacity = from->hash_capacity;
+	into->chunk_size = from->chunk_size;
+	return true;
+}
+
+//Moves the bits of value into the even bits of the result
+static u64 spread_bits(u32 value)
+{
+	u64 bits = value;
+	bits = (bits | (bits << 16)) & (u64) 0x0000FFFF0000FFFF;
+	bits = (bits | (bits << 8))  & (u64) 0x00FF00FF00FF00FF;
+	bits = (bits | (bits << 4))  & (u64) 0x0F0F0F0F0F0F0F0F;
+	bits = (bits | (bits << 2))  & (u64) 0x3333333333333333;
+	bits = (bits | (bits << 1))  & (u64) 0x5555555555555555;
+	return bits;
+}
+
+//Position along the Morton (Z) curve. Close positions tend to have close keys.
+static u64 morton_key(u32 x, u32 y)
+{
+	return spread_bits(x) | spread_bits(y) << 1;
+}
+
+typedef struct Chunk_Order
+{
+	u64 key;
+	i32 index; //in the unsorted hash
+} Chunk_Order;
+
+#define SORT_RADIX_BITS 11
+
+bool chunk_hash_sort(const Chunk_Hash* from, Chunk_Hash* into)
+{
+	PERF_COUNTER("sort");
+	assert(from != into);
+	chunk_hash_clear(into);
+
+	i32 count = from->chunk_size;
+	if(chunk_hash_reserve(into, count) == false)
+		return false;
+	if(count == 0)
+		return true;
+
+	//Relative to the top left chunk so that the keys have only as many bits as the universe needs
+	Vec2i min_pos = from->positions[0];
+	for(i32 i = 1; i < count; i++)
 	{
-		PERF_COUNTER("grow");
-		i32 old_capacity = chunk_hash->chunk_capacity;
-		i32 new_capacity = old_capacity*5/4 + 8;
-		chunk_hash->chunks = (Chunk*) sure_realloc(chunk_hash->chunks, new_capacity*sizeof(Chunk), old_capacity*sizeof(Chunk));
-		chunk_hash->chunk_capacity = new_capacity;
+		if(from->positions[i].x < min_pos.x) min_pos.x = from->positions[i].x;
+		if(from->positions[i].y < min_pos.y) min_pos.y = from->positions[i].y;
 	}
-	
-	//assert(is_power_of_two(chunk_hash->chunk_capacity));
+
+	isize buffer_size = 2 * count * (isize) sizeof(Chunk_Order);
+	Chunk_Order* buffer = (Chunk_Order*) sure_realloc(NULL, buffer_size, 0, ALLOC_TAG_STEP);
+	Chunk_Order* orders = buffer;
+	Chunk_Order* sorted = buffer + count;
+	u64 all_keys = 0;
+	for(i32 i = 0; i < count; i++)
+	{
+		Vec2i pos = from->positions[i];
+		orders[i].key = morton_key((u32) ((i64) pos.x - min_pos.x), (u32) ((i64) pos.y - min_pos.y));
+		orders[i].index = i;
+		all_keys |= orders[i].key;
+	}
+
+	//Radix sort from the lowest digit, skipping the digits that are 0 in all keys
+	const u64 digit_mask = (1 << SORT_RADIX_BITS) - 1;
+	for(i32 shift = 0; shift < 64 && (all_keys >> shift) != 0; shift += SORT_RADIX_BITS)
+	{
+		i32 offsets[1 << SORT_RADIX_BITS] = {0};
+		for(i32 i = 0; i < count; i++)
+			offsets[(orders[i].key >> shift) & digit_mask] += 1;
+
+		i32 offset = 0;
+		for(i32 digit = 0; digit < (1 << SORT_RADIX_BITS); digit++)
+		{
+			i32 digit_count = offsets[digit];
+			offsets[digit] = offset;
+			offset += digit_count;
+		}
+
+		for(i32 i = 0; i < count; i++)
+			sorted[offsets[(orders[i].key >> shift) & digit_mask]++] = orders[i];
+
+		Chunk_Order* temp = orders;
+		orders = sorted;
+		sorted = temp;
+	}
+
+	//The other half of the buffer is not needed anymore. We use it to remap the links.
+	i32* new_indices = (i32*) sorted;
+	for(i32 i = 0; i < count; i++)
+		new_indices[orders[i].index] = i;
+
+	into->chunk_size = count;
+	into->step_generations = from->step_generations;
+	into->unneeded_count = from->unneeded_count;
+	for(i32 i = 0; i < count; i++)
+	{
+		i32 old_i = orders[i].index;
+		into->chunks[i] = from->chunks[old_i];
+		into->positions[i] = from->positions[old_i];
+
+		const Chunk_Meta* old_meta = &from->meta[old_i];
+		Chunk_Meta* meta = &into->meta[i];
+		for(i32 dir = 0; dir < DIRECTION_COUNT; dir++)
+		{
+			i32 neighbour = old_meta->neighbours[dir];
+			meta->neighbours[dir] = neighbour >= 0 ? new_indices[neighbour] : neighbour;
+		}
+		meta->prev = old_meta->prev;
+		meta->flags = old_meta->flags;
+		meta->next = -1;
+		meta->next_flags = 0;
+
+		chunk_hash_link_concurrent(into, i);
+	}
+
+	sure_realloc(buffer, 0, buffer_size, ALLOC_TAG_STEP);
+	return true;
+}
+
+i32 chunk_hash_insert(Chunk_Hash* chunk_hash, Vec2i pos)
+{
+	i32 size_before = chunk_hash->chunk_size;
+	i32 index = chunk_hash_insert_unlinked(chunk_hash, pos);
+	if(index == size_before)
+		chunk_hash_link(chunk_hash, index);
+
+	return index;
+}
+
+void chunk_hash_link(Chunk_Hash* chunk_hash, i32 index)
+{
+	PERF_COUNTER("link");
+	assert(0 <= index && index < chunk_hash->chunk_size);
+	Vec2i pos = chunk_hash->positions[index];
+	for(i32 dir = 0; dir < DIRECTION_COUNT; dir++)
+	{
+		i32 found = chunk_hash_find(chunk_hash, vec_add(pos, chunk_directions[dir]));
+		chunk_hash->meta[index].neighbours[dir] = found;
+		if(found != -1)
+			chunk_hash->meta[found].neighbours[DIRECTION_COUNT - 1 - dir] = index;
+	}
+}
+
+i32 chunk_hash_insert_unlinked(Chunk_Hash* chunk_hash, Vec2i pos)
+{
+	PERF_COUNTER("insert");
+	//if is overfull grow (or if that failed at least look if it is present)
+	if(chunk_hash_fits(chunk_hash->chunk_size + 1, chunk_hash->hash_capacity) == false)
+	{
+		if(chunk_hash_grow_hash(chunk_hash, chunk_hash->chunk_size + 1) == false)
+		{
+			chunk_hash->full = true;
+			return chunk_hash_find(chunk_hash, pos);
+		}
+	}
+
 	assert(is_power_of_two(chunk_hash->hash_capacity));
-	assert(chunk_hash->hash_capacity > 0 && chunk_hash->chunk_capacity > 0);
-	assert(chunk_hash->hash != NULL && chunk_hash->chunks != NULL);
+	assert(chunk_hash->hash_capacity > 0 && chunk_hash->hash != NULL);
 
-	u64 pos_splat = splat_vec2i_bits(pos);
-	u64 hash = hash64(pos_splat);
-	u64 mask = (u64) chunk_hash->hash_capacity - 1;
-	u64 i = hash & mask;
+	//If it is already in the hash return its index
+	u64 hash = hash64(splat_vec2i_bits(pos));
+	u64 slot = 0;
+	i64 found = chunk_hash_find_slot(chunk_hash, pos, hash, &slot);
+	if(found != -1)
+		return (i32) chunk_hash->hash[found].chunk - CHUNK_HASH_FLAG_OFFSET;
 
-	//Find empty slot for the newly added. If it is already in the hash
-	// return its index
-	i32 counter = 0;
-	for(; chunk_hash->hash[i].chunk > 0; i = (i + 1) & mask)
+	//If has too little size for new entry grow. This does not move the hash so slot stays valid.
+	if(chunk_hash->chunk_size >= chunk_hash->chunk_capacity)
 	{
-		assert(counter ++ < chunk_hash->hash_capacity && "there must be an empty slot!");
-		if(vec_equal(chunk_hash->hash[i].pos, pos))
-			return (i32) chunk_hash->hash[i].chunk - CHUNK_HASH_FLAG_OFFSET;
+		if(chunk_hash_grow_chunks(chunk_hash, chunk_hash->chunk_size + 1) == false)
+		{
+			chunk_hash->full = true;
+			return CHUNK_HASH_FULL;
+		}
 	}
 
 	//Push back the new chunk
 	assert(chunk_hash->chunk_size < chunk_hash->chunk_capacity);
 	chunk_hash->chunks[chunk_hash->chunk_size] = Chunk{0};
-	chunk_hash->chunks[chunk_hash->chunk_size].pos = pos;
+	chunk_hash->positions[chunk_hash->chunk_size] = pos;
+
+	Chunk_Meta* meta = &chunk_hash->meta[chunk_hash->chunk_size];
+	for(i32 dir = 0; dir < DIRECTION_COUNT; dir++)
+		meta->neighbours[dir] = CHUNK_LINK_UNKNOWN;
+	meta->prev = CHUNK_LINK_UNKNOWN;
+	meta->flags = 0;
+	meta->next = -1;
+	meta->next_flags = 0;
 
 	//Link it in the hash
-	chunk_hash->hash[i].chunk = (uint32_t) chunk_hash->chunk_size + CHUNK_HASH_FLAG_OFFSET;
-	chunk_hash->hash[i].pos = pos;
+	chunk_hash->tags[slot] = tag_of_hash(hash);
+	chunk_hash->hash[slot].chunk = (uint32_t) chunk_hash->chunk_size + CHUNK_HASH_FLAG_OFFSET;
+	chunk_hash->hash[slot].pos = pos;
 
 	chunk_hash->chunk_size ++;
 	return chunk_hash->chunk_size - 1;
 }
 
+//Is called a lot (the step, linking, drawing) so it has no PERF_COUNTER. Its calls are timed by the bench instead.
 i32 chunk_hash_find(Chunk_Hash* chunk_hash, Vec2i pos)
 {
-	PERF_COUNTER();
 	if(chunk_hash->hash_capacity == 0)
 		return -1;
 
-	//assert(is_power_of_two(chunk_hash->chunk_capacity));
 	assert(is_power_of_two(chunk_hash->hash_capacity));
-	assert(chunk_hash->hash_capacity > 0 && chunk_hash->chunk_capacity > 0);
-	assert(chunk_hash->hash != NULL && chunk_hash->chunks != NULL);
+	assert(chunk_hash->hash != NULL && chunk_hash->tags != NULL);
 
-	u64 hash = hash64(splat_vec2i_bits(pos));
-	u64 mask = (u64) chunk_hash->hash_capacity - 1;
-	u64 i = hash & mask;
-	i32 counter = 0;
-	for(; chunk_hash->hash[i].chunk > 0; i = (i + 1) & mask)
-	{
-		assert(counter ++ < chunk_hash->hash_capacity && "there must be an empty slot!");
-		if(vec_equal(chunk_hash->hash[i].pos, pos))
-			return chunk_hash->hash[i].chunk - CHUNK_HASH_FLAG_OFFSET;
-	}
+	i64 slot = chunk_hash_find_slot(chunk_hash, pos, hash64(splat_vec2i_bits(pos)), NULL);
+	if(slot == -1)
+		return -1;
 
-	return -1;
+	return (i32) chunk_hash->hash[slot].chunk - CHUNK_HASH_FLAG_OFFSET;
 }
 
 Chunk* chunk_hash_get_or(Chunk_Hash* chunk_hash, Vec2i chunk_pos, Chunk* if_not_found)
@@ -182,4 +750,44 @@ Chunk* chunk_hash_get_or(Chunk_Hash* chunk_hash, Vec2i chunk_pos, Chunk* if_not_
 		return if_not_found;
 	else
 		return chunk_hash_at(chunk_hash, found);
-};
\ No newline at end of file
+};
+Vec2i get_chunk_pos(Vec2i sym_position)
+{
+	Vec2i output = {0};
+	output.x = div_round_down(sym_position.x, CHUNK_SIZE);
+	output.y = div_round_down(sym_position.y, CHUNK_SIZE);
+
+	return output;
+};
+	
+Vec2i get_cell_pos(Vec2i sym_position)
+{
+	Vec2i output = {0};
+	output.x = (sym_position.x % CHUNK_SIZE + CHUNK_SIZE) % CHUNK_SIZE;
+	output.y = (sym_position.y % CHUNK_SIZE + CHUNK_SIZE) % CHUNK_SIZE;
+
+	return output;
+};
+
+void set_cell_at(Chunk_Hash* chunk_hash, Vec2i sym_pos, bool to)
+{
+	Vec2i place_at_chunk = get_chunk_pos(sym_pos);
+	Vec2i place_at_pixel = get_cell_pos(sym_pos);
+
+	i32 chunk_i = chunk_hash_insert(chunk_hash, place_at_chunk);
+	if(chunk_i == CHUNK_HASH_FULL)
+		return;
+
+	Chunk* chunk = chunk_hash_at(chunk_hash, chunk_i);
+	chunk_set_cell(chunk, place_at_pixel, to);
+
+	//the content changed so nothing we knew about it holds anymore
+	chunk_hash->meta[chunk_i].flags = 0;
+
+	//@TODO: careful insertion of only the chunks we need!
+	if(to)
+	{
+		for(i32 i = 0; i < DIRECTION_COUNT; i++)
+			chunk_hash_insert(chunk_hash, vec_add(chunk_directions[i], place_at_chunk));
+	}
+};
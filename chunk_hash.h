@@ -1,21 +1,44 @@
 #pragma once
 #include "types.h"
 #include "chunk.h"
+#include "mapped_file.h"
 
 // This file provides an iterface to a simple (but very performant) hash map implementation. 
 // 
 // It uses 2 arrays: one for the keys and one for the values.
 // This is important because it gives us optimal traversal speed over the values.
-// It uses simple linear probing on hash closions but the downsides of this approach 
-// are compansated by extremely small allowed hash fullness (only 25%). 
+// The values are split further into the chunks and their positions so that every chunk is exactly
+// CHUNK_ROWS * CHUNK_ROW_WORDS u64s and starts on a cache line.
+//
+// The keys are looked up through a third array of 1 byte tags, one per slot (a "swiss table").
+// A tag is either CHUNK_HASH_TAG_EMPTY or has the top bit set and 7 bits of the hash of the key.
+// Slots are probed in aligned groups of CHUNK_HASH_GROUP whose tags are all compared at once (SSE2).
+// Only the slots whose tag matches (1 in 128 for a wrong key) are compared by position so a lookup
+// usually touches a single cache line of tags plus the slot of the found key. A group with an empty
+// tag ends the probing. Because probing is this cheap the hash can be kept 87.5% full.
+//
+// Nothing is ever removed so there are no tombstones. The tags and slots live in address ranges reserved up front
+// just like the chunks. Growing doubles the capacity by committing more of them and moving the keys
+// to their new places in place (see chunk_hash_grow_hash).
 // 
-// We can do this because the ratio of key size (12B) to value size (64*64B) is extremely small,
-// thus having 4x more keys than values still results in very little space used.
+// Next to every chunk we also keep its Chunk_Meta in a separate array. It holds the indices of the 8 neighbouring
+// chunks so that the step does not need to look them up in the hash (which used to be the most called function by far).
+// The links are maintained by chunk_hash_insert. The step builds the hash for the next generation using
+// chunk_hash_insert_unlinked and derives the links from the previous generation instead (see step.cpp).
+//
+// Chunks are stored in the order they were inserted. The step inserts them in the order of the previous generation
+// so neighbouring chunks tend to stay close in memory, but new ones are appended at the end and the order decays.
+// chunk_hash_sort copies the hash with its chunks in the Morton (Z) order of their positions which puts spatially
+// close chunks close in memory. The symulation does that every CHUNK_HASH_SORT_PERIOD generations.
+//
+// The chunks, positions and meta arrays live in address ranges reserved up front for CHUNK_HASH_MAX_CHUNKS chunks
+// (see virtual_memory.h). Growing just commits more of the range (in CHUNK_HASH_COMMIT_BYTES steps) so
+// nothing is ever copied and we never need twice the memory like realloc does. When the limit is reached
+// (or the OS runs out of memory) inserting a new chunk returns CHUNK_HASH_FULL and sets full instead of
+// aborting. The universe is then missing some chunks so the caller should stop the symulation.
 // 
-// Uses growth old*5/4 + 8 for the chunks array to minimize wasted memory when many chunks are present. 
-// Still because we use simple malloc/free to obtain memory we often run out of system memory and freeze.
-// This could be circumwented by properly memory mapping straight from the OS but I am far too lazy to do 
-// that in ths project.
+// A hash loaded from a snapshot (see snapshot.h) uses the chunks, positions and slots straight from the mapped file.
+// They are moved into our own memory only once they need to grow (or the hash is cleared).
 // 
 // See implementation for more details.
 
@@ -28,23 +51,144 @@ typedef struct Hash_Slot
 	u32 chunk;
 } Hash_Slot;
 
+#define CHUNK_HASH_GROUP		16	 /* slots whose tags are compared at once. The capacity is a multiple of it */
+#define CHUNK_HASH_TAG_EMPTY	0	 /* tag of an empty slot. Used slots have the top bit set */
+#define CHUNK_HASH_MAX_FULLNESS	0.875 /* the hash grows when more of its slots would be used */
+
+//Neighbour is not present in the hash
+#define CHUNK_LINK_NONE		-1
+//Neighbour was not yet looked up (only after chunk_hash_insert_unlinked)
+#define CHUNK_LINK_UNKNOWN	-2
+
+//Returned by insert when the chunk is not present and there is no space for it
+#define CHUNK_HASH_FULL		-1
+
+#define CHUNK_HASH_MAX_CHUNKS	((1 << 26) / (CHUNK_ROWS / 64 * CHUNK_ROW_WORDS)) /* ~35GB of chunks. Only reserves address space */
+#define CHUNK_HASH_COMMIT_BYTES	(2 << 20) /* the chunks are committed in steps of this size (one huge page) */
+#define CHUNK_HASH_HUGE_PAGES	true /* asks the OS to back the chunks with huge pages */
+#define CHUNK_HASH_SORT_PERIOD	64 /* generations between reordering the chunks with chunk_hash_sort */
+
+//What we know about the content of a chunk and its history. Used by the step to skip chunks whose
+//result is known without computing (still lifes and period 2 oscillators). Only ever set when known for sure
+//so 0 is always a safe value. The border are the cells the neighbouring chunks see.
+typedef enum Chunk_Flag
+{
+	CHUNK_FLAG_EMPTY		= 1 << 0, //has no alive cells
+	CHUNK_FLAG_EDGE_EMPTY	= 1 << 1, //has no alive cells on its border
+	CHUNK_FLAG_SAME_1		= 1 << 2, //is the same as one generation ago
+	CHUNK_FLAG_EDGE_SAME_1	= 1 << 3, //border is the same as one generation ago
+	CHUNK_FLAG_SAME_2		= 1 << 4, //is the same as two generations ago
+	CHUNK_FLAG_EDGE_SAME_2	= 1 << 5, //border is the same as two generations ago
+
+	//The neighbours that are not present are empty now. These say that they were empty
+	//one (and two) generations ago as well.
+	CHUNK_FLAG_MISSING_EMPTY_1	= 1 << 6,
+	CHUNK_FLAG_MISSING_EMPTY_2	= 1 << 7,
+} Chunk_Flag;
+
+typedef struct Chunk_Meta
+{
+	//Indices of the neighbouring chunks indexed by Chunk_Direction or CHUNK_LINK_NONE/CHUNK_LINK_UNKNOWN
+	i32 neighbours[DIRECTION_COUNT];
+
+	//Index of this chunk in the hash of the previous generation, CHUNK_LINK_NONE if
+	//it was not present there or CHUNK_LINK_UNKNOWN if we dont know (it was inserted by hand)
+	i32 prev;
+	u32 flags; //Chunk_Flag
+
+	//Index of this chunk in the hash of the next generation or -1 and its flags there. Only used by the step.
+	i32 next;
+	u32 next_flags;
+} Chunk_Meta;
+
 typedef struct Chunk_Hash
 {
 	Chunk* chunks;
+	Vec2i* positions; //position of each chunk. Has the same size and capacity as chunks
+	Chunk_Meta* meta; //has the same size and capacity as chunks
 	Hash_Slot* hash;
+	u8* tags; //one per slot of hash
 
 	i32 hash_capacity;
 	i32 chunk_size;
-	i32 chunk_capacity;
+	i32 chunk_capacity; //number of committed chunks
+
+	//bytes of the reserved chunks, positions, meta, slots and tags we committed (reported to alloc_stats)
+	isize committed_chunk_bytes;
+	isize committed_position_bytes;
+	isize committed_meta_bytes;
+	isize committed_hash_bytes;
+	isize committed_tag_bytes;
+
+	//empty chunks that no alive chunk reached into in the generation step that made this hash.
+	//They are kept only to avoid reinserting the rest (see step.h). 0 when unknown.
+	i32 unneeded_count;
+
+	//generations advanced by the step that made this hash (0 if it was not made by a step). The flags of its chunks
+	//compare against that many generations ago and it has all chunks within that many cells of an alive cell (see step.h).
+	i32 step_generations;
+
+	//when not 0 the hash holds at most this many chunks instead of CHUNK_HASH_MAX_CHUNKS (set after init).
+	//Lets the paths that run out of space be tested without committing the whole reserved range.
+	i32 chunk_limit;
+
+	//some insert failed because there was no space (cleared by chunk_hash_clear)
+	bool full;
+
+	//the snapshot file chunks, positions, hash and tags point into (if any)
+	Mapped_File mapped;
 } Chunk_Hash;
 
 void chunk_hash_init(Chunk_Hash* chunk_hash);
 void chunk_hash_deinit(Chunk_Hash* chunk_hash);
 
+//Inserts a chunk at pos (if not already present) and returns its index or CHUNK_HASH_FULL.
+//Newly inserted chunks are linked with their neighbours (and the neighbours back with them).
 i32 chunk_hash_insert(Chunk_Hash* chunk_hash, Vec2i pos);
+//Same as chunk_hash_insert but leaves the neighbours of new chunks as CHUNK_LINK_UNKNOWN.
+//The caller is responsible for filling them (or calling chunk_hash_link) before the hash is stepped.
+i32 chunk_hash_insert_unlinked(Chunk_Hash* chunk_hash, Vec2i pos);
+//Looks up all neighbours of the chunk at index and links them both ways
+void chunk_hash_link(Chunk_Hash* chunk_hash, i32 index);
 i32 chunk_hash_find(Chunk_Hash* chunk_hash, Vec2i pos);
 Chunk* chunk_hash_at(Chunk_Hash* chunk_hash, i32 index);
 
 Chunk* chunk_hash_get_or(Chunk_Hash* chunk_hash, Vec2i chunk_pos, Chunk* if_not_found);
 void chunk_hash_clear(Chunk_Hash* chunk_hash);
 
+//Makes sure chunk_count chunks fit without growing the chunks array or rehashing.
+//Returns false (and sets full) if they cannot fit.
+bool chunk_hash_reserve(Chunk_Hash* chunk_hash, i32 chunk_count);
+
+//Makes the hash use chunks, positions, hash and tags straight from the mapped file (which it takes ownership of).
+//The neighbours are linked and nothing is known about the history of the chunks. Used by snapshot_load.
+//Returns false (and leaves the hash empty) if the meta could not be allocated.
+bool chunk_hash_map(Chunk_Hash* chunk_hash, Mapped_File mapped, Chunk* chunks, Vec2i* positions, i32 chunk_count, Hash_Slot* hash, u8* tags, i32 hash_capacity);
+
+//Makes the empty into hold the same positions at the same indices as from by copying the positions,
+//slots and tags. The chunks and meta are left for the caller to fill. Used by the step to not reinsert
+//the chunks every generation. Returns false if they dont fit (into stays empty).
+bool chunk_hash_copy_index(Chunk_Hash* into, const Chunk_Hash* from);
+
+//Clears into and copies from into it with the chunks sorted in the Morton (Z) order of their positions.
+//The links are remapped and the history (prev index, flags and unneeded_count) is kept so into can be stepped
+//in place of from with the same prev_chunk_hash. Returns false (and sets full of into) if the chunks dont fit.
+bool chunk_hash_sort(const Chunk_Hash* from, Chunk_Hash* into);
+
+//Returns the tag of pos (see above)
+u8 chunk_hash_tag(Vec2i pos);
+
+//Links an already filled chunk at index into the hash. Is used to build the hash 
+//from multiple threads at once without locking. Can only be called when:
+// 1) enough space was reserved using chunk_hash_reserve and chunk_size was set 
+// 2) all linked chunks have unique positions that are not yet present in the hash
+// 3) no other function modifies or reads the hash at the same time
+void chunk_hash_link_concurrent(Chunk_Hash* chunk_hash, i32 index);
+
+//Converts a position in the symulation (in cells) to position of the chunk containing it
+Vec2i get_chunk_pos(Vec2i sym_position);
+//Converts a position in the symulation (in cells) to position of the cell within its chunk
+Vec2i get_cell_pos(Vec2i sym_position);
+//Sets the cell at the given symulation position inserting the chunk (and its neighbours) if needed.
+//Does nothing if the chunk does not fit.
+void set_cell_at(Chunk_Hash* chunk_hash, Vec2i sym_pos, bool to);
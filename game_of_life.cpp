@@ -65,9 +65,17 @@
 // 
 // This might look daunting (and indeed its painful to debug) but with a bit of patience its not that diffuclt to trial and error into.
 //
-// This approach is ~200x fatster than naive implementation using serial ifs, and about ~20x faster than branchless version. It can further be sped up about 4x
-// by using 256 bit SIMD registers and doing essentially the same thing wider. I was however lazy to implement this as this was fast enough for my need as the
-// current bottle neck is rendering and then hash map lookup.
+// This approach is ~200x fatster than naive implementation using serial ifs, and about ~20x faster than branchless version. 
+// It is further sped up by using 256 (AVX2) or 512 (AVX-512) bit SIMD registers and doing essentially the same thing on 4 or 8 rows
+// at once. The kernel with all of its versions lives in life.cpp.
+//
+// A simpler approach turned out to be even faster: keeping the neighbour count of every cell as 4 u64 (one per bit of the
+// count) and adding the 8 shifted neighbour rows into it with bitwise full adders (a ^ b ^ c and (a & b) | ((a ^ b) & c)).
+// That finishes all 64 cells of a row in a single pass instead of three. This "adder" kernel is the default,
+// the one above is still there and can be selected (see life.h).
+//
+// Other outer totalistic rules (HighLife B36/S23, Day & Night B3678/S34678, Seeds B2/S ...) are supported as well,
+// either from the rule in the header of the loaded pattern or from the command line: game_of_life [pattern] [--rule B36/S23]
 
 // Controls:
 // mouse wheel			- zoom in and out
@@ -80,10 +88,17 @@
 
 #include "chunk.h"
 #include "chunk_hash.h"
+#include "symulation.h"
 #include "time.h"
 #include "perf.h"
 #include "alloc.h"
+#include "load.h"
+#include "snapshot.h"
+#include "life.h"
+#include "lod.h"
+#include "texture_atlas.h"
 
+#include <string.h>
 #include <SDL/SDL.h>
 
 #define WINDOW_TITLE        "Game of Life"
@@ -96,6 +111,15 @@
 #define CLEAR_COLOR_2		 0x070707FF
 #define CLEAR_COLOR_ACTIVE_1 0x221111FF
 #define CLEAR_COLOR_ACTIVE_2 0x140707FF
+#define LOD_MIN_SHADE		 0x60 /* brightness of the sparsest alive areas when zoomed out */
+
+#define SYMULATION_THREADS		0 /* number of threads used by the generation step. 0 means one per hardware thread, 1 runs the serial step */
+#define HASHLIFE_MEMORY_BUDGET	((isize) 1024 << 20) /* memory the hashlife engine can use before collecting garbage */
+#define HASHLIFE_MAX_STEP_LOG2	40 /* the biggest jump (2^N generations) per update selectable with K */
+#define SNAPSHOT_PATH			"snapshot.gols" /* where F5 saves and F9 loads the universe from */
+#define TRACE_PATH				"trace.json" /* where the trace recorded between two presses of F7 is written */
+#define TRACE_MAX_EVENTS		(1 << 20) /* events each thread records at most while tracing */
+#define LOD_CHUNK_PIXELS		24 /* chunks smaller than this many pixels are drawn from the density mipmaps (see lod.h) */
 
 #define DO_LIN_DOWNSAMPLING		false
 #define DO_UPDATE_SCREEN		true
@@ -115,194 +139,15 @@
 // 
 #define DO_CLEANUP
 
-//A single generation step of the symulation
-void game_of_life_generation_step(Chunk_Hash* curr_chunk_hash, Chunk_Hash* next_chunk_hash)
-{
-	Chunk empty_chunks[9] = {0};
-	PERF_COUNTER("step");
-
-	for(i32 i = 0; i < curr_chunk_hash->chunk_size; i++)
-	{
-		PERF_COUNTER("single chunk");
-		Chunk* chunk = &curr_chunk_hash->chunks[i];
-				
-		Chunk* top   = NULL;
-		Chunk* bot   = NULL;
-		Chunk* left  = NULL;
-		Chunk* right = NULL;
-				
-		Chunk* top_l = NULL;
-		Chunk* top_r = NULL;
-		Chunk* bot_l = NULL;
-		Chunk* bot_r = NULL;
-
-		{
-			PERF_COUNTER("neighbour gather");
-			//@TODO: only add only needed chunks just like in the add after
-			//save the computation from last time
-
-			top   = chunk_hash_get_or(curr_chunk_hash, vec_add(chunk->pos, vec( 0, -1)), empty_chunks);
-			bot   = chunk_hash_get_or(curr_chunk_hash, vec_add(chunk->pos, vec( 0,  1)), empty_chunks);
-			left  = chunk_hash_get_or(curr_chunk_hash, vec_add(chunk->pos, vec(-1,  0)), empty_chunks);
-			right = chunk_hash_get_or(curr_chunk_hash, vec_add(chunk->pos, vec( 1,  0)), empty_chunks);
-				
-			top_l = chunk_hash_get_or(curr_chunk_hash, vec_add(chunk->pos, vec(-1, -1)), empty_chunks);
-			top_r = chunk_hash_get_or(curr_chunk_hash, vec_add(chunk->pos, vec( 1, -1)), empty_chunks);
-			bot_l = chunk_hash_get_or(curr_chunk_hash, vec_add(chunk->pos, vec(-1,  1)), empty_chunks);
-			bot_r = chunk_hash_get_or(curr_chunk_hash, vec_add(chunk->pos, vec( 1,  1)), empty_chunks);
-		}
-
-		//Main life algorhirm
-		{
-			#define OUTER (CHUNK_SIZE + 1)
-
-			//Generate Masks: R|CONTENT_BITS|L|0
-			u64 R_OUTER_BIT = ((u64) 1 << OUTER); 
-			u64 L_OUTER_BIT = ((u64) 1);
-			u64 CONTENT_BITS = (((u64) -1) & ~R_OUTER_BIT) & ~L_OUTER_BIT;
-
-			for(i32 i = OUTER; i < 64; i++)
-				CONTENT_BITS &= ~((u64) 1 << i);
-
-			//Holds a composed value for the currently processed block.
-			//Includes the edge from adjecent chunks
-			Chunk assembled = {0};
-
-			//Fill edge pixels from adjecent chunks
-			assembled.data[0]  = top->data[OUTER - 1] & CONTENT_BITS;
-			assembled.data[OUTER] = bot->data[1] & CONTENT_BITS;
-				
-			u64 top_l_bit = (top_l->data[OUTER - 1] << 1) & R_OUTER_BIT;
-			u64 top_r_bit = (top_r->data[OUTER - 1] >> 1) & L_OUTER_BIT;
-			u64 bot_l_bit = (bot_l->data[1] << 1) & R_OUTER_BIT;
-			u64 bot_r_bit = (bot_r->data[1] >> 1) & L_OUTER_BIT;
-
-			assembled.data[0]  |= top_l_bit >> OUTER;
-			assembled.data[0]  |= top_r_bit << OUTER;
-				
-			assembled.data[OUTER] |= bot_l_bit >> OUTER;
-			assembled.data[OUTER] |= bot_r_bit << OUTER;
-
-			//Adds the middle set of data from the main processed chunk
-			for(i32 i = 0; i < CHUNK_SIZE; i++)
-			{
-				u64 middle = chunk->data[i + 1] & CONTENT_BITS;
-				u64 first = (left->data[i + 1] << 1) & R_OUTER_BIT;
-				u64 last = (right->data[i + 1] >> 1) & L_OUTER_BIT;
-
-				assembled.data[1 + i] = (first >> OUTER) | middle | (last << OUTER);
-			}
-
-			//This is the resulting chunk in the next generation
-			Chunk new_chunk = {0};
-			new_chunk.pos = chunk->pos;
-				
-			u64 pattern = 01111111111111111111111;//pattern of 0b...001001 repeating (in oct)
-			u64 oct0 = pattern << 0; //pattern of 0b...001001
-			u64 oct1 = pattern << 1; //pattern of 0b...010010
-			u64 oct2 = pattern << 2; //pattern of 0b...100100 
-					
-			{
-				PERF_COUNTER("life");
-				//for all three offsets in the 3 bit slots
-				for(i32 slot = 0; slot < 3; slot++)
-				{
-					u64 accumulators[64] = {0};
-
-					for(i32 i = 0; i < 64; i++)
-					{
-						u64 curr_accumulator = 0;
-						u64 slid = (assembled.data[i] << 1); 
-						//we have to align it so that its in the ceneter of the oct
-						//otherwise for     0b 0 0 1 0 0 0 1 0
-						//we woudl geenrate    1 1 1 0 1 1 1 0
-						//but we want:         0 1 1 1 0 1 1 1
-
-						curr_accumulator += (oct0 & (slid >> (0 + slot)));
-						curr_accumulator += (oct0 & (slid >> (1 + slot)));
-						curr_accumulator += (oct0 & (slid >> (2 + slot)));
-						accumulators[i] = curr_accumulator;
-					}
-
-					//iterate all inner rows of the chunk
-					for(i32 y = 1; y < OUTER; y++)
-					{
-						u64 first_sum = accumulators[y - 1] + accumulators[y];
-						u64 has_4 = first_sum & oct2;
-					
-						u64 next_row_has_any = ((accumulators[y + 1] & oct1) << 1 | (accumulators[y + 1] & oct0) << 2);
-
-						u64 is_overfull = has_4 & next_row_has_any; //the sum around has value higher or equal to 4 (if is true dies)
-						u64 complete_sum = (~is_overfull & first_sum) + accumulators[y + 1];
-
-						u64 three_pattern = oct0 | oct1; //pattern of the number 3 in binary repeating in slots of 3 bits
-						u64 four_pattern = oct2;
-
-						u64 three_check = three_pattern ^ complete_sum; //completely 0 if is three
-						u64 four_check = four_pattern ^ complete_sum; //completely 0 if is four
-
-						u64 is_not_three = (three_check & oct0) << 2 | (three_check & oct1) << 1 | (three_check & oct2) << 0;
-						u64 is_not_four  = (four_check & oct0) << 2 | (four_check & oct1) << 1 | (four_check & oct2) << 0;    
-						u64 is_current_alive = (oct0 & (assembled.data[y] >> slot)) << 2; 
-					
-						u64 is_three = ~is_not_three; 
-						u64 is_four = ~is_not_four; 
-						u64 is_next_generation_alive = (is_three | (is_current_alive & is_four)) & ~is_overfull;
-
-						is_next_generation_alive &= oct2;
-
-						new_chunk.data[y] |= (is_next_generation_alive >> (2 - slot));
-					}
-				}
-			}
-
-			u64 acummulated = 0;
-			for(i32 i = 0; i < CHUNK_SIZE; i++)
-				acummulated |= new_chunk.data[1 + i] & CONTENT_BITS;
-
-			//Unless chunk is comletely dead insert itself alongside all neigboring chunks chunk_hash the next generation
-			if(acummulated != 0)
-			{
-				PERF_COUNTER("neighbour add");
-				i32 curr_i = chunk_hash_insert(next_chunk_hash, chunk->pos);
-				*chunk_hash_at(next_chunk_hash, curr_i) = new_chunk;
-					
-				//left right 
-				if(acummulated & ((u64) 1 << 1))
-					chunk_hash_insert(next_chunk_hash, vec_add(chunk->pos, vec(-1,  0)));
-				if(acummulated & ((u64) 1 << CHUNK_SIZE))
-					chunk_hash_insert(next_chunk_hash, vec_add(chunk->pos, vec(1,  0)));
-
-				//top bot
-				if(new_chunk.data[1] & CONTENT_BITS)
-					chunk_hash_insert(next_chunk_hash, vec_add(chunk->pos, vec(0,  -1)));
-				if(new_chunk.data[CHUNK_SIZE] & CONTENT_BITS)
-					chunk_hash_insert(next_chunk_hash, vec_add(chunk->pos, vec(0,  1)));
-						
-				//diagonals - there is only very small chence these will get added
-				if(chunk_get_cell(&new_chunk, vec(0, 0)))
-					chunk_hash_insert(next_chunk_hash, vec_add(chunk->pos, vec(-1, -1)));
-				if(chunk_get_cell(&new_chunk, vec(0, CHUNK_SIZE - 1)))
-					chunk_hash_insert(next_chunk_hash, vec_add(chunk->pos, vec(-1,  1)));
-				if(chunk_get_cell(&new_chunk, vec(CHUNK_SIZE - 1, 0)))
-					chunk_hash_insert(next_chunk_hash, vec_add(chunk->pos, vec(1,  -1)));
-				if(chunk_get_cell(&new_chunk, vec(CHUNK_SIZE - 1, CHUNK_SIZE - 1)))
-					chunk_hash_insert(next_chunk_hash, vec_add(chunk->pos, vec(1,  1)));
-			}
-		}
-	}
-}
-
-Vec2i get_chunk_pos(Vec2i sym_position);
-Vec2i get_cell_pos(Vec2i sym_position);
-void set_cell_at(Chunk_Hash* chunk_hash, Vec2i sym_pos, bool to);
-void set_cell_at_f(Chunk_Hash* chunk_hash, Vec2f64 sym_posf, bool to);
+void set_cell_at_f(Symulation* sym, Vec2f64 sym_posf, bool to);
 Vec2i to_screen_pos(Vec2f64 sym_position, Vec2f64 sym_center, Vec2i screen_center, f64 zoom);
 Vec2f64 to_sym_pos(Vec2i screen_position, Vec2f64 sym_center, Vec2i screen_center, f64 zoom);
 Vec2i get_mouse_pos(u32* state);
 
-void init_textures(SDL_Texture** normal_chunk_texture, SDL_Texture** clear_tex1, SDL_Texture** clear_tex2, SDL_Renderer* renderer);
-void update_screen(Vec2i top_chunk, Vec2i bot_chunk, Vec2f64 sym_center, Vec2i screen_center, f64 zoom, Chunk_Hash* chunk_hash, SDL_Texture* chunk_texture, SDL_Texture* clear_tex1, SDL_Texture* clear_tex2, SDL_Renderer* renderer);
+void init_textures(SDL_Texture** clear_tex1, SDL_Texture** clear_tex2, SDL_Renderer* renderer);
+void update_screen(Vec2i top_chunk, Vec2i bot_chunk, Vec2f64 sym_center, Vec2i screen_center, f64 zoom, Chunk_Hash* chunk_hash, u64 universe_version, Texture_Atlas* atlas, SDL_Texture* clear_tex1, SDL_Texture* clear_tex2, SDL_Renderer* renderer);
+SDL_Texture* create_screen_texture(Vec2i window_size, SDL_Renderer* renderer);
+void update_screen_lod(Vec2f64 sym_center, Vec2i screen_center, Vec2i window_size, f64 zoom, const Lod* lod, SDL_Texture* screen_texture, SDL_Renderer* renderer);
 
 int main(int argc, char *argv[]) {
 
@@ -318,47 +163,111 @@ int main(int argc, char *argv[]) {
 		SDL_SetHint(SDL_HINT_RENDER_SCALE_QUALITY, "linear");
 	SDL_Renderer* renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED);
 	
-	SDL_Texture* chunk_texture = NULL;
 	SDL_Texture* clear_chunk_texture1 = NULL;
 	SDL_Texture* clear_chunk_texture2 = NULL;
 
-	init_textures(&chunk_texture, &clear_chunk_texture1, &clear_chunk_texture2, renderer);
+	init_textures(&clear_chunk_texture1, &clear_chunk_texture2, renderer);
+	SDL_Texture* screen_texture = create_screen_texture(vec(DEF_WINDOW_WIDTH, DEF_WINDOW_HEIGHT), renderer);
 
-	//We keep two hashes and swap between them on every uodate
-	#define CHUNK_HASHES_COUNT 2
-	Chunk_Hash chunk_hashes[CHUNK_HASHES_COUNT] = {};
-	for(i32 i = 0; i < CHUNK_HASHES_COUNT; i++)
-		chunk_hash_init(&chunk_hashes[i]);
-	
-	i64 generation = 0;
-	Chunk_Hash* curr_chunk_hash  = &chunk_hashes[(generation + 0) % CHUNK_HASHES_COUNT];
-	Chunk_Hash* next_chunk_hash  = &chunk_hashes[(generation + 1) % CHUNK_HASHES_COUNT];
+	//The pixels of drawn chunks are cached in the atlas and only uploaded again when the chunk
+	//changed since the last drawn version of the universe (see texture_atlas.h).
+	Texture_Atlas atlas = {};
+	texture_atlas_init(&atlas, renderer);
+
+	//When zoomed out we draw the density mipmaps of the universe instead of the chunks.
+	//They are rebuilt only when drawn after the universe changed.
+	Lod lod = {};
+	lod_init(&lod);
+	u64 lod_version = (u64) -1;
+
+	//The starting pattern is loaded here and then handed over to the symulation thread
+	Chunk_Hash universe = {};
+	chunk_hash_init(&universe);
 
 	f64 zoom = 3.0;
-	f64 symulation_time = DEF_SYM_FREQ_MS;
 	Vec2f64 sym_center = {0.0, 0.0};
 	Vec2i window_size = {DEF_WINDOW_WIDTH, DEF_WINDOW_HEIGHT};
 	Vec2i screen_center = {window_size.x / 2, window_size.y / 2};
 	
 	f64 dt = 1.0 / TARGET_FRAME_TIME * 1000;
-	f64 last_sym_update_clock = clock_s();
 	f64 last_screen_update_clock = clock_s();
 	f64 last_frame_clock = clock_s();
 
-	f64 last_update_duration = 0;
 	f64 last_draw_duration = 0;
+	i64 last_title_updates = -1;
 
 	Vec2i old_mouse_pos = get_mouse_pos(NULL);
-	bool paused = false;
 
-	//Initialize the screen to square
-	for(i32 x = -250; x < 250; x++)
-		for(i32 y = -250; y < 250; y++)
-			set_cell_at(curr_chunk_hash, vec(x, y), true);
+	//Command line: [pattern file] [--rule B36/S23]
+	const char* pattern_path = NULL;
+	const char* rule_text = NULL;
+	for(i32 i = 1; i < argc; i++)
+	{
+		if(strcmp(argv[i], "--rule") == 0 && i + 1 < argc)
+			rule_text = argv[++i];
+		else
+			pattern_path = argv[i];
+	}
+
+	//Load the pattern given on the command line (RLE, Life 1.06, Macrocell or our text format)
+	//or initialize the screen to square
+	if(pattern_path != NULL)
+	{
+		char* text = NULL;
+		isize text_size = 0;
+		if(read_whole_file_alloc(pattern_path, &text, &text_size) == false)
+			printf("could not read pattern file '%s'\n", pattern_path);
+		else
+		{
+			Parse_Error error = parse_pattern_into_chunks(&universe, text);
+			if(error != PARSE_ERROR_NONE)
+				printf("error loading pattern '%s': %s\n", pattern_path, parse_error_to_string(error));
+
+			//the rule of the pattern is used unless given explicitly
+			Life_Rule rule = {0};
+			if(parse_pattern_rule(text, &rule))
+				life_rule_set(rule);
+			sure_realloc(text, 0, text_size, ALLOC_TAG_FILE);
+		}
+	}
+	else
+	{
+		for(i32 x = -250; x < 250; x++)
+			for(i32 y = -250; y < 250; y++)
+				set_cell_at(&universe, vec(x, y), true);
+	}
+
+	if(rule_text != NULL)
+	{
+		Life_Rule rule = {0};
+		if(life_rule_parse(&rule, rule_text))
+			life_rule_set(rule);
+		else
+			printf("invalid or unsupported rule '%s'\n", rule_text);
+	}
+
+	{
+		char rule_string[LIFE_RULE_STRING_SIZE] = {0};
+		life_rule_format(life_rule_get(), rule_string, sizeof rule_string);
+		printf("rule: %s\n", rule_string);
+	}
+
+	//The symulation runs on its own thread (see symulation.h). With the H key it is advanced
+	//by the hashlife engine instead by 2^hashlife_step_log2 generations per update (J/K keys).
+	Symulation_Settings settings = {0};
+	settings.update_period_ms = DEF_SYM_FREQ_MS;
+	settings.paused = DO_UPDATE_SYMULATION == false;
+	settings.use_hashlife = false;
+	settings.hashlife_step_log2 = 0;
+
+	Symulation sym = {};
+	symulation_init(&sym, &universe, 0, settings, SYMULATION_THREADS, HASHLIFE_MEMORY_BUDGET);
 
 	// main loop
 	while(true) 
 	{
+		PERF_COUNTER("frame");
+
 		// event handling
 		SDL_Event event;
 		if(SDL_PollEvent(&event)) 
@@ -366,21 +275,26 @@ int main(int argc, char *argv[]) {
 			if(event.type == SDL_QUIT)
 				break;
 				
+			//the symulation pauses itself when the universe gets full
+			settings = symulation_get_settings(&sym);
+
 			const u8* keayboard_state = SDL_GetKeyboardState(NULL);
 			if (keayboard_state[SDL_SCANCODE_P]) 
 			{
-				symulation_time += INPUT_FACTOR_INCREASE_SPEED*dt;
-				printf("new sym time: %lf ms\n", symulation_time);
+				settings.update_period_ms += INPUT_FACTOR_INCREASE_SPEED*dt;
+				symulation_set_settings(&sym, settings);
+				printf("new sym time: %lf ms\n", settings.update_period_ms);
 			}
 			
 			if (keayboard_state[SDL_SCANCODE_O]) 
 			{
-				f64 new_symulation_time = symulation_time - INPUT_FACTOR_INCREASE_SPEED*dt;
-				if(symulation_time / INPUT_FACTOR_INCREASE_SPEED_FRACTION > new_symulation_time)
-					symulation_time /= INPUT_FACTOR_INCREASE_SPEED_FRACTION;
+				f64 new_symulation_time = settings.update_period_ms - INPUT_FACTOR_INCREASE_SPEED*dt;
+				if(settings.update_period_ms / INPUT_FACTOR_INCREASE_SPEED_FRACTION > new_symulation_time)
+					settings.update_period_ms /= INPUT_FACTOR_INCREASE_SPEED_FRACTION;
 				else
-					symulation_time = new_symulation_time;
-				printf("new sym time: %lf ms\n", symulation_time);
+					settings.update_period_ms = new_symulation_time;
+				symulation_set_settings(&sym, settings);
+				printf("new sym time: %lf ms\n", settings.update_period_ms);
 			}
 
 			if(event.type == SDL_WINDOWEVENT)
@@ -393,13 +307,67 @@ int main(int argc, char *argv[]) {
 					window_size.x = w;
 					window_size.y = h;
 					screen_center = {window_size.x / 2, window_size.y / 2};
+
+					SDL_DestroyTexture(screen_texture);
+					screen_texture = create_screen_texture(window_size, renderer);
 				}
 			}
 
 			if(event.type == SDL_KEYUP)
 			{
 				if(event.key.keysym.sym == SDLK_SPACE)
-					paused = !paused;
+				{
+					settings.paused = !settings.paused;
+					symulation_set_settings(&sym, settings);
+				}
+
+				if(event.key.keysym.sym == SDLK_h)
+				{
+					settings.use_hashlife = !settings.use_hashlife;
+					symulation_set_settings(&sym, settings);
+					printf("engine: %s\n", settings.use_hashlife ? "hashlife" : "chunk");
+				}
+
+				if(event.key.keysym.sym == SDLK_k && settings.hashlife_step_log2 < HASHLIFE_MAX_STEP_LOG2)
+				{
+					settings.hashlife_step_log2 += 1;
+					symulation_set_settings(&sym, settings);
+					printf("hashlife step: 2^%d generations\n", settings.hashlife_step_log2);
+				}
+
+				if(event.key.keysym.sym == SDLK_j && settings.hashlife_step_log2 > 0)
+				{
+					settings.hashlife_step_log2 -= 1;
+					symulation_set_settings(&sym, settings);
+					printf("hashlife step: 2^%d generations\n", settings.hashlife_step_log2);
+				}
+
+				if(event.key.keysym.sym == SDLK_F5)
+				{
+					i64 generation = 0;
+					const Chunk_Hash* chunk_hash = symulation_acquire(&sym, NULL, &generation);
+					Snapshot_Error error = snapshot_save(chunk_hash, generation, SNAPSHOT_PATH);
+					symulation_release(&sym);
+					printf("saving snapshot '%s': %s\n", SNAPSHOT_PATH, snapshot_error_to_string(error));
+				}
+
+				if(event.key.keysym.sym == SDLK_F7)
+				{
+					if(perf_trace_is_running())
+					{
+						perf_trace_stop();
+						bool ok = perf_trace_export(TRACE_PATH);
+						printf("writing trace '%s': %s\n", TRACE_PATH, ok ? "ok" : "failed");
+					}
+					else
+					{
+						perf_trace_start(TRACE_MAX_EVENTS);
+						printf("tracing started (press F7 again to stop)\n");
+					}
+				}
+
+				if(event.key.keysym.sym == SDLK_F9)
+					symulation_load_snapshot(&sym, SNAPSHOT_PATH);
 			}
 
 			if(event.type == SDL_MOUSEWHEEL)
@@ -443,7 +411,7 @@ int main(int argc, char *argv[]) {
 				bool is_draw = !keayboard_state[SDL_SCANCODE_D];
 				if(mouse_sym_delta_f.x == 0 && mouse_sym_delta_f.y == 0)
 				{
-					set_cell_at_f(curr_chunk_hash, Vec2f64{new_mouse_sym_f.x, new_mouse_sym_f.y}, is_draw);
+					set_cell_at_f(&sym, Vec2f64{new_mouse_sym_f.x, new_mouse_sym_f.y}, is_draw);
 				}
 				else if(fabs(mouse_sym_delta_f.x) >= fabs(mouse_sym_delta_f.y))
 				{
@@ -451,13 +419,13 @@ int main(int argc, char *argv[]) {
 					for(f64 x = new_mouse_sym_f.x; x <= old_mouse_sym_f.x; x++)
 					{
 						f64 y = r*(x - new_mouse_sym_f.x) + new_mouse_sym_f.y;
-						set_cell_at_f(curr_chunk_hash, Vec2f64{x, y}, is_draw);
+						set_cell_at_f(&sym, Vec2f64{x, y}, is_draw);
 					}
 					
 					for(f64 x = old_mouse_sym_f.x; x <= new_mouse_sym_f.x; x++)
 					{
 						f64 y = r*(x - old_mouse_sym_f.x) + old_mouse_sym_f.y;
-						set_cell_at_f(curr_chunk_hash, Vec2f64{x, y}, is_draw);
+						set_cell_at_f(&sym, Vec2f64{x, y}, is_draw);
 					}
 				}
 				else
@@ -466,13 +434,13 @@ int main(int argc, char *argv[]) {
 					for(f64 y = old_mouse_sym_f.y; y <= new_mouse_sym_f.y; y++)
 					{
 						f64 x = r*(y - old_mouse_sym_f.y) + old_mouse_sym_f.x;
-						set_cell_at_f(curr_chunk_hash, Vec2f64{x, y}, is_draw);
+						set_cell_at_f(&sym, Vec2f64{x, y}, is_draw);
 					}
 					
 					for(f64 y = new_mouse_sym_f.y; y <= old_mouse_sym_f.y; y++)
 					{
 						f64 x = r*(y - new_mouse_sym_f.y) + new_mouse_sym_f.x;
-						set_cell_at_f(curr_chunk_hash, Vec2f64{x, y}, is_draw);
+						set_cell_at_f(&sym, Vec2f64{x, y}, is_draw);
 					}
 				}
 			}
@@ -499,28 +467,35 @@ int main(int argc, char *argv[]) {
 		if((clock_s() - last_screen_update_clock)*1000 >= TARGET_FRAME_TIME && DO_UPDATE_SCREEN)
 		{
 			f64 screen_update_start = clock_s();
-			update_screen(top_chunk, bot_chunk, sym_center, screen_center, zoom, curr_chunk_hash, chunk_texture, clear_chunk_texture1, clear_chunk_texture2, renderer);
+
+			//The symulation thread keeps going while we draw the newest generation
+			u64 universe_version = 0;
+			Chunk_Hash* chunk_hash = symulation_acquire(&sym, &universe_version, NULL);
+			if(zoom * CHUNK_SIZE < LOD_CHUNK_PIXELS)
+			{
+				if(lod_version != universe_version)
+					lod_build(&lod, chunk_hash);
+				lod_version = universe_version;
+				symulation_release(&sym);
+				update_screen_lod(sym_center, screen_center, window_size, zoom, &lod, screen_texture, renderer);
+			}
+			else
+			{
+				update_screen(top_chunk, bot_chunk, sym_center, screen_center, zoom, chunk_hash, universe_version, &atlas, clear_chunk_texture1, clear_chunk_texture2, renderer);
+				symulation_release(&sym);
+			}
 			last_screen_update_clock = clock_s();
 
 			last_draw_duration = last_screen_update_clock - screen_update_start;
 		}
 		
-		if((clock_s() - last_sym_update_clock)*1000 >= symulation_time && paused == false && DO_UPDATE_SYMULATION)
+		Symulation_Stats stats = symulation_get_stats(&sym);
+		if(stats.updates != last_title_updates)
 		{
-			generation++;
-			f64 clock_update_start = clock_s();
-
-			chunk_hash_clear(next_chunk_hash);
-			game_of_life_generation_step(curr_chunk_hash, next_chunk_hash);
-			
-			curr_chunk_hash  = &chunk_hashes[(generation + 0) % CHUNK_HASHES_COUNT];
-			next_chunk_hash  = &chunk_hashes[(generation + 1) % CHUNK_HASHES_COUNT];
-
-			last_sym_update_clock = clock_s();	
-			last_update_duration = last_sym_update_clock - clock_update_start;
-
+			last_title_updates = stats.updates;
 			char title_buffer[256] = "";
-			snprintf(title_buffer, sizeof title_buffer, "%s update: %8lf draw: %8lf", WINDOW_TITLE, last_update_duration, last_draw_duration);
+			snprintf(title_buffer, sizeof title_buffer, "%s update: %8lf draw: %8lf population: %lld", WINDOW_TITLE,
+				stats.last_update_duration, last_draw_duration, (lld) stats.last_step.population);
 			SDL_SetWindowTitle(window, title_buffer);
 		}
 
@@ -529,32 +504,51 @@ int main(int argc, char *argv[]) {
 		last_frame_clock = new_frame_clock;
 	}
 	
+	Symulation_Stats final_stats = symulation_get_stats(&sym);
 	printf("total time: %lf\n", clock_s());
-	printf("generations: %d\n", (int) generation);
-	printf("generations/s: %lf\n", generation / clock_s());
+	printf("generations: %lld\n", (lld) final_stats.generation);
+	printf("generations/s: %lf\n", final_stats.generation / clock_s());
 
-	const Perf_Counter* const* perf_counters = perf_get_counters();
-	for(isize i = 0; i < perf_get_counter_count(); i++)
+	i64 perf_counter_count = 0;
+	const Perf_Counter* perf_counters = perf_get_counters(&perf_counter_count);
+	for(isize i = 0; i < perf_counter_count; i++)
 	{
-		Perf_Counter counter = *perf_counters[i];
-		if(counter.runs != 0)
+		const Perf_Counter* counter = &perf_counters[i];
+		if(counter->runs != 0)
 		{
 			f64 total_s = perf_counter_get_total_running_time_s(counter);
 			f64 per_run_s = perf_counter_get_average_running_time_s(counter);
-
-			printf("%-25s: total: %8.8lf run: %8.8lf runs: %-8lld at %s %lld\n", 
-				counter.name ? counter.name : "", total_s, per_run_s, (lld) counter.runs, counter.function, (lld) counter.line);
+			f64 p50_s = perf_counter_get_percentile_running_time_s(counter, 0.5);
+			f64 p99_s = perf_counter_get_percentile_running_time_s(counter, 0.99);
+			f64 max_s = perf_counter_get_max_running_time_s(counter);
+
+			//indent children under their parents
+			int indent = counter->depth * 2;
+			printf("%*s%-*s: total: %8.8lf run: %8.8lf p50: %8.8lf p99: %8.8lf max: %8.8lf runs: %-8lld at %s %lld\n", 
+				indent, "", 30 - indent, counter->name ? counter->name : counter->function, 
+				total_s, per_run_s, p50_s, p99_s, max_s, (lld) counter->runs, counter->function, (lld) counter->line);
 		}
 	}
+
+	for(i32 i = 0; i < ALLOC_TAG_COUNT; i++)
+	{
+		Alloc_Stats stats = alloc_get_stats((Alloc_Tag) i);
+		printf("memory %-18s: live: %-14lld peak: %-14lld allocs: %-8lld reallocs: %-8lld frees: %lld\n", 
+			alloc_tag_to_string((Alloc_Tag) i), (lld) stats.live_bytes, (lld) stats.peak_bytes, 
+			(lld) stats.allocations, (lld) stats.reallocations, (lld) stats.frees);
+	}
 	
 	#ifdef DO_CLEANUP
 	SDL_DestroyTexture(clear_chunk_texture1);
 	SDL_DestroyTexture(clear_chunk_texture2);
+	SDL_DestroyTexture(screen_texture);
+	texture_atlas_deinit(&atlas);
 	SDL_DestroyRenderer(renderer);
 	SDL_DestroyWindow(window);
 	
-	for(i32 i = 0; i < CHUNK_HASHES_COUNT; i++)
-		chunk_hash_deinit(&chunk_hashes[i]);
+	symulation_deinit(&sym);
+	chunk_hash_deinit(&universe);
+	lod_deinit(&lod);
 
 	SDL_Quit(); 
 	#endif // DO_CLEANUP
@@ -562,55 +556,14 @@ int main(int argc, char *argv[]) {
 }
 
 
-Vec2i get_chunk_pos(Vec2i sym_position)
-{
-	Vec2i output = {0};
-	output.x = div_round_down(sym_position.x, CHUNK_SIZE);
-	output.y = div_round_down(sym_position.y, CHUNK_SIZE);
-
-	return output;
-};
-	
-Vec2i get_cell_pos(Vec2i sym_position)
-{
-	Vec2i output = {0};
-	output.x = (sym_position.x % CHUNK_SIZE + CHUNK_SIZE) % CHUNK_SIZE;
-	output.y = (sym_position.y % CHUNK_SIZE + CHUNK_SIZE) % CHUNK_SIZE;
-
-	return output;
-};
-
-void set_cell_at(Chunk_Hash* chunk_hash, Vec2i sym_pos, bool to)
-{
-	Vec2i place_at_chunk = get_chunk_pos(sym_pos);
-	Vec2i place_at_pixel = get_cell_pos(sym_pos);
-
-	i32 chunk_i = chunk_hash_insert(chunk_hash, place_at_chunk);
-	Chunk* chunk = chunk_hash_at(chunk_hash, chunk_i);
-	chunk_set_cell(chunk, place_at_pixel, to);
-
-	//@TODO: careful insertion of only the chunks we need!
-	if(to)
-	{
-		const Vec2i directions[8] = {
-			{-1, -1},{0, -1},{1, -1},
-			{-1, 0}, /* X */ {1,  0},
-			{-1,  1},{0,  1},{1,  1},
-		};
-
-		for(i32 i = 0; i < 8; i++)
-			chunk_hash_insert(chunk_hash, vec_add(directions[i], place_at_chunk));
-	}
-};
-
-void set_cell_at_f(Chunk_Hash* chunk_hash, Vec2f64 sym_posf, bool to)
+void set_cell_at_f(Symulation* sym, Vec2f64 sym_posf, bool to)
 {
 	Vec2i sym_pos = {
 		(i32) round(sym_posf.x),
 		(i32) round(sym_posf.y),
 	};
 
-	set_cell_at(chunk_hash, sym_pos, to);
+	symulation_set_cell(sym, sym_pos, to);
 };
 
 Vec2i to_screen_pos(Vec2f64 sym_position, Vec2f64 sym_center, Vec2i screen_center, f64 zoom)
@@ -647,14 +600,8 @@ Vec2i get_mouse_pos(u32* state)
 	return {x, y};
 }
 
-void init_textures(SDL_Texture** normal_chunk_texture, SDL_Texture** clear_tex1, SDL_Texture** clear_tex2, SDL_Renderer* renderer)
+void init_textures(SDL_Texture** clear_tex1, SDL_Texture** clear_tex2, SDL_Renderer* renderer)
 {
-	SDL_Texture* chunk_texture = SDL_CreateTexture(renderer,
-                           SDL_PIXELFORMAT_BGRA8888,
-                           SDL_TEXTUREACCESS_STREAMING, 
-                           CHUNK_SIZE,
-                           CHUNK_SIZE);
-
 	SDL_Texture* clear_chunk_texture1 = SDL_CreateTexture(renderer,
                            SDL_PIXELFORMAT_BGRA8888,
                            SDL_TEXTUREACCESS_STREAMING, 
@@ -688,11 +635,10 @@ void init_textures(SDL_Texture** normal_chunk_texture, SDL_Texture** clear_tex1,
 	}
 
 	*clear_tex1 = clear_chunk_texture1;
-	*clear_tex1 = clear_chunk_texture2;
-	*normal_chunk_texture = chunk_texture;
+	*clear_tex2 = clear_chunk_texture2;
 }
 
-void update_screen(Vec2i top_chunk, Vec2i bot_chunk, Vec2f64 sym_center, Vec2i screen_center, f64 zoom, Chunk_Hash* chunk_hash, SDL_Texture* chunk_texture, SDL_Texture* clear_tex1, SDL_Texture* clear_tex2, SDL_Renderer* renderer)
+void update_screen(Vec2i top_chunk, Vec2i bot_chunk, Vec2f64 sym_center, Vec2i screen_center, f64 zoom, Chunk_Hash* chunk_hash, u64 universe_version, Texture_Atlas* atlas, SDL_Texture* clear_tex1, SDL_Texture* clear_tex2, SDL_Renderer* renderer)
 {
 	PERF_COUNTER();
 	SDL_RenderClear(renderer);
@@ -735,27 +681,111 @@ void update_screen(Vec2i top_chunk, Vec2i bot_chunk, Vec2f64 sym_center, Vec2i s
 			}
 			else
 			{
-				uint32_t* pixels = NULL;
-				int pitch = 0;
-				SDL_LockTexture(chunk_texture, NULL, (void**) &pixels, &pitch);
-				
-				for(i32 j = 0; j < CHUNK_SIZE; j++)
-					for(i32 i = 0; i < CHUNK_SIZE; i ++)
-					{
-						if(chunk_get_cell(chunk, vec(i, j)))
-							pixels[i + j*CHUNK_SIZE] = (uint32_t) -1; 
-						else
-							pixels[i + j*CHUNK_SIZE] = clear_color;
-					}
-			
-		
-				SDL_UnlockTexture(chunk_texture);
-				SDL_RenderCopy(renderer, chunk_texture, NULL, &dest_rect);
+				SDL_Rect source_rect = texture_atlas_get(atlas, chunk_pos_sym, chunk, universe_version, clear_color);
+				SDL_RenderCopy(renderer, atlas->texture, &source_rect, &dest_rect);
 			}
 		}
 	}
 	SDL_RenderPresent(renderer);
 };
 
+SDL_Texture* create_screen_texture(Vec2i window_size, SDL_Renderer* renderer)
+{
+	return SDL_CreateTexture(renderer,
+                           SDL_PIXELFORMAT_BGRA8888,
+                           SDL_TEXTUREACCESS_STREAMING, 
+                           window_size.x > 0 ? window_size.x : 1,
+                           window_size.y > 0 ? window_size.y : 1);
+}
+
+//Returns the color of a texel of a Lod_Tile covering texel_cells cells with count alive ones
+static u32 lod_density_color(u32 count, f64 texel_cells)
+{
+	if(count == 0)
+		return CLEAR_COLOR_ACTIVE_1;
 
+	//sqrt so that even sparse areas are visible. Random soup settles around 3-4% density
+	f64 density = sqrt((f64) count / texel_cells * 2);
+	if(density > 1)
+		density = 1;
 
+	u32 shade = LOD_MIN_SHADE + (u32) ((0xFF - LOD_MIN_SHADE) * density);
+	return shade << 24 | shade << 16 | shade << 8 | 0xFF;
+}
+
+//Draws the universe from the density mipmaps into a single screen sized texture. Picks the level whose
+//texels are at most a pixel big so that there are at most about as many texels drawn as there are pixels.
+//Where more texels fall into the same pixel the brightest one wins so that lone gliders dont disappear.
+void update_screen_lod(Vec2f64 sym_center, Vec2i screen_center, Vec2i window_size, f64 zoom, const Lod* lod, SDL_Texture* screen_texture, SDL_Renderer* renderer)
+{
+	PERF_COUNTER();
+	i32 level = lod_pick_level(lod, zoom);
+
+	i64 tile_cells = (i64) CHUNK_SIZE << level;
+	f64 texel_cells = (f64) tile_cells * (f64) tile_cells / (LOD_TILE * LOD_TILE);
+	Vec2f64 sym_top = to_sym_pos(vec(0, 0), sym_center, screen_center, zoom);
+	Vec2f64 sym_bot = to_sym_pos(window_size, sym_center, screen_center, zoom);
+	i64 top_tile_x = (i64) floor(sym_top.x / (f64) tile_cells);
+	i64 top_tile_y = (i64) floor(sym_top.y / (f64) tile_cells);
+	i64 bot_tile_x = (i64) floor(sym_bot.x / (f64) tile_cells);
+	i64 bot_tile_y = (i64) floor(sym_bot.y / (f64) tile_cells);
+
+	uint32_t* pixels = NULL;
+	int pitch = 0;
+	SDL_LockTexture(screen_texture, NULL, (void**) &pixels, &pitch);
+	i32 stride = pitch / (i32) sizeof(uint32_t);
+
+	for(i32 j = 0; j < window_size.y; j++)
+		for(i32 i = 0; i < window_size.x; i++)
+			pixels[i + j*stride] = CLEAR_COLOR_1;
+
+	for(i64 tile_y = top_tile_y; tile_y <= bot_tile_y; tile_y++)
+	{
+		for(i64 tile_x = top_tile_x; tile_x <= bot_tile_x; tile_x++)
+		{
+			const Lod_Tile* tile = lod_get(lod, level, vec((i32) tile_x, (i32) tile_y));
+			if(tile == NULL)
+				continue;
+
+			//screen position of the borders between texels
+			i32 screen_x[LOD_TILE + 1] = {0};
+			i32 screen_y[LOD_TILE + 1] = {0};
+			for(i32 i = 0; i <= LOD_TILE; i++)
+			{
+				i64 offset = lod_texel_offset(level, i);
+				Vec2f64 corner = {(f64) (tile_x*tile_cells + offset), (f64) (tile_y*tile_cells + offset)};
+				Vec2i screen_corner = to_screen_pos(corner, sym_center, screen_center, zoom);
+				screen_x[i] = screen_corner.x;
+				screen_y[i] = screen_corner.y;
+			}
+
+			for(i32 ty = 0; ty < LOD_TILE; ty++)
+			{
+				i32 from_y = screen_y[ty] > 0 ? screen_y[ty] : 0;
+				i32 to_y = screen_y[ty + 1] > screen_y[ty] ? screen_y[ty + 1] : screen_y[ty] + 1;
+				if(to_y > window_size.y)
+					to_y = window_size.y;
+
+				for(i32 tx = 0; tx < LOD_TILE; tx++)
+				{
+					i32 from_x = screen_x[tx] > 0 ? screen_x[tx] : 0;
+					i32 to_x = screen_x[tx + 1] > screen_x[tx] ? screen_x[tx + 1] : screen_x[tx] + 1;
+					if(to_x > window_size.x)
+						to_x = window_size.x;
+
+					//alive texels are shades of grey brighter than the clear colors so the brighter one is also the bigger number
+					u32 color = lod_density_color(tile->counts[tx + ty*LOD_TILE], texel_cells);
+					for(i32 y = from_y; y < to_y; y++)
+						for(i32 x = from_x; x < to_x; x++)
+							if(pixels[x + y*stride] < color)
+								pixels[x + y*stride] = color;
+				}
+			}
+		}
+	}
+
+	SDL_UnlockTexture(screen_texture);
+	SDL_RenderClear(renderer);
+	SDL_RenderCopy(renderer, screen_texture, NULL, NULL);
+	SDL_RenderPresent(renderer);
+}
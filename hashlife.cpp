@@ -0,0 +1,781 @@
+#include "hashlife.h"
+#include "life.h"
+#include "perf.h"
+#include "alloc.h"
+
+enum
+{
+	QUAD_NW = 0,
+	QUAD_NE = 1,
+	QUAD_SW = 2,
+	QUAD_SE = 3,
+};
+
+//Level whose children are leaves and whose result is computed by brute force
+#define BASE_LEVEL (HASHLIFE_LEAF_LEVEL + 1)
+//The smallest root level we ever use. Makes sure the root is never a leaf (or a base node).
+#define MIN_ROOT_LEVEL (HASHLIFE_LEAF_LEVEL + 2)
+
+static u64 hashlife_mix(u64 hash, u64 value)
+{
+	hash = (hash ^ value) * (u64) 0xbf58476d1ce4e5b9;
+	hash = hash ^ (hash >> 31);
+	return hash;
+}
+
+static u64 leaf_hash_of(const u64* rows)
+{
+	u64 hash = 0x9e3779b97f4a7c15;
+	for(i32 i = 0; i < HASHLIFE_LEAF_SIZE; i++)
+		hash = hashlife_mix(hash, rows[i]);
+	return hash;
+}
+
+static u64 node_hash_of(i32 level, const u32* children)
+{
+	u64 hash = hashlife_mix(0x9e3779b97f4a7c15, (u64) level);
+	hash = hashlife_mix(hash, (u64) children[0] << 32 | children[1]);
+	hash = hashlife_mix(hash, (u64) children[2] << 32 | children[3]);
+	return hash;
+}
+
+static i32 popcount64(u64 val)
+{
+	i32 count = 0;
+	for(; val; count++)
+		val &= val - 1;
+	return count;
+}
+
+static void hashlife_rehash_leaves(Hashlife* hashlife, i32 new_capacity)
+{
+	PERF_COUNTER("hashlife rehash");
+	sure_realloc(hashlife->leaf_hash, 0, hashlife->leaf_hash_capacity * sizeof(u32), ALLOC_TAG_HASHLIFE);
+	hashlife->leaf_hash = (u32*) sure_realloc(NULL, new_capacity * sizeof(u32), 0, ALLOC_TAG_HASHLIFE);
+	hashlife->leaf_hash_capacity = new_capacity;
+	memset(hashlife->leaf_hash, 0, new_capacity * sizeof(u32));
+
+	u64 mod = (u64) new_capacity - 1;
+	for(i32 i = 0; i < hashlife->leaf_size; i++)
+	{
+		u64 k = leaf_hash_of(hashlife->leaves[i].rows) & mod;
+		while(hashlife->leaf_hash[k] != 0)
+			k = (k + 1) & mod;
+		hashlife->leaf_hash[k] = (u32) i + 1;
+	}
+}
+
+static void hashlife_rehash_nodes(Hashlife* hashlife, i32 new_capacity)
+{
+	PERF_COUNTER("hashlife rehash");
+	sure_realloc(hashlife->node_hash, 0, hashlife->node_hash_capacity * sizeof(u32), ALLOC_TAG_HASHLIFE);
+	hashlife->node_hash = (u32*) sure_realloc(NULL, new_capacity * sizeof(u32), 0, ALLOC_TAG_HASHLIFE);
+	hashlife->node_hash_capacity = new_capacity;
+	memset(hashlife->node_hash, 0, new_capacity * sizeof(u32));
+
+	u64 mod = (u64) new_capacity - 1;
+	for(i32 i = 0; i < hashlife->node_size; i++)
+	{
+		Hashlife_Node* node = &hashlife->nodes[i];
+		u64 k = node_hash_of(node->level, node->children) & mod;
+		while(hashlife->node_hash[k] != 0)
+			k = (k + 1) & mod;
+		hashlife->node_hash[k] = (u32) i + 1;
+	}
+}
+
+//Returns the canonical leaf with the given rows (adding it if it does not exist yet)
+static u32 hashlife_leaf(Hashlife* hashlife, const u64* rows)
+{
+	//keep the hash at most half full
+	if(hashlife->leaf_size * 2 >= hashlife->leaf_hash_capacity)
+		hashlife_rehash_leaves(hashlife, hashlife->leaf_hash_capacity ? hashlife->leaf_hash_capacity * 2 : 1024);
+
+	u64 mod = (u64) hashlife->leaf_hash_capacity - 1;
+	u64 k = leaf_hash_of(rows) & mod;
+	for(; hashlife->leaf_hash[k] != 0; k = (k + 1) & mod)
+	{
+		u32 index = hashlife->leaf_hash[k] - 1;
+		if(memcmp(hashlife->leaves[index].rows, rows, sizeof(hashlife->leaves[index].rows)) == 0)
+			return index;
+	}
+
+	if(hashlife->leaf_size >= hashlife->leaf_capacity)
+	{
+		i32 new_capacity = hashlife->leaf_capacity * 2 + 256;
+		hashlife->leaves = (Hashlife_Leaf*) sure_realloc(hashlife->leaves, new_capacity * sizeof(Hashlife_Leaf), hashlife->leaf_capacity * sizeof(Hashlife_Leaf), ALLOC_TAG_HASHLIFE);
+		hashlife->leaf_capacity = new_capacity;
+	}
+
+	u32 index = (u32) hashlife->leaf_size++;
+	Hashlife_Leaf* leaf = &hashlife->leaves[index];
+	memcpy(leaf->rows, rows, sizeof(leaf->rows));
+	leaf->population = 0;
+	for(i32 i = 0; i < HASHLIFE_LEAF_SIZE; i++)
+		leaf->population += popcount64(rows[i]);
+
+	hashlife->leaf_hash[k] = index + 1;
+	return index;
+}
+
+static u64 hashlife_population_of(const Hashlife* hashlife, u32 index, i32 level)
+{
+	if(level == HASHLIFE_LEAF_LEVEL)
+		return hashlife->leaves[index].population;
+	else
+		return hashlife->nodes[index].population;
+}
+
+//Returns the canonical node of level with the given children (adding it if it does not exist yet)
+static u32 hashlife_node(Hashlife* hashlife, i32 level, u32 nw, u32 ne, u32 sw, u32 se)
+{
+	assert(BASE_LEVEL <= level && level <= HASHLIFE_MAX_LEVEL);
+	u32 children[4] = {nw, ne, sw, se};
+
+	if(hashlife->node_size * 2 >= hashlife->node_hash_capacity)
+		hashlife_rehash_nodes(hashlife, hashlife->node_hash_capacity ? hashlife->node_hash_capacity * 2 : 1024);
+
+	u64 mod = (u64) hashlife->node_hash_capacity - 1;
+	u64 k = node_hash_of(level, children) & mod;
+	for(; hashlife->node_hash[k] != 0; k = (k + 1) & mod)
+	{
+		u32 index = hashlife->node_hash[k] - 1;
+		Hashlife_Node* node = &hashlife->nodes[index];
+		if(node->level == level && memcmp(node->children, children, sizeof(children)) == 0)
+			return index;
+	}
+
+	if(hashlife->node_size >= hashlife->node_capacity)
+	{
+		i32 new_capacity = hashlife->node_capacity * 2 + 1024;
+		hashlife->nodes = (Hashlife_Node*) sure_realloc(hashlife->nodes, new_capacity * sizeof(Hashlife_Node), hashlife->node_capacity * sizeof(Hashlife_Node), ALLOC_TAG_HASHLIFE);
+		hashlife->node_capacity = new_capacity;
+	}
+
+	u32 index = (u32) hashlife->node_size++;
+	Hashlife_Node* node = &hashlife->nodes[index];
+	memcpy(node->children, children, sizeof(children));
+	node->result = HASHLIFE_NONE;
+	node->result_step = 0;
+	node->level = (u8) level;
+	node->population = 0;
+	for(i32 i = 0; i < 4; i++)
+		node->population += hashlife_population_of(hashlife, children[i], level - 1);
+
+	hashlife->node_hash[k] = index + 1;
+	return index;
+}
+
+static u32 hashlife_empty(Hashlife* hashlife, i32 level)
+{
+	if(level == HASHLIFE_LEAF_LEVEL)
+	{
+		static const u64 empty_rows[HASHLIFE_LEAF_SIZE] = {0};
+		return hashlife_leaf(hashlife, empty_rows);
+	}
+
+	if(hashlife->empty_nodes[level] == HASHLIFE_NONE)
+	{
+		u32 child = hashlife_empty(hashlife, level - 1);
+		hashlife->empty_nodes[level] = hashlife_node(hashlife, level, child, child, child, child);
+	}
+
+	return hashlife->empty_nodes[level];
+}
+
+static u32 hashlife_child(const Hashlife* hashlife, u32 index, i32 quadrant)
+{
+	return hashlife->nodes[index].children[quadrant];
+}
+
+//Returns the center of node of level as a node of level - 1 (without advancing it)
+static u32 hashlife_center(Hashlife* hashlife, u32 index, i32 level)
+{
+	Hashlife_Node node = hashlife->nodes[index];
+	if(level == BASE_LEVEL)
+	{
+		//Glue together the inner quarters of the 4 leaves
+		const u64 half = HASHLIFE_LEAF_SIZE / 2;
+		u64 rows[HASHLIFE_LEAF_SIZE];
+		const Hashlife_Leaf* nw = &hashlife->leaves[node.children[QUAD_NW]];
+		const Hashlife_Leaf* ne = &hashlife->leaves[node.children[QUAD_NE]];
+		const Hashlife_Leaf* sw = &hashlife->leaves[node.children[QUAD_SW]];
+		const Hashlife_Leaf* se = &hashlife->leaves[node.children[QUAD_SE]];
+		for(u64 y = 0; y < half; y++)
+		{
+			rows[y]        = (nw->rows[y + half] >> half) | (ne->rows[y + half] << half);
+			rows[y + half] = (sw->rows[y] >> half)        | (se->rows[y] << half);
+		}
+
+		return hashlife_leaf(hashlife, rows);
+	}
+
+	return hashlife_node(hashlife, level - 1,
+		hashlife_child(hashlife, node.children[QUAD_NW], QUAD_SE),
+		hashlife_child(hashlife, node.children[QUAD_NE], QUAD_SW),
+		hashlife_child(hashlife, node.children[QUAD_SW], QUAD_NE),
+		hashlife_child(hashlife, node.children[QUAD_SE], QUAD_NW));
+}
+
+//Advances a 128x128 field by a single generation of rule. Cells outside are considered dead.
+//Each row is made of 2 words: [0] holds x = 0..63, [1] holds x = 64..127
+static void base_life_step(u64 (*field)[2], u64 (*next)[2], Life_Rule rule)
+{
+	const i32 size = HASHLIFE_LEAF_SIZE * 2;
+
+	//Horizontal sums of 3 (ones and twos bits) and of 2 (without center)
+	//are computed per row and then combined with full adders
+	u64 sum3_1[size][2], sum3_2[size][2], sum2_1[size][2], sum2_2[size][2];
+	for(i32 y = 0; y < size; y++)
+	{
+		u64 lo = field[y][0];
+		u64 hi = field[y][1];
+		u64 left[2] = {lo << 1, (hi << 1) | (lo >> 63)};
+		u64 right[2] = {(lo >> 1) | (hi << 63), hi >> 1};
+		for(i32 w = 0; w < 2; w++)
+		{
+			u64 c = field[y][w];
+			u64 l = left[w];
+			u64 r = right[w];
+			sum2_1[y][w] = l ^ r;
+			sum2_2[y][w] = l & r;
+			sum3_1[y][w] = l ^ r ^ c;
+			sum3_2[y][w] = (l & r) | (c & (l ^ r));
+		}
+	}
+
+	for(i32 y = 0; y < size; y++)
+	{
+		for(i32 w = 0; w < 2; w++)
+		{
+			u64 a1 = y > 0 ? sum3_1[y - 1][w] : 0;
+			u64 a2 = y > 0 ? sum3_2[y - 1][w] : 0;
+			u64 b1 = y < size - 1 ? sum3_1[y + 1][w] : 0;
+			u64 b2 = y < size - 1 ? sum3_2[y + 1][w] : 0;
+			u64 e1 = sum2_1[y][w];
+			u64 e2 = sum2_2[y][w];
+
+			//ones
+			u64 ones = a1 ^ e1 ^ b1;
+			u64 ones_carry = (a1 & e1) | (b1 & (a1 ^ e1));
+
+			//twos: a2 + e2 + b2 + ones_carry
+			u64 partial = a2 ^ e2 ^ b2;
+			u64 partial_carry = (a2 & e2) | (b2 & (a2 ^ e2));
+
+			Life_Count count = {0};
+			count.ones = ones;
+			count.twos = partial ^ ones_carry;
+			count.fours = partial_carry ^ (partial & ones_carry);
+			count.eights = partial_carry & partial & ones_carry;
+			next[y][w] = life_rule_apply(rule.birth, rule.survive, count, field[y][w]);
+		}
+	}
+}
+
+//Computes the center of a base level node advanced by 2^step generations (step <= 5)
+static u32 hashlife_base_result(Hashlife* hashlife, u32 index, i32 step)
+{
+	PERF_COUNTER("hashlife base");
+	const i32 half = HASHLIFE_LEAF_SIZE / 2;
+	const i32 size = HASHLIFE_LEAF_SIZE * 2;
+
+	Hashlife_Node node = hashlife->nodes[index];
+	const Hashlife_Leaf* nw = &hashlife->leaves[node.children[QUAD_NW]];
+	const Hashlife_Leaf* ne = &hashlife->leaves[node.children[QUAD_NE]];
+	const Hashlife_Leaf* sw = &hashlife->leaves[node.children[QUAD_SW]];
+	const Hashlife_Leaf* se = &hashlife->leaves[node.children[QUAD_SE]];
+
+	u64 buffers[2][size][2];
+	for(i32 y = 0; y < HASHLIFE_LEAF_SIZE; y++)
+	{
+		buffers[0][y][0] = nw->rows[y];
+		buffers[0][y][1] = ne->rows[y];
+		buffers[0][y + HASHLIFE_LEAF_SIZE][0] = sw->rows[y];
+		buffers[0][y + HASHLIFE_LEAF_SIZE][1] = se->rows[y];
+	}
+
+	//The invalid border (where the dead outside leaks in) grows by one cell each generation
+	//so after at most 32 generations the center 64x64 is still correct
+	i32 generations = 1 << step;
+	for(i32 i = 0; i < generations; i++)
+		base_life_step(buffers[i % 2], buffers[(i + 1) % 2], hashlife->rule);
+
+	u64 (*field)[2] = buffers[generations % 2];
+	u64 rows[HASHLIFE_LEAF_SIZE];
+	for(i32 y = 0; y < HASHLIFE_LEAF_SIZE; y++)
+		rows[y] = (field[y + half][0] >> half) | (field[y + half][1] << half);
+
+	return hashlife_leaf(hashlife, rows);
+}
+
+//Returns the center of node of level (as a node of level - 1) advanced by 2^step generations.
+//step is clamped to level - 2 which is the most a node can be advanced by.
+static u32 hashlife_result(Hashlife* hashlife, u32 index, i32 level, i32 step)
+{
+	if(step > level - 2)
+		step = level - 2;
+
+	Hashlife_Node* node = &hashlife->nodes[index];
+	if(node->result != HASHLIFE_NONE && node->result_step == step)
+		return node->result;
+
+	u32 result = HASHLIFE_NONE;
+	if(node->population == 0)
+		result = hashlife_empty(hashlife, level - 1);
+	else if(level == BASE_LEVEL)
+		result = hashlife_base_result(hashlife, index, step);
+	else
+	{
+		//Split into 9 overlapping nodes of level - 1
+		u32 nw = node->children[QUAD_NW];
+		u32 ne = node->children[QUAD_NE];
+		u32 sw = node->children[QUAD_SW];
+		u32 se = node->children[QUAD_SE];
+		i32 sub = level - 1;
+
+		u32 n00 = nw;
+		u32 n01 = hashlife_node(hashlife, sub, hashlife_child(hashlife, nw, QUAD_NE), hashlife_child(hashlife, ne, QUAD_NW), hashlife_child(hashlife, nw, QUAD_SE), hashlife_child(hashlife, ne, QUAD_SW));
+		u32 n02 = ne;
+		u32 n10 = hashlife_node(hashlife, sub, hashlife_child(hashlife, nw, QUAD_SW), hashlife_child(hashlife, nw, QUAD_SE), hashlife_child(hashlife, sw, QUAD_NW), hashlife_child(hashlife, sw, QUAD_NE));
+		u32 n11 = hashlife_node(hashlife, sub, hashlife_child(hashlife, nw, QUAD_SE), hashlife_child(hashlife, ne, QUAD_SW), hashlife_child(hashlife, sw, QUAD_NE), hashlife_child(hashlife, se, QUAD_NW));
+		u32 n12 = hashlife_node(hashlife, sub, hashlife_child(hashlife, ne, QUAD_SW), hashlife_child(hashlife, ne, QUAD_SE), hashlife_child(hashlife, se, QUAD_NW), hashlife_child(hashlife, se, QUAD_NE));
+		u32 n20 = sw;
+		u32 n21 = hashlife_node(hashlife, sub, hashlife_child(hashlife, sw, QUAD_NE), hashlife_child(hashlife, se, QUAD_NW), hashlife_child(hashlife, sw, QUAD_SE), hashlife_child(hashlife, se, QUAD_SW));
+		u32 n22 = se;
+
+		//At full speed both halves advance by 2^(level - 3) generations.
+		//Otherwise the first half does not advance at all and the second does the whole step.
+		u32 sub_nodes[9] = {n00, n01, n02, n10, n11, n12, n20, n21, n22};
+		u32 r[9];
+		bool full_speed = step == level - 2;
+		for(i32 i = 0; i < 9; i++)
+		{
+			if(full_speed)
+				r[i] = hashlife_result(hashlife, sub_nodes[i], sub, step);
+			else
+				r[i] = hashlife_center(hashlife, sub_nodes[i], sub);
+		}
+
+		u32 q_nw = hashlife_node(hashlife, sub, r[0], r[1], r[3], r[4]);
+		u32 q_ne = hashlife_node(hashlife, sub, r[1], r[2], r[4], r[5]);
+		u32 q_sw = hashlife_node(hashlife, sub, r[3], r[4], r[6], r[7]);
+		u32 q_se = hashlife_node(hashlife, sub, r[4], r[5], r[7], r[8]);
+
+		result = hashlife_node(hashlife, sub,
+			hashlife_result(hashlife, q_nw, sub, step),
+			hashlife_result(hashlife, q_ne, sub, step),
+			hashlife_result(hashlife, q_sw, sub, step),
+			hashlife_result(hashlife, q_se, sub, step));
+	}
+
+	//the nodes array could have been reallocated
+	node = &hashlife->nodes[index];
+	node->result = result;
+	node->result_step = (u8) step;
+	return result;
+}
+
+//Wraps the root into a node one level higher with the old root in its center
+static void hashlife_expand(Hashlife* hashlife)
+{
+	i32 level = hashlife->root_level;
+	assert(level < HASHLIFE_MAX_LEVEL && "universe too big!");
+
+	Hashlife_Node root = hashlife->nodes[hashlife->root];
+	u32 empty = hashlife_empty(hashlife, level - 1);
+	u32 nw = hashlife_node(hashlife, level, empty, empty, empty, root.children[QUAD_NW]);
+	u32 ne = hashlife_node(hashlife, level, empty, empty, root.children[QUAD_NE], empty);
+	u32 sw = hashlife_node(hashlife, level, empty, root.children[QUAD_SW], empty, empty);
+	u32 se = hashlife_node(hashlife, level, root.children[QUAD_SE], empty, empty, empty);
+
+	hashlife->root = hashlife_node(hashlife, level + 1, nw, ne, sw, se);
+	hashlife->root_level = level + 1;
+
+	i64 quarter = (i64) 1 << (level - 1);
+	hashlife->origin_x -= quarter;
+	hashlife->origin_y -= quarter;
+}
+
+//Returns true if all alive cells of root are within its center quarter (2 levels down).
+//Only then the result of root contains everything the pattern can grow into.
+static bool hashlife_is_centered(Hashlife* hashlife)
+{
+	u32 center = hashlife_center(hashlife, hashlife->root, hashlife->root_level);
+	u32 inner = hashlife_center(hashlife, center, hashlife->root_level - 1);
+	return hashlife_population_of(hashlife, inner, hashlife->root_level - 2) == hashlife->nodes[hashlife->root].population;
+}
+
+static void hashlife_reset(Hashlife* hashlife)
+{
+	hashlife->root = hashlife_empty(hashlife, MIN_ROOT_LEVEL);
+	hashlife->root_level = MIN_ROOT_LEVEL;
+	hashlife->origin_x = 0;
+	hashlife->origin_y = 0;
+}
+
+void hashlife_init(Hashlife* hashlife, isize memory_budget)
+{
+	hashlife_deinit(hashlife);
+	hashlife->memory_budget = memory_budget > 0 ? memory_budget : HASHLIFE_DEF_MEMORY_BUDGET;
+	for(i32 i = 0; i <= HASHLIFE_MAX_LEVEL; i++)
+		hashlife->empty_nodes[i] = HASHLIFE_NONE;
+
+	hashlife->rule = life_rule_get();
+	hashlife_reset(hashlife);
+}
+
+void hashlife_deinit(Hashlife* hashlife)
+{
+	sure_realloc(hashlife->nodes, 0, hashlife->node_capacity * sizeof(Hashlife_Node), ALLOC_TAG_HASHLIFE);
+	sure_realloc(hashlife->leaves, 0, hashlife->leaf_capacity * sizeof(Hashlife_Leaf), ALLOC_TAG_HASHLIFE);
+	sure_realloc(hashlife->node_hash, 0, hashlife->node_hash_capacity * sizeof(u32), ALLOC_TAG_HASHLIFE);
+	sure_realloc(hashlife->leaf_hash, 0, hashlife->leaf_hash_capacity * sizeof(u32), ALLOC_TAG_HASHLIFE);
+	memset(hashlife, 0, sizeof *hashlife);
+}
+
+u64 hashlife_population(const Hashlife* hashlife)
+{
+	return hashlife->nodes[hashlife->root].population;
+}
+
+isize hashlife_memory_usage(const Hashlife* hashlife)
+{
+	return hashlife->node_capacity * sizeof(Hashlife_Node)
+		+ hashlife->leaf_capacity * sizeof(Hashlife_Leaf)
+		+ hashlife->node_hash_capacity * sizeof(u32)
+		+ hashlife->leaf_hash_capacity * sizeof(u32);
+}
+
+typedef struct Hashlife_Collect
+{
+	Hashlife* from;
+	Hashlife* to;
+	u32* node_remap;
+	u32* leaf_remap;
+} Hashlife_Collect;
+
+static u32 hashlife_collect_copy(Hashlife_Collect* collect, u32 index, i32 level)
+{
+	if(level == HASHLIFE_LEAF_LEVEL)
+	{
+		if(collect->leaf_remap[index] == HASHLIFE_NONE)
+			collect->leaf_remap[index] = hashlife_leaf(collect->to, collect->from->leaves[index].rows);
+		return collect->leaf_remap[index];
+	}
+
+	if(collect->node_remap[index] == HASHLIFE_NONE)
+	{
+		const u32* children = collect->from->nodes[index].children;
+		u32 copied[4];
+		for(i32 i = 0; i < 4; i++)
+			copied[i] = hashlife_collect_copy(collect, children[i], level - 1);
+
+		collect->node_remap[index] = hashlife_node(collect->to, level, copied[0], copied[1], copied[2], copied[3]);
+	}
+
+	return collect->node_remap[index];
+}
+
+void hashlife_collect(Hashlife* hashlife)
+{
+	PERF_COUNTER("hashlife collect");
+
+	//We copy everything reachable from root into a fresh state and throw the old one away.
+	//All memoized results are lost but those would need to be traced as well and most of them
+	//are garbage anyway.
+	Hashlife collected = {0};
+	hashlife_init(&collected, hashlife->memory_budget);
+
+	Hashlife_Collect collect = {0};
+	collect.from = hashlife;
+	collect.to = &collected;
+	collect.node_remap = (u32*) sure_realloc(NULL, hashlife->node_size * sizeof(u32), 0, ALLOC_TAG_HASHLIFE);
+	collect.leaf_remap = (u32*) sure_realloc(NULL, hashlife->leaf_size * sizeof(u32), 0, ALLOC_TAG_HASHLIFE);
+	memset(collect.node_remap, 0xFF, hashlife->node_size * sizeof(u32));
+	memset(collect.leaf_remap, 0xFF, hashlife->leaf_size * sizeof(u32));
+
+	collected.root = hashlife_collect_copy(&collect, hashlife->root, hashlife->root_level);
+	collected.root_level = hashlife->root_level;
+	collected.origin_x = hashlife->origin_x;
+	collected.origin_y = hashlife->origin_y;
+	collected.generation = hashlife->generation;
+	collected.rule = hashlife->rule;
+
+	sure_realloc(collect.node_remap, 0, hashlife->node_size * sizeof(u32), ALLOC_TAG_HASHLIFE);
+	sure_realloc(collect.leaf_remap, 0, hashlife->leaf_size * sizeof(u32), ALLOC_TAG_HASHLIFE);
+
+	hashlife_deinit(hashlife);
+	*hashlife = collected;
+}
+
+void hashlife_step(Hashlife* hashlife, i32 step_log2)
+{
+	PERF_COUNTER("hashlife step");
+	assert(0 <= step_log2 && step_log2 <= HASHLIFE_MAX_LEVEL - 3);
+
+	if(hashlife_population(hashlife) > 0)
+	{
+		//the result is the center half of root advanced. We need the root big enough to be advanced
+		//by the step and the pattern small enough to not grow out of the result
+		while(hashlife->root_level < step_log2 + 3 || hashlife_is_centered(hashlife) == false)
+			hashlife_expand(hashlife);
+
+		i32 level = hashlife->root_level;
+		hashlife->root = hashlife_result(hashlife, hashlife->root, level, step_log2);
+		hashlife->root_level = level - 1;
+
+		i64 quarter = (i64) 1 << (level - 2);
+		hashlife->origin_x += quarter;
+		hashlife->origin_y += quarter;
+
+		//keep the root at least MIN_ROOT_LEVEL so that centering always works
+		if(hashlife->root_level < MIN_ROOT_LEVEL)
+			hashlife_expand(hashlife);
+	}
+
+	hashlife->generation += (i64) 1 << step_log2;
+
+	if(hashlife_memory_usage(hashlife) > hashlife->memory_budget)
+		hashlife_collect(hashlife);
+}
+
+void hashlife_advance(Hashlife* hashlife, i64 generations)
+{
+	assert(generations >= 0);
+	for(i32 bit = 62; bit >= 0; bit--)
+		if(generations & ((i64) 1 << bit))
+			hashlife_step(hashlife, bit);
+}
+
+//Imported leaves are gathered as a list of leaf coordinates which is then recursively
+//split into quadrants. This way we only ever touch the parts of the tree that are alive
+//no matter how sparse the pattern is.
+typedef struct Hashlife_Import_Leaf
+{
+	i64 x;
+	i64 y;
+	u32 leaf;
+} Hashlife_Import_Leaf;
+
+static u32 hashlife_build(Hashlife* hashlife, i32 level, i64 x, i64 y, Hashlife_Import_Leaf* items, i32 count)
+{
+	if(count == 0)
+		return hashlife_empty(hashlife, level);
+
+	if(level == HASHLIFE_LEAF_LEVEL)
+	{
+		assert(count == 1);
+		return items[0].leaf;
+	}
+
+	//partition items into the quadrants in place (nw, ne, sw, se)
+	i64 half = (i64) 1 << (level - 1 - HASHLIFE_LEAF_LEVEL);
+	i32 counts[4] = {0};
+	for(i32 pass = 0; pass < 4; pass++)
+	{
+		i32 from = 0;
+		for(i32 i = 0; i < pass; i++)
+			from += counts[i];
+
+		for(i32 i = from; i < count; i++)
+		{
+			i32 quad = (items[i].x >= x + half ? 1 : 0) + (items[i].y >= y + half ? 2 : 0);
+			if(quad == pass)
+			{
+				Hashlife_Import_Leaf temp = items[i];
+				items[i] = items[from + counts[pass]];
+				items[from + counts[pass]] = temp;
+				counts[pass] += 1;
+			}
+		}
+	}
+
+	Hashlife_Import_Leaf* nw_items = items;
+	Hashlife_Import_Leaf* ne_items = nw_items + counts[QUAD_NW];
+	Hashlife_Import_Leaf* sw_items = ne_items + counts[QUAD_NE];
+	Hashlife_Import_Leaf* se_items = sw_items + counts[QUAD_SW];
+
+	u32 nw = hashlife_build(hashlife, level - 1, x, y, nw_items, counts[QUAD_NW]);
+	u32 ne = hashlife_build(hashlife, level - 1, x + half, y, ne_items, counts[QUAD_NE]);
+	u32 sw = hashlife_build(hashlife, level - 1, x, y + half, sw_items, counts[QUAD_SW]);
+	u32 se = hashlife_build(hashlife, level - 1, x + half, y + half, se_items, counts[QUAD_SE]);
+	return hashlife_node(hashlife, level, nw, ne, sw, se);
+}
+
+static i64 floor_div(i64 val, i64 by)
+{
+	i64 div = val / by;
+	if(val % by != 0 && val < 0)
+		div -= 1;
+	return div;
+}
+
+void hashlife_import(Hashlife* hashlife, Chunk_Hash* chunk_hash)
+{
+	PERF_COUNTER("hashlife import");
+
+	//Gather the cells into 64x64 leaf aligned bitfields. We use a temporary Chunk_Hash for that
+	//with its data used as the whole 64x64 field (no halo). It is never stepped so it does not need links.
+	static_assert(CHUNK_ROWS * CHUNK_ROW_WORDS >= HASHLIFE_LEAF_SIZE, "chunk data must hold a leaf");
+	Chunk_Hash leaves = {0};
+	chunk_hash_init(&leaves);
+	for(i32 i = 0; i < chunk_hash->chunk_size; i++)
+	{
+		const Chunk* chunk = &chunk_hash->chunks[i];
+		Vec2i pos = chunk_hash->positions[i];
+
+		//Chunk rows can be longer than a leaf so we move them in segments of at most 64 cells
+		for(i32 y = 0; y < CHUNK_SIZE; y++)
+		for(i32 segment_x = 0; segment_x < CHUNK_SIZE; segment_x += HASHLIFE_LEAF_SIZE)
+		{
+			i32 count = CHUNK_SIZE - segment_x < HASHLIFE_LEAF_SIZE ? CHUNK_SIZE - segment_x : HASHLIFE_LEAF_SIZE;
+			u64 row = chunk_row_get_bits(chunk_row(chunk, y), segment_x, count);
+			if(row == 0)
+				continue;
+
+			i64 cell_x = (i64) pos.x * CHUNK_SIZE + segment_x;
+			i64 leaf_x = floor_div(cell_x, HASHLIFE_LEAF_SIZE);
+			i64 offset = cell_x - leaf_x * HASHLIFE_LEAF_SIZE;
+
+			i64 cell_y = (i64) pos.y * CHUNK_SIZE + y;
+			i64 leaf_y = floor_div(cell_y, HASHLIFE_LEAF_SIZE);
+			i64 row_i = cell_y - leaf_y * HASHLIFE_LEAF_SIZE;
+
+			//(the leaves can only be full if chunk_hash is close to full as well)
+			i32 first = chunk_hash_insert_unlinked(&leaves, vec((i32) leaf_x, (i32) leaf_y));
+			if(first != CHUNK_HASH_FULL)
+				leaves.chunks[first].data[row_i] |= row << offset;
+
+			//the cells of the segment can spill over into the next leaf
+			if(offset + count > HASHLIFE_LEAF_SIZE)
+			{
+				i32 second = chunk_hash_insert_unlinked(&leaves, vec((i32) leaf_x + 1, (i32) leaf_y));
+				if(second != CHUNK_HASH_FULL)
+					leaves.chunks[second].data[row_i] |= row >> (HASHLIFE_LEAF_SIZE - offset);
+			}
+		}
+	}
+
+	Hashlife_Import_Leaf* items = (Hashlife_Import_Leaf*) sure_realloc(NULL, (leaves.chunk_size + 1) * sizeof(Hashlife_Import_Leaf), 0, ALLOC_TAG_HASHLIFE);
+	i32 item_count = 0;
+	i64 min_x = 0, min_y = 0, max_x = 0, max_y = 0;
+	for(i32 i = 0; i < leaves.chunk_size; i++)
+	{
+		Hashlife_Import_Leaf item = {0};
+		item.x = leaves.positions[i].x;
+		item.y = leaves.positions[i].y;
+		item.leaf = hashlife_leaf(hashlife, leaves.chunks[i].data);
+
+		if(item_count == 0 || item.x < min_x) min_x = item.x;
+		if(item_count == 0 || item.y < min_y) min_y = item.y;
+		if(item_count == 0 || item.x > max_x) max_x = item.x;
+		if(item_count == 0 || item.y > max_y) max_y = item.y;
+		items[item_count++] = item;
+	}
+
+	chunk_hash_deinit(&leaves);
+
+	//The memoized results are only valid for the rule they were computed with
+	Life_Rule rule = life_rule_get();
+	if(life_rule_equal(rule, hashlife->rule) == false)
+	{
+		for(i32 i = 0; i < hashlife->node_size; i++)
+			hashlife->nodes[i].result = HASHLIFE_NONE;
+		hashlife->rule = rule;
+	}
+
+	hashlife_reset(hashlife);
+	if(item_count > 0)
+	{
+		i64 span = (max_x - min_x > max_y - min_y ? max_x - min_x : max_y - min_y) + 1;
+		i32 level = MIN_ROOT_LEVEL;
+		while(((i64) 1 << (level - HASHLIFE_LEAF_LEVEL)) < span)
+			level += 1;
+
+		hashlife->root = hashlife_build(hashlife, level, min_x, min_y, items, item_count);
+		hashlife->root_level = level;
+		hashlife->origin_x = min_x * HASHLIFE_LEAF_SIZE;
+		hashlife->origin_y = min_y * HASHLIFE_LEAF_SIZE;
+	}
+
+	sure_realloc(items, 0, (leaves.chunk_size + 1) * sizeof(Hashlife_Import_Leaf), ALLOC_TAG_HASHLIFE);
+}
+
+static void hashlife_export_leaf(const Hashlife_Leaf* leaf, i64 x, i64 y, Chunk_Hash* chunk_hash)
+{
+	const i64 min_cell = (i64) INT32_MIN * CHUNK_SIZE;
+	const i64 max_cell = (i64) INT32_MAX * CHUNK_SIZE;
+	if(x < min_cell || y < min_cell || x + HASHLIFE_LEAF_SIZE > max_cell || y + HASHLIFE_LEAF_SIZE > max_cell)
+		return;
+
+	for(i32 row_i = 0; row_i < HASHLIFE_LEAF_SIZE; row_i++)
+	{
+		u64 row = leaf->rows[row_i];
+		if(row == 0)
+			continue;
+
+		i64 cell_y = y + row_i;
+		i64 chunk_y = floor_div(cell_y, CHUNK_SIZE);
+		i64 local_y = cell_y - chunk_y * CHUNK_SIZE;
+
+		//The 64 cells of the row span 2 or 3 chunks. Move them in chunk sized segments.
+		i64 cell_x = x;
+		i32 remaining = HASHLIFE_LEAF_SIZE;
+		while(remaining > 0)
+		{
+			i64 chunk_x = floor_div(cell_x, CHUNK_SIZE);
+			i64 local_x = cell_x - chunk_x * CHUNK_SIZE;
+			i32 count = CHUNK_SIZE - (i32) local_x;
+			if(count > remaining)
+				count = remaining;
+
+			u64 segment = count < 64 ? row & (((u64) 1 << count) - 1) : row;
+			if(segment)
+			{
+				i32 index = chunk_hash_insert(chunk_hash, vec((i32) chunk_x, (i32) chunk_y));
+				if(index != CHUNK_HASH_FULL)
+					chunk_row_or_bits(chunk_row(&chunk_hash->chunks[index], (i32) local_y), (i32) local_x, segment);
+			}
+
+			row = count < 64 ? row >> count : 0;
+			cell_x += count;
+			remaining -= count;
+		}
+	}
+}
+
+static void hashlife_export_node(const Hashlife* hashlife, u32 index, i32 level, i64 x, i64 y, Chunk_Hash* chunk_hash)
+{
+	if(hashlife_population_of(hashlife, index, level) == 0)
+		return;
+
+	if(level == HASHLIFE_LEAF_LEVEL)
+	{
+		hashlife_export_leaf(&hashlife->leaves[index], x, y, chunk_hash);
+		return;
+	}
+
+	i64 half = (i64) 1 << (level - 1);
+	const u32* children = hashlife->nodes[index].children;
+	hashlife_export_node(hashlife, children[QUAD_NW], level - 1, x, y, chunk_hash);
+	hashlife_export_node(hashlife, children[QUAD_NE], level - 1, x + half, y, chunk_hash);
+	hashlife_export_node(hashlife, children[QUAD_SW], level - 1, x, y + half, chunk_hash);
+	hashlife_export_node(hashlife, children[QUAD_SE], level - 1, x + half, y + half, chunk_hash);
+}
+
+void hashlife_export(Hashlife* hashlife, Chunk_Hash* chunk_hash)
+{
+	PERF_COUNTER("hashlife export");
+	chunk_hash_clear(chunk_hash);
+	hashlife_export_node(hashlife, hashlife->root, hashlife->root_level, hashlife->origin_x, hashlife->origin_y, chunk_hash);
+
+	//The chunk engine expects all neighbours of alive chunks to be present
+	i32 alive_count = chunk_hash->chunk_size;
+	for(i32 i = 0; i < alive_count; i++)
+	{
+		Vec2i pos = chunk_hash->positions[i];
+		for(i32 dir = 0; dir < DIRECTION_COUNT; dir++)
+			chunk_hash_insert(chunk_hash, vec_add(pos, chunk_directions[dir]));
+	}
+}
@@ -0,0 +1,106 @@
+#pragma once
+#include "chunk_hash.h"
+#include "life.h"
+
+// This file provides a HashLife engine which can be used alongside the chunk engine.
+//
+// The chunk engine costs time linear in the number of alive chunks per generation. HashLife
+// instead represents the universe as a quadtree whose nodes are canonicalized (each distinct
+// node exists only once) and memoizes the result of advancing every node. A node of level k
+// (2^k x 2^k cells) knows its center 2^(k-1) x 2^(k-1) cells 2^(k-2) generations into the future.
+// Because of that regular patterns (guns, breeders, spaceships...) can be advanced by huge
+// power of two jumps in time proportional to the number of *distinct* nodes instead of cells.
+//
+// Leaves are 64x64 bitfields just like the data of Chunk (but without the halo). The results
+// of level 7 nodes (4 leaves) are computed by brute force with bit parallel full adders,
+// everything above is memoized recursion.
+//
+// All nodes live in two arrays (nodes and leaves) and are referenced by u32 indices.
+// Canonicalization is done through two open addressing hashes of those indices.
+// When the memory used exceeds the given budget all nodes not reachable from the current
+// universe are collected (along with all memoized results). This is checked between steps
+// so a single huge step may go over the budget temporarily.
+//
+// The universe can be imported from and exported to Chunk_Hash so that the rest
+// of the program (rendering, editing, loading) works unchanged. Cell coordinates are
+// the same as the ones used by set_cell_at. The universe follows the rule that was
+// selected (life_rule_set) when it was imported.
+
+#define HASHLIFE_LEAF_LEVEL 6
+#define HASHLIFE_LEAF_SIZE (1 << HASHLIFE_LEAF_LEVEL)
+#define HASHLIFE_MAX_LEVEL 62
+#define HASHLIFE_NONE ((u32) -1)
+#define HASHLIFE_DEF_MEMORY_BUDGET ((isize) 1 << 30)
+
+typedef struct Hashlife_Leaf
+{
+	u64 rows[HASHLIFE_LEAF_SIZE]; //bit x of rows[y] is the cell (x, y)
+	u64 population;
+} Hashlife_Leaf;
+
+typedef struct Hashlife_Node
+{
+	//nw, ne, sw, se quadrants. Are indices into leaves for level 7 nodes, into nodes otherwise
+	u32 children[4];
+
+	//memoized center of this node advanced by 2^result_step generations
+	//(index into leaves for level 7 nodes, into nodes otherwise) or HASHLIFE_NONE
+	u32 result;
+	u8 result_step;
+	u8 level;
+	u64 population;
+} Hashlife_Node;
+
+typedef struct Hashlife
+{
+	Hashlife_Node* nodes;
+	i32 node_size;
+	i32 node_capacity;
+
+	Hashlife_Leaf* leaves;
+	i32 leaf_size;
+	i32 leaf_capacity;
+
+	//open addressing hashes of index + 1 (0 means empty slot)
+	u32* node_hash;
+	i32 node_hash_capacity;
+	u32* leaf_hash;
+	i32 leaf_hash_capacity;
+
+	//cached empty node for each level (HASHLIFE_NONE if not yet created)
+	u32 empty_nodes[HASHLIFE_MAX_LEVEL + 1];
+
+	//The universe. The top left cell of root is at origin.
+	u32 root;
+	i32 root_level;
+	i64 origin_x;
+	i64 origin_y;
+
+	i64 generation;
+	isize memory_budget;
+	Life_Rule rule; //the rule of the universe, taken from life_rule_get on import
+} Hashlife;
+
+//Initializes an empty universe. If memory_budget <= 0 uses HASHLIFE_DEF_MEMORY_BUDGET
+void hashlife_init(Hashlife* hashlife, isize memory_budget);
+void hashlife_deinit(Hashlife* hashlife);
+
+//Replaces the universe with the alive cells of chunk_hash. Keeps the generation counter.
+void hashlife_import(Hashlife* hashlife, Chunk_Hash* chunk_hash);
+
+//Clears chunk_hash and fills it with the universe (plus the neighbours of all alive chunks
+//so that it can be used by the chunk engine directly). Cells that cannot be represented
+//by Chunk_Hash (too far from the origin) are skipped.
+void hashlife_export(Hashlife* hashlife, Chunk_Hash* chunk_hash);
+
+//Advances the universe by 2^step_log2 generations
+void hashlife_step(Hashlife* hashlife, i32 step_log2);
+
+//Advances the universe by any number of generations (as a sum of power of two steps)
+void hashlife_advance(Hashlife* hashlife, i64 generations);
+
+u64 hashlife_population(const Hashlife* hashlife);
+isize hashlife_memory_usage(const Hashlife* hashlife);
+
+//Drops everything not reachable from the current universe
+void hashlife_collect(Hashlife* hashlife);
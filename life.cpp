@@ -0,0 +1,1043 @@
+#include "life.h"
+#include "chunk.h"
+#include <string.h>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+	#define LIFE_X86
+	#include <immintrin.h>
+	#ifdef _MSC_VER
+		#include <intrin.h>
+	#endif
+#endif
+
+//MSVC lets us use any intrinsic anywhere. GCC and clang need to be told
+//which functions can use which instruction sets.
+#if defined(_MSC_VER) || !defined(LIFE_X86)
+	#define TARGET_AVX2
+	#define TARGET_AVX512
+#else
+	#define TARGET_AVX2 __attribute__((target("avx2")))
+	#define TARGET_AVX512 __attribute__((target("avx512f")))
+#endif
+
+#ifdef _MSC_VER
+	#define LIFE_INLINE __forceinline
+#else
+	#define LIFE_INLINE inline __attribute__((always_inline))
+#endif
+
+//Adds the three bits a, b, c in each position into sum (weight 1) and carry (weight 2)
+static LIFE_INLINE void full_add(u64 a, u64 b, u64 c, u64* sum, u64* carry)
+{
+	u64 a_xor_b = a ^ b;
+	*sum = a_xor_b ^ c;
+	*carry = (a & b) | (a_xor_b & c);
+}
+
+//Counts the 8 neighbours of all 64 cells of a word at once. Every row of three cells (left, middle, right)
+//gives a 2 bit sum and those are then added together with full adders into the bits of the count.
+static LIFE_INLINE Life_Count count_neighbours(u64 above_l, u64 above, u64 above_r, u64 middle_l, u64 middle_r, u64 below_l, u64 below, u64 below_r)
+{
+	u64 above_1, above_2, below_1, below_2;
+	full_add(above_l, above, above_r, &above_1, &above_2);
+	full_add(below_l, below, below_r, &below_1, &below_2);
+	u64 middle_1 = middle_l ^ middle_r;
+	u64 middle_2 = middle_l & middle_r;
+
+	Life_Count count = {0};
+	u64 twos_carry, twos_partial, fours_partial;
+	full_add(above_1, middle_1, below_1, &count.ones, &twos_carry);
+	full_add(above_2, middle_2, below_2, &twos_partial, &fours_partial);
+
+	u64 fours_carry = twos_partial & twos_carry;
+	count.twos = twos_partial ^ twos_carry;
+	count.fours = fours_partial ^ fours_carry;
+	count.eights = fours_partial & fours_carry;
+	return count;
+}
+
+#if CHUNK_HALO == 0
+//Shifts the row so that every cell lines up with its left (from_left) and right (from_right) neighbour.
+//row points to a content word, the words around it are either content or the border.
+static LIFE_INLINE void neighbour_words(const u64* row, u64* from_left, u64* from_right)
+{
+	*from_left = (row[0] << 1) | (row[-1] >> 63);
+	*from_right = (row[0] >> 1) | (row[1] << 63);
+}
+#endif
+
+//Computes the next generation of assembled with the rule given by its birth and survive masks
+static LIFE_INLINE void life_rule_step(const u64* assembled, u64* next, u32 birth, u32 survive)
+{
+	#if CHUNK_HALO
+	//The border is inline so the neighbours are just the rows shifted. The bits at the very ends get
+	//wrong counts but those are the halo which gets masked out anyway.
+	for(i32 y = 1; y < CHUNK_SIZE + 1; y++)
+	{
+		u64 above = assembled[y - 1];
+		u64 middle = assembled[y];
+		u64 below = assembled[y + 1];
+
+		Life_Count count = count_neighbours(above << 1, above, above >> 1, middle << 1, middle >> 1, below << 1, below, below >> 1);
+		next[y] = life_rule_apply(birth, survive, count, middle);
+	}
+	#else
+	const i32 stride = LIFE_ASSEMBLED_ROW_WORDS;
+	for(i32 y = 0; y < CHUNK_SIZE; y++)
+	{
+		const u64* above = &assembled[y * stride + 1];
+		const u64* middle = above + stride;
+		const u64* below = middle + stride;
+
+		for(i32 w = 0; w < CHUNK_ROW_WORDS; w++)
+		{
+			u64 above_l, above_r, middle_l, middle_r, below_l, below_r;
+			neighbour_words(above + w, &above_l, &above_r);
+			neighbour_words(middle + w, &middle_l, &middle_r);
+			neighbour_words(below + w, &below_l, &below_r);
+
+			Life_Count count = count_neighbours(above_l, above[w], above_r, middle_l, middle_r, below_l, below[w], below_r);
+			next[y * CHUNK_ROW_WORDS + w] = life_rule_apply(birth, survive, count, middle[w]);
+		}
+	}
+	#endif
+}
+
+static const u64 wide_zero_plane[LIFE_WIDE_ROWS] = {0};
+
+//Computes the rows [from_row, to_row) of the next generation of the wide block from into into
+static LIFE_INLINE void life_wide_pass(const u64* from, u64* into, i32 from_row, i32 to_row, u32 birth, u32 survive)
+{
+	for(i32 w = 0; w < LIFE_WIDE_WORDS; w++)
+	{
+		//The cells left of the lowest bit are in the highest bit of the previous word and the other way around
+		const u64* plane = &from[w * LIFE_WIDE_ROWS];
+		const u64* lower = w > 0 ? plane - LIFE_WIDE_ROWS : wide_zero_plane;
+		const u64* higher = w + 1 < LIFE_WIDE_WORDS ? plane + LIFE_WIDE_ROWS : wide_zero_plane;
+		u64* next = &into[w * LIFE_WIDE_ROWS];
+
+		//Each row is shifted once and used as the row below, in the middle and above
+		u64 above = plane[from_row - 1];
+		u64 above_l = (above << 1) | (lower[from_row - 1] >> 63);
+		u64 above_r = (above >> 1) | (higher[from_row - 1] << 63);
+		u64 middle = plane[from_row];
+		u64 middle_l = (middle << 1) | (lower[from_row] >> 63);
+		u64 middle_r = (middle >> 1) | (higher[from_row] << 63);
+		for(i32 y = from_row; y < to_row; y++)
+		{
+			u64 below = plane[y + 1];
+			u64 below_l = (below << 1) | (lower[y + 1] >> 63);
+			u64 below_r = (below >> 1) | (higher[y + 1] << 63);
+
+			Life_Count count = count_neighbours(above_l, above, above_r, middle_l, middle_r, below_l, below, below_r);
+			next[y] = life_rule_apply(birth, survive, count, middle);
+
+			above = middle; above_l = middle_l; above_r = middle_r;
+			middle = below; middle_l = below_l; middle_r = below_r;
+		}
+	}
+}
+
+#if CHUNK_HALO
+#define OUTER (CHUNK_SIZE + 1)
+#define OCT_PATTERN ((u64) 01111111111111111111111) //pattern of 0b...001001 repeating (in oct)
+
+static void life_kernel_scalar(const u64* assembled, u64* next)
+{
+	u64 oct0 = OCT_PATTERN << 0; //pattern of 0b...001001
+	u64 oct1 = OCT_PATTERN << 1; //pattern of 0b...010010
+	u64 oct2 = OCT_PATTERN << 2; //pattern of 0b...100100
+
+	for(i32 y = 1; y < OUTER; y++)
+		next[y] = 0;
+
+	//for all three offsets in the 3 bit slots
+	for(i32 slot = 0; slot < 3; slot++)
+	{
+		u64 accumulators[64] = {0};
+
+		for(i32 i = 0; i < 64; i++)
+		{
+			u64 curr_accumulator = 0;
+			u64 slid = (assembled[i] << 1);
+			//we have to align it so that its in the ceneter of the oct
+			//otherwise for     0b 0 0 1 0 0 0 1 0
+			//we woudl geenrate    1 1 1 0 1 1 1 0
+			//but we want:         0 1 1 1 0 1 1 1
+
+			curr_accumulator += (oct0 & (slid >> (0 + slot)));
+			curr_accumulator += (oct0 & (slid >> (1 + slot)));
+			curr_accumulator += (oct0 & (slid >> (2 + slot)));
+			accumulators[i] = curr_accumulator;
+		}
+
+		//iterate all inner rows of the chunk
+		for(i32 y = 1; y < OUTER; y++)
+		{
+			u64 first_sum = accumulators[y - 1] + accumulators[y];
+			u64 has_4 = first_sum & oct2;
+
+			u64 next_row_has_any = ((accumulators[y + 1] & oct1) << 1 | (accumulators[y + 1] & oct0) << 2);
+
+			u64 is_overfull = has_4 & next_row_has_any; //the sum around has value higher or equal to 4 (if is true dies)
+			u64 complete_sum = (~is_overfull & first_sum) + accumulators[y + 1];
+
+			u64 three_pattern = oct0 | oct1; //pattern of the number 3 in binary repeating in slots of 3 bits
+			u64 four_pattern = oct2;
+
+			u64 three_check = three_pattern ^ complete_sum; //completely 0 if is three
+			u64 four_check = four_pattern ^ complete_sum; //completely 0 if is four
+
+			u64 is_not_three = (three_check & oct0) << 2 | (three_check & oct1) << 1 | (three_check & oct2) << 0;
+			u64 is_not_four  = (four_check & oct0) << 2 | (four_check & oct1) << 1 | (four_check & oct2) << 0;
+			u64 is_current_alive = (oct0 & (assembled[y] >> slot)) << 2;
+
+			u64 is_three = ~is_not_three;
+			u64 is_four = ~is_not_four;
+			u64 is_next_generation_alive = (is_three | (is_current_alive & is_four)) & ~is_overfull;
+
+			is_next_generation_alive &= oct2;
+
+			next[y] |= (is_next_generation_alive >> (2 - slot));
+		}
+	}
+}
+
+#ifdef LIFE_X86
+
+// The SIMD versions do exactly the same as the scalar one above, just with every row
+// replaced by a vector of consecutive rows. Because the rows are independent of each other
+// (apart from reading the row above and below which we get by unaligned loads) this is
+// a straight translation.
+//
+// The 61 inner rows are not divisible by the vector width so the last vector
+// is moved back to end exactly at the last row. The few overlapping rows are simply
+// computed and stored twice.
+//
+// We also compute the accumulators for all 3 slots up front so that each output
+// row is composed in register and stored only once.
+
+TARGET_AVX2
+static void life_kernel_avx2(const u64* assembled, u64* next)
+{
+	#define W 4
+	u64 accumulators[3][64];
+
+	__m256i oct0 = _mm256_set1_epi64x((i64) (OCT_PATTERN << 0));
+	__m256i oct1 = _mm256_set1_epi64x((i64) (OCT_PATTERN << 1));
+	__m256i oct2 = _mm256_set1_epi64x((i64) (OCT_PATTERN << 2));
+	__m256i three_pattern = _mm256_or_si256(oct0, oct1);
+	__m256i four_pattern = oct2;
+
+	for(i32 slot = 0; slot < 3; slot++)
+	{
+		__m128i shift0 = _mm_cvtsi32_si128(0 + slot);
+		__m128i shift1 = _mm_cvtsi32_si128(1 + slot);
+		__m128i shift2 = _mm_cvtsi32_si128(2 + slot);
+
+		for(i32 i = 0; i < 64; i += W)
+		{
+			__m256i slid = _mm256_slli_epi64(_mm256_loadu_si256((const __m256i*) (assembled + i)), 1);
+			__m256i acc = _mm256_and_si256(oct0, _mm256_srl_epi64(slid, shift0));
+			acc = _mm256_add_epi64(acc, _mm256_and_si256(oct0, _mm256_srl_epi64(slid, shift1)));
+			acc = _mm256_add_epi64(acc, _mm256_and_si256(oct0, _mm256_srl_epi64(slid, shift2)));
+			_mm256_storeu_si256((__m256i*) (accumulators[slot] + i), acc);
+		}
+	}
+
+	for(i32 y_start = 1; y_start < OUTER; y_start += W)
+	{
+		i32 y = y_start + W > OUTER ? OUTER - W : y_start;
+		__m256i curr = _mm256_loadu_si256((const __m256i*) (assembled + y));
+		__m256i out = _mm256_setzero_si256();
+
+		for(i32 slot = 0; slot < 3; slot++)
+		{
+			__m256i above = _mm256_loadu_si256((const __m256i*) (accumulators[slot] + y - 1));
+			__m256i middle = _mm256_loadu_si256((const __m256i*) (accumulators[slot] + y));
+			__m256i below = _mm256_loadu_si256((const __m256i*) (accumulators[slot] + y + 1));
+
+			__m256i first_sum = _mm256_add_epi64(above, middle);
+			__m256i has_4 = _mm256_and_si256(first_sum, oct2);
+			__m256i next_row_has_any = _mm256_or_si256(
+				_mm256_slli_epi64(_mm256_and_si256(below, oct1), 1),
+				_mm256_slli_epi64(_mm256_and_si256(below, oct0), 2));
+
+			__m256i is_overfull = _mm256_and_si256(has_4, next_row_has_any);
+			__m256i complete_sum = _mm256_add_epi64(_mm256_andnot_si256(is_overfull, first_sum), below);
+
+			__m256i three_check = _mm256_xor_si256(three_pattern, complete_sum);
+			__m256i four_check = _mm256_xor_si256(four_pattern, complete_sum);
+
+			__m256i is_not_three = _mm256_or_si256(_mm256_or_si256(
+				_mm256_slli_epi64(_mm256_and_si256(three_check, oct0), 2),
+				_mm256_slli_epi64(_mm256_and_si256(three_check, oct1), 1)),
+				_mm256_and_si256(three_check, oct2));
+			__m256i is_not_four = _mm256_or_si256(_mm256_or_si256(
+				_mm256_slli_epi64(_mm256_and_si256(four_check, oct0), 2),
+				_mm256_slli_epi64(_mm256_and_si256(four_check, oct1), 1)),
+				_mm256_and_si256(four_check, oct2));
+
+			__m256i is_current_alive = _mm256_slli_epi64(_mm256_and_si256(oct0, _mm256_srl_epi64(curr, _mm_cvtsi32_si128(slot))), 2);
+
+			//(is_three | (is_current_alive & is_four)) & ~is_overfull & oct2
+			__m256i alive = _mm256_or_si256(
+				_mm256_andnot_si256(is_not_three, oct2),
+				_mm256_andnot_si256(is_not_four, is_current_alive));
+			alive = _mm256_andnot_si256(is_overfull, alive);
+			alive = _mm256_and_si256(alive, oct2);
+
+			out = _mm256_or_si256(out, _mm256_srl_epi64(alive, _mm_cvtsi32_si128(2 - slot)));
+		}
+
+		_mm256_storeu_si256((__m256i*) (next + y), out);
+	}
+	#undef W
+}
+
+TARGET_AVX512
+static void life_kernel_avx512(const u64* assembled, u64* next)
+{
+	#define W 8
+	u64 accumulators[3][64];
+
+	__m512i oct0 = _mm512_set1_epi64((i64) (OCT_PATTERN << 0));
+	__m512i oct1 = _mm512_set1_epi64((i64) (OCT_PATTERN << 1));
+	__m512i oct2 = _mm512_set1_epi64((i64) (OCT_PATTERN << 2));
+	__m512i three_pattern = _mm512_or_si512(oct0, oct1);
+	__m512i four_pattern = oct2;
+
+	for(i32 slot = 0; slot < 3; slot++)
+	{
+		__m128i shift0 = _mm_cvtsi32_si128(0 + slot);
+		__m128i shift1 = _mm_cvtsi32_si128(1 + slot);
+		__m128i shift2 = _mm_cvtsi32_si128(2 + slot);
+
+		for(i32 i = 0; i < 64; i += W)
+		{
+			__m512i slid = _mm512_slli_epi64(_mm512_loadu_si512((const void*) (assembled + i)), 1);
+			__m512i acc = _mm512_and_si512(oct0, _mm512_srl_epi64(slid, shift0));
+			acc = _mm512_add_epi64(acc, _mm512_and_si512(oct0, _mm512_srl_epi64(slid, shift1)));
+			acc = _mm512_add_epi64(acc, _mm512_and_si512(oct0, _mm512_srl_epi64(slid, shift2)));
+			_mm512_storeu_si512((void*) (accumulators[slot] + i), acc);
+		}
+	}
+
+	for(i32 y_start = 1; y_start < OUTER; y_start += W)
+	{
+		i32 y = y_start + W > OUTER ? OUTER - W : y_start;
+		__m512i curr = _mm512_loadu_si512((const void*) (assembled + y));
+		__m512i out = _mm512_setzero_si512();
+
+		for(i32 slot = 0; slot < 3; slot++)
+		{
+			__m512i above = _mm512_loadu_si512((const void*) (accumulators[slot] + y - 1));
+			__m512i middle = _mm512_loadu_si512((const void*) (accumulators[slot] + y));
+			__m512i below = _mm512_loadu_si512((const void*) (accumulators[slot] + y + 1));
+
+			__m512i first_sum = _mm512_add_epi64(above, middle);
+			__m512i has_4 = _mm512_and_si512(first_sum, oct2);
+			__m512i next_row_has_any = _mm512_or_si512(
+				_mm512_slli_epi64(_mm512_and_si512(below, oct1), 1),
+				_mm512_slli_epi64(_mm512_and_si512(below, oct0), 2));
+
+			__m512i is_overfull = _mm512_and_si512(has_4, next_row_has_any);
+			__m512i complete_sum = _mm512_add_epi64(_mm512_andnot_si512(is_overfull, first_sum), below);
+
+			__m512i three_check = _mm512_xor_si512(three_pattern, complete_sum);
+			__m512i four_check = _mm512_xor_si512(four_pattern, complete_sum);
+
+			__m512i is_not_three = _mm512_or_si512(_mm512_or_si512(
+				_mm512_slli_epi64(_mm512_and_si512(three_check, oct0), 2),
+				_mm512_slli_epi64(_mm512_and_si512(three_check, oct1), 1)),
+				_mm512_and_si512(three_check, oct2));
+			__m512i is_not_four = _mm512_or_si512(_mm512_or_si512(
+				_mm512_slli_epi64(_mm512_and_si512(four_check, oct0), 2),
+				_mm512_slli_epi64(_mm512_and_si512(four_check, oct1), 1)),
+				_mm512_and_si512(four_check, oct2));
+
+			__m512i is_current_alive = _mm512_slli_epi64(_mm512_and_si512(oct0, _mm512_srl_epi64(curr, _mm_cvtsi32_si128(slot))), 2);
+
+			__m512i alive = _mm512_or_si512(
+				_mm512_andnot_si512(is_not_three, oct2),
+				_mm512_andnot_si512(is_not_four, is_current_alive));
+			alive = _mm512_andnot_si512(is_overfull, alive);
+			alive = _mm512_and_si512(alive, oct2);
+
+			out = _mm512_or_si512(out, _mm512_srl_epi64(alive, _mm_cvtsi32_si128(2 - slot)));
+		}
+
+		_mm512_storeu_si512((void*) (next + y), out);
+	}
+	#undef W
+}
+
+#endif
+#endif
+
+#if defined(LIFE_X86)
+
+// SIMD versions of life_rule_step for the layout with halo and of life_wide_pass for all layouts. Just like the SIMD
+// versions of the kernel above they do the same as the scalar one on 4 (AVX2) or 8 (AVX-512) consecutive rows at once
+// and move the last vector back so that it ends exactly at the last row.
+
+TARGET_AVX2
+static LIFE_INLINE void full_add_avx2(__m256i a, __m256i b, __m256i c, __m256i* sum, __m256i* carry)
+{
+	__m256i a_xor_b = _mm256_xor_si256(a, b);
+	*sum = _mm256_xor_si256(a_xor_b, c);
+	*carry = _mm256_or_si256(_mm256_and_si256(a, b), _mm256_and_si256(a_xor_b, c));
+}
+
+//count_neighbours followed by life_rule_apply on 4 rows at once
+TARGET_AVX2
+static LIFE_INLINE __m256i life_rule_next_avx2(__m256i above_l, __m256i above, __m256i above_r, __m256i middle_l, __m256i middle, __m256i middle_r,
+	__m256i below_l, __m256i below, __m256i below_r, u32 birth, u32 survive)
+{
+	const __m256i all = _mm256_set1_epi64x(-1);
+	__m256i above_1, above_2, below_1, below_2;
+	full_add_avx2(above_l, above, above_r, &above_1, &above_2);
+	full_add_avx2(below_l, below, below_r, &below_1, &below_2);
+	__m256i middle_1 = _mm256_xor_si256(middle_l, middle_r);
+	__m256i middle_2 = _mm256_and_si256(middle_l, middle_r);
+
+	__m256i ones, twos_carry, twos_partial, fours_partial;
+	full_add_avx2(above_1, middle_1, below_1, &ones, &twos_carry);
+	full_add_avx2(above_2, middle_2, below_2, &twos_partial, &fours_partial);
+
+	__m256i fours_carry = _mm256_and_si256(twos_partial, twos_carry);
+	__m256i twos = _mm256_xor_si256(twos_partial, twos_carry);
+	__m256i fours = _mm256_xor_si256(fours_partial, fours_carry);
+	__m256i eights = _mm256_and_si256(fours_partial, fours_carry);
+
+	__m256i out = _mm256_setzero_si256();
+	if(birth == LIFE_RULE_CONWAY.birth && survive == LIFE_RULE_CONWAY.survive)
+		out = _mm256_andnot_si256(_mm256_or_si256(fours, eights), _mm256_and_si256(twos, _mm256_or_si256(ones, middle)));
+	else
+	{
+		__m256i born = _mm256_setzero_si256();
+		__m256i survives = _mm256_setzero_si256();
+		for(u32 n = 0; n <= 8; n++)
+		{
+			if(((birth | survive) & (1u << n)) == 0)
+				continue;
+
+			__m256i is_n = _mm256_and_si256(
+				_mm256_and_si256(n & 1 ? ones : _mm256_xor_si256(ones, all), n & 2 ? twos : _mm256_xor_si256(twos, all)),
+				_mm256_and_si256(n & 4 ? fours : _mm256_xor_si256(fours, all), n & 8 ? eights : _mm256_xor_si256(eights, all)));
+			if(birth & (1u << n))
+				born = _mm256_or_si256(born, is_n);
+			if(survive & (1u << n))
+				survives = _mm256_or_si256(survives, is_n);
+		}
+		out = _mm256_or_si256(_mm256_andnot_si256(middle, born), _mm256_and_si256(middle, survives));
+	}
+
+	return out;
+}
+
+#if CHUNK_HALO
+TARGET_AVX2
+static LIFE_INLINE void life_rule_step_avx2(const u64* assembled, u64* next, u32 birth, u32 survive)
+{
+	for(i32 y = 1; y < OUTER; y += 4)
+	{
+		if(y + 4 > OUTER)
+			y = OUTER - 4;
+
+		__m256i above = _mm256_loadu_si256((const __m256i*) (assembled + y - 1));
+		__m256i middle = _mm256_loadu_si256((const __m256i*) (assembled + y));
+		__m256i below = _mm256_loadu_si256((const __m256i*) (assembled + y + 1));
+
+		__m256i out = life_rule_next_avx2(_mm256_slli_epi64(above, 1), above, _mm256_srli_epi64(above, 1), _mm256_slli_epi64(middle, 1), middle, _mm256_srli_epi64(middle, 1),
+			_mm256_slli_epi64(below, 1), below, _mm256_srli_epi64(below, 1), birth, survive);
+		_mm256_storeu_si256((__m256i*) (next + y), out);
+	}
+}
+#endif
+
+TARGET_AVX2
+static LIFE_INLINE void life_wide_pass_avx2(const u64* from, u64* into, i32 from_row, i32 to_row, u32 birth, u32 survive)
+{
+	for(i32 w = 0; w < LIFE_WIDE_WORDS; w++)
+	{
+		const u64* plane = &from[w * LIFE_WIDE_ROWS];
+		const u64* lower = w > 0 ? plane - LIFE_WIDE_ROWS : wide_zero_plane;
+		const u64* higher = w + 1 < LIFE_WIDE_WORDS ? plane + LIFE_WIDE_ROWS : wide_zero_plane;
+		u64* next = &into[w * LIFE_WIDE_ROWS];
+		for(i32 y = from_row; y < to_row; y += 4)
+		{
+			if(y + 4 > to_row)
+				y = to_row - 4;
+
+			__m256i above = _mm256_loadu_si256((const __m256i*) (plane + y - 1));
+			__m256i middle = _mm256_loadu_si256((const __m256i*) (plane + y));
+			__m256i below = _mm256_loadu_si256((const __m256i*) (plane + y + 1));
+			__m256i above_l = _mm256_or_si256(_mm256_slli_epi64(above, 1), _mm256_srli_epi64(_mm256_loadu_si256((const __m256i*) (lower + y - 1)), 63));
+			__m256i above_r = _mm256_or_si256(_mm256_srli_epi64(above, 1), _mm256_slli_epi64(_mm256_loadu_si256((const __m256i*) (higher + y - 1)), 63));
+			__m256i middle_l = _mm256_or_si256(_mm256_slli_epi64(middle, 1), _mm256_srli_epi64(_mm256_loadu_si256((const __m256i*) (lower + y)), 63));
+			__m256i middle_r = _mm256_or_si256(_mm256_srli_epi64(middle, 1), _mm256_slli_epi64(_mm256_loadu_si256((const __m256i*) (higher + y)), 63));
+			__m256i below_l = _mm256_or_si256(_mm256_slli_epi64(below, 1), _mm256_srli_epi64(_mm256_loadu_si256((const __m256i*) (lower + y + 1)), 63));
+			__m256i below_r = _mm256_or_si256(_mm256_srli_epi64(below, 1), _mm256_slli_epi64(_mm256_loadu_si256((const __m256i*) (higher + y + 1)), 63));
+
+			__m256i out = life_rule_next_avx2(above_l, above, above_r, middle_l, middle, middle_r, below_l, below, below_r, birth, survive);
+			_mm256_storeu_si256((__m256i*) (next + y), out);
+		}
+	}
+}
+
+TARGET_AVX512
+static LIFE_INLINE void full_add_avx512(__m512i a, __m512i b, __m512i c, __m512i* sum, __m512i* carry)
+{
+	__m512i a_xor_b = _mm512_xor_si512(a, b);
+	*sum = _mm512_xor_si512(a_xor_b, c);
+	*carry = _mm512_or_si512(_mm512_and_si512(a, b), _mm512_and_si512(a_xor_b, c));
+}
+
+//The same on 8 rows at once
+TARGET_AVX512
+static LIFE_INLINE __m512i life_rule_next_avx512(__m512i above_l, __m512i above, __m512i above_r, __m512i middle_l, __m512i middle, __m512i middle_r,
+	__m512i below_l, __m512i below, __m512i below_r, u32 birth, u32 survive)
+{
+	const __m512i all = _mm512_set1_epi64(-1);
+	__m512i above_1, above_2, below_1, below_2;
+	full_add_avx512(above_l, above, above_r, &above_1, &above_2);
+	full_add_avx512(below_l, below, below_r, &below_1, &below_2);
+	__m512i middle_1 = _mm512_xor_si512(middle_l, middle_r);
+	__m512i middle_2 = _mm512_and_si512(middle_l, middle_r);
+
+	__m512i ones, twos_carry, twos_partial, fours_partial;
+	full_add_avx512(above_1, middle_1, below_1, &ones, &twos_carry);
+	full_add_avx512(above_2, middle_2, below_2, &twos_partial, &fours_partial);
+
+	__m512i fours_carry = _mm512_and_si512(twos_partial, twos_carry);
+	__m512i twos = _mm512_xor_si512(twos_partial, twos_carry);
+	__m512i fours = _mm512_xor_si512(fours_partial, fours_carry);
+	__m512i eights = _mm512_and_si512(fours_partial, fours_carry);
+
+	__m512i out = _mm512_setzero_si512();
+	if(birth == LIFE_RULE_CONWAY.birth && survive == LIFE_RULE_CONWAY.survive)
+		out = _mm512_andnot_si512(_mm512_or_si512(fours, eights), _mm512_and_si512(twos, _mm512_or_si512(ones, middle)));
+	else
+	{
+		__m512i born = _mm512_setzero_si512();
+		__m512i survives = _mm512_setzero_si512();
+		for(u32 n = 0; n <= 8; n++)
+		{
+			if(((birth | survive) & (1u << n)) == 0)
+				continue;
+
+			__m512i is_n = _mm512_and_si512(
+				_mm512_and_si512(n & 1 ? ones : _mm512_xor_si512(ones, all), n & 2 ? twos : _mm512_xor_si512(twos, all)),
+				_mm512_and_si512(n & 4 ? fours : _mm512_xor_si512(fours, all), n & 8 ? eights : _mm512_xor_si512(eights, all)));
+			if(birth & (1u << n))
+				born = _mm512_or_si512(born, is_n);
+			if(survive & (1u << n))
+				survives = _mm512_or_si512(survives, is_n);
+		}
+		out = _mm512_or_si512(_mm512_andnot_si512(middle, born), _mm512_and_si512(middle, survives));
+	}
+
+	return out;
+}
+
+#if CHUNK_HALO
+TARGET_AVX512
+static LIFE_INLINE void life_rule_step_avx512(const u64* assembled, u64* next, u32 birth, u32 survive)
+{
+	for(i32 y = 1; y < OUTER; y += 8)
+	{
+		if(y + 8 > OUTER)
+			y = OUTER - 8;
+
+		__m512i above = _mm512_loadu_si512((const void*) (assembled + y - 1));
+		__m512i middle = _mm512_loadu_si512((const void*) (assembled + y));
+		__m512i below = _mm512_loadu_si512((const void*) (assembled + y + 1));
+
+		__m512i out = life_rule_next_avx512(_mm512_slli_epi64(above, 1), above, _mm512_srli_epi64(above, 1), _mm512_slli_epi64(middle, 1), middle, _mm512_srli_epi64(middle, 1),
+			_mm512_slli_epi64(below, 1), below, _mm512_srli_epi64(below, 1), birth, survive);
+		_mm512_storeu_si512((void*) (next + y), out);
+	}
+}
+#endif
+
+TARGET_AVX512
+static LIFE_INLINE void life_wide_pass_avx512(const u64* from, u64* into, i32 from_row, i32 to_row, u32 birth, u32 survive)
+{
+	for(i32 w = 0; w < LIFE_WIDE_WORDS; w++)
+	{
+		const u64* plane = &from[w * LIFE_WIDE_ROWS];
+		const u64* lower = w > 0 ? plane - LIFE_WIDE_ROWS : wide_zero_plane;
+		const u64* higher = w + 1 < LIFE_WIDE_WORDS ? plane + LIFE_WIDE_ROWS : wide_zero_plane;
+		u64* next = &into[w * LIFE_WIDE_ROWS];
+		for(i32 y = from_row; y < to_row; y += 8)
+		{
+			if(y + 8 > to_row)
+				y = to_row - 8;
+
+			__m512i above = _mm512_loadu_si512((const void*) (plane + y - 1));
+			__m512i middle = _mm512_loadu_si512((const void*) (plane + y));
+			__m512i below = _mm512_loadu_si512((const void*) (plane + y + 1));
+			__m512i above_l = _mm512_or_si512(_mm512_slli_epi64(above, 1), _mm512_srli_epi64(_mm512_loadu_si512((const void*) (lower + y - 1)), 63));
+			__m512i above_r = _mm512_or_si512(_mm512_srli_epi64(above, 1), _mm512_slli_epi64(_mm512_loadu_si512((const void*) (higher + y - 1)), 63));
+			__m512i middle_l = _mm512_or_si512(_mm512_slli_epi64(middle, 1), _mm512_srli_epi64(_mm512_loadu_si512((const void*) (lower + y)), 63));
+			__m512i middle_r = _mm512_or_si512(_mm512_srli_epi64(middle, 1), _mm512_slli_epi64(_mm512_loadu_si512((const void*) (higher + y)), 63));
+			__m512i below_l = _mm512_or_si512(_mm512_slli_epi64(below, 1), _mm512_srli_epi64(_mm512_loadu_si512((const void*) (lower + y + 1)), 63));
+			__m512i below_r = _mm512_or_si512(_mm512_srli_epi64(below, 1), _mm512_slli_epi64(_mm512_loadu_si512((const void*) (higher + y + 1)), 63));
+
+			__m512i out = life_rule_next_avx512(above_l, above, above_r, middle_l, middle, middle_r, below_l, below, below_r, birth, survive);
+			_mm512_storeu_si512((void*) (next + y), out);
+		}
+	}
+}
+#endif
+
+static Life_Rule selected_rule = LIFE_RULE_CONWAY;
+
+template <u32 BIRTH, u32 SURVIVE>
+static void life_kernel_rule(const u64* assembled, u64* next)
+{
+	life_rule_step(assembled, next, BIRTH, SURVIVE);
+}
+
+static void life_kernel_rule_runtime(const u64* assembled, u64* next)
+{
+	life_rule_step(assembled, next, selected_rule.birth, selected_rule.survive);
+}
+
+#if defined(LIFE_X86) && CHUNK_HALO
+template <u32 BIRTH, u32 SURVIVE>
+TARGET_AVX2
+static void life_kernel_rule_avx2(const u64* assembled, u64* next)
+{
+	life_rule_step_avx2(assembled, next, BIRTH, SURVIVE);
+}
+
+template <u32 BIRTH, u32 SURVIVE>
+TARGET_AVX512
+static void life_kernel_rule_avx512(const u64* assembled, u64* next)
+{
+	life_rule_step_avx512(assembled, next, BIRTH, SURVIVE);
+}
+
+TARGET_AVX2
+static void life_kernel_rule_runtime_avx2(const u64* assembled, u64* next)
+{
+	life_rule_step_avx2(assembled, next, selected_rule.birth, selected_rule.survive);
+}
+
+TARGET_AVX512
+static void life_kernel_rule_runtime_avx512(const u64* assembled, u64* next)
+{
+	life_rule_step_avx512(assembled, next, selected_rule.birth, selected_rule.survive);
+}
+#endif
+
+//The adder kernels exist once for every instruction set: scalar, AVX2 and AVX-512.
+//The kernels of rules other than B3/S23 are picked by the instruction set of the selected kernel.
+#define INSTRUCTION_SETS 3
+
+static i32 kernel_instruction_set(Life_Kernel kernel)
+{
+	switch(kernel)
+	{
+		case LIFE_KERNEL_AVX2:
+		case LIFE_KERNEL_ADDER_AVX2:   return 1;
+		case LIFE_KERNEL_AVX512:
+		case LIFE_KERNEL_ADDER_AVX512: return 2;
+		default:                       return 0;
+	}
+}
+
+#if defined(LIFE_X86) && CHUNK_HALO
+#define RULE_KERNEL(birth, survive) {{birth, survive}, {life_kernel_rule<birth, survive>, life_kernel_rule_avx2<birth, survive>, life_kernel_rule_avx512<birth, survive>}}
+static const Life_Kernel_Func runtime_rule_kernels[INSTRUCTION_SETS] = {life_kernel_rule_runtime, life_kernel_rule_runtime_avx2, life_kernel_rule_runtime_avx512};
+#else
+#define RULE_KERNEL(birth, survive) {{birth, survive}, {life_kernel_rule<birth, survive>, life_kernel_rule<birth, survive>, life_kernel_rule<birth, survive>}}
+static const Life_Kernel_Func runtime_rule_kernels[INSTRUCTION_SETS] = {life_kernel_rule_runtime, life_kernel_rule_runtime, life_kernel_rule_runtime};
+#endif
+
+//Rules with a specialized kernel (for each instruction set). The masks have bit n set for n neighbours.
+//The first one is also the Conway adder kernel.
+static const struct { Life_Rule rule; Life_Kernel_Func funcs[INSTRUCTION_SETS]; } rule_kernels[] = {
+	RULE_KERNEL(0x008, 0x00C), //B3/S23 Conway's life
+	RULE_KERNEL(0x048, 0x00C), //B36/S23 HighLife
+	RULE_KERNEL(0x1C8, 0x1D8), //B3678/S34678 Day & Night
+	RULE_KERNEL(0x004, 0x000), //B2/S Seeds
+	RULE_KERNEL(0x008, 0x1FF), //B3/S012345678 Life without death
+	RULE_KERNEL(0x048, 0x026), //B36/S125 2x2
+	RULE_KERNEL(0x008, 0x03E), //B3/S12345 Maze
+	RULE_KERNEL(0x148, 0x034), //B368/S245 Morley
+};
+
+#if defined(LIFE_X86)
+struct Cpu_Features
+{
+	bool avx2;
+	bool avx512;
+};
+
+static Cpu_Features query_cpu_features()
+{
+	Cpu_Features features = {0};
+	#ifdef _MSC_VER
+		//We need to check both that the CPU supports the instructions and that
+		//the OS saves the wide registers on context switch (XCR0)
+		int info[4] = {0};
+		__cpuid(info, 0);
+		int max_leaf = info[0];
+
+		__cpuid(info, 1);
+		bool has_osxsave = (info[2] & (1 << 27)) != 0;
+		bool has_avx = (info[2] & (1 << 28)) != 0;
+		if(max_leaf < 7 || has_osxsave == false || has_avx == false)
+			return features;
+
+		u64 xcr0 = _xgetbv(0);
+		bool os_saves_ymm = (xcr0 & 0x06) == 0x06;
+		bool os_saves_zmm = (xcr0 & 0xe6) == 0xe6;
+
+		__cpuidex(info, 7, 0);
+		features.avx2 = os_saves_ymm && (info[1] & (1 << 5)) != 0;
+		features.avx512 = os_saves_zmm && (info[1] & (1 << 16)) != 0;
+	#else
+		__builtin_cpu_init();
+		features.avx2 = __builtin_cpu_supports("avx2");
+		features.avx512 = __builtin_cpu_supports("avx512f");
+	#endif
+
+	return features;
+}
+#endif
+
+bool life_kernel_is_supported(Life_Kernel kernel)
+{
+	#if defined(LIFE_X86) && CHUNK_HALO
+	static Cpu_Features features = query_cpu_features();
+	switch(kernel)
+	{
+		case LIFE_KERNEL_SCALAR:
+		case LIFE_KERNEL_ADDER:        return true;
+		case LIFE_KERNEL_AVX2:
+		case LIFE_KERNEL_ADDER_AVX2:   return features.avx2;
+		case LIFE_KERNEL_AVX512:
+		case LIFE_KERNEL_ADDER_AVX512: return features.avx512;
+		default:                       return false;
+	}
+	#elif CHUNK_HALO
+	return kernel == LIFE_KERNEL_SCALAR || kernel == LIFE_KERNEL_ADDER;
+	#else
+	return kernel == LIFE_KERNEL_ADDER;
+	#endif
+}
+
+Life_Kernel life_kernel_detect()
+{
+	if(life_kernel_is_supported(LIFE_KERNEL_ADDER_AVX512))
+		return LIFE_KERNEL_ADDER_AVX512;
+	if(life_kernel_is_supported(LIFE_KERNEL_ADDER_AVX2))
+		return LIFE_KERNEL_ADDER_AVX2;
+	return LIFE_KERNEL_ADDER;
+}
+
+const char* life_kernel_name(Life_Kernel kernel)
+{
+	switch(kernel)
+	{
+		case LIFE_KERNEL_SCALAR:       return "scalar";
+		case LIFE_KERNEL_AVX2:         return "avx2";
+		case LIFE_KERNEL_AVX512:       return "avx512";
+		case LIFE_KERNEL_ADDER:        return "adder";
+		case LIFE_KERNEL_ADDER_AVX2:   return "adder_avx2";
+		case LIFE_KERNEL_ADDER_AVX512: return "adder_avx512";
+		default:                       return "unknown";
+	}
+}
+
+Life_Kernel_Func life_kernel_get_func(Life_Kernel kernel)
+{
+	if(life_kernel_is_supported(kernel) == false)
+		return NULL;
+
+	switch(kernel)
+	{
+		#if defined(LIFE_X86) && CHUNK_HALO
+		case LIFE_KERNEL_AVX2:   return life_kernel_avx2;
+		case LIFE_KERNEL_AVX512: return life_kernel_avx512;
+		#endif
+		#if CHUNK_HALO
+		case LIFE_KERNEL_SCALAR: return life_kernel_scalar;
+		#endif
+		default:                 return rule_kernels[0].funcs[kernel_instruction_set(kernel)];
+	}
+}
+
+static void life_kernel_resolve(const u64* assembled, u64* next);
+
+//Starts out pointing to the resolve function which picks the best kernel
+//and replaces itself. That way we dont need any checks in life_kernel_run.
+static Life_Kernel selected_kernel = LIFE_KERNEL_ADDER;
+static Life_Kernel_Func selected_func = life_kernel_resolve;
+
+static void life_kernel_resolve(const u64* assembled, u64* next)
+{
+	life_kernel_set(life_kernel_detect());
+	selected_func(assembled, next);
+}
+
+//Returns the function computing rule. The kernel only matters for B3/S23.
+static Life_Kernel_Func life_kernel_get_rule_func(Life_Kernel kernel, Life_Rule rule)
+{
+	if(life_rule_equal(rule, LIFE_RULE_CONWAY))
+		return life_kernel_get_func(kernel);
+
+	for(isize i = 0; i < (isize) (sizeof rule_kernels / sizeof *rule_kernels); i++)
+		if(life_rule_equal(rule, rule_kernels[i].rule))
+			return rule_kernels[i].funcs[kernel_instruction_set(kernel)];
+
+	return runtime_rule_kernels[kernel_instruction_set(kernel)];
+}
+
+bool life_kernel_set(Life_Kernel kernel)
+{
+	if(life_kernel_get_func(kernel) == NULL)
+		return false;
+
+	selected_kernel = kernel;
+	selected_func = life_kernel_get_rule_func(kernel, selected_rule);
+	return true;
+}
+
+Life_Kernel life_kernel_get()
+{
+	if(selected_func == life_kernel_resolve)
+		life_kernel_set(life_kernel_detect());
+
+	return selected_kernel;
+}
+
+void life_kernel_run(const u64* assembled, u64* next)
+{
+	selected_func(assembled, next);
+}
+
+//A single generation of the wide block (see life_wide_pass)
+typedef void (*Life_Wide_Pass)(const u64* from, u64* into, i32 from_row, i32 to_row);
+
+template <u32 BIRTH, u32 SURVIVE>
+static void life_wide_pass_rule(const u64* from, u64* into, i32 from_row, i32 to_row)
+{
+	life_wide_pass(from, into, from_row, to_row, BIRTH, SURVIVE);
+}
+
+static void life_wide_pass_runtime(const u64* from, u64* into, i32 from_row, i32 to_row)
+{
+	life_wide_pass(from, into, from_row, to_row, selected_rule.birth, selected_rule.survive);
+}
+
+#if defined(LIFE_X86)
+template <u32 BIRTH, u32 SURVIVE>
+TARGET_AVX2
+static void life_wide_pass_rule_avx2(const u64* from, u64* into, i32 from_row, i32 to_row)
+{
+	life_wide_pass_avx2(from, into, from_row, to_row, BIRTH, SURVIVE);
+}
+
+template <u32 BIRTH, u32 SURVIVE>
+TARGET_AVX512
+static void life_wide_pass_rule_avx512(const u64* from, u64* into, i32 from_row, i32 to_row)
+{
+	life_wide_pass_avx512(from, into, from_row, to_row, BIRTH, SURVIVE);
+}
+
+TARGET_AVX2
+static void life_wide_pass_runtime_avx2(const u64* from, u64* into, i32 from_row, i32 to_row)
+{
+	life_wide_pass_avx2(from, into, from_row, to_row, selected_rule.birth, selected_rule.survive);
+}
+
+TARGET_AVX512
+static void life_wide_pass_runtime_avx512(const u64* from, u64* into, i32 from_row, i32 to_row)
+{
+	life_wide_pass_avx512(from, into, from_row, to_row, selected_rule.birth, selected_rule.survive);
+}
+
+static const Life_Wide_Pass conway_wide_passes[INSTRUCTION_SETS] = {life_wide_pass_rule<0x008, 0x00C>, life_wide_pass_rule_avx2<0x008, 0x00C>, life_wide_pass_rule_avx512<0x008, 0x00C>};
+static const Life_Wide_Pass runtime_wide_passes[INSTRUCTION_SETS] = {life_wide_pass_runtime, life_wide_pass_runtime_avx2, life_wide_pass_runtime_avx512};
+#else
+static const Life_Wide_Pass conway_wide_passes[INSTRUCTION_SETS] = {life_wide_pass_rule<0x008, 0x00C>, life_wide_pass_rule<0x008, 0x00C>, life_wide_pass_rule<0x008, 0x00C>};
+static const Life_Wide_Pass runtime_wide_passes[INSTRUCTION_SETS] = {life_wide_pass_runtime, life_wide_pass_runtime, life_wide_pass_runtime};
+#endif
+
+//With halo the wide kernel uses the instruction set of the selected kernel.
+//The other layouts have only the scalar kernel so it uses the best one the CPU supports.
+static i32 wide_instruction_set()
+{
+	#if defined(LIFE_X86) && CHUNK_HALO
+	return kernel_instruction_set(life_kernel_get());
+	#elif defined(LIFE_X86)
+	static Cpu_Features features = query_cpu_features();
+	return features.avx512 ? 2 : features.avx2 ? 1 : 0;
+	#else
+	return 0;
+	#endif
+}
+
+const u64* life_kernel_run_wide(u64* block, u64* temp, i32 generations)
+{
+	assert(1 <= generations && generations <= LIFE_WIDE_MARGIN);
+	i32 instruction_set = wide_instruction_set();
+	Life_Wide_Pass pass = life_rule_equal(selected_rule, LIFE_RULE_CONWAY) ? conway_wide_passes[instruction_set] : runtime_wide_passes[instruction_set];
+
+	u64* from = block;
+	u64* into = temp;
+	for(i32 generation = 1; generation <= generations; generation++)
+	{
+		//The rows of the unused margin are not filled and every generation one more row on each side is not needed
+		i32 from_row = LIFE_WIDE_MARGIN - generations + generation;
+		pass(from, into, from_row, LIFE_WIDE_ROWS - from_row);
+
+		u64* swap = from;
+		from = into;
+		into = swap;
+	}
+
+	return from;
+}
+
+bool life_rule_equal(Life_Rule a, Life_Rule b)
+{
+	return a.birth == b.birth && a.survive == b.survive;
+}
+
+bool life_rule_is_specialized(Life_Rule rule)
+{
+	return life_kernel_get_rule_func(LIFE_KERNEL_ADDER, rule) != runtime_rule_kernels[0];
+}
+
+static bool life_rule_is_supported(Life_Rule rule)
+{
+	const u32 all_counts = (1 << 9) - 1;
+	return (rule.birth & 1) == 0 && (rule.birth & ~all_counts) == 0 && (rule.survive & ~all_counts) == 0;
+}
+
+bool life_rule_set(Life_Rule rule)
+{
+	if(life_rule_is_supported(rule) == false)
+		return false;
+
+	//makes sure the kernel is picked and then reselects the function for the new rule
+	Life_Kernel kernel = life_kernel_get();
+	selected_rule = rule;
+	life_kernel_set(kernel);
+	return true;
+}
+
+Life_Rule life_rule_get()
+{
+	return selected_rule;
+}
+
+static bool is_space(char c)
+{
+	return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+bool life_rule_parse(Life_Rule* rule, const char* text)
+{
+	const char* at = text ? text : "";
+	while(is_space(*at))
+		at++;
+
+	const char* end = at;
+	while(*end != '\0' && is_space(*end) == false)
+		end++;
+
+	const char* rest = end;
+	while(is_space(*rest))
+		rest++;
+	if(*rest != '\0' || at == end)
+		return false;
+
+	bool has_letters = false;
+	for(const char* c = at; c < end; c++)
+		if(*c == 'B' || *c == 'b' || *c == 'S' || *c == 's')
+			has_letters = true;
+
+	Life_Rule parsed = {0};
+	if(has_letters)
+	{
+		//B36/S23 (or S23/B36, or without the slash)
+		u16* list = NULL;
+		bool seen_birth = false;
+		bool seen_survive = false;
+		for(const char* c = at; c < end; c++)
+		{
+			if((*c == 'B' || *c == 'b') && seen_birth == false)
+			{
+				list = &parsed.birth;
+				seen_birth = true;
+			}
+			else if((*c == 'S' || *c == 's') && seen_survive == false)
+			{
+				list = &parsed.survive;
+				seen_survive = true;
+			}
+			else if(*c == '/' && list != NULL)
+				list = NULL;
+			else if('0' <= *c && *c <= '8' && list != NULL)
+				*list |= (u16) (1 << (*c - '0'));
+			else
+				return false;
+		}
+
+		if(seen_birth == false || seen_survive == false || end[-1] == '/')
+			return false;
+	}
+	else
+	{
+		//23/36 - survive first
+		u16* list = &parsed.survive;
+		for(const char* c = at; c < end; c++)
+		{
+			if(*c == '/' && list == &parsed.survive)
+				list = &parsed.birth;
+			else if('0' <= *c && *c <= '8')
+				*list |= (u16) (1 << (*c - '0'));
+			else
+				return false;
+		}
+
+		if(list != &parsed.birth)
+			return false;
+	}
+
+	if(life_rule_is_supported(parsed) == false)
+		return false;
+
+	*rule = parsed;
+	return true;
+}
+
+void life_rule_format(Life_Rule rule, char* into, isize into_size)
+{
+	char buffer[LIFE_RULE_STRING_SIZE] = {0};
+	isize size = 0;
+	buffer[size++] = 'B';
+	for(i32 n = 0; n <= 8; n++)
+		if(rule.birth & (1 << n))
+			buffer[size++] = (char) ('0' + n);
+
+	buffer[size++] = '/';
+	buffer[size++] = 'S';
+	for(i32 n = 0; n <= 8; n++)
+		if(rule.survive & (1 << n))
+			buffer[size++] = (char) ('0' + n);
+
+	if(into_size <= 0)
+		return;
+
+	isize copied = size < into_size - 1 ? size : into_size - 1;
+	memcpy(into, buffer, (usize) copied);
+	into[copied] = '\0';
+}
@@ -0,0 +1,170 @@
+#pragma once
+#include "types.h"
+#include "chunk.h"
+
+// This file provides the "life" kernel: the function that takes a single
+// assembled block (chunk content together with one cell of border from
+// its neighbours) and computes the inner cells of the next generation.
+//
+// For CHUNK_LAYOUT_61 the block is 64x64 with the border inline and there are two algorhitms
+// each with multiple implementations:
+//  - oct:   sums the neighbours in 3 bit slots (see game_of_life.cpp for its explanation) which
+//           takes three passes over each row, every one producing every third bit of the output.
+//  - adder: counts the neighbours of all 64 cells of a row in a single pass with bit sliced
+//           full adders (the count is kept as one u64 per bit of the count).
+// The scalar versions work on a single u64 row at a time, the SIMD ones do the exact same
+// thing on 4 (AVX2) or 8 (AVX-512) rows at once.
+// The adder takes about a fifth of the time of the oct kernel per block (the whole step is 10-30% faster)
+// so the best adder the current CPU supports is picked on first use by cpuid.
+// All of them produce bit identical output.
+//
+// For the layouts without halo the border is kept in separate words around each row
+// and there is only the scalar adder kernel (LIFE_KERNEL_ADDER).
+
+#if CHUNK_HALO
+	#define LIFE_ASSEMBLED_ROW_WORDS 1
+	#define LIFE_ASSEMBLED_WORDS 64
+#else
+	//[left border word][CHUNK_ROW_WORDS content words][right border word] for each of the
+	//CHUNK_SIZE + 2 rows. Only the bit touching the content of the border words is used.
+	#define LIFE_ASSEMBLED_ROW_WORDS (CHUNK_ROW_WORDS + 2)
+	#define LIFE_ASSEMBLED_WORDS ((CHUNK_SIZE + 2) * LIFE_ASSEMBLED_ROW_WORDS)
+#endif
+
+typedef enum Life_Kernel
+{
+	LIFE_KERNEL_SCALAR = 0, //oct
+	LIFE_KERNEL_AVX2,
+	LIFE_KERNEL_AVX512,
+	LIFE_KERNEL_ADDER,
+	LIFE_KERNEL_ADDER_AVX2,
+	LIFE_KERNEL_ADDER_AVX512,
+	LIFE_KERNEL_COUNT,
+} Life_Kernel;
+
+//Computes the next generation of assembled (LIFE_ASSEMBLED_WORDS) into next (Chunk::data).
+//With halo only rows 1 to 62 (exclusive) of next are written and the bits outside
+//of the chunk content are unspecified and should be masked.
+//Without halo all of next is written.
+typedef void (*Life_Kernel_Func)(const u64* assembled, u64* next);
+
+//Returns the fastest kernel supported by this CPU
+Life_Kernel life_kernel_detect();
+bool life_kernel_is_supported(Life_Kernel kernel);
+const char* life_kernel_name(Life_Kernel kernel);
+
+//Changes the kernel used by life_kernel_run. Returns false (and changes nothing)
+//if the kernel is not supported by this CPU.
+bool life_kernel_set(Life_Kernel kernel);
+Life_Kernel life_kernel_get();
+Life_Kernel_Func life_kernel_get_func(Life_Kernel kernel);
+
+//Runs the currently selected kernel
+void life_kernel_run(const u64* assembled, u64* next);
+
+// Temporal blocking
+//
+// life_kernel_run_wide advances a bigger block by several generations at once (see game_of_life_generation_step_multi).
+// The block is the chunk content with a margin of LIFE_WIDE_MARGIN cells from the neighbouring chunks around it.
+// Every generation the cells at the edge of the block get wrong counts (their neighbours outside are missing)
+// and the wrong cells spread one cell inwards per generation so advancing by n generations needs a margin of n cells.
+// Each generation computes only the rows that are still needed for the content in the end.
+//
+// The block is stored by columns of words: LIFE_WIDE_WORDS planes of LIFE_WIDE_ROWS u64s where plane w holds the word w
+// of every row. That way the kernel goes down the rows of one word like the other kernels do. Cell (x, y) of the content
+// is the bit x + LIFE_WIDE_MARGIN of the row y + LIFE_WIDE_MARGIN. It is the adder kernel in its scalar, AVX2 and AVX-512
+// versions (the one of the selected kernel with halo, the best the CPU supports otherwise). B3/S23 is specialized
+// at compile time, the other rules are read at runtime.
+
+#define LIFE_WIDE_MARGIN		8 /* most generations advanced at once */
+#define LIFE_WIDE_ROWS			(CHUNK_SIZE + 2*LIFE_WIDE_MARGIN)
+#define LIFE_WIDE_WORDS			((CHUNK_SIZE + 2*LIFE_WIDE_MARGIN + 63) / 64)
+#define LIFE_WIDE_BLOCK_WORDS	(LIFE_WIDE_WORDS * LIFE_WIDE_ROWS)
+
+//Advances block (LIFE_WIDE_BLOCK_WORDS) by generations (1 to LIFE_WIDE_MARGIN) using temp (the same size) in between.
+//Only the rows and the bits of the content with a margin of generations cells have to be filled (the rest is never read).
+//Returns the one of them holding the result in which only the content is valid.
+const u64* life_kernel_run_wide(u64* block, u64* temp, i32 generations);
+
+// Rules
+//
+// The step follows an outer totalistic rule in the usual B/S notation: a dead cell is born if its number
+// of alive neighbours is listed after B and an alive cell survives if it is listed after S.
+// Conway's life is B3/S23, HighLife B36/S23, Day & Night B3678/S34678 and Seeds B2/S.
+// Rules with B0 are not supported (empty space would fill up which breaks skipping of empty chunks and HashLife).
+//
+// B3/S23 runs on the selected kernel. Other rules always run on the adder kernel of the same
+// instruction set which applies the rule to the bits of the count (life_rule_apply).
+// For the well known rules the kernel is specialized at compile time (a template on the rule masks)
+// so the rule folds into a few bitwise operations. Everything else runs the same code with the
+// rule read at runtime which is somewhat slower.
+
+#define LIFE_RULE_STRING_SIZE 24 /* enough for any rule formatted by life_rule_format */
+
+typedef struct Life_Rule
+{
+	u16 birth;   //bit n is set if a dead cell with n alive neighbours becomes alive
+	u16 survive; //bit n is set if an alive cell with n alive neighbours stays alive
+} Life_Rule;
+
+static const Life_Rule LIFE_RULE_CONWAY = {1 << 3, (1 << 2) | (1 << 3)};
+
+//Parses a rule in the B/S notation ("B36/S23", case insensitive, the slash is optional)
+//or the older S/B one ("23/36"). Returns false if text is not a valid rule or the rule has B0.
+bool life_rule_parse(Life_Rule* rule, const char* text);
+
+//Writes the rule in the B/S notation into a buffer of into_size bytes
+void life_rule_format(Life_Rule rule, char* into, isize into_size);
+bool life_rule_equal(Life_Rule a, Life_Rule b);
+
+//Changes the rule used by life_kernel_run. Returns false (and changes nothing) if the rule is not supported.
+//Should not be called during a step.
+bool life_rule_set(Life_Rule rule);
+Life_Rule life_rule_get();
+
+//Returns true if the rule has its own compile time specialized kernel (or is B3/S23)
+bool life_rule_is_specialized(Life_Rule rule);
+
+//The number of alive neighbours of 64 cells in bit sliced form:
+//bit i of the count of cell i is bit i of ones, twos, fours and eights.
+typedef struct Life_Count
+{
+	u64 ones;
+	u64 twos;
+	u64 fours;
+	u64 eights;
+} Life_Count;
+
+//Returns the bits of the cells whose count is n
+static inline u64 life_count_is(Life_Count count, u32 n)
+{
+	return (n & 1 ? count.ones : ~count.ones)
+		& (n & 2 ? count.twos : ~count.twos)
+		& (n & 4 ? count.fours : ~count.fours)
+		& (n & 8 ? count.eights : ~count.eights);
+}
+
+//Returns the next generation of the 64 cells alive given their counts and the birth and survive masks of a rule.
+//With constant masks the compiler drops all counts the rule does not mention.
+static inline u64 life_rule_apply(u32 birth, u32 survive, Life_Count count, u64 alive)
+{
+	//B3/S23 has a shorter form
+	if(birth == LIFE_RULE_CONWAY.birth && survive == LIFE_RULE_CONWAY.survive)
+		return count.twos & ~count.fours & ~count.eights & (count.ones | alive);
+
+	u64 born = 0;
+	u64 survives = 0;
+	for(u32 n = 0; n <= 8; n++)
+	{
+		if(((birth | survive) & (1u << n)) == 0)
+			continue;
+
+		u64 is_n = life_count_is(count, n);
+		if(birth & (1u << n))
+			born |= is_n;
+		if(survive & (1u << n))
+			survives |= is_n;
+	}
+
+	return (born & ~alive) | (survives & alive);
+}
@@ -4,7 +4,10 @@
 #include "load.h"
 #include "types.h"
 
-bool read_whole_file_alloc(const char* path, char** into)
+//Cells further than this from the origin are not loaded
+#define MAX_CELL_COORD ((i64) 1 << 30)
+
+bool read_whole_file_alloc(const char* path, char** into, isize* into_alloced_size)
 {
 	size_t alloced_size = 0;
 	size_t data_size = 0;
@@ -20,11 +23,8 @@ bool read_whole_file_alloc(const char* path, char** into)
 		if(data_size + chunk_size + 1 > alloced_size)
 		{
 			size_t new_size = (data_size + chunk_size) * 2 + 1;
-			void* new_data = sure_realloc(data, data_size, new_size);
-			if(new_data == NULL)
-				break;
-
-			data = (char*) new_data;
+			data = (char*) sure_realloc(data, new_size, alloced_size, ALLOC_TAG_FILE);
+			alloced_size = new_size;
 		}
 
         size_t read = fread(data + data_size, 1, chunk_size, file);
@@ -36,13 +36,436 @@ bool read_whole_file_alloc(const char* path, char** into)
 	}
 	
 	if(data != NULL)
-		data[data_size - 1] = '\0';
+		data[data_size] = '\0';
 		
 	fclose(file);
 	*into = data;
+	*into_alloced_size = (isize) alloced_size;
 	return true;
 }
 
+const char* parse_error_to_string(Parse_Error error)
+{
+	switch(error)
+	{
+		case PARSE_ERROR_NONE: return "none";
+		case PARSE_ERROR_BAD_DIMENSIONS: return "bad dimensions";
+		case PARSE_ERROR_INVALID_CAHARCTER: return "invalid character";
+		case PARSE_ERROR_BAD_HEADER: return "bad header";
+		case PARSE_ERROR_BAD_NODE: return "bad node";
+		case PARSE_ERROR_OUT_OF_RANGE: return "cells out of range";
+		case PARSE_ERROR_UNKNOWN_FORMAT: return "unknown format";
+		case PARSE_ERROR_FULL: return "too many chunks";
+		default: return "unknown error";
+	}
+}
+
+//Cached index of a column whose chunk could not be inserted. Its cells are dropped for the rest of the row of chunks.
+#define WRITER_COLUMN_FULL -2
+
+//Assembles the cells of a single row into whole chunk rows (in the format of chunk_row per chunk column) and
+//or-s them into the chunks once the row is done. The indices of the chunks are cached for the
+//whole row of chunks so every chunk is looked up only once as long as the cells come roughly
+//in the order of rows (which they do in all formats we load).
+typedef struct Pattern_Writer
+{
+	Chunk_Hash* chunk_hash;
+	bool has_row;
+	i32 y;       //row being assembled
+	i32 chunk_y; //row of chunks the cached indices belong to
+
+	i32 first_chunk_x; //chunk x of column 0
+	i32 column_count;
+	u64* bits;    //assembled chunk row (CHUNK_ROW_WORDS) per column
+	i32* indices; //cached chunk index per column, -1 or WRITER_COLUMN_FULL
+	i32* used;    //columns with some bits or a cached index
+	i32 used_count;
+
+	//all chunks written to (can repeat)
+	i32* written;
+	i32 written_size;
+	i32 written_capacity;
+
+	bool out_of_range;
+} Pattern_Writer;
+
+static void pattern_writer_deinit(Pattern_Writer* writer)
+{
+	sure_realloc(writer->bits, 0, writer->column_count * CHUNK_ROW_WORDS * (isize) sizeof(u64), ALLOC_TAG_FILE);
+	sure_realloc(writer->indices, 0, writer->column_count * (isize) sizeof(i32), ALLOC_TAG_FILE);
+	sure_realloc(writer->used, 0, writer->column_count * (isize) sizeof(i32), ALLOC_TAG_FILE);
+	sure_realloc(writer->written, 0, writer->written_capacity * (isize) sizeof(i32), ALLOC_TAG_FILE);
+	memset(writer, 0, sizeof *writer);
+}
+
+static bool row_is_empty(const u64* row)
+{
+	u64 any = 0;
+	for(i32 w = 0; w < CHUNK_ROW_WORDS; w++)
+		any |= row[w];
+	return any == 0;
+}
+
+static void pattern_writer_flush(Pattern_Writer* writer)
+{
+	if(writer->has_row == false)
+		return;
+
+	Chunk_Hash* chunk_hash = writer->chunk_hash;
+	i32 local_y = writer->y - writer->chunk_y * CHUNK_SIZE;
+	for(i32 i = 0; i < writer->used_count; i++)
+	{
+		i32 column = writer->used[i];
+		u64* bits = &writer->bits[column * CHUNK_ROW_WORDS];
+		if(row_is_empty(bits))
+			continue;
+
+		i32 index = writer->indices[column];
+		if(index == -1)
+		{
+			//The failure is cached as well so that the column is not added to used again
+			index = chunk_hash_insert(chunk_hash, vec(writer->first_chunk_x + column, writer->chunk_y));
+			if(index == CHUNK_HASH_FULL)
+				index = WRITER_COLUMN_FULL;
+			else
+			{
+				if(writer->written_size >= writer->written_capacity)
+				{
+					i32 new_capacity = writer->written_capacity * 2 + 16;
+					writer->written = (i32*) sure_realloc(writer->written, new_capacity * (isize) sizeof(i32), writer->written_capacity * (isize) sizeof(i32), ALLOC_TAG_FILE);
+					writer->written_capacity = new_capacity;
+				}
+				writer->written[writer->written_size++] = index;
+			}
+
+			writer->indices[column] = index;
+		}
+
+		if(index == WRITER_COLUMN_FULL)
+		{
+			memset(bits, 0, CHUNK_ROW_WORDS * sizeof(u64));
+			continue;
+		}
+
+		u64* row = chunk_row(&chunk_hash->chunks[index], local_y);
+		for(i32 w = 0; w < CHUNK_ROW_WORDS; w++)
+			row[w] |= bits[w];
+		chunk_hash->meta[index].flags = 0;
+		memset(bits, 0, CHUNK_ROW_WORDS * sizeof(u64));
+	}
+}
+
+static void pattern_writer_set_row(Pattern_Writer* writer, i32 y)
+{
+	if(writer->has_row && writer->y == y)
+		return;
+
+	pattern_writer_flush(writer);
+
+	//the cached indices are only valid for a single row of chunks
+	i32 chunk_y = div_round_down(y, CHUNK_SIZE);
+	if(writer->has_row == false || writer->chunk_y != chunk_y)
+	{
+		for(i32 i = 0; i < writer->used_count; i++)
+			writer->indices[writer->used[i]] = -1;
+		writer->used_count = 0;
+	}
+
+	writer->has_row = true;
+	writer->y = y;
+	writer->chunk_y = chunk_y;
+}
+
+//Returns the column of chunk_x (growing the columns if needed) and marks it used
+static i32 pattern_writer_column(Pattern_Writer* writer, i32 chunk_x)
+{
+	i32 column = chunk_x - writer->first_chunk_x;
+	if(column < 0 || column >= writer->column_count)
+	{
+		i32 last_chunk_x = writer->first_chunk_x + writer->column_count - 1;
+		i32 new_count = writer->column_count * 2;
+		if(new_count < 16)
+			new_count = 16;
+
+		i32 new_first = writer->first_chunk_x;
+		if(writer->column_count == 0)
+			new_first = chunk_x - new_count/2;
+		else if(chunk_x < writer->first_chunk_x)
+		{
+			if(new_count < last_chunk_x - chunk_x + 1)
+				new_count = last_chunk_x - chunk_x + 1;
+			new_first = last_chunk_x - new_count + 1;
+		}
+		else if(new_count < chunk_x - new_first + 1)
+			new_count = chunk_x - new_first + 1;
+
+		u64* new_bits = (u64*) sure_realloc(NULL, new_count * CHUNK_ROW_WORDS * (isize) sizeof(u64), 0, ALLOC_TAG_FILE);
+		i32* new_indices = (i32*) sure_realloc(NULL, new_count * (isize) sizeof(i32), 0, ALLOC_TAG_FILE);
+		i32* new_used = (i32*) sure_realloc(NULL, new_count * (isize) sizeof(i32), 0, ALLOC_TAG_FILE);
+		memset(new_bits, 0, new_count * CHUNK_ROW_WORDS * sizeof(u64));
+		memset(new_indices, 0xFF, new_count * sizeof(i32));
+
+		i32 shift = writer->first_chunk_x - new_first;
+		for(i32 i = 0; i < writer->column_count; i++)
+		{
+			for(i32 w = 0; w < CHUNK_ROW_WORDS; w++)
+				new_bits[(i + shift) * CHUNK_ROW_WORDS + w] = writer->bits[i * CHUNK_ROW_WORDS + w];
+			new_indices[i + shift] = writer->indices[i];
+		}
+		for(i32 i = 0; i < writer->used_count; i++)
+			new_used[i] = writer->used[i] + shift;
+
+		i32 used_count = writer->used_count;
+		i32 old_count = writer->column_count;
+		sure_realloc(writer->bits, 0, old_count * CHUNK_ROW_WORDS * (isize) sizeof(u64), ALLOC_TAG_FILE);
+		sure_realloc(writer->indices, 0, old_count * (isize) sizeof(i32), ALLOC_TAG_FILE);
+		sure_realloc(writer->used, 0, old_count * (isize) sizeof(i32), ALLOC_TAG_FILE);
+
+		writer->bits = new_bits;
+		writer->indices = new_indices;
+		writer->used = new_used;
+		writer->used_count = used_count;
+		writer->first_chunk_x = new_first;
+		writer->column_count = new_count;
+		column = chunk_x - new_first;
+	}
+
+	if(row_is_empty(&writer->bits[column * CHUNK_ROW_WORDS]) && writer->indices[column] == -1)
+		writer->used[writer->used_count++] = column;
+
+	return column;
+}
+
+//Sets count cells starting at (x, y) according to the lowest count bits of cells (bit 0 is x). count <= 64
+static void pattern_writer_bits(Pattern_Writer* writer, i64 x, i64 y, u64 cells, i32 count)
+{
+	if(count < 64)
+		cells &= ((u64) 1 << count) - 1;
+	if(cells == 0)
+		return;
+
+	if(x < -MAX_CELL_COORD || x + 64 > MAX_CELL_COORD || y < -MAX_CELL_COORD || y >= MAX_CELL_COORD)
+	{
+		writer->out_of_range = true;
+		return;
+	}
+
+	pattern_writer_set_row(writer, (i32) y);
+
+	//The cells span up to 3 chunks. Move them in chunk sized segments.
+	i32 cell_x = (i32) x;
+	while(cells != 0)
+	{
+		i32 chunk_x = div_round_down(cell_x, CHUNK_SIZE);
+		i32 local_x = cell_x - chunk_x * CHUNK_SIZE;
+		i32 segment_size = CHUNK_SIZE - local_x;
+		if(segment_size >= 64)
+			segment_size = 64;
+
+		u64 segment = segment_size < 64 ? cells & (((u64) 1 << segment_size) - 1) : cells;
+		if(segment != 0)
+		{
+			i32 column = pattern_writer_column(writer, chunk_x);
+			chunk_row_or_bits(&writer->bits[column * CHUNK_ROW_WORDS], local_x, segment);
+		}
+
+		cells = segment_size < 64 ? cells >> segment_size : 0;
+		cell_x += segment_size;
+	}
+}
+
+static void pattern_writer_run(Pattern_Writer* writer, i64 x, i64 y, i64 count)
+{
+	for(; count > 0; count -= 64, x += 64)
+	{
+		i32 size = count < 64 ? (i32) count : 64;
+		pattern_writer_bits(writer, x, y, ~(u64) 0, size);
+	}
+}
+
+//Writes out the last row, inserts the neighbours of all written chunks and deinits the writer.
+//Returns error or PARSE_ERROR_OUT_OF_RANGE/PARSE_ERROR_FULL if some cells were skipped.
+static Parse_Error pattern_writer_finish(Pattern_Writer* writer, Parse_Error error)
+{
+	pattern_writer_flush(writer);
+
+	//The step expects all neighbours of alive chunks to be present (see set_cell_at)
+	Chunk_Hash* chunk_hash = writer->chunk_hash;
+	for(i32 i = 0; i < writer->written_size; i++)
+	{
+		Vec2i pos = chunk_hash->positions[writer->written[i]];
+		for(i32 dir = 0; dir < DIRECTION_COUNT; dir++)
+			chunk_hash_insert(chunk_hash, vec_add(pos, chunk_directions[dir]));
+	}
+
+	if(error == PARSE_ERROR_NONE && writer->out_of_range)
+		error = PARSE_ERROR_OUT_OF_RANGE;
+	if(error == PARSE_ERROR_NONE && chunk_hash->full)
+		error = PARSE_ERROR_FULL;
+
+	pattern_writer_deinit(writer);
+	return error;
+}
+
+static bool is_blank(char c)
+{
+	return c == ' ' || c == '\t' || c == '\r';
+}
+
+static bool is_space(char c)
+{
+	return is_blank(c) || c == '\n';
+}
+
+static const char* skip_blank(const char* at)
+{
+	while(is_blank(*at))
+		at++;
+	return at;
+}
+
+static const char* skip_space(const char* at)
+{
+	while(is_space(*at))
+		at++;
+	return at;
+}
+
+static const char* skip_line(const char* at)
+{
+	while(*at != '\0' && *at != '\n')
+		at++;
+	if(*at == '\n')
+		at++;
+	return at;
+}
+
+static bool starts_with(const char* str, const char* prefix)
+{
+	return strncmp(str, prefix, strlen(prefix)) == 0;
+}
+
+//Parses optionally signed decimal number. Fails if there is none or it is absurdly large.
+//(We dont use sscanf because it calls strlen on the whole rest of the file every call)
+static bool parse_i64(const char** at, i64* out)
+{
+	const char* c = skip_blank(*at);
+	bool negative = false;
+	if(*c == '-' || *c == '+')
+	{
+		negative = *c == '-';
+		c++;
+	}
+
+	if(*c < '0' || *c > '9')
+		return false;
+
+	i64 value = 0;
+	for(; '0' <= *c && *c <= '9'; c++)
+	{
+		value = value * 10 + (*c - '0');
+		if(value > ((i64) 1 << 62) / 10)
+			return false;
+	}
+
+	*out = negative ? -value : value;
+	*at = c;
+	return true;
+}
+
+Pattern_Format detect_pattern_format(const char* read_data)
+{
+	if(read_data == NULL)
+		return PATTERN_FORMAT_UNKNOWN;
+
+	const char* at = skip_space(read_data);
+	if(starts_with(at, "[M2]"))
+		return PATTERN_FORMAT_MACROCELL;
+	if(starts_with(at, "#Life 1.06"))
+		return PATTERN_FORMAT_LIFE_106;
+
+	//Our format starts with a line containing just the width
+	if('0' <= *at && *at <= '9')
+	{
+		const char* c = at;
+		while('0' <= *c && *c <= '9')
+			c++;
+		c = skip_blank(c);
+		if(*c == '\n' || *c == '\0')
+			return PATTERN_FORMAT_TEXT;
+	}
+
+	//RLE starts with comments then the header or directly with the cells
+	while(*at == '#')
+		at = skip_space(skip_line(at));
+
+	if(*at == 'x' || *at == 'b' || *at == 'o' || *at == '$' || *at == '!' || ('0' <= *at && *at <= '9'))
+		return PATTERN_FORMAT_RLE;
+
+	return PATTERN_FORMAT_UNKNOWN;
+}
+
+//Parses the rule from the text up to the end of line or a comma
+static bool parse_rule_until_line_end(const char* at, Life_Rule* rule)
+{
+	char text[64] = {0};
+	isize size = 0;
+	for(; *at != '\0' && *at != '\n' && *at != ','; at++)
+	{
+		if(size >= (isize) sizeof text - 1)
+			return false;
+		text[size++] = *at;
+	}
+
+	return life_rule_parse(rule, text);
+}
+
+bool parse_pattern_rule(const char* read_data, Life_Rule* rule)
+{
+	Pattern_Format format = detect_pattern_format(read_data);
+	const char* at = skip_space(read_data ? read_data : "");
+	if(format == PATTERN_FORMAT_MACROCELL)
+	{
+		//#R B3/S23 is one of the comment lines after [M2]
+		for(at = skip_space(skip_line(at)); *at == '#'; at = skip_space(skip_line(at)))
+			if(starts_with(at, "#R"))
+				return parse_rule_until_line_end(at + 2, rule);
+	}
+	else if(format == PATTERN_FORMAT_RLE)
+	{
+		//x = 3, y = 3, rule = B3/S23
+		while(*at == '#')
+			at = skip_space(skip_line(at));
+		if(*at != 'x')
+			return false;
+
+		for(; *at != '\0' && *at != '\n'; at++)
+		{
+			if(starts_with(at, "rule") == false)
+				continue;
+
+			at = skip_blank(at + 4);
+			if(*at != '=')
+				return false;
+			return parse_rule_until_line_end(at + 1, rule);
+		}
+	}
+
+	return false;
+}
+
+Parse_Error parse_pattern_into_chunks(Chunk_Hash* chunk_hash, const char* read_data)
+{
+	switch(detect_pattern_format(read_data))
+	{
+		case PATTERN_FORMAT_TEXT: return parse_text_into_chunks(chunk_hash, read_data);
+		case PATTERN_FORMAT_RLE: return parse_rle_into_chunks(chunk_hash, read_data);
+		case PATTERN_FORMAT_LIFE_106: return parse_life_106_into_chunks(chunk_hash, read_data);
+		case PATTERN_FORMAT_MACROCELL: return parse_macrocell_into_chunks(chunk_hash, read_data);
+		default: return PARSE_ERROR_UNKNOWN_FORMAT;
+	}
+}
+
 Parse_Error parse_text_into_chunks(Chunk_Hash* chunk_hash, const char* read_data)
 {
 	int width = -1;
@@ -50,8 +473,11 @@ Parse_Error parse_text_into_chunks(Chunk_Hash* chunk_hash, const char* read_data
 	i32 size = read_data ? (i32) strlen(read_data) : 0;
 	i32 line_count = 0;
 	i32 line_size = 0;
+	Parse_Error error = PARSE_ERROR_NONE;
+	Pattern_Writer writer = {0};
+	writer.chunk_hash = chunk_hash;
 
-	for(i32 i = 0; i < size; i += line_size + 1, line_count ++)
+	for(i32 i = 0; i < size && error == PARSE_ERROR_NONE; i += line_size + 1, line_count ++)
     {
 		while((read_data[i] == '\r' || read_data[i] == '\n') && read_data[i] != '\0')
 			i++;
@@ -80,7 +506,8 @@ Parse_Error parse_text_into_chunks(Chunk_Hash* chunk_hash, const char* read_data
 
 			if(state < 1)
 			{
-				return PARSE_ERROR_BAD_DIMENSIONS;
+				error = PARSE_ERROR_BAD_DIMENSIONS;
+				break;
 			}
 				
 			continue;
@@ -88,36 +515,305 @@ Parse_Error parse_text_into_chunks(Chunk_Hash* chunk_hash, const char* read_data
 
         //translate line and add it
 		i32 y = line_count;
-        for(i32 x = 0; x < line_size; x++)
+        for(i32 x = 0; x < line_size && error == PARSE_ERROR_NONE; x++)
         {
 			char c = line[x];
             switch(c)
             {
                 case 'X': {
-				
-					i32 offset_x = x - (i32) width/2 + CHUNK_SIZE/2; 
-					i32 offset_y = y - (i32) height/2  + CHUNK_SIZE/2;
-				
-					i32 chunk_x = offset_x / CHUNK_SIZE;
-					i32 chunk_y = offset_y / CHUNK_SIZE;
-					
-					i32 local_x = (offset_x % CHUNK_SIZE + CHUNK_SIZE) % CHUNK_SIZE;
-					i32 local_y = (offset_y % CHUNK_SIZE + CHUNK_SIZE) % CHUNK_SIZE;
-					
-					i32 chunk_i = chunk_hash_insert(chunk_hash, Vec2i{chunk_x, chunk_y});
-					Chunk* chunk = chunk_hash_at(chunk_hash, chunk_i);
-					assert(chunk != NULL);
-					chunk_set_cell(chunk, vec(local_x, local_y), true);
+					//the neighbouring chunks are inserted by pattern_writer_finish
+					i64 offset_x = x - (i64) width/2 + CHUNK_SIZE/2; 
+					i64 offset_y = y - (i64) height/2  + CHUNK_SIZE/2;
+					pattern_writer_bits(&writer, offset_x, offset_y, 1, 1);
 				}
 
 				break;
                 case '-': break;
 
                 default: 
-					return PARSE_ERROR_INVALID_CAHARCTER;
+					error = PARSE_ERROR_INVALID_CAHARCTER;
 			}
         }
     }
 
-	return PARSE_ERROR_NONE;
+	return pattern_writer_finish(&writer, error);
+}
+
+//The standard run length encoded format:
+//  #C comment
+//  x = 3, y = 3, rule = B3/S23
+//  bo$2bo$3o!
+//b is a dead cell, o (or any upper case letter of the multistate variant) alive, $ ends a row and
+//each can be preceded by a repeat count.
+Parse_Error parse_rle_into_chunks(Chunk_Hash* chunk_hash, const char* read_data)
+{
+	const char* at = read_data ? read_data : "";
+	at = skip_space(at);
+	while(*at == '#')
+		at = skip_space(skip_line(at));
+
+	i64 width = 0;
+	i64 height = 0;
+	if(*at == 'x')
+	{
+		at = skip_blank(at + 1);
+		if(*at != '=')
+			return PARSE_ERROR_BAD_HEADER;
+		at++;
+		if(parse_i64(&at, &width) == false)
+			return PARSE_ERROR_BAD_HEADER;
+
+		at = skip_blank(at);
+		if(*at == ',')
+		{
+			at = skip_blank(at + 1);
+			if(*at != 'y')
+				return PARSE_ERROR_BAD_HEADER;
+			at = skip_blank(at + 1);
+			if(*at != '=')
+				return PARSE_ERROR_BAD_HEADER;
+			at++;
+			if(parse_i64(&at, &height) == false)
+				return PARSE_ERROR_BAD_HEADER;
+		}
+
+		//the rest is the rule
+		at = skip_line(at);
+	}
+
+	if(width < 0 || height < 0 || width > MAX_CELL_COORD || height > MAX_CELL_COORD)
+		return PARSE_ERROR_BAD_DIMENSIONS;
+
+	i64 origin_x = -width/2 + CHUNK_SIZE/2;
+	i64 origin_y = -height/2 + CHUNK_SIZE/2;
+
+	Pattern_Writer writer = {0};
+	writer.chunk_hash = chunk_hash;
+	Parse_Error error = PARSE_ERROR_NONE;
+	i64 x = 0;
+	i64 y = 0;
+	i64 count = 0;
+	for(; *at != '\0' && *at != '!'; at++)
+	{
+		char c = *at;
+		if(is_space(c))
+			continue;
+
+		if('0' <= c && c <= '9')
+		{
+			count = count * 10 + (c - '0');
+			if(count > MAX_CELL_COORD)
+			{
+				error = PARSE_ERROR_BAD_DIMENSIONS;
+				break;
+			}
+			continue;
+		}
+
+		i64 run = count > 0 ? count : 1;
+		count = 0;
+		if(c == 'b' || c == '.')
+			x += run;
+		else if(c == '$')
+		{
+			y += run;
+			x = 0;
+		}
+		else if(c == 'o' || ('A' <= c && c <= 'X'))
+		{
+			pattern_writer_run(&writer, origin_x + x, origin_y + y, run);
+			x += run;
+		}
+		else
+		{
+			error = PARSE_ERROR_INVALID_CAHARCTER;
+			break;
+		}
+	}
+
+	return pattern_writer_finish(&writer, error);
+}
+
+//A list of alive cells:
+//  #Life 1.06
+//  0 -1
+//  1 0
+//  -1 1
+Parse_Error parse_life_106_into_chunks(Chunk_Hash* chunk_hash, const char* read_data)
+{
+	const char* at = skip_space(read_data ? read_data : "");
+	if(starts_with(at, "#Life 1.06") == false)
+		return PARSE_ERROR_BAD_HEADER;
+
+	Pattern_Writer writer = {0};
+	writer.chunk_hash = chunk_hash;
+	Parse_Error error = PARSE_ERROR_NONE;
+	while(true)
+	{
+		at = skip_space(at);
+		if(*at == '\0')
+			break;
+		if(*at == '#')
+		{
+			at = skip_line(at);
+			continue;
+		}
+
+		i64 x = 0;
+		i64 y = 0;
+		if(parse_i64(&at, &x) == false || parse_i64(&at, &y) == false)
+		{
+			error = PARSE_ERROR_INVALID_CAHARCTER;
+			break;
+		}
+
+		at = skip_blank(at);
+		if(*at != '\n' && *at != '\0')
+		{
+			error = PARSE_ERROR_INVALID_CAHARCTER;
+			break;
+		}
+
+		pattern_writer_bits(&writer, x + CHUNK_SIZE/2, y + CHUNK_SIZE/2, 1, 1);
+	}
+
+	return pattern_writer_finish(&writer, error);
+}
+
+#define MACROCELL_LEAF_LEVEL 3
+
+typedef struct Macrocell_Node
+{
+	i32 level;
+	u32 children[4]; //nw, ne, sw, se as 1 based indices into the nodes (0 is empty)
+	u64 leaf;        //cells of 8x8 leaves. Bit x + 8*y is the cell (x, y)
+} Macrocell_Node;
+
+static void macrocell_write_node(Pattern_Writer* writer, const Macrocell_Node* nodes, u32 index, i64 x, i64 y)
+{
+	if(index == 0)
+		return;
+
+	const Macrocell_Node* node = &nodes[index - 1];
+	if(node->level == MACROCELL_LEAF_LEVEL)
+	{
+		for(i32 row = 0; row < 8; row++)
+			pattern_writer_bits(writer, x, y + row, node->leaf >> (row * 8), 8);
+		return;
+	}
+
+	//Dont even walk the parts which are completely out of range
+	i64 size = (i64) 1 << node->level;
+	if(x + size <= -MAX_CELL_COORD || y + size <= -MAX_CELL_COORD || x >= MAX_CELL_COORD || y >= MAX_CELL_COORD)
+	{
+		writer->out_of_range = true;
+		return;
+	}
+
+	i64 half = size / 2;
+	macrocell_write_node(writer, nodes, node->children[0], x, y);
+	macrocell_write_node(writer, nodes, node->children[1], x + half, y);
+	macrocell_write_node(writer, nodes, node->children[2], x, y + half);
+	macrocell_write_node(writer, nodes, node->children[3], x + half, y + half);
+}
+
+//The quadtree format of the HashLife programs:
+//  [M2] (golly 4.2)
+//  #R B3/S23
+//  .**$**$.*$        <- 8x8 leaf. Rows end with $, trailing dead cells and rows are left out
+//  4 0 1 0 1         <- node of level 4 (16x16) with 1 based indices of its nw, ne, sw, se children (0 is empty)
+//The last node is the root.
+Parse_Error parse_macrocell_into_chunks(Chunk_Hash* chunk_hash, const char* read_data)
+{
+	const char* at = skip_space(read_data ? read_data : "");
+	if(starts_with(at, "[M2]") == false)
+		return PARSE_ERROR_BAD_HEADER;
+	at = skip_line(at);
+
+	Macrocell_Node* nodes = NULL;
+	i32 node_size = 0;
+	i32 node_capacity = 0;
+	Parse_Error error = PARSE_ERROR_NONE;
+	while(error == PARSE_ERROR_NONE)
+	{
+		at = skip_space(at);
+		if(*at == '\0')
+			break;
+		if(*at == '#')
+		{
+			at = skip_line(at);
+			continue;
+		}
+
+		Macrocell_Node node = {0};
+		if(*at == '.' || *at == '*' || *at == '$')
+		{
+			node.level = MACROCELL_LEAF_LEVEL;
+			i32 x = 0;
+			i32 y = 0;
+			for(; *at == '.' || *at == '*' || *at == '$'; at++)
+			{
+				if(*at == '$')
+				{
+					x = 0;
+					y++;
+					continue;
+				}
+
+				if(x >= 8 || y >= 8)
+				{
+					error = PARSE_ERROR_BAD_NODE;
+					break;
+				}
+
+				if(*at == '*')
+					node.leaf |= (u64) 1 << (x + 8*y);
+				x++;
+			}
+		}
+		else
+		{
+			i64 values[5] = {0};
+			for(i32 i = 0; i < 5 && error == PARSE_ERROR_NONE; i++)
+				if(parse_i64(&at, &values[i]) == false)
+					error = PARSE_ERROR_INVALID_CAHARCTER;
+
+			//Only two state patterns are supported so there are no nodes below the leaves
+			node.level = (i32) values[0];
+			if(error == PARSE_ERROR_NONE && (values[0] <= MACROCELL_LEAF_LEVEL || values[0] > 62))
+				error = PARSE_ERROR_BAD_NODE;
+
+			for(i32 i = 0; i < 4 && error == PARSE_ERROR_NONE; i++)
+			{
+				i64 child = values[i + 1];
+				if(child < 0 || child > node_size || (child > 0 && nodes[child - 1].level != node.level - 1))
+					error = PARSE_ERROR_BAD_NODE;
+				else
+					node.children[i] = (u32) child;
+			}
+		}
+
+		at = skip_blank(at);
+		if(error == PARSE_ERROR_NONE && *at != '\n' && *at != '\0')
+			error = PARSE_ERROR_INVALID_CAHARCTER;
+
+		if(node_size >= node_capacity)
+		{
+			i32 new_capacity = node_capacity * 2 + 64;
+			nodes = (Macrocell_Node*) sure_realloc(nodes, new_capacity * (isize) sizeof(Macrocell_Node), node_capacity * (isize) sizeof(Macrocell_Node), ALLOC_TAG_FILE);
+			node_capacity = new_capacity;
+		}
+		nodes[node_size++] = node;
+	}
+
+	Pattern_Writer writer = {0};
+	writer.chunk_hash = chunk_hash;
+	if(error == PARSE_ERROR_NONE && node_size > 0)
+	{
+		i64 half = (i64) 1 << (nodes[node_size - 1].level - 1);
+		macrocell_write_node(&writer, nodes, (u32) node_size, -half + CHUNK_SIZE/2, -half + CHUNK_SIZE/2);
+	}
+
+	sure_realloc(nodes, 0, node_capacity * (isize) sizeof(Macrocell_Node), ALLOC_TAG_FILE);
+	return pattern_writer_finish(&writer, error);
 }
@@ -1,13 +1,57 @@
 #pragma once
 #include "alloc.h"
 #include "chunk_hash.h"
+#include "life.h"
+
+// This file provides loading of patterns into Chunk_Hash.
+//
+// Supported are our own text format (width and height on the first two lines then rows of X and -),
+// RLE, Life 1.06 and Macrocell (the formats of the usual pattern collections).
+// None of the loaders set cells one by one. Cells are assembled into whole chunk rows which are
+// then or-ed into the chunks, and each chunk is looked up only once per row of chunks.
+// After a pattern is loaded all neighbours of the touched chunks are inserted (like set_cell_at does)
+// so the result can be stepped right away. Rules in the headers are not applied, they can be read
+// with parse_pattern_rule and selected with life_rule_set.
+//
+// Patterns are centered on the chunk at (0, 0). RLE and our text format are centered by their
+// dimensions, Life 1.06 and Macrocell use their own coordinates (Macrocell has the center of the root at 0).
 
 typedef enum Parse_Error
 {
 	PARSE_ERROR_NONE = 0,
 	PARSE_ERROR_BAD_DIMENSIONS,
 	PARSE_ERROR_INVALID_CAHARCTER,
+	PARSE_ERROR_BAD_HEADER,
+	PARSE_ERROR_BAD_NODE,
+	PARSE_ERROR_OUT_OF_RANGE, //some cells are too far from the origin. The rest of the pattern is loaded
+	PARSE_ERROR_UNKNOWN_FORMAT,
+	PARSE_ERROR_FULL, //chunk_hash is full (see CHUNK_HASH_MAX_CHUNKS). Only the part that fit is loaded
 } Parse_Error;
 
-bool read_whole_file_alloc(const char* path, char** into);
+typedef enum Pattern_Format
+{
+	PATTERN_FORMAT_UNKNOWN = 0,
+	PATTERN_FORMAT_TEXT, //our own format
+	PATTERN_FORMAT_RLE,
+	PATTERN_FORMAT_LIFE_106,
+	PATTERN_FORMAT_MACROCELL,
+} Pattern_Format;
+
+//Reads the whole file into a null terminated buffer of alloced_size bytes (free it with sure_realloc(into, 0, alloced_size, ALLOC_TAG_FILE))
+bool read_whole_file_alloc(const char* path, char** into, isize* alloced_size);
+const char* parse_error_to_string(Parse_Error error);
+
+//Guesses the format from the first lines of the data
+Pattern_Format detect_pattern_format(const char* read_data);
+
+//Reads the rule from the header of the pattern (rule = in RLE, #R in Macrocell).
+//Returns false if there is none or it is not supported.
+bool parse_pattern_rule(const char* read_data, Life_Rule* rule);
+
+//Loads the pattern in any of the supported formats
+Parse_Error parse_pattern_into_chunks(Chunk_Hash* chunk_hash, const char* read_data);
+
 Parse_Error parse_text_into_chunks(Chunk_Hash* chunk_hash, const char* read_data);
+Parse_Error parse_rle_into_chunks(Chunk_Hash* chunk_hash, const char* read_data);
+Parse_Error parse_life_106_into_chunks(Chunk_Hash* chunk_hash, const char* read_data);
+Parse_Error parse_macrocell_into_chunks(Chunk_Hash* chunk_hash, const char* read_data);
@@ -0,0 +1,232 @@
+#include "lod.h"
+#include "perf.h"
+#include "alloc.h"
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+static i32 popcount64(u64 val)
+{
+	#ifdef _MSC_VER
+	return (i32) __popcnt64(val);
+	#else
+	return __builtin_popcountll(val);
+	#endif
+}
+
+static u64 lod_hash_pos(Vec2i pos)
+{
+	u64 hash = (u64) (u32) pos.y << 32 | (u32) pos.x;
+	hash = (hash ^ (hash >> 30)) * (u64) 0xbf58476d1ce4e5b9;
+	hash = (hash ^ (hash >> 27)) * (u64) 0x94d049bb133111eb;
+	return hash ^ (hash >> 31);
+}
+
+static u32 saturating_add(u32 a, u32 b)
+{
+	u32 sum = a + b;
+	return sum < a ? (u32) -1 : sum;
+}
+
+static void lod_level_clear(Lod_Level* level)
+{
+	level->size = 0;
+	if(level->hash != NULL)
+		memset(level->hash, 0, level->hash_capacity * sizeof(i32));
+}
+
+static void lod_level_deinit(Lod_Level* level)
+{
+	sure_realloc(level->tiles, 0, level->capacity * sizeof(Lod_Tile), ALLOC_TAG_RENDER);
+	sure_realloc(level->positions, 0, level->capacity * sizeof(Vec2i), ALLOC_TAG_RENDER);
+	sure_realloc(level->hash, 0, level->hash_capacity * sizeof(i32), ALLOC_TAG_RENDER);
+	memset(level, 0, sizeof *level);
+}
+
+static void lod_level_rehash(Lod_Level* level, i32 new_capacity)
+{
+	sure_realloc(level->hash, 0, level->hash_capacity * sizeof(i32), ALLOC_TAG_RENDER);
+	level->hash = (i32*) sure_realloc(NULL, new_capacity * sizeof(i32), 0, ALLOC_TAG_RENDER);
+	level->hash_capacity = new_capacity;
+	memset(level->hash, 0, new_capacity * sizeof(i32));
+
+	u64 mod = (u64) new_capacity - 1;
+	for(i32 i = 0; i < level->size; i++)
+	{
+		u64 slot = lod_hash_pos(level->positions[i]) & mod;
+		while(level->hash[slot] != 0)
+			slot = (slot + 1) & mod;
+		level->hash[slot] = i + 1;
+	}
+}
+
+//Returns the tile at pos inserting a zeroed one if not present
+static Lod_Tile* lod_level_get_or_insert(Lod_Level* level, Vec2i pos)
+{
+	//The tiles are few so a plain linear probing hash kept at most 25% full is enough
+	if(level->size * 4 >= level->hash_capacity)
+		lod_level_rehash(level, level->hash_capacity ? level->hash_capacity * 2 : 256);
+
+	u64 mod = (u64) level->hash_capacity - 1;
+	u64 slot = lod_hash_pos(pos) & mod;
+	for(; level->hash[slot] != 0; slot = (slot + 1) & mod)
+	{
+		i32 index = level->hash[slot] - 1;
+		if(vec_equal(level->positions[index], pos))
+			return &level->tiles[index];
+	}
+
+	if(level->size >= level->capacity)
+	{
+		i32 new_capacity = level->capacity * 2 + 64;
+		level->tiles = (Lod_Tile*) sure_realloc(level->tiles, new_capacity * sizeof(Lod_Tile), level->capacity * sizeof(Lod_Tile), ALLOC_TAG_RENDER);
+		level->positions = (Vec2i*) sure_realloc(level->positions, new_capacity * sizeof(Vec2i), level->capacity * sizeof(Vec2i), ALLOC_TAG_RENDER);
+		level->capacity = new_capacity;
+	}
+
+	i32 index = level->size++;
+	level->hash[slot] = index + 1;
+	level->positions[index] = pos;
+	memset(&level->tiles[index], 0, sizeof(Lod_Tile));
+	return &level->tiles[index];
+}
+
+void lod_init(Lod* lod)
+{
+	memset(lod, 0, sizeof *lod);
+}
+
+void lod_deinit(Lod* lod)
+{
+	for(i32 i = 0; i < LOD_MAX_LEVELS; i++)
+		lod_level_deinit(&lod->levels[i]);
+	lod->level_count = 0;
+}
+
+i32 lod_pick_level(const Lod* lod, f64 cell_pixels)
+{
+	i32 level = 0;
+	while(level + 1 < lod->level_count && cell_pixels * (f64) ((i64) CHUNK_SIZE << (level + 1)) / LOD_TILE <= 1.0)
+		level++;
+
+	return level;
+}
+
+i64 lod_texel_offset(i32 level, i32 index)
+{
+	return ((i64) CHUNK_SIZE << level) * index / LOD_TILE;
+}
+
+//The cells of a texel column within a chunk row. Texels are at most 64 cells wide so they touch at most two words.
+typedef struct Texel_Column
+{
+	i32 word;
+	u64 mask;
+	u64 next_mask; //of word + 1 (0 when not needed)
+} Texel_Column;
+
+static void lod_count_chunk(const Chunk* chunk, Lod_Tile* tile, const Texel_Column* columns)
+{
+	for(i32 ty = 0; ty < LOD_TILE; ty++)
+	{
+		u32* counts = &tile->counts[ty*LOD_TILE];
+		i32 from_y = (i32) lod_texel_offset(0, ty);
+		i32 to_y = (i32) lod_texel_offset(0, ty + 1);
+		for(i32 y = from_y; y < to_y; y++)
+		{
+			const u64* row = chunk_row(chunk, y);
+			for(i32 tx = 0; tx < LOD_TILE; tx++)
+			{
+				const Texel_Column* column = &columns[tx];
+				u32 count = (u32) popcount64(row[column->word] & column->mask);
+				if(column->next_mask)
+					count += (u32) popcount64(row[column->word + 1] & column->next_mask);
+				counts[tx] += count;
+			}
+		}
+	}
+}
+
+void lod_build(Lod* lod, const Chunk_Hash* chunk_hash)
+{
+	PERF_COUNTER();
+	static_assert(LOD_TILE % 2 == 0 && CHUNK_SIZE / LOD_TILE <= 64, "texels must be halvable and fit into a chunk row segment");
+
+	for(i32 i = 0; i < lod->level_count; i++)
+		lod_level_clear(&lod->levels[i]);
+	lod->level_count = 0;
+
+	if(chunk_hash->chunk_size == 0)
+		return;
+
+	Texel_Column columns[LOD_TILE] = {0};
+	for(i32 tx = 0; tx < LOD_TILE; tx++)
+	{
+		for(i32 x = (i32) lod_texel_offset(0, tx); x < (i32) lod_texel_offset(0, tx + 1); x++)
+		{
+			i32 index = x + CHUNK_HALO;
+			if(x == (i32) lod_texel_offset(0, tx))
+				columns[tx].word = index / 64;
+
+			if(index / 64 == columns[tx].word)
+				columns[tx].mask |= (u64) 1 << (index % 64);
+			else
+				columns[tx].next_mask |= (u64) 1 << (index % 64);
+		}
+	}
+
+	Lod_Level* base = &lod->levels[0];
+	for(i32 i = 0; i < chunk_hash->chunk_size; i++)
+	{
+		lod_count_chunk(&chunk_hash->chunks[i], lod_level_get_or_insert(base, chunk_hash->positions[i]), columns);
+	}
+	lod->level_count = 1;
+
+	//Each tile is summed 2x2 into a quadrant of its parent
+	const i32 half = LOD_TILE / 2;
+	while(lod->level_count < LOD_MAX_LEVELS && lod->levels[lod->level_count - 1].size > 1)
+	{
+		Lod_Level* below = &lod->levels[lod->level_count - 1];
+		Lod_Level* above = &lod->levels[lod->level_count];
+		for(i32 i = 0; i < below->size; i++)
+		{
+			Vec2i pos = below->positions[i];
+			const Lod_Tile* child = &below->tiles[i];
+			Lod_Tile* parent = lod_level_get_or_insert(above, vec(pos.x >> 1, pos.y >> 1));
+
+			i32 quadrant_x = (pos.x & 1) * half;
+			i32 quadrant_y = (pos.y & 1) * half;
+			for(i32 y = 0; y < half; y++)
+				for(i32 x = 0; x < half; x++)
+				{
+					const u32* counts = &child->counts[2*x + 2*y*LOD_TILE];
+					u32 sum = saturating_add(saturating_add(counts[0], counts[1]), saturating_add(counts[LOD_TILE], counts[LOD_TILE + 1]));
+					u32* into = &parent->counts[quadrant_x + x + (quadrant_y + y)*LOD_TILE];
+					*into = saturating_add(*into, sum);
+				}
+		}
+
+		lod->level_count += 1;
+	}
+}
+
+const Lod_Tile* lod_get(const Lod* lod, i32 level_index, Vec2i pos)
+{
+	if(level_index < 0 || level_index >= lod->level_count)
+		return NULL;
+
+	const Lod_Level* level = &lod->levels[level_index];
+	if(level->size == 0)
+		return NULL;
+
+	u64 mod = (u64) level->hash_capacity - 1;
+	for(u64 slot = lod_hash_pos(pos) & mod; level->hash[slot] != 0; slot = (slot + 1) & mod)
+	{
+		i32 index = level->hash[slot] - 1;
+		if(vec_equal(level->positions[index], pos))
+			return &level->tiles[index];
+	}
+
+	return NULL;
+}
@@ -0,0 +1,63 @@
+#pragma once
+#include "chunk_hash.h"
+
+// This file provides density mipmaps of the universe which are drawn instead of the cells when zoomed out.
+//
+// The universe is summarized in levels of square tiles. A tile of level 0 covers a single chunk,
+// a tile of level k covers 2^k x 2^k chunks (the tile at (x, y) has the chunks from (x << k, y << k)).
+// Every tile is a LOD_TILE x LOD_TILE grid of the number of alive cells in that part of it (texel).
+// Level 0 is counted from the chunks, every level above is built from the 4 tiles below by
+// summing each 2x2 texels into one. Tiles exist only where there are chunks so just like Chunk_Hash
+// every level is a sparse array of tiles with an open addressing hash of their indices.
+//
+// When zoomed out far enough that a texel is about a pixel the renderer picks the level where
+// that is the case and draws its tiles. That way the number of tiles drawn (and so the frame time)
+// depends on the number of pixels on the screen and not on the number of visible chunks.
+//
+// lod_build recomputes everything from the Chunk_Hash in time linear to the number of chunks
+// so it should be called only when the universe changed (and only when it is going to be drawn).
+
+#define LOD_TILE 8 /* texels per side of a tile */
+#define LOD_MAX_LEVELS 26 /* enough for any universe fitting into Chunk_Hash */
+
+typedef struct Lod_Tile
+{
+	//alive cells in each texel (saturated at UINT32_MAX). Texel (x, y) is counts[x + y*LOD_TILE]
+	u32 counts[LOD_TILE * LOD_TILE];
+} Lod_Tile;
+
+typedef struct Lod_Level
+{
+	Lod_Tile* tiles;
+	Vec2i* positions; //position of each tile (in tiles of this level)
+	i32 size;
+	i32 capacity;
+
+	//index + 1 of the tile (0 means empty slot)
+	i32* hash;
+	i32 hash_capacity;
+} Lod_Level;
+
+typedef struct Lod
+{
+	Lod_Level levels[LOD_MAX_LEVELS];
+	//number of built levels. The last one has a single tile (unless LOD_MAX_LEVELS was reached)
+	i32 level_count;
+} Lod;
+
+void lod_init(Lod* lod);
+void lod_deinit(Lod* lod);
+
+//Rebuilds all levels from the chunks of chunk_hash
+void lod_build(Lod* lod, const Chunk_Hash* chunk_hash);
+
+//Returns the tile of level at pos (in tiles of that level) or NULL if there are no chunks in it
+const Lod_Tile* lod_get(const Lod* lod, i32 level, Vec2i pos);
+
+//Returns the highest built level whose texels are at most a pixel big when a cell is cell_pixels big
+//(or level 0 if even its texels are bigger)
+i32 lod_pick_level(const Lod* lod, f64 cell_pixels);
+
+//Returns the first cell (in both x and y) of the texel at index (0 to LOD_TILE inclusive) of a tile
+//of the given level relative to the tile origin. The texels of a level 0 tile split CHUNK_SIZE as evenly as possible.
+i64 lod_texel_offset(i32 level, i32 index);
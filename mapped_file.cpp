@@ -0,0 +1,79 @@
+#include "mapped_file.h"
+#include <string.h>
+
+#if defined(_WIN32) || defined(_WIN64) || defined(__CYGWIN__)
+#include <windows.h>
+
+bool mapped_file_open(Mapped_File* mapped, const char* path)
+{
+	HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if(file == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER size = {};
+	if(GetFileSizeEx(file, &size) == false || size.QuadPart == 0)
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	//The mapping keeps the file open and the view keeps the mapping so we can close both handles
+	HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_WRITECOPY, 0, 0, NULL);
+	CloseHandle(file);
+	if(mapping == NULL)
+		return false;
+
+	void* data = MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0);
+	CloseHandle(mapping);
+	if(data == NULL)
+		return false;
+
+	mapped->data = data;
+	mapped->size = (isize) size.QuadPart;
+	return true;
+}
+
+void mapped_file_close(Mapped_File* mapped)
+{
+	if(mapped->data != NULL)
+		UnmapViewOfFile(mapped->data);
+	memset(mapped, 0, sizeof *mapped);
+}
+
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+bool mapped_file_open(Mapped_File* mapped, const char* path)
+{
+	int file = open(path, O_RDONLY);
+	if(file == -1)
+		return false;
+
+	struct stat info = {0};
+	if(fstat(file, &info) != 0 || info.st_size == 0)
+	{
+		close(file);
+		return false;
+	}
+
+	//The mapping stays valid after closing the file
+	void* data = mmap(NULL, (size_t) info.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, file, 0);
+	close(file);
+	if(data == MAP_FAILED)
+		return false;
+
+	mapped->data = data;
+	mapped->size = (isize) info.st_size;
+	return true;
+}
+
+void mapped_file_close(Mapped_File* mapped)
+{
+	if(mapped->data != NULL)
+		munmap(mapped->data, (size_t) mapped->size);
+	memset(mapped, 0, sizeof *mapped);
+}
+#endif
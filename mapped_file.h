@@ -0,0 +1,18 @@
+#pragma once
+#include "types.h"
+
+// This file provides memory mapping of whole files.
+//
+// The mapping is private (copy on write): the mapped memory can be freely written to
+// but the changes are never written back into the file. Pages are read from the file
+// only when first touched so opening even a huge file is instant.
+
+typedef struct Mapped_File
+{
+	void* data; //NULL if nothing is mapped
+	isize size;
+} Mapped_File;
+
+//Maps the whole file at path. Returns false if it could not be opened, is empty or could not be mapped.
+bool mapped_file_open(Mapped_File* mapped, const char* path);
+void mapped_file_close(Mapped_File* mapped);
@@ -1,59 +1,441 @@
 #include "perf.h"
 #include "time.h"
+#include "alloc.h"
+#include "virtual_memory.h"
 
-#ifndef MAX_PERF_COUNTERS
-#define MAX_PERF_COUNTERS 100
-#endif
+#include <mutex>
 
-static Perf_Counter* perf_counters[MAX_PERF_COUNTERS] = {0};
-static int64_t perf_counter_count = 0;
+// Every distinct pair of a site (PERF_COUNTER in code) and the node it was hit under is a node.
+// The nodes are global and registered under a lock, but the stats of each node are kept separately
+// for every thread. To find its node without locking each thread keeps a small cache from (site, parent) to node.
+//
+// The thread buffers are never freed so that the stats of finished threads stay around.
+// They are committed virtual memory so only the pages of nodes that were actually hit are ever touched.
 
-Perf_Counter_Executor::Perf_Counter_Executor(Perf_Counter* _my_counter, int64_t _line, const char* _file, const char* _function, const char* _name)
+#define PERF_CACHE_SIZE (PERF_MAX_NODES * 4)
+
+typedef struct Perf_Node
+{
+	Perf_Site* site;
+	int32_t parent;
+} Perf_Node;
+
+typedef struct Perf_Stats
+{
+	int64_t counter;
+	int64_t runs;
+	int64_t min;
+	int64_t max;
+	uint64_t histogram[PERF_HISTOGRAM_BUCKETS];
+} Perf_Stats;
+
+typedef struct Perf_Cache_Slot
+{
+	Perf_Site* site; //NULL if empty
+	int32_t parent;
+	int32_t node;
+} Perf_Cache_Slot;
+
+typedef struct Perf_Event
+{
+	int32_t node;
+	int64_t start;
+	int64_t duration;
+} Perf_Event;
+
+struct Perf_Thread
+{
+	int32_t index;
+	int32_t scope;
+
+	Perf_Event* events;
+	int64_t event_count;
+	int64_t event_capacity;
+	int64_t dropped_events;
+	int64_t trace_generation; //the trace events belong to
+
+	int32_t cache_count;
+	Perf_Cache_Slot cache[PERF_CACHE_SIZE];
+	Perf_Stats stats[PERF_MAX_NODES];
+};
+
+static std::mutex perf_mutex;
+static Perf_Node perf_nodes[PERF_MAX_NODES] = {0};
+static int32_t perf_node_count = 0;
+static Perf_Thread* perf_threads[PERF_MAX_THREADS] = {0};
+static int32_t perf_thread_count = 0;
+static thread_local Perf_Thread* perf_this_thread = NULL;
+
+static volatile bool perf_tracing = false;
+static int64_t perf_trace_generation = 0;
+static int64_t perf_trace_capacity = 0;
+static int64_t perf_trace_start_ticks = 0;
+
+static Perf_Thread* perf_thread_get()
+{
+	if(perf_this_thread != NULL)
+		return perf_this_thread;
+
+	std::unique_lock<std::mutex> lock(perf_mutex);
+	if(perf_thread_count >= PERF_MAX_THREADS)
+		return NULL;
+
+	Perf_Thread* thread = (Perf_Thread*) virtual_memory_reserve(sizeof(Perf_Thread), false);
+	if(thread == NULL || virtual_memory_commit(thread, sizeof(Perf_Thread)) == false)
+	{
+		virtual_memory_release(thread, sizeof(Perf_Thread));
+		return NULL;
+	}
+
+	alloc_stats_add(ALLOC_TAG_PERF, sizeof(Perf_Thread));
+	thread->index = perf_thread_count;
+	thread->scope = PERF_NO_SCOPE;
+	perf_threads[perf_thread_count++] = thread;
+	perf_this_thread = thread;
+	return thread;
+}
+
+static uint64_t perf_cache_hash(Perf_Site* site, int32_t parent)
+{
+	uint64_t hash = (uint64_t) site ^ ((uint64_t) (uint32_t) parent * (uint64_t) 0x9e3779b97f4a7c15);
+	return hash ^ (hash >> 29);
+}
+
+//Returns the node of site under parent or -1 if there are too many nodes
+static int32_t perf_thread_find_node(Perf_Thread* thread, Perf_Site* site, int32_t parent)
+{
+	uint64_t mask = PERF_CACHE_SIZE - 1;
+	uint64_t i = perf_cache_hash(site, parent) & mask;
+	for(; thread->cache[i].site != NULL; i = (i + 1) & mask)
+	{
+		if(thread->cache[i].site == site && thread->cache[i].parent == parent)
+			return thread->cache[i].node;
+	}
+
+	//First time on this thread. Look it up in the global nodes (or add it).
+	//A counter directly inside itself (recursion) is not measured again since that would add a new node 
+	//for every level. The outermost run already includes it.
+	int32_t node = -1;
+	{
+		std::unique_lock<std::mutex> lock(perf_mutex);
+		bool recursive = parent != PERF_NO_SCOPE && perf_nodes[parent].site == site;
+		for(int32_t j = 0; j < perf_node_count && recursive == false; j++)
+			if(perf_nodes[j].site == site && perf_nodes[j].parent == parent)
+				node = j;
+
+		if(node == -1 && recursive == false && perf_node_count < PERF_MAX_NODES)
+		{
+			node = perf_node_count++;
+			perf_nodes[node].site = site;
+			perf_nodes[node].parent = parent;
+		}
+	}
+
+	//Keep the cache at most half full so that the probing above always ends.
+	//When full we just keep locking (which only happens with more than PERF_MAX_NODES nodes).
+	if(thread->cache_count < PERF_CACHE_SIZE / 2)
+	{
+		thread->cache[i].site = site;
+		thread->cache[i].parent = parent;
+		thread->cache[i].node = node;
+		thread->cache_count += 1;
+	}
+	return node;
+}
+
+static int32_t perf_histogram_bucket(int64_t ticks)
 {
+	if(ticks < PERF_HISTOGRAM_SUB_BUCKETS)
+		return ticks < 0 ? 0 : (int32_t) ticks;
+
+	#ifdef _MSC_VER
+	unsigned long top = 0;
+	_BitScanReverse64(&top, (unsigned long long) ticks);
+	#else
+	int32_t top = 63 - __builtin_clzll((unsigned long long) ticks);
+	#endif
+
+	//3 is log2(PERF_HISTOGRAM_SUB_BUCKETS)
+	int32_t sub = (int32_t) (ticks >> (top - 3)) & (PERF_HISTOGRAM_SUB_BUCKETS - 1);
+	int32_t bucket = ((int32_t) top - 2) * PERF_HISTOGRAM_SUB_BUCKETS + sub;
+	return bucket < PERF_HISTOGRAM_BUCKETS ? bucket : PERF_HISTOGRAM_BUCKETS - 1;
+}
+
+//Returns the middle of the range of ticks falling into bucket
+static double perf_histogram_bucket_value(int32_t bucket)
+{
+	if(bucket < PERF_HISTOGRAM_SUB_BUCKETS)
+		return (double) bucket;
+
+	int32_t top = bucket / PERF_HISTOGRAM_SUB_BUCKETS + 2;
+	int32_t sub = bucket % PERF_HISTOGRAM_SUB_BUCKETS;
+	double width = (double) ((int64_t) 1 << (top - 3));
+	return (PERF_HISTOGRAM_SUB_BUCKETS + sub) * width + width / 2;
+}
+
+static void perf_trace_record(Perf_Thread* thread, int32_t node, int64_t start, int64_t duration)
+{
+	//The first event of a new trace on this thread
+	if(thread->trace_generation != perf_trace_generation)
+	{
+		int64_t capacity = perf_trace_capacity;
+		thread->events = (Perf_Event*) sure_realloc(thread->events, capacity * sizeof(Perf_Event), thread->event_capacity * sizeof(Perf_Event), ALLOC_TAG_PERF);
+		thread->event_capacity = capacity;
+		thread->event_count = 0;
+		thread->dropped_events = 0;
+		thread->trace_generation = perf_trace_generation;
+	}
+
+	if(thread->event_count < thread->event_capacity)
+	{
+		Perf_Event* event = &thread->events[thread->event_count++];
+		event->node = node;
+		event->start = start;
+		event->duration = duration;
+	}
+	else
+		thread->dropped_events += 1;
+}
+
+Perf_Counter_Executor::Perf_Counter_Executor(Perf_Site* site)
+{
+	thread = perf_thread_get();
+	node = -1;
+	parent = PERF_NO_SCOPE;
+	if(thread != NULL)
+	{
+		parent = thread->scope;
+		node = perf_thread_find_node(thread, site, parent);
+		if(node != -1)
+			thread->scope = node;
+	}
+
 	start = perf_counter();
-	my_counter = _my_counter;
-	line = _line;
-	file = _file;
-	function = _function;
-	name = _name;
 }
 
 Perf_Counter_Executor::~Perf_Counter_Executor()
 {
 	int64_t delta = perf_counter() - start;
+	if(node == -1)
+		return;
 
-	//if is a first run add itself to counters
-	//and set first run only stats
-	if(my_counter->runs == 0)
+	Perf_Stats* stats = &thread->stats[node];
+	if(stats->runs == 0 || delta < stats->min)
+		stats->min = delta;
+	if(delta > stats->max)
+		stats->max = delta;
+
+	stats->counter += delta;
+	stats->runs += 1;
+	stats->histogram[perf_histogram_bucket(delta)] += 1;
+
+	if(perf_tracing)
+		perf_trace_record(thread, node, start, delta);
+
+	thread->scope = parent;
+}
+
+int32_t perf_get_scope()
+{
+	Perf_Thread* thread = perf_thread_get();
+	return thread ? thread->scope : PERF_NO_SCOPE;
+}
+
+int32_t perf_set_scope(int32_t scope)
+{
+	Perf_Thread* thread = perf_thread_get();
+	if(thread == NULL)
+		return PERF_NO_SCOPE;
+
+	int32_t prev = thread->scope;
+	thread->scope = scope;
+	return prev;
+}
+
+//Appends node and all of its children (recursively) in the order they were registered
+static void perf_collect_node(Perf_Counter* into, int32_t* remap, int64_t* count, int32_t node, int32_t depth)
+{
+	Perf_Site* site = perf_nodes[node].site;
+	int32_t parent = perf_nodes[node].parent;
+	Perf_Counter* counter = &into[*count];
+	memset(counter, 0, sizeof *counter);
+	counter->line = site->line;
+	counter->file = site->file;
+	counter->function = site->function;
+	counter->name = site->name;
+	counter->parent = parent == PERF_NO_SCOPE ? -1 : remap[parent];
+	counter->depth = depth;
+	remap[node] = (int32_t) *count;
+	*count += 1;
+
+	for(int32_t i = 0; i < perf_thread_count; i++)
+	{
+		const Perf_Stats* stats = &perf_threads[i]->stats[node];
+		if(stats->runs == 0)
+			continue;
+
+		if(counter->threads == 0 || stats->min < counter->min)
+			counter->min = stats->min;
+		if(stats->max > counter->max)
+			counter->max = stats->max;
+
+		counter->counter += stats->counter;
+		counter->runs += stats->runs;
+		counter->threads += 1;
+		for(int32_t j = 0; j < PERF_HISTOGRAM_BUCKETS; j++)
+			counter->histogram[j] += stats->histogram[j];
+	}
+
+	for(int32_t child = node + 1; child < perf_node_count; child++)
+		if(perf_nodes[child].parent == node)
+			perf_collect_node(into, remap, count, child, depth + 1);
+}
+
+const Perf_Counter* perf_get_counters(int64_t* count)
+{
+	static Perf_Counter* counters = NULL;
+	static int32_t remap[PERF_MAX_NODES] = {0};
+
+	std::unique_lock<std::mutex> lock(perf_mutex);
+	if(counters == NULL)
+		counters = (Perf_Counter*) sure_realloc(NULL, PERF_MAX_NODES * sizeof(Perf_Counter), 0, ALLOC_TAG_PERF);
+
+	//Parents are always registered before their children
+	*count = 0;
+	for(int32_t node = 0; node < perf_node_count; node++)
+		if(perf_nodes[node].parent == PERF_NO_SCOPE)
+			perf_collect_node(counters, remap, count, node, 0);
+
+	return counters;
+}
+
+void perf_reset()
+{
+	std::unique_lock<std::mutex> lock(perf_mutex);
+	for(int32_t i = 0; i < perf_thread_count; i++)
+		memset(perf_threads[i]->stats, 0, perf_node_count * sizeof(Perf_Stats));
+}
+
+double perf_counter_get_total_running_time_s(const Perf_Counter* counter)
+{
+	return (double) counter->counter / (double) perf_counter_freq();
+}
+
+double perf_counter_get_average_running_time_s(const Perf_Counter* counter)
+{
+	if(counter->runs == 0)
+		return 0;
+	return (double) counter->counter / (double) (counter->runs * perf_counter_freq());
+}
+
+double perf_counter_get_max_running_time_s(const Perf_Counter* counter)
+{
+	return (double) counter->max / (double) perf_counter_freq();
+}
+
+double perf_counter_get_percentile_running_time_s(const Perf_Counter* counter, double percentile)
+{
+	if(counter->runs == 0)
+		return 0;
+
+	//The first bucket at which at least percentile of the runs are
+	double needed_f = percentile * (double) counter->runs;
+	uint64_t needed = (uint64_t) needed_f;
+	if((double) needed < needed_f || needed < 1)
+		needed += 1;
+
+	uint64_t seen = 0;
+	int32_t bucket = 0;
+	for(; bucket < PERF_HISTOGRAM_BUCKETS - 1; bucket++)
 	{
-		my_counter->file = file;
-		my_counter->line = line;
-		my_counter->function = function;
-		my_counter->name = name;
-		perf_counters[perf_counter_count++] = my_counter;
+		seen += counter->histogram[bucket];
+		if(seen >= needed)
+			break;
 	}
-	
-	//Add cumulative stats
-	my_counter->counter += delta;
-	my_counter->runs += 1;
+
+	//The bucket middle can be outside of what was actually measured
+	double ticks = perf_histogram_bucket_value(bucket);
+	if(ticks < (double) counter->min)
+		ticks = (double) counter->min;
+	if(ticks > (double) counter->max)
+		ticks = (double) counter->max;
+
+	return ticks / (double) perf_counter_freq();
 }
 
-const Perf_Counter* const* perf_get_counters()
+void perf_trace_start(int64_t max_events_per_thread)
 {
-	return perf_counters;
+	std::unique_lock<std::mutex> lock(perf_mutex);
+	perf_trace_capacity = max_events_per_thread > 0 ? max_events_per_thread : 0;
+	perf_trace_generation += 1;
+	perf_trace_start_ticks = perf_counter();
+	perf_tracing = true;
 }
 
-int64_t perf_get_counter_count()
+void perf_trace_stop()
 {
-	return perf_counter_count;
+	perf_tracing = false;
 }
 
-double perf_counter_get_total_running_time_s(Perf_Counter counter)
+bool perf_trace_is_running()
 {
-	return (double) counter.counter / (double) perf_counter_freq();
+	return perf_tracing;
 }
 
-double perf_counter_get_average_running_time_s(Perf_Counter counter)
+static void perf_write_json_string(FILE* file, const char* str)
 {
-	return (double) counter.counter / (double) (counter.runs * perf_counter_freq());
-}
\ No newline at end of file
+	fputc('"', file);
+	for(const char* c = str ? str : ""; *c != '\0'; c++)
+	{
+		if(*c == '"' || *c == '\\')
+			fprintf(file, "\\%c", *c);
+		else if((unsigned char) *c < 0x20)
+			fprintf(file, "\\u%04x", (unsigned) (unsigned char) *c);
+		else
+			fputc(*c, file);
+	}
+	fputc('"', file);
+}
+
+bool perf_trace_export(const char* path)
+{
+	FILE* file = fopen(path, "wb");
+	if(file == NULL)
+		return false;
+
+	std::unique_lock<std::mutex> lock(perf_mutex);
+	double ticks_to_us = 1e6 / (double) perf_counter_freq();
+
+	fprintf(file, "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [");
+	bool first = true;
+	for(int32_t i = 0; i < perf_thread_count; i++)
+	{
+		Perf_Thread* thread = perf_threads[i];
+		if(thread->trace_generation != perf_trace_generation)
+			continue;
+
+		fprintf(file, "%s\n{\"ph\": \"M\", \"name\": \"thread_name\", \"pid\": 1, \"tid\": %d, \"args\": {\"name\": \"thread %d\"}}",
+			first ? "" : ",", (int) thread->index, (int) thread->index);
+		first = false;
+
+		if(thread->dropped_events > 0)
+			fprintf(stderr, "perf trace: thread %d dropped %lld events\n", (int) thread->index, (long long) thread->dropped_events);
+
+		for(int64_t j = 0; j < thread->event_count; j++)
+		{
+			Perf_Event event = thread->events[j];
+			Perf_Site* site = perf_nodes[event.node].site;
+			fprintf(file, ",\n{\"ph\": \"X\", \"name\": ");
+			perf_write_json_string(file, site->name ? site->name : site->function);
+			fprintf(file, ", \"cat\": ");
+			perf_write_json_string(file, site->function);
+			fprintf(file, ", \"pid\": 1, \"tid\": %d, \"ts\": %.3lf, \"dur\": %.3lf}",
+				(int) thread->index, (double) (event.start - perf_trace_start_ticks) * ticks_to_us, (double) event.duration * ticks_to_us);
+		}
+	}
+	fprintf(file, "\n]}\n");
+
+	bool ok = ferror(file) == 0;
+	ok = fclose(file) == 0 && ok;
+	return ok;
+}
@@ -2,54 +2,118 @@
 #include <stdint.h>
 
 // This file provides a simple interface for measuring performance of a scope.
-// Simply write PERF_COUNTER() into a function and its runtime will 
-// automatically be measured. 
+// Simply write PERF_COUNTER() into a function and its runtime will
+// automatically be measured.
 //
-// The gathered statistics can be retrieved by calling the get_counters() which 
-// is a simple pointer to an array of Perf_Counter structs. 
+// Counters nest. A counter hit while another one is running on the same thread is its child
+// so the same scope reached from different places is measured separately (for example
+// "step" > "single chunk" > "life"). Workers of a Thread_Pool continue the nesting of the
+// thread that called thread_pool_run.
+//
+// Every thread records into its own buffers so counters can be hit from any number of threads
+// without any locking (only the first run of a counter under a given parent on a thread locks).
+// Besides the total and mean we also keep a histogram of the run times from which percentiles
+// are estimated (to within about 6%).
+//
+// Optionally every run can also be recorded as an event (perf_trace_start) and exported in the
+// Chrome trace format (perf_trace_export) which can be viewed in chrome://tracing or ui.perfetto.dev.
+// That is what you want when looking for a single slow frame instead of averages.
+//
+// The gathered statistics can be retrieved by calling perf_get_counters() which merges the buffers
+// of all threads into an array of Perf_Counter structs.
+
+#define PERF_MAX_NODES 256 /* max number of distinct counter and parent pairs */
+#define PERF_MAX_THREADS 256 /* threads after this many are not measured */
+
+//Run times below 8 ticks have a bucket each. Above that each power of two is split into 8 buckets.
+#define PERF_HISTOGRAM_SUB_BUCKETS 8
+#define PERF_HISTOGRAM_BUCKETS (46 * PERF_HISTOGRAM_SUB_BUCKETS) /* up to 2^48 ticks (~3 days in ns) */
+
+#define PERF_NO_SCOPE -1
 
 struct Perf_Counter
 {
-	int64_t counter;
+	int64_t counter; //total ticks
 	int64_t runs;
+	int64_t min; //ticks of the fastest run
+	int64_t max; //ticks of the slowest run
 	int64_t line;
 	const char* file;
 	const char* function;
 	const char* name;
+
+	int32_t parent; //index of the parent in the array returned by perf_get_counters or -1
+	int32_t depth; //0 for counters without parent
+	int32_t threads; //number of threads that ran the counter
+	uint64_t histogram[PERF_HISTOGRAM_BUCKETS];
 };
 
-//Returns a pointer to the gathered statistics. The array has perf_get_counter_count() size.
-const Perf_Counter* const* perf_get_counters();
-//Returns the number of currently registered statistics
-int64_t perf_get_counter_count();
+//Merges the statistics of all threads and returns them in an array of *count counters.
+//Children always come right after their parent so the tree can be printed just by indenting by depth.
+//The array stays valid untill the next call.
+//Values of counters running on other threads at the time might be slightly off.
+const Perf_Counter* perf_get_counters(int64_t* count);
+
+//Clears the statistics of all counters (but keeps them registered)
+void perf_reset();
 
 //Return the total running time of the counter in seconds
-double perf_counter_get_total_running_time_s(Perf_Counter counter);
+double perf_counter_get_total_running_time_s(const Perf_Counter* counter);
 
 //Return the average running time of the counter in seconds
-double perf_counter_get_average_running_time_s(Perf_Counter counter);
+double perf_counter_get_average_running_time_s(const Perf_Counter* counter);
+
+//Return the running time of the slowest run in seconds
+double perf_counter_get_max_running_time_s(const Perf_Counter* counter);
+
+//Returns an estimate of the running time under which percentile (0 to 1) of the runs finished in seconds
+double perf_counter_get_percentile_running_time_s(const Perf_Counter* counter, double percentile);
+
+//Starts recording every run of every counter as an event. Each thread records at most max_events_per_thread
+//events since the start, the rest is dropped. Discards the events of the previous trace.
+void perf_trace_start(int64_t max_events_per_thread);
+void perf_trace_stop();
+bool perf_trace_is_running();
+
+//Writes the events of the last trace to path in the Chrome trace JSON format. Returns false if the file cannot be written.
+//Should not be called while other threads are recording.
+bool perf_trace_export(const char* path);
+
+//Returns the counter currently running on this thread (PERF_NO_SCOPE if none).
+int32_t perf_get_scope();
+//Makes the counters hit on this thread children of scope (a value from perf_get_scope). Returns the previous scope.
+int32_t perf_set_scope(int32_t scope);
 
 //Creates a performance counter
 #define PERF_COUNTER(...) \
-		static Perf_Counter CONCAT(__perf_counter__, __LINE__) = {0}; \
-		Perf_Counter_Executor CONCAT(__perf_executor__, __LINE__)(&CONCAT(__perf_counter__, __LINE__), __LINE__, __FILE__, __FUNCTION__, ##__VA_ARGS__)
+		static Perf_Site CONCAT(__perf_site__, __LINE__) = {__LINE__, __FILE__, __FUNCTION__, ##__VA_ARGS__}; \
+		Perf_Counter_Executor CONCAT(__perf_executor__, __LINE__)(&CONCAT(__perf_site__, __LINE__))
 
 #define CONCAT_(a, b) a ## b
 #define CONCAT(a, b) CONCAT_(a, b)
 
 #ifndef _MSC_VER
 #define __FUNCTION__ __func__
-#endif 
+#endif
 
-struct Perf_Counter_Executor
+//The place in code of a counter
+struct Perf_Site
 {
-	Perf_Counter* my_counter;
-	int64_t start;
 	int64_t line;
 	const char* file;
 	const char* function;
 	const char* name;
-	
-	Perf_Counter_Executor(Perf_Counter* _my_counter, int64_t _line, const char* _file, const char* _function = nullptr, const char* _name = nullptr);
+};
+
+struct Perf_Thread;
+
+struct Perf_Counter_Executor
+{
+	Perf_Thread* thread;
+	int64_t start;
+	int32_t node;
+	int32_t parent;
+
+	Perf_Counter_Executor(Perf_Site* site);
 	~Perf_Counter_Executor();
-};
\ No newline at end of file
+};
@@ -0,0 +1,194 @@
+#define _CRT_SECURE_NO_WARNINGS
+#include "snapshot.h"
+#include "alloc.h"
+#include "perf.h"
+
+#if defined(_WIN32) || defined(_WIN64) || defined(__CYGWIN__)
+#include <windows.h>
+#endif
+
+const char* snapshot_error_to_string(Snapshot_Error error)
+{
+	switch(error)
+	{
+		case SNAPSHOT_ERROR_NONE: return "none";
+		case SNAPSHOT_ERROR_OPEN: return "could not open file";
+		case SNAPSHOT_ERROR_WRITE: return "could not write file";
+		case SNAPSHOT_ERROR_BAD_MAGIC: return "not a snapshot";
+		case SNAPSHOT_ERROR_BAD_VERSION: return "unsupported version";
+		case SNAPSHOT_ERROR_BAD_LAYOUT: return "saved by an incompatible build";
+		case SNAPSHOT_ERROR_CORRUPTED: return "corrupted";
+		case SNAPSHOT_ERROR_OUT_OF_MEMORY: return "out of memory";
+		default: return "unknown error";
+	}
+}
+
+static i64 align_up(i64 value, i64 to)
+{
+	return (value + to - 1) / to * to;
+}
+
+static bool write_zeros(FILE* file, i64 count)
+{
+	static const u8 zeros[SNAPSHOT_ALIGN] = {0};
+	assert(0 <= count && count <= SNAPSHOT_ALIGN);
+	return count == 0 || fwrite(zeros, 1, (size_t) count, file) == (size_t) count;
+}
+
+//Replaces to with from (rename does not replace existing files on Windows)
+static bool replace_file(const char* from, const char* to)
+{
+	#if defined(_WIN32) || defined(_WIN64) || defined(__CYGWIN__)
+	return MoveFileExA(from, to, MOVEFILE_REPLACE_EXISTING) != 0;
+	#else
+	return rename(from, to) == 0;
+	#endif
+}
+
+Snapshot_Error snapshot_save(const Chunk_Hash* chunk_hash, i64 generation, const char* path)
+{
+	PERF_COUNTER("snapshot save");
+	i64 chunk_count = chunk_hash->chunk_size;
+	i64 hash_capacity = chunk_hash->hash_capacity;
+	i64 chunks_bytes = chunk_count * (i64) sizeof(Chunk);
+	i64 positions_bytes = chunk_count * (i64) sizeof(Vec2i);
+	i64 hash_bytes = hash_capacity * (i64) sizeof(Hash_Slot);
+	i64 tag_bytes = hash_capacity;
+
+	Snapshot_Header header = {0};
+	memcpy(header.magic, SNAPSHOT_MAGIC, sizeof SNAPSHOT_MAGIC);
+	header.version = SNAPSHOT_VERSION;
+	header.chunk_size = CHUNK_SIZE;
+	header.chunk_bytes = sizeof(Chunk);
+	header.slot_bytes = sizeof(Hash_Slot);
+	header.generation = generation;
+	header.chunk_count = chunk_count;
+	header.hash_capacity = hash_capacity;
+	header.chunks_offset = align_up(sizeof header, SNAPSHOT_ALIGN);
+	header.positions_offset = align_up(header.chunks_offset + chunks_bytes, SNAPSHOT_ALIGN);
+	header.hash_offset = align_up(header.positions_offset + positions_bytes, SNAPSHOT_ALIGN);
+	header.tags_offset = align_up(header.hash_offset + hash_bytes, SNAPSHOT_ALIGN);
+
+	char temp_path[1024] = "";
+	if(snprintf(temp_path, sizeof temp_path, "%s.tmp", path) >= (int) sizeof temp_path)
+		return SNAPSHOT_ERROR_OPEN;
+
+	FILE* file = fopen(temp_path, "wb");
+	if(file == NULL)
+		return SNAPSHOT_ERROR_OPEN;
+
+	bool ok = fwrite(&header, sizeof header, 1, file) == 1;
+	ok = ok && write_zeros(file, header.chunks_offset - (i64) sizeof header);
+	ok = ok && (chunk_count == 0 || fwrite(chunk_hash->chunks, sizeof(Chunk), (size_t) chunk_count, file) == (size_t) chunk_count);
+	ok = ok && write_zeros(file, header.positions_offset - header.chunks_offset - chunks_bytes);
+	ok = ok && (chunk_count == 0 || fwrite(chunk_hash->positions, sizeof(Vec2i), (size_t) chunk_count, file) == (size_t) chunk_count);
+	ok = ok && write_zeros(file, header.hash_offset - header.positions_offset - positions_bytes);
+	ok = ok && (hash_bytes == 0 || fwrite(chunk_hash->hash, sizeof(Hash_Slot), (size_t) hash_capacity, file) == (size_t) hash_capacity);
+	ok = ok && write_zeros(file, header.tags_offset - header.hash_offset - hash_bytes);
+	ok = ok && (tag_bytes == 0 || fwrite(chunk_hash->tags, 1, (size_t) tag_bytes, file) == (size_t) tag_bytes);
+	ok = (fclose(file) == 0) && ok;
+
+	if(ok == false || replace_file(temp_path, path) == false)
+	{
+		remove(temp_path);
+		return SNAPSHOT_ERROR_WRITE;
+	}
+
+	return SNAPSHOT_ERROR_NONE;
+}
+
+static Snapshot_Error snapshot_validate(const Mapped_File* mapped)
+{
+	if(mapped->size < (isize) sizeof(Snapshot_Header))
+		return SNAPSHOT_ERROR_BAD_MAGIC;
+
+	const Snapshot_Header* header = (const Snapshot_Header*) mapped->data;
+	if(memcmp(header->magic, SNAPSHOT_MAGIC, sizeof SNAPSHOT_MAGIC) != 0)
+		return SNAPSHOT_ERROR_BAD_MAGIC;
+	if(header->version != SNAPSHOT_VERSION)
+		return SNAPSHOT_ERROR_BAD_VERSION;
+	if(header->chunk_size != CHUNK_SIZE || header->chunk_bytes != sizeof(Chunk) || header->slot_bytes != sizeof(Hash_Slot))
+		return SNAPSHOT_ERROR_BAD_LAYOUT;
+
+	i64 count = header->chunk_count;
+	i64 capacity = header->hash_capacity;
+	if(header->generation < 0 || count < 0 || count > CHUNK_HASH_MAX_CHUNKS || capacity < 0 || capacity > INT32_MAX)
+		return SNAPSHOT_ERROR_CORRUPTED;
+
+	//the hash has to be a power of two number of whole groups with the fullness chunk_hash_insert keeps
+	//(a hash without any empty slot would make lookups loop forever)
+	if((capacity & (capacity - 1)) != 0 || (count > 0 && (capacity < CHUNK_HASH_GROUP || count > (i64) (capacity * CHUNK_HASH_MAX_FULLNESS))))
+		return SNAPSHOT_ERROR_CORRUPTED;
+
+	i64 chunks_end = header->chunks_offset + count * (i64) sizeof(Chunk);
+	i64 positions_end = header->positions_offset + count * (i64) sizeof(Vec2i);
+	i64 hash_end = header->hash_offset + capacity * (i64) sizeof(Hash_Slot);
+	i64 tags_end = header->tags_offset + capacity;
+	if(header->chunks_offset < (i64) sizeof(Snapshot_Header) || header->chunks_offset % SNAPSHOT_ALIGN != 0
+		|| header->positions_offset < chunks_end || header->positions_offset % SNAPSHOT_ALIGN != 0
+		|| header->hash_offset < positions_end || header->hash_offset % SNAPSHOT_ALIGN != 0
+		|| header->tags_offset < hash_end || header->tags_offset % SNAPSHOT_ALIGN != 0
+		|| tags_end > mapped->size)
+		return SNAPSHOT_ERROR_CORRUPTED;
+
+	//A bad slot would make us read out of bounds later so we check them all.
+	//They are a small fraction of the file. Slots of empty tags are never read.
+	//Each chunk has to be at the position of its slot.
+	const Vec2i* positions = (const Vec2i*) ((const u8*) mapped->data + header->positions_offset);
+	const Hash_Slot* hash = (const Hash_Slot*) ((const u8*) mapped->data + header->hash_offset);
+	const u8* tags = (const u8*) mapped->data + header->tags_offset;
+	i64 used_slots = 0;
+	for(i64 i = 0; i < capacity; i++)
+	{
+		if(tags[i] == CHUNK_HASH_TAG_EMPTY)
+			continue;
+
+		if(tags[i] != chunk_hash_tag(hash[i].pos) || hash[i].chunk == 0 || hash[i].chunk > (u64) count)
+			return SNAPSHOT_ERROR_CORRUPTED;
+		if(vec_equal(positions[hash[i].chunk - 1], hash[i].pos) == false)
+			return SNAPSHOT_ERROR_CORRUPTED;
+		used_slots += 1;
+	}
+
+	if(used_slots != count)
+		return SNAPSHOT_ERROR_CORRUPTED;
+
+	return SNAPSHOT_ERROR_NONE;
+}
+
+Snapshot_Error snapshot_load(Chunk_Hash* chunk_hash, i64* generation, const char* path)
+{
+	PERF_COUNTER("snapshot load");
+	Mapped_File mapped = {0};
+	if(mapped_file_open(&mapped, path) == false)
+		return SNAPSHOT_ERROR_OPEN;
+
+	Snapshot_Error error = snapshot_validate(&mapped);
+	if(error != SNAPSHOT_ERROR_NONE)
+	{
+		mapped_file_close(&mapped);
+		return error;
+	}
+
+	Snapshot_Header header = *(const Snapshot_Header*) mapped.data;
+	chunk_hash_deinit(chunk_hash);
+	if(generation != NULL)
+		*generation = header.generation;
+
+	//Nothing to use in place
+	if(header.chunk_count == 0)
+	{
+		mapped_file_close(&mapped);
+		return SNAPSHOT_ERROR_NONE;
+	}
+
+	u8* data = (u8*) mapped.data;
+	Chunk* chunks = (Chunk*) (data + header.chunks_offset);
+	Vec2i* positions = (Vec2i*) (data + header.positions_offset);
+	Hash_Slot* hash = (Hash_Slot*) (data + header.hash_offset);
+	u8* tags = data + header.tags_offset;
+	if(chunk_hash_map(chunk_hash, mapped, chunks, positions, (i32) header.chunk_count, hash, tags, (i32) header.hash_capacity) == false)
+		return SNAPSHOT_ERROR_OUT_OF_MEMORY;
+
+	return SNAPSHOT_ERROR_NONE;
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include "chunk_hash.h"
+
+// This file provides saving and loading of the whole universe (a Chunk_Hash plus the generation number).
+//
+// The snapshot is just the header followed by the raw chunks array, their positions, the raw Hash_Slot array and the tags of the slots
+// exactly as they are in memory (all aligned to SNAPSHOT_ALIGN). Loading memory maps the file and
+// points the Chunk_Hash straight into it so there is no parsing or copying at all. The pages are read
+// by the OS only when the step first touches them. The only work done up front is allocating the
+// Chunk_Meta array and linking the neighbours (8 lookups per chunk).
+//
+// The mapping is copy on write so the loaded hash can be stepped and edited normally. Once it needs to
+// grow it is moved into our own memory (see chunk_hash.h).
+//
+// Because we dump the memory as is the snapshot is only loadable on machines with the same endianness
+// and only by builds with the same CHUNK_SIZE and struct layouts (all of which is checked in the header).
+// Saving writes into a temporary file first and then renames it so a crash during saving never
+// destroys the previous snapshot. (On Windows a snapshot cannot be replaced while it is loaded.)
+
+#define SNAPSHOT_MAGIC		"GOLSNAP"
+#define SNAPSHOT_VERSION	4
+#define SNAPSHOT_ALIGN		64
+
+typedef struct Snapshot_Header
+{
+	char magic[8]; //SNAPSHOT_MAGIC including the null terminator
+	u32 version;
+	u32 chunk_size;  //CHUNK_SIZE
+	u32 chunk_bytes; //sizeof(Chunk)
+	u32 slot_bytes;  //sizeof(Hash_Slot)
+
+	i64 generation;
+	i64 chunk_count;
+	i64 hash_capacity;
+
+	//offsets from the start of the file
+	i64 chunks_offset;
+	i64 positions_offset;
+	i64 hash_offset;
+	i64 tags_offset;
+} Snapshot_Header;
+
+typedef enum Snapshot_Error
+{
+	SNAPSHOT_ERROR_NONE = 0,
+	SNAPSHOT_ERROR_OPEN,
+	SNAPSHOT_ERROR_WRITE,
+	SNAPSHOT_ERROR_BAD_MAGIC,
+	SNAPSHOT_ERROR_BAD_VERSION,
+	SNAPSHOT_ERROR_BAD_LAYOUT, //written by a build with different CHUNK_SIZE or struct layouts
+	SNAPSHOT_ERROR_CORRUPTED,
+	SNAPSHOT_ERROR_OUT_OF_MEMORY,
+} Snapshot_Error;
+
+const char* snapshot_error_to_string(Snapshot_Error error);
+
+Snapshot_Error snapshot_save(const Chunk_Hash* chunk_hash, i64 generation, const char* path);
+
+//Replaces the content of chunk_hash with the snapshot and writes its generation into generation (if not NULL).
+//On error chunk_hash is left untouched (except for SNAPSHOT_ERROR_OUT_OF_MEMORY after which it is empty).
+Snapshot_Error snapshot_load(Chunk_Hash* chunk_hash, i64* generation, const char* path);
@@ -0,0 +1,677 @@
+#include "soup_search.h"
+#include "alloc.h"
+#include "life.h"
+#include "perf.h"
+#include "time.h"
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#define SOUP_STRIPS ((SOUP_MAX_OBJECT + 4) / 5) /* strips of 5 rows of the extended Wechsler format */
+#define SOUP_POPULATION_RING (SOUP_SEARCH_POPULATION_WINDOW + SOUP_SEARCH_MAX_PERIOD)
+#define SOUP_PREFIX_SIZE 24 /* the longest prefix of a census code ("xs<cells>_") */
+
+typedef struct Soup_Worker
+{
+	Chunk_Hash chunk_hashes[3];
+
+	//alive cells of the stable soup and the union find parents used to group them into objects
+	Vec2i* cells;
+	i32 cell_capacity;
+	i32* parents;
+	i32 parent_capacity;
+
+	//cells of the object being classified
+	Vec2i* object_cells;
+	i32 object_capacity;
+
+	//the best encoding of every phase of the object being classified (without the prefix)
+	char phase_codes[SOUP_SEARCH_MAX_PERIOD + 1][SOUP_CODE_SIZE - SOUP_PREFIX_SIZE];
+
+	//populations of the last steps of the soup (a ring)
+	i64 populations[SOUP_POPULATION_RING];
+
+	Soup_Census census;
+	i64 soups;
+	i64 stable_soups;
+	i64 generations;
+	i64 objects;
+} Soup_Worker;
+
+typedef struct Soup_Search
+{
+	const Soup_Search_Options* options;
+	Soup_Worker* workers; //one per thread
+	volatile i64 next_soup;
+} Soup_Search;
+
+void soup_search_default_options(Soup_Search_Options* options)
+{
+	memset(options, 0, sizeof *options);
+	options->seed = 1;
+	options->soup_size = SOUP_SEARCH_SIZE;
+	options->soup_density = SOUP_SEARCH_DENSITY;
+	options->step_generations = SOUP_SEARCH_STEP_GENERATIONS;
+	options->max_generations = SOUP_SEARCH_MAX_GENERATIONS;
+	options->max_period = SOUP_SEARCH_MAX_PERIOD;
+}
+
+static u64 random_u64(u64* state)
+{
+	//splitmix64
+	u64 z = (*state += (u64) 0x9e3779b97f4a7c15);
+	z = (z ^ (z >> 30)) * (u64) 0xbf58476d1ce4e5b9;
+	z = (z ^ (z >> 27)) * (u64) 0x94d049bb133111eb;
+	return z ^ (z >> 31);
+}
+
+void soup_search_generate(Chunk_Hash* chunk_hash, const Soup_Search_Options* options, i64 index)
+{
+	//Every soup gets its own stream starting from a hash of the seed and its index
+	u64 state = options->seed;
+	state = random_u64(&state) + (u64) index * (u64) 0xd1b54a32d192ed03;
+	state = random_u64(&state);
+
+	i32 size = options->soup_size;
+	for(i32 y = 0; y < size; y++)
+		for(i32 x = 0; x < size; x++)
+			if(random_u64(&state) % 100 < (u64) options->soup_density)
+				set_cell_at(chunk_hash, vec(x - size/2, y - size/2), true);
+}
+
+static i32 lowest_set_bit(u64 mask)
+{
+	#ifdef _MSC_VER
+	unsigned long index = 0;
+	_BitScanForward64(&index, mask);
+	return (i32) index;
+	#else
+	return __builtin_ctzll(mask);
+	#endif
+}
+
+//Writes the alive cells of chunk_hash into cells (growing it when needed) and returns their count
+static i32 soup_collect_cells(const Chunk_Hash* chunk_hash, Vec2i** cells, i32* capacity)
+{
+	i32 count = 0;
+	for(i32 i = 0; i < chunk_hash->chunk_size; i++)
+	{
+		Vec2i origin = vec(chunk_hash->positions[i].x * CHUNK_SIZE, chunk_hash->positions[i].y * CHUNK_SIZE);
+		for(i32 y = 0; y < CHUNK_SIZE; y++)
+		{
+			const u64* row = chunk_row(&chunk_hash->chunks[i], y);
+			for(i32 x = 0; x < CHUNK_SIZE; x += 64)
+			{
+				i32 bits = CHUNK_SIZE - x < 64 ? CHUNK_SIZE - x : 64;
+				for(u64 word = chunk_row_get_bits(row, x, bits); word != 0; word &= word - 1)
+				{
+					if(count >= *capacity)
+					{
+						i32 new_capacity = *capacity * 2 + 64;
+						*cells = (Vec2i*) sure_realloc(*cells, new_capacity * sizeof(Vec2i), *capacity * sizeof(Vec2i), ALLOC_TAG_SEARCH);
+						*capacity = new_capacity;
+					}
+
+					(*cells)[count++] = vec(origin.x + x + lowest_set_bit(word), origin.y + y);
+				}
+			}
+		}
+	}
+
+	return count;
+}
+
+static void census_add(Soup_Census* census, const char* code, i64 count)
+{
+	for(i32 i = 0; i < census->size; i++)
+	{
+		if(strcmp(census->entries[i].code, code) == 0)
+		{
+			census->entries[i].count += count;
+			return;
+		}
+	}
+
+	if(census->size >= census->capacity)
+	{
+		i32 new_capacity = census->capacity * 2 + 16;
+		census->entries = (Census_Entry*) sure_realloc(census->entries, new_capacity * sizeof(Census_Entry), census->capacity * sizeof(Census_Entry), ALLOC_TAG_SEARCH);
+		census->capacity = new_capacity;
+	}
+
+	Census_Entry* entry = &census->entries[census->size++];
+	memset(entry, 0, sizeof *entry);
+	memcpy(entry->code, code, strlen(code) + 1);
+	entry->count = count;
+}
+
+void soup_census_deinit(Soup_Census* census)
+{
+	sure_realloc(census->entries, 0, census->capacity * sizeof(Census_Entry), ALLOC_TAG_SEARCH);
+	memset(census, 0, sizeof *census);
+}
+
+static int census_entry_compare(const void* a, const void* b)
+{
+	const Census_Entry* entry_a = (const Census_Entry*) a;
+	const Census_Entry* entry_b = (const Census_Entry*) b;
+	if(entry_a->count != entry_b->count)
+		return entry_a->count > entry_b->count ? -1 : 1;
+	return strcmp(entry_a->code, entry_b->code);
+}
+
+//Shorter codes come first and then alphabetically
+static bool code_is_before(const char* a, const char* b)
+{
+	size_t length_a = strlen(a);
+	size_t length_b = strlen(b);
+	if(length_a != length_b)
+		return length_a < length_b;
+	return strcmp(a, b) < 0;
+}
+
+//Writes the extended Wechsler format of the strips (each column of a strip is a 5 bit value with the top row in the lowest bit).
+//Returns false if it does not fit into size chars (including the null terminator).
+static bool encode_wechsler(char* out, isize size, u8 strips[SOUP_STRIPS][SOUP_MAX_OBJECT], i32 strip_count, i32 width)
+{
+	static const char digits[] = "0123456789abcdefghijklmnopqrstuvwxyz";
+	isize length = 0;
+	for(i32 s = 0; s < strip_count; s++)
+	{
+		if(s > 0)
+		{
+			if(length + 1 >= size)
+				return false;
+			out[length++] = 'z';
+		}
+
+		//the zeros at the end of a strip are left out
+		i32 end = width;
+		while(end > 0 && strips[s][end - 1] == 0)
+			end--;
+
+		for(i32 x = 0; x < end; )
+		{
+			if(length + 2 >= size)
+				return false;
+
+			if(strips[s][x] != 0)
+			{
+				out[length++] = digits[strips[s][x]];
+				x++;
+				continue;
+			}
+
+			//0 is a single zero, w two, x three and y followed by a digit 4 to 39
+			i32 run = 0;
+			while(x + run < end && strips[s][x + run] == 0 && run < 39)
+				run++;
+
+			if(run == 1)
+				out[length++] = '0';
+			else if(run == 2)
+				out[length++] = 'w';
+			else if(run == 3)
+				out[length++] = 'x';
+			else
+			{
+				out[length++] = 'y';
+				out[length++] = digits[run - 4];
+			}
+			x += run;
+		}
+	}
+
+	out[length] = '\0';
+	return true;
+}
+
+//Writes the first encoding of the cells in all 8 rotations and reflections into out.
+//Returns false if the cells are too big for it (or for size chars).
+static bool encode_object(char* out, isize size, const Vec2i* cells, i32 cell_count)
+{
+	if(cell_count == 0)
+	{
+		out[0] = '\0';
+		return true;
+	}
+
+	Vec2i min = cells[0];
+	Vec2i max = cells[0];
+	for(i32 i = 1; i < cell_count; i++)
+	{
+		if(min.x > cells[i].x) min.x = cells[i].x;
+		if(min.y > cells[i].y) min.y = cells[i].y;
+		if(max.x < cells[i].x) max.x = cells[i].x;
+		if(max.y < cells[i].y) max.y = cells[i].y;
+	}
+
+	i32 width = max.x - min.x + 1;
+	i32 height = max.y - min.y + 1;
+	if(width > SOUP_MAX_OBJECT || height > SOUP_MAX_OBJECT)
+		return false;
+
+	bool found = false;
+	char encoded[SOUP_CODE_SIZE] = "";
+	u8 strips[SOUP_STRIPS][SOUP_MAX_OBJECT];
+	for(i32 orientation = 0; orientation < 8; orientation++)
+	{
+		bool transposed = orientation >= 4;
+		i32 oriented_width = transposed ? height : width;
+		i32 oriented_height = transposed ? width : height;
+		i32 strip_count = (oriented_height + 4) / 5;
+		for(i32 s = 0; s < strip_count; s++)
+			memset(strips[s], 0, (size_t) oriented_width);
+
+		for(i32 i = 0; i < cell_count; i++)
+		{
+			i32 x = cells[i].x - min.x;
+			i32 y = cells[i].y - min.y;
+			if(orientation & 1) x = width - 1 - x;
+			if(orientation & 2) y = height - 1 - y;
+			if(transposed)
+			{
+				i32 temp = x;
+				x = y;
+				y = temp;
+			}
+
+			strips[y / 5][x] |= (u8) (1 << (y % 5));
+		}
+
+		if(encode_wechsler(encoded, size < SOUP_CODE_SIZE ? size : SOUP_CODE_SIZE, strips, strip_count, oriented_width) == false)
+			continue;
+
+		if(found == false || code_is_before(encoded, out))
+			strcpy(out, encoded);
+		found = true;
+	}
+
+	return found;
+}
+
+//Writes the census code of an object with the given period and offset in which the encoding of its first phase is encoded
+static void make_object_code(char* code, const char* encoded, i64 population, i64 period, Vec2i offset)
+{
+	if(period == 1 && offset.x == 0 && offset.y == 0)
+		snprintf(code, SOUP_CODE_SIZE, "xs%lld_%s", (lld) population, encoded);
+	else if(offset.x == 0 && offset.y == 0)
+		snprintf(code, SOUP_CODE_SIZE, "xp%lld_%s", (lld) period, encoded);
+	else
+		snprintf(code, SOUP_CODE_SIZE, "xq%lld_%s", (lld) period, encoded);
+}
+
+void soup_object_code(char* code, const Vec2i* cells, i32 cell_count, i64 period, Vec2i offset)
+{
+	char encoded[SOUP_CODE_SIZE - SOUP_PREFIX_SIZE] = "";
+	if(encode_object(encoded, sizeof encoded, cells, cell_count))
+		make_object_code(code, encoded, cell_count, period, offset);
+	else
+		strcpy(code, SOUP_CODE_LARGE);
+}
+
+const char* soup_object_name(const char* code)
+{
+	static const char* names[][2] = {
+		{"xs4_33", "block"},
+		{"xp2_7", "blinker"},
+		{"xs6_696", "beehive"},
+		{"xq4_153", "glider"},
+		{"xs7_2596", "loaf"},
+		{"xs5_253", "boat"},
+		{"xs6_356", "ship"},
+		{"xs4_252", "tub"},
+		{"xs8_6996", "pond"},
+		{"xs7_25ac", "long boat"},
+		{"xs6_25a4", "barge"},
+		{"xp2_7e", "toad"},
+		{"xp2_318c", "beacon"},
+		{"xp15_4r4z4r4", "pentadecathlon"},
+		{"xp3_co9nas0san9oczgoldlo0oldlogz1047210127401", "pulsar"},
+	};
+
+	for(i32 i = 0; i < (i32) (sizeof names / sizeof *names); i++)
+		if(strcmp(names[i][0], code) == 0)
+			return names[i][1];
+
+	return NULL;
+}
+
+//Steps the object in object_cells alone to find its period and writes its census code into code
+static void soup_classify_object(Soup_Worker* worker, i32 cell_count, i32 max_period, char* code)
+{
+	Chunk_Hash* chunk_hashes = worker->chunk_hashes;
+	for(i32 i = 0; i < 3; i++)
+		chunk_hash_clear(&chunk_hashes[i]);
+
+	Step_Stats stats = {0};
+	stats.population = cell_count;
+	stats.min = worker->object_cells[0];
+	stats.max = worker->object_cells[0];
+	for(i32 i = 0; i < cell_count; i++)
+	{
+		Vec2i cell = worker->object_cells[i];
+		set_cell_at(&chunk_hashes[0], cell, true);
+		if(stats.min.x > cell.x) stats.min.x = cell.x;
+		if(stats.min.y > cell.y) stats.min.y = cell.y;
+		if(stats.max.x < cell.x) stats.max.x = cell.x;
+		if(stats.max.y < cell.y) stats.max.y = cell.y;
+	}
+	stats.hash = universe_hash(&chunk_hashes[0]);
+
+	Cycle_Detector cycle = {0};
+	cycle_detector_push(&cycle, 0, &stats, max_period);
+
+	//The period is not known until the end so every phase is encoded
+	i32 phase_count = 0;
+	for(i32 generation = 0; ; generation++)
+	{
+		i32 count = cell_count;
+		if(generation > 0)
+			count = soup_collect_cells(&chunk_hashes[generation % 3], &worker->object_cells, &worker->object_capacity);
+
+		if(encode_object(worker->phase_codes[phase_count++], sizeof *worker->phase_codes, worker->object_cells, count) == false)
+		{
+			strcpy(code, SOUP_CODE_LARGE);
+			return;
+		}
+
+		if(cycle.found || generation >= max_period)
+			break;
+
+		Chunk_Hash* prev_chunk_hash = &chunk_hashes[(generation + 2) % 3];
+		Chunk_Hash* curr_chunk_hash = &chunk_hashes[generation % 3];
+		Chunk_Hash* next_chunk_hash = &chunk_hashes[(generation + 1) % 3];
+		chunk_hash_clear(next_chunk_hash);
+		game_of_life_generation_step_multi(prev_chunk_hash, curr_chunk_hash, next_chunk_hash, 1, &stats);
+		cycle_detector_push(&cycle, generation + 1, &stats, max_period);
+	}
+
+	if(cycle.found == false)
+	{
+		strcpy(code, SOUP_CODE_UNSTABLE);
+		return;
+	}
+
+	//The phases of the cycle are the period ones before the last (which is the same as the first of them)
+	i32 first_phase = phase_count - 1 - (i32) cycle.period;
+	const char* best = worker->phase_codes[first_phase];
+	for(i32 i = first_phase + 1; i < phase_count - 1; i++)
+		if(code_is_before(worker->phase_codes[i], best))
+			best = worker->phase_codes[i];
+
+	make_object_code(code, best, stats.population, cycle.period, cycle.offset);
+}
+
+//Index of the cell at pos in the sorted cells or -1
+static i32 find_cell(const Vec2i* cells, i32 count, Vec2i pos)
+{
+	i32 low = 0;
+	i32 high = count;
+	while(low < high)
+	{
+		i32 middle = (low + high) / 2;
+		Vec2i cell = cells[middle];
+		if(cell.y < pos.y || (cell.y == pos.y && cell.x < pos.x))
+			low = middle + 1;
+		else
+			high = middle;
+	}
+
+	return low < count && vec_equal(cells[low], pos) ? low : -1;
+}
+
+static int cell_compare(const void* a, const void* b)
+{
+	Vec2i cell_a = *(const Vec2i*) a;
+	Vec2i cell_b = *(const Vec2i*) b;
+	if(cell_a.y != cell_b.y)
+		return cell_a.y < cell_b.y ? -1 : 1;
+	if(cell_a.x != cell_b.x)
+		return cell_a.x < cell_b.x ? -1 : 1;
+	return 0;
+}
+
+static i32 find_root(i32* parents, i32 i)
+{
+	while(parents[i] != i)
+	{
+		parents[i] = parents[parents[i]];
+		i = parents[i];
+	}
+	return i;
+}
+
+//Splits the alive cells of chunk_hash into objects and adds them to the census of the worker
+static void soup_take_census(Soup_Worker* worker, const Chunk_Hash* chunk_hash, i32 max_period)
+{
+	PERF_COUNTER("census");
+	i32 count = soup_collect_cells(chunk_hash, &worker->cells, &worker->cell_capacity);
+	if(count > worker->parent_capacity)
+	{
+		worker->parents = (i32*) sure_realloc(worker->parents, worker->cell_capacity * sizeof(i32), worker->parent_capacity * sizeof(i32), ALLOC_TAG_SEARCH);
+		worker->parent_capacity = worker->cell_capacity;
+	}
+
+	qsort(worker->cells, (size_t) count, sizeof(Vec2i), cell_compare);
+
+	//Cells closer than 3 cells (in both directions) belong to the same object.
+	//Looking only at the cells after each one is enough since the relation is symmetric.
+	for(i32 i = 0; i < count; i++)
+		worker->parents[i] = i;
+
+	for(i32 i = 0; i < count; i++)
+	{
+		Vec2i cell = worker->cells[i];
+		for(i32 dy = 0; dy <= 2; dy++)
+			for(i32 dx = dy == 0 ? 1 : -2; dx <= 2; dx++)
+			{
+				i32 other = find_cell(worker->cells, count, vec(cell.x + dx, cell.y + dy));
+				if(other == -1)
+					continue;
+
+				//The smaller index becomes the root so that every root is the first cell of its object
+				i32 root = find_root(worker->parents, i);
+				i32 other_root = find_root(worker->parents, other);
+				if(other_root < root)
+				{
+					i32 swap = root;
+					root = other_root;
+					other_root = swap;
+				}
+				if(root != other_root)
+					worker->parents[other_root] = root;
+			}
+	}
+
+	//Each root collects its object from the cells after it
+	for(i32 i = 0; i < count; i++)
+		worker->parents[i] = find_root(worker->parents, i);
+
+	for(i32 root = 0; root < count; root++)
+	{
+		if(worker->parents[root] != root)
+			continue;
+
+		i32 cell_count = 0;
+		for(i32 i = root; i < count; i++)
+		{
+			if(worker->parents[i] != root)
+				continue;
+
+			if(cell_count >= worker->object_capacity)
+			{
+				i32 new_capacity = worker->object_capacity * 2 + 64;
+				worker->object_cells = (Vec2i*) sure_realloc(worker->object_cells, new_capacity * sizeof(Vec2i), worker->object_capacity * sizeof(Vec2i), ALLOC_TAG_SEARCH);
+				worker->object_capacity = new_capacity;
+			}
+			worker->object_cells[cell_count++] = worker->cells[i];
+		}
+
+		char code[SOUP_CODE_SIZE] = "";
+		soup_classify_object(worker, cell_count, max_period, code);
+		census_add(&worker->census, code, 1);
+		worker->objects += 1;
+	}
+}
+
+//Returns true if the last window populations (with period at most max_period, all in steps) repeat with some period
+static bool population_is_periodic(const i64* populations, i64 steps, i32 window, i32 max_period)
+{
+	if(steps < window + max_period)
+		return false;
+
+	for(i32 period = 1; period <= max_period; period++)
+	{
+		bool periodic = true;
+		for(i64 i = steps - window; i < steps && periodic; i++)
+			periodic = populations[i % SOUP_POPULATION_RING] == populations[(i - period) % SOUP_POPULATION_RING];
+
+		if(periodic)
+			return true;
+	}
+
+	return false;
+}
+
+static void soup_run(Soup_Worker* worker, const Soup_Search_Options* options, i64 index)
+{
+	PERF_COUNTER("soup");
+	Chunk_Hash* chunk_hashes = worker->chunk_hashes;
+	for(i32 i = 0; i < 3; i++)
+		chunk_hash_clear(&chunk_hashes[i]);
+	soup_search_generate(&chunk_hashes[0], options, index);
+
+	//The soup is looked at once per step so the window and periods are in steps
+	i32 generations = options->step_generations;
+	i32 window = SOUP_SEARCH_POPULATION_WINDOW / generations;
+
+	Cycle_Detector cycle = {0};
+	bool stable = false;
+	i64 steps = 0;
+	i64 generation = 0;
+	while(generation < options->max_generations)
+	{
+		Chunk_Hash* prev_chunk_hash = &chunk_hashes[(steps + 2) % 3];
+		Chunk_Hash* curr_chunk_hash = &chunk_hashes[steps % 3];
+		Chunk_Hash* next_chunk_hash = &chunk_hashes[(steps + 1) % 3];
+
+		Step_Stats stats = {0};
+		chunk_hash_clear(next_chunk_hash);
+		game_of_life_generation_step_multi(prev_chunk_hash, curr_chunk_hash, next_chunk_hash, generations, &stats);
+		worker->populations[steps % SOUP_POPULATION_RING] = stats.population;
+		steps += 1;
+		generation += generations;
+		if(next_chunk_hash->full)
+			break;
+
+		if(cycle_detector_push(&cycle, generation, &stats, (i64) options->max_period * generations)
+			|| population_is_periodic(worker->populations, steps, window, options->max_period))
+		{
+			stable = true;
+			break;
+		}
+	}
+
+	worker->soups += 1;
+	worker->generations += generation;
+	if(stable)
+	{
+		worker->stable_soups += 1;
+		soup_take_census(worker, &chunk_hashes[steps % 3], options->max_period);
+	}
+}
+
+static void soup_worker_init(Soup_Worker* worker)
+{
+	memset(worker, 0, sizeof *worker);
+	for(i32 i = 0; i < 3; i++)
+		chunk_hash_init(&worker->chunk_hashes[i]);
+}
+
+static void soup_worker_deinit(Soup_Worker* worker)
+{
+	soup_census_deinit(&worker->census);
+	for(i32 i = 0; i < 3; i++)
+		chunk_hash_deinit(&worker->chunk_hashes[i]);
+	sure_realloc(worker->cells, 0, worker->cell_capacity * sizeof(Vec2i), ALLOC_TAG_SEARCH);
+	sure_realloc(worker->parents, 0, worker->parent_capacity * sizeof(i32), ALLOC_TAG_SEARCH);
+	sure_realloc(worker->object_cells, 0, worker->object_capacity * sizeof(Vec2i), ALLOC_TAG_SEARCH);
+	memset(worker, 0, sizeof *worker);
+}
+
+void soup_census_take(const Chunk_Hash* chunk_hash, i32 max_period, Soup_Census* census)
+{
+	assert(1 <= max_period && max_period <= SOUP_SEARCH_MAX_PERIOD);
+	Soup_Worker* worker = (Soup_Worker*) sure_realloc(NULL, sizeof(Soup_Worker), 0, ALLOC_TAG_SEARCH);
+	soup_worker_init(worker);
+	soup_take_census(worker, chunk_hash, max_period);
+	for(i32 i = 0; i < worker->census.size; i++)
+		census_add(census, worker->census.entries[i].code, worker->census.entries[i].count);
+
+	soup_worker_deinit(worker);
+	sure_realloc(worker, 0, sizeof(Soup_Worker), ALLOC_TAG_SEARCH);
+}
+
+static void soup_search_worker(void* context, i32 thread_index, i32 thread_count)
+{
+	(void) thread_count;
+	Soup_Search* search = (Soup_Search*) context;
+	Soup_Worker* worker = &search->workers[thread_index];
+	for(;;)
+	{
+		i64 index = atomic_add64(&search->next_soup, 1);
+		if(index >= search->options->soup_count)
+			break;
+
+		soup_run(worker, search->options, index);
+	}
+}
+
+void soup_search_run(const Soup_Search_Options* options, Soup_Search_Result* result)
+{
+	PERF_COUNTER("soup search");
+	assert(1 <= options->step_generations && options->step_generations <= LIFE_WIDE_MARGIN);
+	assert(1 <= options->max_period && options->max_period <= SOUP_SEARCH_MAX_PERIOD);
+
+	memset(result, 0, sizeof *result);
+	f64 start = clock_s();
+
+	Thread_Pool pool = {0};
+	thread_pool_init(&pool, options->threads);
+
+	Soup_Search search = {0};
+	search.options = options;
+	search.workers = (Soup_Worker*) sure_realloc(NULL, pool.thread_count * sizeof(Soup_Worker), 0, ALLOC_TAG_SEARCH);
+	for(i32 i = 0; i < pool.thread_count; i++)
+		soup_worker_init(&search.workers[i]);
+
+	thread_pool_run(&pool, soup_search_worker, &search);
+	result->threads = pool.thread_count;
+
+	for(i32 i = 0; i < pool.thread_count; i++)
+	{
+		Soup_Worker* worker = &search.workers[i];
+		for(i32 j = 0; j < worker->census.size; j++)
+			census_add(&result->census, worker->census.entries[j].code, worker->census.entries[j].count);
+
+		result->soups += worker->soups;
+		result->stable_soups += worker->stable_soups;
+		result->generations += worker->generations;
+		result->objects += worker->objects;
+		soup_worker_deinit(worker);
+	}
+
+	sure_realloc(search.workers, 0, pool.thread_count * sizeof(Soup_Worker), ALLOC_TAG_SEARCH);
+	thread_pool_deinit(&pool);
+
+	qsort(result->census.entries, (size_t) result->census.size, sizeof(Census_Entry), census_entry_compare);
+	result->seconds = clock_s() - start;
+}
+
+void soup_search_result_deinit(Soup_Search_Result* result)
+{
+	soup_census_deinit(&result->census);
+	memset(result, 0, sizeof *result);
+}
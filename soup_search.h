@@ -0,0 +1,94 @@
+#pragma once
+#include "step.h"
+#include "universe_hash.h"
+
+// This file provides a batch search of many small random soups which reports a census of the objects they leave behind.
+//
+// Every thread of the pool holds its own 3 Chunk_Hash universes and steps one soup after another in them (taking the
+// next soup index from a shared counter) so all cores are busy stepping different universes at once without any locking.
+// The hashes are only cleared between soups so nothing is allocated per soup. Soup i is generated from seed and i alone
+// so the results do not depend on the number of threads or the order the soups were run in.
+//
+// The soups are stepped by SOUP_SEARCH_STEP_GENERATIONS at once (see game_of_life_generation_step_multi).
+// A soup is stable once Cycle_Detector finds the whole universe repeating (see universe_hash.h). Soups that send out
+// spaceships never repeat as a whole so a soup whose population was periodic for SOUP_SEARCH_POPULATION_WINDOW
+// generations is taken as stable too. Gliders flying away do not change the population.
+//
+// The alive cells of a stable soup are then split into objects: groups of cells closer than 3 cells to each other
+// (so close enough to interact). Each object is stepped alone for up to max_period generations to find its period
+// and whether it moves. Its census code is the apgcode used by other soup searches: xs<cells> for still lifes,
+// xp<period> for oscillators and xq<period> for spaceships followed by the extended Wechsler format of the
+// phase and orientation with the shortest (and then alphabetically first) encoding. Objects that are not periodic
+// alone are counted as SOUP_CODE_UNSTABLE and ones too big to encode as SOUP_CODE_LARGE.
+
+#define SOUP_SEARCH_SIZE				16
+#define SOUP_SEARCH_DENSITY				50
+#define SOUP_SEARCH_MAX_GENERATIONS		(1 << 15) /* soups still not stable after this many are counted as unstable */
+#define SOUP_SEARCH_MAX_PERIOD			UNIVERSE_HISTORY
+#define SOUP_SEARCH_POPULATION_WINDOW	512 /* generations the population has to be periodic for */
+#define SOUP_SEARCH_STEP_GENERATIONS	4 /* the soups are small so the per chunk overhead of the step is most of the work */
+
+#define SOUP_CODE_SIZE		128 /* including the null terminator */
+#define SOUP_MAX_OBJECT		160 /* objects with a bigger width or height are SOUP_CODE_LARGE */
+#define SOUP_CODE_UNSTABLE	"zz_UNSTABLE"
+#define SOUP_CODE_LARGE		"zz_LARGE"
+
+typedef struct Soup_Search_Options
+{
+	u64 seed;
+	i64 soup_count;
+	i32 soup_size; //width and height of the soups in cells
+	i32 soup_density; //percentage of alive cells
+	i32 threads; //0 means one per hardware thread
+	i32 step_generations; //generations advanced per step, 1 to LIFE_WIDE_MARGIN (see game_of_life_generation_step_multi)
+	i64 max_generations;
+
+	//longest period of objects that is found. At most SOUP_SEARCH_MAX_PERIOD. The whole soup is only looked at
+	//after every step so for it this is in steps (periods up to max_period * step_generations are found).
+	i32 max_period;
+} Soup_Search_Options;
+
+typedef struct Census_Entry
+{
+	char code[SOUP_CODE_SIZE];
+	i64 count;
+} Census_Entry;
+
+typedef struct Soup_Census
+{
+	Census_Entry* entries;
+	i32 size;
+	i32 capacity;
+} Soup_Census;
+
+typedef struct Soup_Search_Result
+{
+	Soup_Census census; //sorted by count from the most common
+	i64 soups;
+	i64 stable_soups; //the rest did not stabilize in max_generations (or ran out of chunks)
+	i64 generations; //stepped over all soups
+	i64 objects;
+	i32 threads; //used
+	f64 seconds;
+} Soup_Search_Result;
+
+//Fills options with the defaults above
+void soup_search_default_options(Soup_Search_Options* options);
+
+//Runs all soups of options and fills result (which should be zero or deinited)
+void soup_search_run(const Soup_Search_Options* options, Soup_Search_Result* result);
+void soup_search_result_deinit(Soup_Search_Result* result);
+
+//Splits the alive cells of chunk_hash into objects like the search does for a stable soup and adds them to census
+void soup_census_take(const Chunk_Hash* chunk_hash, i32 max_period, Soup_Census* census);
+void soup_census_deinit(Soup_Census* census);
+
+//Writes the cells of soup index of options into chunk_hash (which should be empty)
+void soup_search_generate(Chunk_Hash* chunk_hash, const Soup_Search_Options* options, i64 index);
+
+//Writes the census code of a single phase of an object into code (SOUP_CODE_SIZE chars). period and offset are the period
+//of the object and how far it moves in it. The census takes the first of the codes of all its phases (see above).
+void soup_object_code(char* code, const Vec2i* cells, i32 cell_count, i64 period, Vec2i offset);
+
+//The usual name of the object with the given census code or NULL when it is not a common one
+const char* soup_object_name(const char* code);
@@ -0,0 +1,65 @@
+#define _CRT_SECURE_NO_WARNINGS
+#include "stats_log.h"
+#include "alloc.h"
+
+bool stats_log_open(Stats_Log* log, const char* path)
+{
+	stats_log_close(log);
+
+	FILE* file = fopen(path, "wb");
+	if(file == NULL)
+		return false;
+
+	setvbuf(file, NULL, _IOFBF, STATS_LOG_BUFFER);
+
+	Stats_Log_Header header = {0};
+	memcpy(header.magic, STATS_LOG_MAGIC, sizeof STATS_LOG_MAGIC);
+	header.version = STATS_LOG_VERSION;
+	header.record_bytes = sizeof(Stats_Log_Record);
+	header.chunk_size = CHUNK_SIZE;
+
+	log->file = file;
+	log->records = 0;
+	log->failed = fwrite(&header, sizeof header, 1, file) != 1;
+	return true;
+}
+
+void stats_log_write(Stats_Log* log, i64 generation, const Step_Stats* stats, f64 duration)
+{
+	if(log->file == NULL)
+		return;
+
+	Stats_Log_Record record = {0};
+	record.generation = generation;
+	record.population = stats->population;
+	record.births = stats->births;
+	record.deaths = stats->deaths;
+	if(stats->population > 0)
+	{
+		record.min_x = stats->min.x;
+		record.min_y = stats->min.y;
+		record.max_x = stats->max.x;
+		record.max_y = stats->max.y;
+	}
+
+	record.live_chunks = stats->live_chunks;
+	record.empty_chunks = stats->empty_chunks;
+	record.created_chunks = stats->created_chunks;
+	record.generations = stats->generations;
+	record.duration = duration;
+	record.hash = stats->hash;
+
+	if(fwrite(&record, sizeof record, 1, log->file) != 1)
+		log->failed = true;
+	log->records += 1;
+}
+
+bool stats_log_close(Stats_Log* log)
+{
+	if(log->file == NULL)
+		return true;
+
+	bool ok = (fclose(log->file) == 0) && log->failed == false;
+	memset(log, 0, sizeof *log);
+	return ok;
+}
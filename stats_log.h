@@ -0,0 +1,62 @@
+#pragma once
+#include "step.h"
+#include <stdio.h>
+
+// This file provides a binary time series of the Step_Stats of every step of a long run.
+//
+// The file is a Stats_Log_Header followed by one Stats_Log_Record per step written raw just like snapshots
+// (so it is only readable on machines with the same endianness). Every record has record_bytes from the header
+// so a reader can index them directly and can skip fields added by newer versions. Writing a record is just
+// a copy into the buffer of the file (STATS_LOG_BUFFER bytes) so it can be done every generation.
+// A run that crashes loses only the buffered records and the rest of the file stays readable.
+
+#define STATS_LOG_MAGIC		"GOLSTAT"
+#define STATS_LOG_VERSION	2
+#define STATS_LOG_BUFFER	(1 << 16)
+
+typedef struct Stats_Log_Header
+{
+	char magic[8]; //STATS_LOG_MAGIC including the null terminator
+	u32 version;
+	u32 record_bytes; //sizeof(Stats_Log_Record)
+	u32 chunk_size;   //CHUNK_SIZE
+	u32 reserved;
+} Stats_Log_Header;
+
+typedef struct Stats_Log_Record
+{
+	i64 generation; //of the universe after the step
+	i64 population;
+	i64 births;
+	i64 deaths;
+
+	//bounding box of the alive cells (both inclusive). All 0 when population is 0
+	i32 min_x;
+	i32 min_y;
+	i32 max_x;
+	i32 max_y;
+
+	i32 live_chunks;
+	i32 empty_chunks;
+	i32 created_chunks;
+	i32 generations; //advanced by the step
+
+	f64 duration; //of the step in seconds
+	u64 hash; //of the alive cells (see universe_hash.h)
+} Stats_Log_Record;
+
+typedef struct Stats_Log
+{
+	FILE* file; //NULL when not open
+	i64 records;
+	bool failed; //some write failed
+} Stats_Log;
+
+//Creates (or truncates) the file at path and writes the header. Returns false if it could not be created.
+bool stats_log_open(Stats_Log* log, const char* path);
+
+//Appends the stats of a step. Errors are remembered and reported by stats_log_close.
+void stats_log_write(Stats_Log* log, i64 generation, const Step_Stats* stats, f64 duration);
+
+//Writes out the buffered records and closes the file. Returns false if any write failed. Does nothing when not open.
+bool stats_log_close(Stats_Log* log);
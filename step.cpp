@@ -0,0 +1,1057 @@
+#include "step.h"
+#include "life.h"
+#include "perf.h"
+#include "alloc.h"
+#include "universe_hash.h"
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+//MSVC always emits popcnt for __popcnt64. GCC and clang need to be told they can.
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+	#define TARGET_POPCNT __attribute__((target("popcnt")))
+#else
+	#define TARGET_POPCNT
+#endif
+
+#if CHUNK_HALO
+#define OUTER (CHUNK_SIZE + 1)
+
+//Masks: R|CONTENT_BITS|L
+static const u64 R_OUTER_BIT = (u64) 1 << OUTER;
+static const u64 L_OUTER_BIT = (u64) 1;
+static const u64 CONTENT_BITS = (((u64) 1 << OUTER) - 1) & ~L_OUTER_BIT;
+#else
+//Without halo the rows contain nothing but content
+static const u64 CONTENT_BITS = ~(u64) 0;
+#endif
+
+static const Chunk empty_chunk = {0};
+
+//Cells of the chunk its neighbours see: the first columns in the first word of a row and the last in the last
+#define LAST_WORD ((CHUNK_SIZE - 1 + CHUNK_HALO) / 64)
+
+static u64 row_or(const u64* row)
+{
+	u64 out = 0;
+	for(i32 w = 0; w < CHUNK_ROW_WORDS; w++)
+		out |= row[w];
+	return out;
+}
+
+//Masks of the first and last band columns of a row (in its first and last word).
+//The neighbours see band columns and rows of a chunk when stepping by band generations.
+static u64 first_columns(i32 band)
+{
+	return (((u64) 1 << band) - 1) << CHUNK_HALO;
+}
+
+static u64 last_columns(i32 band)
+{
+	return (((u64) 1 << band) - 1) << ((CHUNK_SIZE - band + CHUNK_HALO) % 64);
+}
+
+//The widest border has to fit into the first and last word
+static_assert((CHUNK_SIZE - LIFE_WIDE_MARGIN + CHUNK_HALO) / 64 == LAST_WORD && LIFE_WIDE_MARGIN + CHUNK_HALO <= 64, "border does not fit");
+
+TARGET_POPCNT
+static i32 popcount64(u64 val)
+{
+	#ifdef _MSC_VER
+	return (i32) __popcnt64(val);
+	#else
+	return __builtin_popcountll(val);
+	#endif
+}
+
+//Indices of the lowest and highest set bit. mask must not be 0
+static i32 lowest_set_bit(u64 mask)
+{
+	#ifdef _MSC_VER
+	unsigned long index = 0;
+	_BitScanForward64(&index, mask);
+	return (i32) index;
+	#else
+	return __builtin_ctzll(mask);
+	#endif
+}
+
+static i32 highest_set_bit(u64 mask)
+{
+	#ifdef _MSC_VER
+	unsigned long index = 0;
+	_BitScanReverse64(&index, mask);
+	return (i32) index;
+	#else
+	return 63 - __builtin_clzll(mask);
+	#endif
+}
+
+//Grows the bounding box of stats to contain min and max
+static void stats_add_box(Step_Stats* stats, Vec2i min, Vec2i max)
+{
+	if(stats->population == 0)
+	{
+		stats->min = min;
+		stats->max = max;
+		return;
+	}
+
+	if(stats->min.x > min.x) stats->min.x = min.x;
+	if(stats->min.y > min.y) stats->min.y = min.y;
+	if(stats->max.x < max.x) stats->max.x = max.x;
+	if(stats->max.y < max.y) stats->max.y = max.y;
+}
+
+static void stats_add(Step_Stats* into, const Step_Stats* from)
+{
+	if(from->population > 0)
+		stats_add_box(into, from->min, from->max);
+
+	into->population += from->population;
+	into->births += from->births;
+	into->deaths += from->deaths;
+	into->live_chunks += from->live_chunks;
+	into->empty_chunks += from->empty_chunks;
+	into->created_chunks += from->created_chunks;
+	into->hash = universe_hash_add(into->hash, from->hash);
+}
+
+//Adds the alive cells of new_chunk at pos, their bounding box and their hash to stats. Cells alive only in new_chunk are counted
+//as births and the ones alive only in chunk (the same position a step ago) as deaths. chunk is NULL when they are the same.
+//Called right after new_chunk is computed so it is still in L1.
+TARGET_POPCNT
+static void add_chunk_stats(Step_Stats* stats, const Chunk* new_chunk, const Chunk* chunk, Vec2i pos)
+{
+	i64 population = 0;
+	i64 births = 0;
+	i64 deaths = 0;
+	u64 columns[CHUNK_ROW_WORDS] = {0};
+	for(i32 y = 0; y < CHUNK_SIZE; y++)
+	{
+		const u64* row = chunk_row(new_chunk, y);
+		for(i32 w = 0; w < CHUNK_ROW_WORDS; w++)
+		{
+			u64 now = row[w] & CONTENT_BITS;
+			population += popcount64(now);
+			columns[w] |= now;
+		}
+	}
+
+	if(chunk != NULL)
+	{
+		for(i32 y = 0; y < CHUNK_SIZE; y++)
+		{
+			const u64* row = chunk_row(new_chunk, y);
+			const u64* before = chunk_row(chunk, y);
+			for(i32 w = 0; w < CHUNK_ROW_WORDS; w++)
+			{
+				births += popcount64(row[w] & ~before[w] & CONTENT_BITS);
+				deaths += popcount64(before[w] & ~row[w] & CONTENT_BITS);
+			}
+		}
+	}
+
+	if(population > 0)
+	{
+		//The pattern usually fills the chunk so these stop right away
+		i32 min_y = 0;
+		i32 max_y = CHUNK_SIZE - 1;
+		while((row_or(chunk_row(new_chunk, min_y)) & CONTENT_BITS) == 0)
+			min_y++;
+		while((row_or(chunk_row(new_chunk, max_y)) & CONTENT_BITS) == 0)
+			max_y--;
+
+		i32 min_w = 0;
+		i32 max_w = CHUNK_ROW_WORDS - 1;
+		while(columns[min_w] == 0)
+			min_w++;
+		while(columns[max_w] == 0)
+			max_w--;
+
+		Vec2i origin = vec(pos.x * CHUNK_SIZE, pos.y * CHUNK_SIZE);
+		Vec2i min = vec(min_w * 64 + lowest_set_bit(columns[min_w]) - CHUNK_HALO, min_y);
+		Vec2i max = vec(max_w * 64 + highest_set_bit(columns[max_w]) - CHUNK_HALO, max_y);
+		stats_add_box(stats, vec_add(origin, min), vec_add(origin, max));
+		stats->hash = universe_hash_add(stats->hash, universe_hash_chunk(new_chunk, pos));
+	}
+
+	stats->population += population;
+	stats->births += births;
+	stats->deaths += deaths;
+}
+
+//Compares the content of two chunks. Returns same_flag if they are the same and edge_same_flag if their borders
+//(the band cells along the edges) are.
+static u32 compare_chunks(const Chunk* a, const Chunk* b, u32 same_flag, u32 edge_same_flag, i32 band)
+{
+	u64 diff = 0;
+	u64 edge_diff = 0;
+	const u64 first_mask = first_columns(band);
+	const u64 last_mask = last_columns(band);
+	for(i32 y = 0; y < CHUNK_SIZE; y++)
+	{
+		const u64* row_a = chunk_row(a, y);
+		const u64* row_b = chunk_row(b, y);
+		for(i32 w = 0; w < CHUNK_ROW_WORDS; w++)
+			diff |= (row_a[w] ^ row_b[w]) & CONTENT_BITS;
+
+		edge_diff |= (row_a[0] ^ row_b[0]) & first_mask;
+		edge_diff |= (row_a[LAST_WORD] ^ row_b[LAST_WORD]) & last_mask;
+	}
+
+	for(i32 i = 0; i < band; i++)
+	{
+		for(i32 w = 0; w < CHUNK_ROW_WORDS; w++)
+		{
+			edge_diff |= (chunk_row(a, i)[w] ^ chunk_row(b, i)[w]) & CONTENT_BITS;
+			edge_diff |= (chunk_row(a, CHUNK_SIZE - 1 - i)[w] ^ chunk_row(b, CHUNK_SIZE - 1 - i)[w]) & CONTENT_BITS;
+		}
+	}
+
+	u32 flags = 0;
+	if(diff == 0)		flags |= same_flag;
+	if(edge_diff == 0)	flags |= edge_same_flag;
+	return flags;
+}
+
+//Returns a bit mask of (1 << Chunk_Direction) for all neighbouring chunks that are within band cells of an alive
+//cell of chunk (those need to be present in the next generation). Sets alive to whether chunk has any alive cell.
+static u32 chunk_reach(const Chunk* chunk, i32 band, bool* alive)
+{
+	const u64 first_mask = first_columns(band);
+	const u64 last_mask = last_columns(band);
+	u64 acummulated = 0;
+	u64 acummulated_first = 0;
+	u64 acummulated_last = 0;
+	for(i32 y = 0; y < CHUNK_SIZE; y++)
+	{
+		const u64* row = chunk_row(chunk, y);
+		acummulated |= row_or(row);
+		acummulated_first |= row[0];
+		acummulated_last |= row[LAST_WORD];
+	}
+
+	*alive = acummulated != 0;
+	if(acummulated == 0)
+		return 0;
+
+	u64 top_rows = 0;
+	u64 bot_rows = 0;
+	u64 top_first = 0, top_last = 0, bot_first = 0, bot_last = 0;
+	for(i32 i = 0; i < band; i++)
+	{
+		const u64* top = chunk_row(chunk, i);
+		const u64* bot = chunk_row(chunk, CHUNK_SIZE - 1 - i);
+		top_rows |= row_or(top);
+		bot_rows |= row_or(bot);
+		top_first |= top[0];
+		top_last |= top[LAST_WORD];
+		bot_first |= bot[0];
+		bot_last |= bot[LAST_WORD];
+	}
+
+	u32 mask = 0;
+	//left right
+	if(acummulated_first & first_mask)	mask |= 1 << DIRECTION_LEFT;
+	if(acummulated_last & last_mask)	mask |= 1 << DIRECTION_RIGHT;
+
+	//top bot
+	if(top_rows & CONTENT_BITS)			mask |= 1 << DIRECTION_TOP;
+	if(bot_rows & CONTENT_BITS)			mask |= 1 << DIRECTION_BOT;
+
+	//diagonals - there is only very small chence these will get added
+	if(top_first & first_mask)			mask |= 1 << DIRECTION_TOP_L;
+	if(bot_first & first_mask)			mask |= 1 << DIRECTION_BOT_L;
+	if(top_last & last_mask)			mask |= 1 << DIRECTION_TOP_R;
+	if(bot_last & last_mask)			mask |= 1 << DIRECTION_BOT_R;
+
+	return mask;
+}
+
+//Returns the chunk at index of prev_chunk_hash. If there was none returns the empty chunk
+//and if we dont know returns NULL
+static const Chunk* get_prev_chunk(const Chunk_Hash* prev_chunk_hash, i32 prev)
+{
+	if(prev == CHUNK_LINK_NONE)
+		return &empty_chunk;
+	if(prev == CHUNK_LINK_UNKNOWN || prev_chunk_hash == NULL)
+		return NULL;
+
+	assert(0 <= prev && prev < prev_chunk_hash->chunk_size);
+	return &prev_chunk_hash->chunks[prev];
+}
+
+typedef enum Step_Skip
+{
+	SKIP_NONE,
+	SKIP_DEAD,   //chunk and the borders around are empty so it stays empty
+	SKIP_SAME_1, //chunk and the borders around did not change since the last generation so neither will the result
+	SKIP_SAME_2, //chunk and the borders around are the same as two generations ago so the result is the previous generation
+} Step_Skip;
+
+static Step_Skip find_skip(const Chunk_Hash* prev_chunk_hash, const Chunk_Hash* curr_chunk_hash, i32 index)
+{
+	const Chunk_Meta* meta = &curr_chunk_hash->meta[index];
+	u32 neighbour_flags = CHUNK_FLAG_EDGE_EMPTY | CHUNK_FLAG_EDGE_SAME_1 | CHUNK_FLAG_EDGE_SAME_2;
+	bool any_missing = false;
+	for(i32 dir = 0; dir < DIRECTION_COUNT; dir++)
+	{
+		i32 neighbour = meta->neighbours[dir];
+		if(neighbour == CHUNK_LINK_NONE)
+			any_missing = true;
+		else
+			neighbour_flags &= curr_chunk_hash->meta[neighbour].flags;
+	}
+
+	//Missing neighbours are empty now but we also need to know what they were before
+	if(any_missing && (meta->flags & CHUNK_FLAG_MISSING_EMPTY_1) == 0)
+		neighbour_flags &= ~CHUNK_FLAG_EDGE_SAME_1;
+	if(any_missing && (meta->flags & CHUNK_FLAG_MISSING_EMPTY_2) == 0)
+		neighbour_flags &= ~CHUNK_FLAG_EDGE_SAME_2;
+
+	if((meta->flags & CHUNK_FLAG_EMPTY) && (neighbour_flags & CHUNK_FLAG_EDGE_EMPTY))
+		return SKIP_DEAD;
+	if((meta->flags & CHUNK_FLAG_SAME_1) && (neighbour_flags & CHUNK_FLAG_EDGE_SAME_1))
+		return SKIP_SAME_1;
+	if((meta->flags & CHUNK_FLAG_SAME_2) && (neighbour_flags & CHUNK_FLAG_EDGE_SAME_2) && get_prev_chunk(prev_chunk_hash, meta->prev) != NULL)
+		return SKIP_SAME_2;
+
+	return SKIP_NONE;
+}
+
+//Computes the next generation of chunk into new_chunk from its neighbours (indexed by Chunk_Direction)
+static void compute_chunk_single(const Chunk* chunk, const Chunk* const* neighbours, Chunk* new_chunk)
+{
+	const Chunk* top   = neighbours[DIRECTION_TOP];
+	const Chunk* bot   = neighbours[DIRECTION_BOT];
+	const Chunk* left  = neighbours[DIRECTION_LEFT];
+	const Chunk* right = neighbours[DIRECTION_RIGHT];
+	const Chunk* top_l = neighbours[DIRECTION_TOP_L];
+	const Chunk* top_r = neighbours[DIRECTION_TOP_R];
+	const Chunk* bot_l = neighbours[DIRECTION_BOT_L];
+	const Chunk* bot_r = neighbours[DIRECTION_BOT_R];
+
+	//Holds a composed value for the currently processed block.
+	//Includes the edge from adjecent chunks
+	#if CHUNK_HALO
+	u64 assembled[LIFE_ASSEMBLED_WORDS] = {0};
+	*new_chunk = Chunk{0};
+
+	//Fill edge pixels from adjecent chunks
+	assembled[0]  = top->data[OUTER - 1] & CONTENT_BITS;
+	assembled[OUTER] = bot->data[1] & CONTENT_BITS;
+
+	u64 top_l_bit = (top_l->data[OUTER - 1] << 1) & R_OUTER_BIT;
+	u64 top_r_bit = (top_r->data[OUTER - 1] >> 1) & L_OUTER_BIT;
+	u64 bot_l_bit = (bot_l->data[1] << 1) & R_OUTER_BIT;
+	u64 bot_r_bit = (bot_r->data[1] >> 1) & L_OUTER_BIT;
+
+	assembled[0]  |= top_l_bit >> OUTER;
+	assembled[0]  |= top_r_bit << OUTER;
+
+	assembled[OUTER] |= bot_l_bit >> OUTER;
+	assembled[OUTER] |= bot_r_bit << OUTER;
+
+	//Adds the middle set of data from the main processed chunk
+	for(i32 i = 0; i < CHUNK_SIZE; i++)
+	{
+		u64 middle = chunk->data[i + 1] & CONTENT_BITS;
+		u64 first = (left->data[i + 1] << 1) & R_OUTER_BIT;
+		u64 last = (right->data[i + 1] >> 1) & L_OUTER_BIT;
+
+		assembled[1 + i] = (first >> OUTER) | middle | (last << OUTER);
+	}
+
+	{
+		PERF_COUNTER("life");
+		life_kernel_run(assembled, new_chunk->data);
+	}
+
+	//The kernel also computes the halo cells (with incomplete neighbourhood)
+	//so we need to mask them out
+	for(i32 i = 0; i < CHUNK_SIZE; i++)
+		new_chunk->data[1 + i] &= CONTENT_BITS;
+	#else
+	u64 assembled[LIFE_ASSEMBLED_WORDS]; //all written below
+
+	//The kernel writes all rows
+	//Every row gets one word of halo on each side of which only the bit touching the content
+	//is used (the last cell of the left neighbour and the first cell of the right one).
+	const u64 LAST_BIT = (u64) 1 << 63;
+	for(i32 y = -1; y <= CHUNK_SIZE; y++)
+	{
+		const Chunk* from_l = left;
+		const Chunk* from = chunk;
+		const Chunk* from_r = right;
+		i32 from_y = y;
+		if(y < 0)
+		{
+			from_l = top_l; from = top; from_r = top_r;
+			from_y = CHUNK_SIZE - 1;
+		}
+		else if(y == CHUNK_SIZE)
+		{
+			from_l = bot_l; from = bot; from_r = bot_r;
+			from_y = 0;
+		}
+
+		u64* into = &assembled[(y + 1) * LIFE_ASSEMBLED_ROW_WORDS];
+		const u64* row = chunk_row(from, from_y);
+		into[0] = chunk_row(from_l, from_y)[CHUNK_ROW_WORDS - 1] & LAST_BIT;
+		for(i32 w = 0; w < CHUNK_ROW_WORDS; w++)
+			into[w + 1] = row[w];
+		into[CHUNK_ROW_WORDS + 1] = chunk_row(from_r, from_y)[0] & 1;
+	}
+
+	{
+		PERF_COUNTER("life");
+		life_kernel_run(assembled, new_chunk->data);
+	}
+	#endif
+}
+
+//The wide block has the content at the bit LIFE_WIDE_MARGIN instead of CHUNK_HALO so its rows are the chunk rows
+//shifted by this (the words of the block are at most one more than those of the chunk)
+#define WIDE_SHIFT (LIFE_WIDE_MARGIN - CHUNK_HALO)
+static_assert(0 < WIDE_SHIFT && WIDE_SHIFT < 64 && LIFE_WIDE_WORDS <= CHUNK_ROW_WORDS + 1, "wide block does not fit");
+
+//Computes chunk generations ahead into new_chunk. Assembles it with a margin of that many cells
+//from its neighbours (indexed by Chunk_Direction) and runs the wide kernel over it.
+static void compute_chunk_wide(const Chunk* chunk, const Chunk* const* neighbours, Chunk* new_chunk, i32 generations)
+{
+	u64 block[LIFE_WIDE_BLOCK_WORDS]; //only the rows of the used margin are written
+	u64 temp[LIFE_WIDE_BLOCK_WORDS];
+
+	//The margin from the left neighbour ends right before the content and the one from the right starts right after it
+	const u64 margin_l = last_columns(generations);
+	const u64 margin_r = first_columns(generations);
+	const i32 margin_l_shift = (CHUNK_SIZE - generations + CHUNK_HALO) % 64 - (LIFE_WIDE_MARGIN - generations);
+	const i32 margin_r_word = (LIFE_WIDE_MARGIN + CHUNK_SIZE) / 64;
+	const i32 margin_r_shift = (LIFE_WIDE_MARGIN + CHUNK_SIZE) % 64 - CHUNK_HALO;
+	for(i32 y = -generations; y < CHUNK_SIZE + generations; y++)
+	{
+		const Chunk* from_l = neighbours[DIRECTION_LEFT];
+		const Chunk* from = chunk;
+		const Chunk* from_r = neighbours[DIRECTION_RIGHT];
+		i32 from_y = y;
+		if(y < 0)
+		{
+			from_l = neighbours[DIRECTION_TOP_L]; from = neighbours[DIRECTION_TOP]; from_r = neighbours[DIRECTION_TOP_R];
+			from_y = y + CHUNK_SIZE;
+		}
+		else if(y >= CHUNK_SIZE)
+		{
+			from_l = neighbours[DIRECTION_BOT_L]; from = neighbours[DIRECTION_BOT]; from_r = neighbours[DIRECTION_BOT_R];
+			from_y = y - CHUNK_SIZE;
+		}
+
+		u64* into = &block[y + LIFE_WIDE_MARGIN];
+		const u64* row = chunk_row(from, from_y);
+		u64 carry = 0;
+		for(i32 w = 0; w < LIFE_WIDE_WORDS; w++)
+		{
+			u64 word = w < CHUNK_ROW_WORDS ? row[w] & CONTENT_BITS : 0;
+			into[w * LIFE_WIDE_ROWS] = (word << WIDE_SHIFT) | carry;
+			carry = word >> (64 - WIDE_SHIFT);
+		}
+
+		u64 left = chunk_row(from_l, from_y)[LAST_WORD] & margin_l;
+		into[0] |= left >> margin_l_shift;
+		into[margin_r_word * LIFE_WIDE_ROWS] |= (chunk_row(from_r, from_y)[0] & margin_r) << margin_r_shift;
+	}
+
+	const u64* result = NULL;
+	{
+		PERF_COUNTER("life");
+		result = life_kernel_run_wide(block, temp, generations);
+	}
+
+	#if CHUNK_HALO
+	*new_chunk = Chunk{0};
+	#endif
+	for(i32 y = 0; y < CHUNK_SIZE; y++)
+	{
+		const u64* from = &result[y + LIFE_WIDE_MARGIN];
+		u64* row = chunk_row(new_chunk, y);
+		for(i32 w = 0; w < CHUNK_ROW_WORDS; w++)
+		{
+			u64 next = w + 1 < LIFE_WIDE_WORDS ? from[(w + 1) * LIFE_WIDE_ROWS] : 0;
+			row[w] = ((from[w * LIFE_WIDE_ROWS] >> WIDE_SHIFT) | (next << (64 - WIDE_SHIFT))) & CONTENT_BITS;
+		}
+	}
+}
+
+//Computes the chunk at index generations ahead into new_chunk. Returns true if the new chunk has
+//any alive cells. In that case also fills reached with a bit mask of (1 << Chunk_Direction)
+//for all neighbouring chunks within generations cells of the new cells (those need to be present in the next generation).
+//Also sets the next_flags of the chunk meta and adds the chunk to stats (if not NULL).
+//
+//prev_chunk_hash is the previous generation (or NULL). It is used to skip chunks that did not change.
+static bool compute_chunk(const Chunk_Hash* prev_chunk_hash, Chunk_Hash* curr_chunk_hash, i32 index, Chunk* new_chunk, u32* reached, i32 generations, Step_Stats* stats)
+{
+	const Chunk* chunk = &curr_chunk_hash->chunks[index];
+	Chunk_Meta* chunk_meta = &curr_chunk_hash->meta[index];
+	Step_Skip skip = find_skip(prev_chunk_hash, curr_chunk_hash, index);
+
+	if(skip == SKIP_DEAD)
+	{
+		PERF_COUNTER("skip dead");
+		chunk_meta->next_flags = CHUNK_FLAG_EMPTY | CHUNK_FLAG_EDGE_EMPTY | CHUNK_FLAG_SAME_1 | CHUNK_FLAG_EDGE_SAME_1;
+		const Chunk* prev_chunk = get_prev_chunk(prev_chunk_hash, chunk_meta->prev);
+		if(chunk_meta->flags & CHUNK_FLAG_SAME_1)
+			chunk_meta->next_flags |= CHUNK_FLAG_SAME_2 | CHUNK_FLAG_EDGE_SAME_2;
+		else if(prev_chunk != NULL)
+			chunk_meta->next_flags |= compare_chunks(&empty_chunk, prev_chunk, CHUNK_FLAG_SAME_2, CHUNK_FLAG_EDGE_SAME_2, generations);
+
+		return false;
+	}
+
+	if(skip == SKIP_SAME_1)
+	{
+		PERF_COUNTER("skip same 1");
+		*new_chunk = *chunk;
+		//t+1 == t == t-1
+		chunk_meta->next_flags = CHUNK_FLAG_SAME_1 | CHUNK_FLAG_EDGE_SAME_1 | CHUNK_FLAG_SAME_2 | CHUNK_FLAG_EDGE_SAME_2;
+	}
+	else if(skip == SKIP_SAME_2)
+	{
+		PERF_COUNTER("skip same 2");
+		const Chunk* prev_chunk = get_prev_chunk(prev_chunk_hash, chunk_meta->prev);
+		*new_chunk = *prev_chunk;
+
+		//t+1 == t-1 so compared to t it is the same as t-1 compared to t
+		chunk_meta->next_flags = (chunk_meta->flags & (CHUNK_FLAG_SAME_1 | CHUNK_FLAG_EDGE_SAME_1))
+			| CHUNK_FLAG_SAME_2 | CHUNK_FLAG_EDGE_SAME_2;
+	}
+	else
+	{
+		const Chunk* neighbours[DIRECTION_COUNT] = {0};
+		{
+			PERF_COUNTER("neighbour gather");
+			for(i32 i = 0; i < DIRECTION_COUNT; i++)
+			{
+				i32 neighbour = chunk_meta->neighbours[i];
+				assert(neighbour != CHUNK_LINK_UNKNOWN && "all chunks must be linked before the step!");
+				neighbours[i] = neighbour == CHUNK_LINK_NONE ? &empty_chunk : &curr_chunk_hash->chunks[neighbour];
+			}
+		}
+		if(generations > 1)
+			compute_chunk_wide(chunk, neighbours, new_chunk, generations);
+		else
+			compute_chunk_single(chunk, neighbours, new_chunk);
+
+		const Chunk* prev_chunk = get_prev_chunk(prev_chunk_hash, chunk_meta->prev);
+		chunk_meta->next_flags = compare_chunks(new_chunk, chunk, CHUNK_FLAG_SAME_1, CHUNK_FLAG_EDGE_SAME_1, generations);
+		if(prev_chunk != NULL)
+			chunk_meta->next_flags |= compare_chunks(new_chunk, prev_chunk, CHUNK_FLAG_SAME_2, CHUNK_FLAG_EDGE_SAME_2, generations);
+	}
+
+	if(stats != NULL)
+		add_chunk_stats(stats, new_chunk, skip == SKIP_SAME_1 ? NULL : chunk, curr_chunk_hash->positions[index]);
+
+	//The emptiness flags are always computed from the result
+	bool alive = false;
+	u32 mask = chunk_reach(new_chunk, generations, &alive);
+	if(mask == 0)
+		chunk_meta->next_flags |= CHUNK_FLAG_EDGE_EMPTY;
+
+	if(alive == false)
+	{
+		chunk_meta->next_flags |= CHUNK_FLAG_EMPTY;
+		return false;
+	}
+
+	if(stats != NULL)
+		stats->live_chunks += 1;
+	*reached = mask;
+	return true;
+}
+
+//Inserts the chunk at index of curr_chunk_hash into next_chunk_hash (if not already there).
+//Chunks present in curr_chunk_hash only ever get into the next one through this function
+//which means their meta.next always tells if and where they are.
+//When in_place the chunk already is at the same index of next_chunk_hash (see chunk_hash_copy_index)
+//and this only marks it as needed.
+static i32 step_insert_known(Chunk_Hash* curr_chunk_hash, Chunk_Hash* next_chunk_hash, i32 index, bool in_place)
+{
+	Chunk_Meta* meta = &curr_chunk_hash->meta[index];
+	if(meta->next == -1)
+		meta->next = in_place ? index : chunk_hash_insert_unlinked(next_chunk_hash, curr_chunk_hash->positions[index]);
+
+	return meta->next;
+}
+
+//Inserts the neighbour in dir of the chunk at index of curr_chunk_hash into next_chunk_hash.
+//Returns true if it created a chunk that was not present in curr_chunk_hash.
+static bool step_insert_neighbour(Chunk_Hash* curr_chunk_hash, Chunk_Hash* next_chunk_hash, i32 index, i32 dir, bool in_place)
+{
+	i32 neighbour = curr_chunk_hash->meta[index].neighbours[dir];
+	if(neighbour != CHUNK_LINK_NONE)
+	{
+		step_insert_known(curr_chunk_hash, next_chunk_hash, neighbour, in_place);
+		return false;
+	}
+	else
+	{
+		i32 size_before = next_chunk_hash->chunk_size;
+		i32 inserted = chunk_hash_insert_unlinked(next_chunk_hash, vec_add(curr_chunk_hash->positions[index], chunk_directions[dir]));
+
+		//It was not present in this generation so it was empty and is empty.
+		//If the requesting chunk knows it was empty before as well so do we.
+		if(inserted == size_before)
+		{
+			Chunk_Meta* meta = &next_chunk_hash->meta[inserted];
+			meta->prev = CHUNK_LINK_NONE;
+			meta->flags = CHUNK_FLAG_EMPTY | CHUNK_FLAG_EDGE_EMPTY | CHUNK_FLAG_SAME_1 | CHUNK_FLAG_EDGE_SAME_1;
+			if(curr_chunk_hash->meta[index].flags & CHUNK_FLAG_MISSING_EMPTY_1)
+				meta->flags |= CHUNK_FLAG_SAME_2 | CHUNK_FLAG_EDGE_SAME_2;
+			return true;
+		}
+
+		return false;
+	}
+}
+
+//Decides whether next_chunk_hash keeps the indices of curr_chunk_hash and if so copies its index.
+//Otherwise the next generation is built by inserting only the chunks that are needed
+//which drops the unneeded ones once there are too many of them.
+static bool step_begin_in_place(const Chunk_Hash* curr_chunk_hash, Chunk_Hash* next_chunk_hash)
+{
+	if((i64) curr_chunk_hash->unneeded_count * STEP_COMPACT_FRACTION > curr_chunk_hash->chunk_size)
+		return false;
+
+	return chunk_hash_copy_index(next_chunk_hash, curr_chunk_hash);
+}
+
+//Keeps the chunks that were not marked as needed at their indices as well and counts them
+static void step_finish_in_place(Chunk_Hash* curr_chunk_hash, Chunk_Hash* next_chunk_hash)
+{
+	i32 unneeded = 0;
+	for(i32 i = 0; i < curr_chunk_hash->chunk_size; i++)
+	{
+		Chunk_Meta* meta = &curr_chunk_hash->meta[i];
+		if(meta->next == -1)
+		{
+			meta->next = i;
+			unneeded += 1;
+		}
+	}
+
+	next_chunk_hash->unneeded_count = unneeded;
+}
+
+//Links the chunks of next_chunk_hash that came from the chunks of curr_chunk_hash in [from, to)
+//and moves over their flags. Also finds out if the neighbours that will be missing were empty before.
+//Their neighbours in the next generation are just the neighbours from this generation moved over.
+//Neighbours which were not present in curr_chunk_hash are left as CHUNK_LINK_NONE
+//and fixed up by step_link_new when it links the new chunks.
+static void step_link_known(Chunk_Hash* curr_chunk_hash, Chunk_Hash* next_chunk_hash, i32 from, i32 to)
+{
+	for(i32 i = from; i < to; i++)
+	{
+		const Chunk_Meta* meta = &curr_chunk_hash->meta[i];
+		if(meta->next == -1)
+			continue;
+
+		Chunk_Meta* next_meta = &next_chunk_hash->meta[meta->next];
+		bool missing_empty_1 = true;
+		bool missing_empty_2 = true;
+		for(i32 dir = 0; dir < DIRECTION_COUNT; dir++)
+		{
+			i32 neighbour = meta->neighbours[dir];
+			if(neighbour == CHUNK_LINK_NONE)
+			{
+				//missing now and missing in the next generation
+				next_meta->neighbours[dir] = CHUNK_LINK_NONE;
+				missing_empty_2 = missing_empty_2 && (meta->flags & CHUNK_FLAG_MISSING_EMPTY_1);
+			}
+			else
+			{
+				next_meta->neighbours[dir] = curr_chunk_hash->meta[neighbour].next;
+				if(next_meta->neighbours[dir] == CHUNK_LINK_NONE)
+				{
+					u32 flags = curr_chunk_hash->meta[neighbour].flags;
+					missing_empty_1 = missing_empty_1 && (flags & CHUNK_FLAG_EDGE_EMPTY);
+					missing_empty_2 = missing_empty_2 && (flags & CHUNK_FLAG_EDGE_EMPTY) && (flags & CHUNK_FLAG_EDGE_SAME_1);
+				}
+			}
+		}
+
+		next_meta->prev = i;
+		next_meta->flags = meta->next_flags;
+		if(missing_empty_1)
+			next_meta->flags |= CHUNK_FLAG_MISSING_EMPTY_1;
+		if(missing_empty_1 && missing_empty_2)
+			next_meta->flags |= CHUNK_FLAG_MISSING_EMPTY_2;
+	}
+}
+
+//Links the chunks that were not present in the previous generation using the hash.
+//Those are only the few empty chunks at the border of the pattern.
+static void step_link_new(Chunk_Hash* next_chunk_hash)
+{
+	for(i32 i = 0; i < next_chunk_hash->chunk_size; i++)
+	{
+		const Chunk_Meta* meta = &next_chunk_hash->meta[i];
+		for(i32 dir = 0; dir < DIRECTION_COUNT; dir++)
+		{
+			if(meta->neighbours[dir] == CHUNK_LINK_UNKNOWN)
+			{
+				chunk_hash_link(next_chunk_hash, i);
+				break;
+			}
+		}
+	}
+}
+
+//Makes curr_chunk_hash ready to be stepped by generations when it was not made by a step of as many generations.
+//
+//The step needs every chunk within generations cells of an alive cell to be present (the cells spread that far)
+//but a step of fewer generations only inserted the chunks that close to the cells. The missing ones are inserted here.
+//The flags of the chunks compare against a different generation and their borders are not as wide
+//so we forget them (0 is always safe) and also the prev links (the prev_chunk_hash is that different generation).
+static void step_prepare(Chunk_Hash* curr_chunk_hash, i32 generations)
+{
+	assert(1 <= generations && generations <= LIFE_WIDE_MARGIN);
+	if(curr_chunk_hash->step_generations == generations)
+		return;
+
+	PERF_COUNTER("step prepare");
+	if(generations > 1 && curr_chunk_hash->step_generations < generations)
+	{
+		//The inserted chunks are empty so they dont need checking
+		i32 chunk_size = curr_chunk_hash->chunk_size;
+		for(i32 i = 0; i < chunk_size; i++)
+		{
+			u32 missing = 0;
+			for(i32 dir = 0; dir < DIRECTION_COUNT; dir++)
+				if(curr_chunk_hash->meta[i].neighbours[dir] == CHUNK_LINK_NONE)
+					missing |= 1 << dir;
+
+			if(missing == 0 || (curr_chunk_hash->meta[i].flags & CHUNK_FLAG_EMPTY))
+				continue;
+
+			bool alive = false;
+			u32 reached = chunk_reach(&curr_chunk_hash->chunks[i], generations, &alive) & missing;
+			for(i32 dir = 0; dir < DIRECTION_COUNT; dir++)
+				if(reached & (1 << dir))
+					chunk_hash_insert(curr_chunk_hash, vec_add(curr_chunk_hash->positions[i], chunk_directions[dir]));
+		}
+	}
+
+	for(i32 i = 0; i < curr_chunk_hash->chunk_size; i++)
+	{
+		curr_chunk_hash->meta[i].prev = CHUNK_LINK_UNKNOWN;
+		curr_chunk_hash->meta[i].flags = 0;
+	}
+
+	curr_chunk_hash->step_generations = generations;
+}
+
+//Fills stats from the gathered ones. Also counts the chunks step_prepare inserted into curr_chunk_hash
+//(from index prepared_from on) that got into next_chunk_hash as created.
+static void step_finish_stats(const Chunk_Hash* curr_chunk_hash, const Chunk_Hash* next_chunk_hash, i32 prepared_from, i32 generations, const Step_Stats* gathered, Step_Stats* stats)
+{
+	*stats = *gathered;
+	for(i32 i = prepared_from; i < curr_chunk_hash->chunk_size; i++)
+		if(curr_chunk_hash->meta[i].next != -1)
+			stats->created_chunks += 1;
+
+	stats->empty_chunks = next_chunk_hash->chunk_size - stats->live_chunks;
+	stats->generations = generations;
+}
+
+void game_of_life_generation_step(const Chunk_Hash* prev_chunk_hash, Chunk_Hash* curr_chunk_hash, Chunk_Hash* next_chunk_hash)
+{
+	game_of_life_generation_step_multi(prev_chunk_hash, curr_chunk_hash, next_chunk_hash, 1, NULL);
+}
+
+void game_of_life_generation_step_multi(const Chunk_Hash* prev_chunk_hash, Chunk_Hash* curr_chunk_hash, Chunk_Hash* next_chunk_hash, i32 generations, Step_Stats* stats)
+{
+	PERF_COUNTER("step");
+	Step_Stats gathered = {0};
+	i32 prepared_from = curr_chunk_hash->chunk_size;
+	step_prepare(curr_chunk_hash, generations);
+	bool in_place = step_begin_in_place(curr_chunk_hash, next_chunk_hash);
+
+	for(i32 i = 0; i < curr_chunk_hash->chunk_size; i++)
+		curr_chunk_hash->meta[i].next = -1;
+
+	//Out of place the chunk is computed here first. compute_chunk writes all of it so it does not need clearing between chunks.
+	Chunk computed_chunk;
+	for(i32 i = 0; i < curr_chunk_hash->chunk_size; i++)
+	{
+		PERF_COUNTER("single chunk");
+		u32 reached = 0;
+
+		//In place the chunk is computed straight into its place in the next generation
+		Chunk* new_chunk = in_place ? chunk_hash_at(next_chunk_hash, i) : &computed_chunk;
+
+		//Unless chunk is comletely dead insert itself alongside all neigboring chunks chunk_hash the next generation
+		if(compute_chunk(prev_chunk_hash, curr_chunk_hash, i, new_chunk, &reached, generations, stats != NULL ? &gathered : NULL))
+		{
+			PERF_COUNTER("neighbour add");
+			i32 next_i = step_insert_known(curr_chunk_hash, next_chunk_hash, i, in_place);
+			if(in_place == false && next_i != CHUNK_HASH_FULL)
+				*chunk_hash_at(next_chunk_hash, next_i) = computed_chunk;
+
+			for(i32 dir = 0; dir < DIRECTION_COUNT; dir++)
+				if(reached & (1 << dir))
+					gathered.created_chunks += step_insert_neighbour(curr_chunk_hash, next_chunk_hash, i, dir, in_place);
+		}
+		else if(in_place)
+			*new_chunk = Chunk{0};
+	}
+
+	if(in_place)
+		step_finish_in_place(curr_chunk_hash, next_chunk_hash);
+
+	{
+		PERF_COUNTER("neighbour link");
+		step_link_known(curr_chunk_hash, next_chunk_hash, 0, curr_chunk_hash->chunk_size);
+		step_link_new(next_chunk_hash);
+	}
+
+	next_chunk_hash->step_generations = generations;
+	if(stats != NULL)
+		step_finish_stats(curr_chunk_hash, next_chunk_hash, prepared_from, generations, &gathered, stats);
+}
+
+void parallel_step_init(Parallel_Step* step, i32 thread_count)
+{
+	parallel_step_deinit(step);
+	thread_pool_init(&step->pool, thread_count);
+
+	isize outputs_size = step->pool.thread_count * sizeof(Step_Worker_Output);
+	step->outputs = (Step_Worker_Output*) sure_realloc(NULL, outputs_size, 0, ALLOC_TAG_STEP);
+	memset(step->outputs, 0, outputs_size);
+}
+
+void parallel_step_deinit(Parallel_Step* step)
+{
+	for(i32 i = 0; i < step->pool.thread_count; i++)
+	{
+		Step_Worker_Output* output = &step->outputs[i];
+		sure_realloc(output->chunks, 0, output->chunk_capacity * sizeof(Chunk), ALLOC_TAG_CHUNKS);
+		sure_realloc(output->requests, 0, output->request_capacity * sizeof(Step_Request), ALLOC_TAG_STEP);
+	}
+
+	sure_realloc(step->outputs, 0, step->pool.thread_count * sizeof(Step_Worker_Output), ALLOC_TAG_STEP);
+	sure_realloc(step->alive, 0, step->alive_capacity * sizeof(u8), ALLOC_TAG_STEP);
+	thread_pool_deinit(&step->pool);
+	memset(step, 0, sizeof *step);
+}
+
+static void parallel_step_compute(void* context, i32 thread_index, i32 thread_count)
+{
+	Parallel_Step* step = (Parallel_Step*) context;
+	Chunk_Hash* curr_chunk_hash = step->curr_chunk_hash;
+	Step_Worker_Output* output = &step->outputs[thread_index];
+
+	output->chunk_size = 0;
+	output->request_size = 0;
+	memset(&output->stats, 0, sizeof output->stats);
+
+	i32 from = (i32) ((i64) curr_chunk_hash->chunk_size * thread_index / thread_count);
+	i32 to = (i32) ((i64) curr_chunk_hash->chunk_size * (thread_index + 1) / thread_count);
+	for(i32 i = from; i < to; i++)
+	{
+		if(step->in_place == false && output->chunk_size >= output->chunk_capacity)
+		{
+			i32 new_capacity = output->chunk_capacity * 2 + 8;
+			output->chunks = (Chunk*) sure_realloc(output->chunks, new_capacity * sizeof(Chunk), output->chunk_capacity * sizeof(Chunk), ALLOC_TAG_CHUNKS);
+			output->chunk_capacity = new_capacity;
+		}
+
+		if(output->request_size + DIRECTION_COUNT > output->request_capacity)
+		{
+			i32 new_capacity = output->request_capacity * 2 + DIRECTION_COUNT;
+			output->requests = (Step_Request*) sure_realloc(output->requests, new_capacity * sizeof(Step_Request), output->request_capacity * sizeof(Step_Request), ALLOC_TAG_STEP);
+			output->request_capacity = new_capacity;
+		}
+
+		//We compute directly into the output and only keep it if it is alive.
+		//In place the chunk goes straight into its place in the next generation.
+		u32 reached = 0;
+		Chunk* new_chunk = step->in_place ? &step->next_chunk_hash->chunks[i] : &output->chunks[output->chunk_size];
+		bool is_alive = compute_chunk(step->prev_chunk_hash, curr_chunk_hash, i, new_chunk, &reached, step->generations, step->gather_stats ? &output->stats : NULL);
+		curr_chunk_hash->meta[i].next = step->in_place && is_alive ? i : -1;
+		step->alive[i] = is_alive;
+		if(is_alive == false)
+		{
+			if(step->in_place)
+				*new_chunk = Chunk{0};
+			continue;
+		}
+
+		if(step->in_place == false)
+			output->chunk_size += 1;
+		for(i32 dir = 0; dir < DIRECTION_COUNT; dir++)
+		{
+			if(reached & (1 << dir))
+			{
+				Step_Request request = {0};
+				request.index = i;
+				request.dir = dir;
+				output->requests[output->request_size++] = request;
+			}
+		}
+	}
+}
+
+static void parallel_step_merge(void* context, i32 thread_index, i32 thread_count)
+{
+	Parallel_Step* step = (Parallel_Step*) context;
+	Chunk_Hash* curr_chunk_hash = step->curr_chunk_hash;
+	Chunk_Hash* next_chunk_hash = step->next_chunk_hash;
+	Step_Worker_Output* output = &step->outputs[thread_index];
+
+	memcpy(next_chunk_hash->chunks + output->offset, output->chunks, output->chunk_size * sizeof(Chunk));
+
+	//Our alive chunks are in the same order as in curr_chunk_hash
+	i32 from = (i32) ((i64) curr_chunk_hash->chunk_size * thread_index / thread_count);
+	i32 to = (i32) ((i64) curr_chunk_hash->chunk_size * (thread_index + 1) / thread_count);
+	i32 next_index = output->offset;
+	for(i32 i = from; i < to; i++)
+	{
+		if(step->alive[i])
+		{
+			next_chunk_hash->positions[next_index] = curr_chunk_hash->positions[i];
+			curr_chunk_hash->meta[i].next = next_index++;
+		}
+	}
+
+	for(i32 i = 0; i < output->chunk_size; i++)
+		chunk_hash_link_concurrent(next_chunk_hash, output->offset + i);
+
+	//Drop the requests for chunks that are alive in the next generation.
+	//Those were just linked by some worker.
+	i32 kept = 0;
+	for(i32 i = 0; i < output->request_size; i++)
+	{
+		Step_Request request = output->requests[i];
+		i32 neighbour = curr_chunk_hash->meta[request.index].neighbours[request.dir];
+		if(neighbour == CHUNK_LINK_NONE || step->alive[neighbour] == false)
+			output->requests[kept++] = request;
+	}
+
+	output->request_size = kept;
+}
+
+//Used when the alive chunks dont fit into next_chunk_hash. Inserts as many as fit one by one.
+static void parallel_step_merge_serial(Parallel_Step* step)
+{
+	Chunk_Hash* curr_chunk_hash = step->curr_chunk_hash;
+	Chunk_Hash* next_chunk_hash = step->next_chunk_hash;
+	for(i32 thread_index = 0; thread_index < step->pool.thread_count; thread_index++)
+	{
+		Step_Worker_Output* output = &step->outputs[thread_index];
+		i32 from = (i32) ((i64) curr_chunk_hash->chunk_size * thread_index / step->pool.thread_count);
+		i32 to = (i32) ((i64) curr_chunk_hash->chunk_size * (thread_index + 1) / step->pool.thread_count);
+		i32 output_i = 0;
+		for(i32 i = from; i < to; i++)
+		{
+			if(step->alive[i] == false)
+				continue;
+
+			i32 next_i = step_insert_known(curr_chunk_hash, next_chunk_hash, i, false);
+			if(next_i != CHUNK_HASH_FULL)
+				next_chunk_hash->chunks[next_i] = output->chunks[output_i];
+			output_i++;
+		}
+	}
+}
+
+static void parallel_step_link(void* context, i32 thread_index, i32 thread_count)
+{
+	Parallel_Step* step = (Parallel_Step*) context;
+	Chunk_Hash* curr_chunk_hash = step->curr_chunk_hash;
+
+	i32 from = (i32) ((i64) curr_chunk_hash->chunk_size * thread_index / thread_count);
+	i32 to = (i32) ((i64) curr_chunk_hash->chunk_size * (thread_index + 1) / thread_count);
+	step_link_known(curr_chunk_hash, step->next_chunk_hash, from, to);
+}
+
+void game_of_life_generation_step_parallel(Parallel_Step* step, const Chunk_Hash* prev_chunk_hash, Chunk_Hash* curr_chunk_hash, Chunk_Hash* next_chunk_hash)
+{
+	game_of_life_generation_step_multi_parallel(step, prev_chunk_hash, curr_chunk_hash, next_chunk_hash, 1, NULL);
+}
+
+void game_of_life_generation_step_multi_parallel(Parallel_Step* step, const Chunk_Hash* prev_chunk_hash, Chunk_Hash* curr_chunk_hash, Chunk_Hash* next_chunk_hash, i32 generations, Step_Stats* stats)
+{
+	PERF_COUNTER("parallel step");
+	assert(next_chunk_hash->chunk_size == 0 && "next_chunk_hash must be cleared!");
+	i32 prepared_from = curr_chunk_hash->chunk_size;
+	step_prepare(curr_chunk_hash, generations);
+
+	if(step->alive_capacity < curr_chunk_hash->chunk_size)
+	{
+		i32 new_capacity = curr_chunk_hash->chunk_size * 2;
+		step->alive = (u8*) sure_realloc(step->alive, new_capacity * sizeof(u8), step->alive_capacity * sizeof(u8), ALLOC_TAG_STEP);
+		step->alive_capacity = new_capacity;
+	}
+
+	step->prev_chunk_hash = prev_chunk_hash;
+	step->curr_chunk_hash = curr_chunk_hash;
+	step->next_chunk_hash = next_chunk_hash;
+	step->generations = generations;
+	step->gather_stats = stats != NULL;
+	step->in_place = step_begin_in_place(curr_chunk_hash, next_chunk_hash);
+
+	{
+		PERF_COUNTER("parallel compute");
+		thread_pool_run(&step->pool, parallel_step_compute, step);
+	}
+
+	Step_Stats gathered = {0};
+	for(i32 i = 0; i < step->pool.thread_count && stats != NULL; i++)
+		stats_add(&gathered, &step->outputs[i].stats);
+
+	//In place the alive chunks already are where they belong
+	if(step->in_place == false)
+	{
+		PERF_COUNTER("parallel merge");
+		i32 total_size = 0;
+		for(i32 i = 0; i < step->pool.thread_count; i++)
+		{
+			step->outputs[i].offset = total_size;
+			total_size += step->outputs[i].chunk_size;
+		}
+
+		if(chunk_hash_reserve(next_chunk_hash, total_size))
+		{
+			next_chunk_hash->chunk_size = total_size;
+			thread_pool_run(&step->pool, parallel_step_merge, step);
+		}
+		else
+			parallel_step_merge_serial(step);
+	}
+
+	{
+		PERF_COUNTER("neighbour add");
+		for(i32 i = 0; i < step->pool.thread_count; i++)
+		{
+			Step_Worker_Output* output = &step->outputs[i];
+			for(i32 j = 0; j < output->request_size; j++)
+				gathered.created_chunks += step_insert_neighbour(curr_chunk_hash, next_chunk_hash, output->requests[j].index, output->requests[j].dir, step->in_place);
+		}
+
+		if(step->in_place)
+			step_finish_in_place(curr_chunk_hash, next_chunk_hash);
+	}
+
+	{
+		PERF_COUNTER("neighbour link");
+		thread_pool_run(&step->pool, parallel_step_link, step);
+		step_link_new(next_chunk_hash);
+	}
+
+	next_chunk_hash->step_generations = generations;
+	step->prev_chunk_hash = NULL;
+	step->curr_chunk_hash = NULL;
+	step->next_chunk_hash = NULL;
+	if(stats != NULL)
+		step_finish_stats(curr_chunk_hash, next_chunk_hash, prepared_from, generations, &gathered, stats);
+}
@@ -0,0 +1,134 @@
+#pragma once
+#include "chunk_hash.h"
+#include "threads.h"
+
+// This file provides the generation step of the symulation.
+//
+// The step reads all chunks of curr_chunk_hash and writes the resulting generation
+// into next_chunk_hash (which should be cleared before). Every chunk that is alive in the
+// next generation gets inserted together with the neighbouring chunks its cells reach into
+// (so that cells can be born there in the generation after).
+//
+// The neighbours of each chunk are read from its Chunk_Meta links instead of looking them up.
+// The links of the next generation are derived from the current ones: every chunk remembers its index
+// in next_chunk_hash so a neighbour in the next generation is just the next index of the current neighbour.
+// Only the chunks that were not present in the current generation (the border) have to be looked up.
+//
+// Usually the next generation keeps every chunk of the current one at the same index. Then the positions, slots and tags
+// are just copied over (chunk_hash_copy_index), the chunks are computed straight into their place and only the new chunks
+// at the border of the pattern are inserted. Steady generations do no hash inserts at all. Chunks that died and that no alive chunk
+// reaches into are kept as empty chunks (which the step skips cheaply) and counted in unneeded_count of the next generation.
+// Once more than 1/STEP_COMPACT_FRACTION of the chunks are unneeded the next generation is instead built by inserting only the
+// needed chunks which removes them.
+//
+// Chunks whose result is known without computing are skipped (see Chunk_Flag). When a chunk and the borders
+// of its neighbours are the same as one generation ago the result is just the chunk. When they are the same as
+// two generations ago the result is the chunk from the previous generation (read from prev_chunk_hash).
+// Because of that prev_chunk_hash has to be the hash passed as curr_chunk_hash to the previous step. It can be NULL
+// (then only the still lifes are skipped). We always keep 3 hashes and rotate them.
+//
+// Temporal blocking: the _multi versions advance every chunk by several generations per visit. The chunk is assembled with
+// a margin of that many cells from its neighbours and the kernel runs that many times over it (see life_kernel_run_wide).
+// The links, skipping, flags and inserts are then paid once per several generations and the block stays in L1 between the runs.
+// The cells spread one cell per generation so every chunk within that many cells of an alive cell has to be present and
+// the flags compare against that many generations ago with borders as wide (see Chunk_Hash::step_generations).
+// When curr_chunk_hash was made by a step of other generations its history is forgotten for one step and if it was
+// fewer the missing chunks are first inserted into it. Because of that it must not be read by anyone else during such step.
+//
+// The _multi versions can also gather the Step_Stats of the generation they make. Every chunk is counted right after
+// it is computed (while it is still in L1) so nobody needs another pass over all chunks to know the population or the extent.
+// They still cost up to 3 popcounts per word of every chunk (and the hash) so they are only gathered when asked for.
+// The hash of the universe in them is what lets Cycle_Detector stop runs that became periodic (see universe_hash.h).
+//
+// There is a serial and a parallel version. Both produce the same set of chunks
+// with the same content, only the order of the chunks in next_chunk_hash can differ.
+
+#define STEP_COMPACT_FRACTION 8 /* see above */
+
+//Statistics of the generation made by a step. When stepping by several generations
+//the births and deaths are counted against curr_chunk_hash (that many generations ago).
+typedef struct Step_Stats
+{
+	i64 population; //alive cells
+	i64 births; //cells alive that were dead in curr_chunk_hash
+	i64 deaths; //cells dead that were alive in curr_chunk_hash
+
+	//bounding box of the alive cells in symulation positions (both inclusive). Only valid when population > 0
+	Vec2i min;
+	Vec2i max;
+
+	i32 live_chunks; //chunks with alive cells
+	i32 empty_chunks; //chunks without alive cells (the border around the pattern and the unneeded ones)
+	i32 created_chunks; //chunks that were not present in curr_chunk_hash before the step
+	i32 generations; //advanced by the step
+
+	u64 hash; //of the alive cells (see universe_hash.h)
+} Step_Stats;
+
+//A single generation step of the symulation
+void game_of_life_generation_step(const Chunk_Hash* prev_chunk_hash, Chunk_Hash* curr_chunk_hash, Chunk_Hash* next_chunk_hash);
+//Advances by generations (1 to LIFE_WIDE_MARGIN) in a single step. prev_chunk_hash is then that many generations before curr_chunk_hash.
+//Fills stats of next_chunk_hash unless it is NULL.
+void game_of_life_generation_step_multi(const Chunk_Hash* prev_chunk_hash, Chunk_Hash* curr_chunk_hash, Chunk_Hash* next_chunk_hash, i32 generations, Step_Stats* stats);
+
+//Neighbour in dir of the chunk at index (of curr_chunk_hash) reached by the new cells
+typedef struct Step_Request
+{
+	i32 index;
+	i32 dir;
+} Step_Request;
+
+//Output of a single worker of the parallel step.
+//We keep them around between the steps so that we dont need to allocate every generation.
+typedef struct Step_Worker_Output
+{
+	Chunk* chunks;
+	i32 chunk_size;
+	i32 chunk_capacity;
+
+	//neighbouring chunks the new chunks reach into
+	Step_Request* requests;
+	i32 request_size;
+	i32 request_capacity;
+
+	//index into next_chunk_hash->chunks where chunks of this worker are placed
+	i32 offset;
+
+	//of the chunks computed by this worker if gathered (the created chunks are counted when merging)
+	Step_Stats stats;
+} Step_Worker_Output;
+
+typedef struct Parallel_Step
+{
+	Thread_Pool pool;
+	Step_Worker_Output* outputs; //one per thread
+
+	//for each chunk of curr_chunk_hash 1 if it is alive in the next generation
+	u8* alive;
+	i32 alive_capacity;
+
+	const Chunk_Hash* prev_chunk_hash;
+	Chunk_Hash* curr_chunk_hash;
+	Chunk_Hash* next_chunk_hash;
+	bool in_place; //next_chunk_hash keeps the indices of curr_chunk_hash (the outputs are not used)
+	i32 generations; //advanced by the current step
+	bool gather_stats; //the workers fill the stats of their outputs
+} Parallel_Step;
+
+//If thread_count <= 0 uses the number of hardware threads
+void parallel_step_init(Parallel_Step* step, i32 thread_count);
+void parallel_step_deinit(Parallel_Step* step);
+
+// A single generation step split across the thread pool of step.
+//
+// In place each worker computes a contiguous range of curr_chunk_hash->chunks straight into next_chunk_hash
+// and only the new chunks are inserted serially. Otherwise each worker computes its range into its own output.
+// The outputs are then merged into next_chunk_hash without any locking:
+// 1) The alive chunks are copied into disjoint ranges of next_chunk_hash->chunks and linked into
+//    the (reserved up front) hash slots by atomic compare and swap. Their positions are unique so this
+//    cannot conflict.
+// 2) Requested neighbours that are alive anyways are dropped (checked in parallel through the links).
+//    Only the few remaining ones (the empty border around the pattern) are inserted serially.
+// 3) The neighbour links of next_chunk_hash are moved over from curr_chunk_hash in parallel.
+void game_of_life_generation_step_parallel(Parallel_Step* step, const Chunk_Hash* prev_chunk_hash, Chunk_Hash* curr_chunk_hash, Chunk_Hash* next_chunk_hash);
+void game_of_life_generation_step_multi_parallel(Parallel_Step* step, const Chunk_Hash* prev_chunk_hash, Chunk_Hash* curr_chunk_hash, Chunk_Hash* next_chunk_hash, i32 generations, Step_Stats* stats);
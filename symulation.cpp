@@ -0,0 +1,370 @@
+#include "symulation.h"
+#include "step.h"
+#include "hashlife.h"
+#include "snapshot.h"
+#include "time.h"
+#include "perf.h"
+#include "alloc.h"
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+typedef struct Cell_Edit
+{
+	Vec2i pos;
+	bool to;
+} Cell_Edit;
+
+struct Symulation_State
+{
+	std::mutex mutex;
+	std::condition_variable changed; //notified on every change of anything below
+	std::thread thread;
+
+	//Only the symulation thread ever modifies the hashes. The indices are changed under the mutex.
+	Chunk_Hash hashes[SYMULATION_HASHES] = {};
+	i32 prev = -1; //the generation before curr (-1 if unknown, after hashlife or loading)
+	i32 curr = 0;  //the newest published generation
+	i32 acquired = -1; //by symulation_acquire (-1 if none)
+	bool writing = false; //curr is being modified by the symulation thread and cannot be acquired
+
+	i64 generation = 0;
+	u64 version = 0;
+	i64 updates = 0;
+	f64 last_update_duration = 0;
+	Step_Stats last_step = {};
+	f64 last_update_clock = 0; //when the last update finished
+	i64 unsorted_updates = 0; //chunk steps since curr was last sorted (see chunk_hash_sort)
+	Symulation_Settings settings = {};
+
+	//queued by symulation_set_cell. The symulation thread swaps them with applied_edits
+	Cell_Edit* edits = NULL;
+	i32 edit_count = 0;
+	i32 edit_capacity = 0;
+	Cell_Edit* applied_edits = NULL;
+	i32 applied_edit_capacity = 0;
+
+	char* load_path = NULL; //queued by symulation_load_snapshot
+	isize load_path_size = 0;
+	bool quit = false;
+
+	//used only by the symulation thread
+	Parallel_Step parallel_step = {};
+	bool use_parallel_step = false;
+	Hashlife hashlife = {};
+	bool hashlife_outdated = true; //curr was changed and needs to be imported again
+};
+
+//Returns a hash that is neither of prev, curr or acquired
+static i32 symulation_free_hash(const Symulation_State* state)
+{
+	for(i32 i = 0; i < SYMULATION_HASHES; i++)
+		if(i != state->prev && i != state->curr && i != state->acquired)
+			return i;
+
+	assert(false && "there are always more hashes than the ones in use");
+	return -1;
+}
+
+//Makes hashes[index] the newest generation. Has to be called with the mutex locked.
+static void symulation_publish(Symulation_State* state, i32 index, i32 prev, i64 generation)
+{
+	state->prev = prev;
+	state->curr = index;
+	state->generation = generation;
+	state->version += 1;
+
+	if(state->hashes[index].full)
+	{
+		printf("the universe does not fit into memory anymore (some chunks are missing), pausing\n");
+		state->settings.paused = true;
+	}
+	state->changed.notify_all();
+}
+
+static void symulation_apply_edits(Symulation_State* state, std::unique_lock<std::mutex>* lock)
+{
+	PERF_COUNTER("edits");
+	state->changed.wait(*lock, [&]{ return state->acquired != state->curr || state->quit; });
+	if(state->quit)
+		return;
+
+	//Swap the queue so that new edits can be queued while we apply these
+	Cell_Edit* edits = state->edits;
+	i32 edit_count = state->edit_count;
+	i32 edit_capacity = state->edit_capacity;
+	state->edits = state->applied_edits;
+	state->edit_capacity = state->applied_edit_capacity;
+	state->edit_count = 0;
+	state->applied_edits = edits;
+	state->applied_edit_capacity = edit_capacity;
+
+	state->writing = true;
+	Chunk_Hash* curr = &state->hashes[state->curr];
+	lock->unlock();
+
+	for(i32 i = 0; i < edit_count; i++)
+		set_cell_at(curr, edits[i].pos, edits[i].to);
+
+	lock->lock();
+	state->writing = false;
+	state->version += 1;
+	state->hashlife_outdated = true;
+	state->changed.notify_all();
+}
+
+static void symulation_load(Symulation_State* state, std::unique_lock<std::mutex>* lock)
+{
+	char* path = state->load_path;
+	isize path_size = state->load_path_size;
+	state->load_path = NULL;
+	state->load_path_size = 0;
+
+	//Nobody else is looking at the free hash so we can load without holding the lock
+	i32 into = symulation_free_hash(state);
+	lock->unlock();
+
+	i64 generation = 0;
+	Snapshot_Error error = snapshot_load(&state->hashes[into], &generation, path);
+	printf("loading snapshot '%s': %s\n", path, snapshot_error_to_string(error));
+	sure_realloc(path, 0, path_size, ALLOC_TAG_FILE);
+
+	lock->lock();
+	if(error == SNAPSHOT_ERROR_NONE)
+	{
+		state->hashlife_outdated = true;
+		symulation_publish(state, into, -1, generation);
+	}
+}
+
+//Replaces curr by a copy with the chunks in Morton order. It is the same generation so the history stays.
+static void symulation_sort(Symulation_State* state, std::unique_lock<std::mutex>* lock)
+{
+	i32 prev = state->prev;
+	i32 curr = state->curr;
+	i32 into = symulation_free_hash(state);
+	state->unsorted_updates = 0;
+
+	//Only we change curr and prev. Nobody else looks at the free hash.
+	lock->unlock();
+	bool sorted = chunk_hash_sort(&state->hashes[curr], &state->hashes[into]);
+	lock->lock();
+
+	if(sorted)
+		symulation_publish(state, into, prev, state->generation);
+}
+
+static void symulation_update(Symulation_State* state, std::unique_lock<std::mutex>* lock)
+{
+	PERF_COUNTER("update");
+	Symulation_Settings settings = state->settings;
+	i32 prev = state->prev;
+	i32 curr = state->curr;
+	i32 next = symulation_free_hash(state);
+	bool hashlife_outdated = state->hashlife_outdated;
+
+	//curr can be acquired while we read it. The step writes only its Chunk_Meta which readers dont look at.
+	lock->unlock();
+	f64 update_start = clock_s();
+
+	Chunk_Hash* curr_chunk_hash = &state->hashes[curr];
+	Chunk_Hash* next_chunk_hash = &state->hashes[next];
+	i64 generations = 1;
+	Step_Stats step_stats = {0};
+	if(settings.use_hashlife)
+	{
+		if(hashlife_outdated)
+			hashlife_import(&state->hashlife, curr_chunk_hash);
+
+		hashlife_step(&state->hashlife, settings.hashlife_step_log2);
+		hashlife_export(&state->hashlife, next_chunk_hash);
+		generations = (i64) 1 << settings.hashlife_step_log2;
+		step_stats.population = (i64) hashlife_population(&state->hashlife);
+	}
+	else
+	{
+		const Chunk_Hash* prev_chunk_hash = prev != -1 ? &state->hashes[prev] : NULL;
+		chunk_hash_clear(next_chunk_hash);
+		if(state->use_parallel_step)
+			game_of_life_generation_step_multi_parallel(&state->parallel_step, prev_chunk_hash, curr_chunk_hash, next_chunk_hash, 1, &step_stats);
+		else
+			game_of_life_generation_step_multi(prev_chunk_hash, curr_chunk_hash, next_chunk_hash, 1, &step_stats);
+	}
+
+	f64 update_end = clock_s();
+	lock->lock();
+
+	state->updates += 1;
+	state->unsorted_updates += settings.use_hashlife == false;
+	state->last_update_duration = update_end - update_start;
+	state->last_step = step_stats;
+	state->last_update_clock = update_end;
+	state->hashlife_outdated = settings.use_hashlife == false;
+
+	//The next chunk step can use curr to skip chunks. The hashlife output has no such history.
+	symulation_publish(state, next, settings.use_hashlife ? -1 : curr, state->generation + generations);
+}
+
+static void symulation_thread(Symulation_State* state)
+{
+	std::unique_lock<std::mutex> lock(state->mutex);
+	while(state->quit == false)
+	{
+		f64 next_update_clock = state->last_update_clock + state->settings.update_period_ms / 1000;
+		if(state->load_path != NULL)
+			symulation_load(state, &lock);
+		else if(state->edit_count > 0)
+			symulation_apply_edits(state, &lock);
+		else if(state->unsorted_updates >= CHUNK_HASH_SORT_PERIOD)
+			symulation_sort(state, &lock);
+		else if(state->settings.paused == false && clock_s() >= next_update_clock)
+			symulation_update(state, &lock);
+		else if(state->settings.paused)
+			state->changed.wait(lock);
+		else
+		{
+			f64 wait_ms = (next_update_clock - clock_s()) * 1000;
+			state->changed.wait_for(lock, std::chrono::duration<f64, std::milli>(wait_ms));
+		}
+	}
+}
+
+void symulation_init(Symulation* sym, Chunk_Hash* universe, i64 generation, Symulation_Settings settings, i32 threads, isize hashlife_memory_budget)
+{
+	symulation_deinit(sym);
+
+	Symulation_State* state = new Symulation_State;
+	for(i32 i = 0; i < SYMULATION_HASHES; i++)
+		chunk_hash_init(&state->hashes[i]);
+
+	state->hashes[0] = *universe;
+	memset(universe, 0, sizeof *universe);
+	chunk_hash_init(universe);
+
+	state->generation = generation;
+	state->settings = settings;
+	state->last_update_clock = clock_s();
+
+	state->use_parallel_step = threads != 1;
+	if(state->use_parallel_step)
+		parallel_step_init(&state->parallel_step, threads);
+	hashlife_init(&state->hashlife, hashlife_memory_budget);
+
+	state->thread = std::thread(symulation_thread, state);
+	sym->state = state;
+}
+
+void symulation_deinit(Symulation* sym)
+{
+	Symulation_State* state = sym->state;
+	if(state == NULL)
+		return;
+
+	{
+		std::unique_lock<std::mutex> lock(state->mutex);
+		state->quit = true;
+	}
+	state->changed.notify_all();
+	state->thread.join();
+
+	for(i32 i = 0; i < SYMULATION_HASHES; i++)
+		chunk_hash_deinit(&state->hashes[i]);
+
+	parallel_step_deinit(&state->parallel_step);
+	hashlife_deinit(&state->hashlife);
+	sure_realloc(state->edits, 0, state->edit_capacity * sizeof(Cell_Edit), ALLOC_TAG_STEP);
+	sure_realloc(state->applied_edits, 0, state->applied_edit_capacity * sizeof(Cell_Edit), ALLOC_TAG_STEP);
+	sure_realloc(state->load_path, 0, state->load_path_size, ALLOC_TAG_FILE);
+
+	delete state;
+	sym->state = NULL;
+}
+
+Symulation_Settings symulation_get_settings(Symulation* sym)
+{
+	std::unique_lock<std::mutex> lock(sym->state->mutex);
+	return sym->state->settings;
+}
+
+void symulation_set_settings(Symulation* sym, Symulation_Settings settings)
+{
+	Symulation_State* state = sym->state;
+	{
+		std::unique_lock<std::mutex> lock(state->mutex);
+		state->settings = settings;
+	}
+	state->changed.notify_all();
+}
+
+Symulation_Stats symulation_get_stats(Symulation* sym)
+{
+	Symulation_State* state = sym->state;
+	std::unique_lock<std::mutex> lock(state->mutex);
+
+	Symulation_Stats stats = {0};
+	stats.generation = state->generation;
+	stats.updates = state->updates;
+	stats.last_update_duration = state->last_update_duration;
+	stats.last_step = state->last_step;
+	return stats;
+}
+
+void symulation_set_cell(Symulation* sym, Vec2i sym_pos, bool to)
+{
+	Symulation_State* state = sym->state;
+	{
+		std::unique_lock<std::mutex> lock(state->mutex);
+		if(state->edit_count >= state->edit_capacity)
+		{
+			i32 new_capacity = state->edit_capacity * 2 + 64;
+			state->edits = (Cell_Edit*) sure_realloc(state->edits, new_capacity * sizeof(Cell_Edit), state->edit_capacity * sizeof(Cell_Edit), ALLOC_TAG_STEP);
+			state->edit_capacity = new_capacity;
+		}
+
+		Cell_Edit edit = {sym_pos, to};
+		state->edits[state->edit_count++] = edit;
+	}
+	state->changed.notify_all();
+}
+
+void symulation_load_snapshot(Symulation* sym, const char* path)
+{
+	Symulation_State* state = sym->state;
+	{
+		std::unique_lock<std::mutex> lock(state->mutex);
+		sure_realloc(state->load_path, 0, state->load_path_size, ALLOC_TAG_FILE);
+
+		state->load_path_size = (isize) strlen(path) + 1;
+		state->load_path = (char*) sure_realloc(NULL, state->load_path_size, 0, ALLOC_TAG_FILE);
+		memcpy(state->load_path, path, state->load_path_size);
+	}
+	state->changed.notify_all();
+}
+
+Chunk_Hash* symulation_acquire(Symulation* sym, u64* version, i64* generation)
+{
+	Symulation_State* state = sym->state;
+	std::unique_lock<std::mutex> lock(state->mutex);
+	assert(state->acquired == -1 && "only one generation can be acquired at a time");
+
+	state->changed.wait(lock, [&]{ return state->writing == false; });
+	state->acquired = state->curr;
+	if(version)
+		*version = state->version;
+	if(generation)
+		*generation = state->generation;
+
+	return &state->hashes[state->acquired];
+}
+
+void symulation_release(Symulation* sym)
+{
+	Symulation_State* state = sym->state;
+	{
+		std::unique_lock<std::mutex> lock(state->mutex);
+		assert(state->acquired != -1);
+		state->acquired = -1;
+	}
+	state->changed.notify_all();
+}
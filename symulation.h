@@ -0,0 +1,67 @@
+#pragma once
+#include "chunk_hash.h"
+#include "step.h"
+
+// This file runs the symulation on its own thread so that a slow generation does not freeze the window
+// and drawing does not slow down the symulation.
+//
+// The symulation thread owns SYMULATION_HASHES chunk hashes. Every finished generation (chunk step,
+// hashlife jump or a loaded snapshot) is written into a hash nobody else is looking at and then published
+// as the newest one. The renderer acquires the newest generation, reads it for as long as it wants and
+// releases it. An acquired hash is never modified: the step only reads the two newest generations and
+// writes into one that is neither of those nor acquired (with 4 hashes there is always one).
+// Every CHUNK_HASH_SORT_PERIOD chunk steps the newest generation is copied the same way with its chunks
+// in Morton order (see chunk_hash_sort) and the copy is published instead.
+//
+// All changes from the outside are queued and applied by the symulation thread. Edits (symulation_set_cell)
+// are applied to the newest generation right before the next one is computed from it (or right away when paused).
+// That is the only time a published generation is modified so the symulation thread first waits for the
+// renderer to release it and acquire waits for the few microseconds the edits take.
+//
+// Every change of the newest generation increments its version so that the renderer can tell
+// whether anything changed since the last frame (see texture_atlas.h).
+
+#define SYMULATION_HASHES 4
+
+typedef struct Symulation_Settings
+{
+	f64 update_period_ms; //the time between the end of one update and the start of the next
+	bool paused;
+	bool use_hashlife; //advance the universe by the hashlife engine instead of the chunk step
+	i32 hashlife_step_log2; //generations per hashlife update (2^N)
+} Symulation_Settings;
+
+typedef struct Symulation_Stats
+{
+	i64 generation;
+	i64 updates; //number of finished updates (generations or hashlife jumps)
+	f64 last_update_duration; //in seconds
+	Step_Stats last_step; //of the last update. After a hashlife update only the population is known
+} Symulation_Stats;
+
+typedef struct Symulation_State Symulation_State;
+
+typedef struct Symulation
+{
+	Symulation_State* state;
+} Symulation;
+
+//Starts the symulation thread. Takes over the universe (leaving it empty but initialized).
+//threads are used by the chunk step (see parallel_step_init, 1 runs the serial step).
+void symulation_init(Symulation* sym, Chunk_Hash* universe, i64 generation, Symulation_Settings settings, i32 threads, isize hashlife_memory_budget);
+void symulation_deinit(Symulation* sym);
+
+Symulation_Settings symulation_get_settings(Symulation* sym);
+void symulation_set_settings(Symulation* sym, Symulation_Settings settings);
+Symulation_Stats symulation_get_stats(Symulation* sym);
+
+//Queues setting the cell at the symulation position sym_pos
+void symulation_set_cell(Symulation* sym, Vec2i sym_pos, bool to);
+
+//Queues replacing the universe with the snapshot at path (see snapshot.h). The result is printed.
+void symulation_load_snapshot(Symulation* sym, const char* path);
+
+//Returns the newest generation which stays unchanged untill symulation_release. It must not be modified.
+//Only one generation can be acquired at a time. version and generation can be NULL.
+Chunk_Hash* symulation_acquire(Symulation* sym, u64* version, i64* generation);
+void symulation_release(Symulation* sym);
@@ -0,0 +1,185 @@
+#include "texture_atlas.h"
+#include "perf.h"
+#include "alloc.h"
+
+static u64 atlas_hash_pos(Vec2i pos)
+{
+	u64 hash = (u64) (u32) pos.y << 32 | (u32) pos.x;
+	hash = (hash ^ (hash >> 30)) * (u64) 0xbf58476d1ce4e5b9;
+	hash = (hash ^ (hash >> 27)) * (u64) 0x94d049bb133111eb;
+	return hash ^ (hash >> 31);
+}
+
+void texture_atlas_init(Texture_Atlas* atlas, SDL_Renderer* renderer)
+{
+	memset(atlas, 0, sizeof *atlas);
+	atlas->texture = SDL_CreateTexture(renderer,
+                           SDL_PIXELFORMAT_BGRA8888,
+                           SDL_TEXTUREACCESS_STATIC,
+                           TEXTURE_ATLAS_SIZE,
+                           TEXTURE_ATLAS_SIZE);
+
+	atlas->slots_per_side = TEXTURE_ATLAS_SIZE / CHUNK_SIZE;
+	atlas->slot_count = atlas->slots_per_side * atlas->slots_per_side;
+	atlas->slots = (Texture_Atlas_Slot*) sure_realloc(NULL, atlas->slot_count * sizeof(Texture_Atlas_Slot), 0, ALLOC_TAG_RENDER);
+	memset(atlas->slots, 0, atlas->slot_count * sizeof(Texture_Atlas_Slot));
+	atlas->newest = -1;
+	atlas->oldest = -1;
+
+	//We keep the linear probing hash at most 25% full. Since there is a fixed number of slots it never grows.
+	atlas->hash_capacity = 64;
+	while(atlas->hash_capacity < atlas->slot_count * 4)
+		atlas->hash_capacity *= 2;
+	atlas->hash = (i32*) sure_realloc(NULL, atlas->hash_capacity * sizeof(i32), 0, ALLOC_TAG_RENDER);
+	memset(atlas->hash, 0, atlas->hash_capacity * sizeof(i32));
+
+	atlas->pixels = (u32*) sure_realloc(NULL, CHUNK_SIZE * CHUNK_SIZE * sizeof(u32), 0, ALLOC_TAG_RENDER);
+}
+
+void texture_atlas_deinit(Texture_Atlas* atlas)
+{
+	if(atlas->texture != NULL)
+		SDL_DestroyTexture(atlas->texture);
+	sure_realloc(atlas->slots, 0, atlas->slot_count * sizeof(Texture_Atlas_Slot), ALLOC_TAG_RENDER);
+	sure_realloc(atlas->hash, 0, atlas->hash_capacity * sizeof(i32), ALLOC_TAG_RENDER);
+	sure_realloc(atlas->pixels, 0, CHUNK_SIZE * CHUNK_SIZE * sizeof(u32), ALLOC_TAG_RENDER);
+	memset(atlas, 0, sizeof *atlas);
+}
+
+//Returns the hash slot holding the slot at pos or the empty hash slot where it would go
+static u64 atlas_hash_find(const Texture_Atlas* atlas, Vec2i pos)
+{
+	u64 mod = (u64) atlas->hash_capacity - 1;
+	u64 at = atlas_hash_pos(pos) & mod;
+	for(; atlas->hash[at] != 0; at = (at + 1) & mod)
+		if(vec_equal(atlas->slots[atlas->hash[at] - 1].pos, pos))
+			break;
+
+	return at;
+}
+
+//Removes the entry at from the hash shifting back the entries after it that would no longer be found
+static void atlas_hash_remove(Texture_Atlas* atlas, u64 at)
+{
+	u64 mod = (u64) atlas->hash_capacity - 1;
+	atlas->hash[at] = 0;
+	for(u64 next = (at + 1) & mod; atlas->hash[next] != 0; next = (next + 1) & mod)
+	{
+		u64 home = atlas_hash_pos(atlas->slots[atlas->hash[next] - 1].pos) & mod;
+
+		//Moves the entry into the hole unless its home lies cyclically in (at, next]
+		bool reachable = at <= next ? (at < home && home <= next) : (at < home || home <= next);
+		if(reachable == false)
+		{
+			atlas->hash[at] = atlas->hash[next];
+			atlas->hash[next] = 0;
+			at = next;
+		}
+	}
+}
+
+static void atlas_lru_unlink(Texture_Atlas* atlas, i32 index)
+{
+	Texture_Atlas_Slot* slot = &atlas->slots[index];
+	if(slot->newer != -1)
+		atlas->slots[slot->newer].older = slot->older;
+	else
+		atlas->newest = slot->older;
+
+	if(slot->older != -1)
+		atlas->slots[slot->older].newer = slot->newer;
+	else
+		atlas->oldest = slot->newer;
+}
+
+static void atlas_lru_push_newest(Texture_Atlas* atlas, i32 index)
+{
+	Texture_Atlas_Slot* slot = &atlas->slots[index];
+	slot->newer = -1;
+	slot->older = atlas->newest;
+	if(atlas->newest != -1)
+		atlas->slots[atlas->newest].newer = index;
+	else
+		atlas->oldest = index;
+	atlas->newest = index;
+}
+
+static SDL_Rect atlas_slot_rect(const Texture_Atlas* atlas, i32 index)
+{
+	SDL_Rect rect = {0};
+	rect.x = (index % atlas->slots_per_side) * CHUNK_SIZE;
+	rect.y = (index / atlas->slots_per_side) * CHUNK_SIZE;
+	rect.w = CHUNK_SIZE;
+	rect.h = CHUNK_SIZE;
+	return rect;
+}
+
+static void atlas_upload(Texture_Atlas* atlas, i32 index, const Chunk* chunk, u32 clear_color)
+{
+	PERF_COUNTER("upload");
+	for(i32 j = 0; j < CHUNK_SIZE; j++)
+	{
+		const u64* row = chunk_row(chunk, j);
+		u32* pixels = atlas->pixels + j*CHUNK_SIZE;
+		for(i32 i = 0; i < CHUNK_SIZE; i += 64)
+		{
+			i32 count = CHUNK_SIZE - i < 64 ? CHUNK_SIZE - i : 64;
+			u64 bits = chunk_row_get_bits(row, i, count);
+			for(i32 k = 0; k < count; k++)
+				pixels[i + k] = (bits >> k) & 1 ? (u32) -1 : clear_color;
+		}
+	}
+
+	SDL_Rect rect = atlas_slot_rect(atlas, index);
+	SDL_UpdateTexture(atlas->texture, &rect, atlas->pixels, CHUNK_SIZE * (int) sizeof(u32));
+	atlas->uploads += 1;
+}
+
+SDL_Rect texture_atlas_get(Texture_Atlas* atlas, Vec2i pos, const Chunk* chunk, u64 version, u32 clear_color)
+{
+	u64 at = atlas_hash_find(atlas, pos);
+	i32 index = atlas->hash[at] - 1;
+	if(index != -1)
+	{
+		Texture_Atlas_Slot* slot = &atlas->slots[index];
+		atlas_lru_unlink(atlas, index);
+		atlas_lru_push_newest(atlas, index);
+
+		bool same = slot->version == version
+			|| (slot->clear_color == clear_color && memcmp(slot->data, chunk->data, sizeof chunk->data) == 0);
+		slot->version = version;
+		if(same)
+		{
+			atlas->hits += 1;
+			return atlas_slot_rect(atlas, index);
+		}
+	}
+	else
+	{
+		//Take a free slot or evict the least recently used one
+		if(atlas->used_count < atlas->slot_count)
+			index = atlas->used_count++;
+		else
+		{
+			index = atlas->oldest;
+			atlas_lru_unlink(atlas, index);
+			atlas_hash_remove(atlas, atlas_hash_find(atlas, atlas->slots[index].pos));
+			atlas->evictions += 1;
+
+			//the removal might have moved entries around
+			at = atlas_hash_find(atlas, pos);
+		}
+
+		Texture_Atlas_Slot* slot = &atlas->slots[index];
+		slot->pos = pos;
+		slot->version = version;
+		atlas->hash[at] = index + 1;
+		atlas_lru_push_newest(atlas, index);
+	}
+
+	Texture_Atlas_Slot* slot = &atlas->slots[index];
+	slot->clear_color = clear_color;
+	memcpy(slot->data, chunk->data, sizeof chunk->data);
+	atlas_upload(atlas, index, chunk, clear_color);
+	return atlas_slot_rect(atlas, index);
+}
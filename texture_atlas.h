@@ -0,0 +1,64 @@
+#pragma once
+#include "chunk.h"
+
+#include <SDL/SDL.h>
+
+// This file provides a cache of the pixels of drawn chunks so that they dont need to be expanded and
+// uploaded every frame.
+//
+// All cached chunks live in a single big texture (atlas) split into CHUNK_SIZE x CHUNK_SIZE slots.
+// Slots are found by chunk position through an open addressing hash. Next to every slot we keep a copy of
+// the bits it was expanded from and the version of the universe it was last checked against. The caller
+// bumps the version whenever the universe changes (a generation, drawing, loading...). While the version stays
+// the same (the symulation is paused) a cached slot is used right away, otherwise its bits are compared
+// with the chunk and only chunks that really changed are expanded and uploaded again (still lifes and
+// empty areas never are).
+//
+// When all slots are used the least recently drawn one is evicted. If more chunks are visible than
+// there are slots everything still works, just some chunks are uploaded every frame.
+
+#define TEXTURE_ATLAS_SIZE 4096 /* width and height of the atlas texture in pixels */
+
+typedef struct Texture_Atlas_Slot
+{
+	Vec2i pos;
+	u64 version;
+	u32 clear_color;
+
+	//least recently used list (most recent first). -1 is the end
+	i32 newer;
+	i32 older;
+
+	u64 data[CHUNK_ROWS * CHUNK_ROW_WORDS]; //copy of Chunk::data the pixels were expanded from
+} Texture_Atlas_Slot;
+
+typedef struct Texture_Atlas
+{
+	SDL_Texture* texture;
+	i32 slots_per_side;
+
+	Texture_Atlas_Slot* slots;
+	i32 slot_count;
+	i32 used_count;
+	i32 newest; //-1 if none
+	i32 oldest; //-1 if none
+
+	//index + 1 of the slot (0 means empty)
+	i32* hash;
+	i32 hash_capacity;
+
+	u32* pixels; //CHUNK_SIZE x CHUNK_SIZE scratch for expanding a chunk
+
+	//since init
+	i64 hits;
+	i64 uploads;
+	i64 evictions;
+} Texture_Atlas;
+
+void texture_atlas_init(Texture_Atlas* atlas, SDL_Renderer* renderer);
+void texture_atlas_deinit(Texture_Atlas* atlas);
+
+//Returns the rectangle of atlas->texture holding the pixels of chunk at pos (alive cells white, dead cells clear_color).
+//The chunk is expanded and uploaded first unless it is cached and did not change since.
+//version identifies the state of the universe and has to change whenever any chunk could have changed.
+SDL_Rect texture_atlas_get(Texture_Atlas* atlas, Vec2i pos, const Chunk* chunk, u64 version, u32 clear_color);
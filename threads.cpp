@@ -0,0 +1,129 @@
+#include "threads.h"
+#include "alloc.h"
+#include "perf.h"
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+struct Thread_Pool_State
+{
+	std::mutex mutex;
+	std::condition_variable work_ready;
+	std::condition_variable work_done;
+
+	Thread_Pool_Func func = NULL;
+	void* context = NULL;
+	i32 perf_scope = PERF_NO_SCOPE; //of the caller of thread_pool_run so that the counters of workers nest under it
+
+	//Incremented on every thread_pool_run. Workers wait for it to change.
+	u64 generation = 0;
+	i32 running = 0;
+	bool quit = false;
+
+	std::thread* threads = NULL;
+	i32 thread_count = 0;
+};
+
+static void thread_pool_worker(Thread_Pool_State* state, i32 thread_index)
+{
+	u64 seen_generation = 0;
+	while(true)
+	{
+		Thread_Pool_Func func = NULL;
+		void* context = NULL;
+		i32 perf_scope = PERF_NO_SCOPE;
+		{
+			std::unique_lock<std::mutex> lock(state->mutex);
+			state->work_ready.wait(lock, [&]{ return state->quit || state->generation != seen_generation; });
+			if(state->quit)
+				return;
+
+			seen_generation = state->generation;
+			func = state->func;
+			context = state->context;
+			perf_scope = state->perf_scope;
+		}
+
+		perf_set_scope(perf_scope);
+		func(context, thread_index, state->thread_count);
+		perf_set_scope(PERF_NO_SCOPE);
+
+		{
+			std::unique_lock<std::mutex> lock(state->mutex);
+			state->running -= 1;
+			if(state->running == 0)
+				state->work_done.notify_one();
+		}
+	}
+}
+
+i32 thread_hardware_count()
+{
+	i32 count = (i32) std::thread::hardware_concurrency();
+	return count > 0 ? count : 1;
+}
+
+void thread_pool_init(Thread_Pool* pool, i32 thread_count)
+{
+	thread_pool_deinit(pool);
+	if(thread_count <= 0)
+		thread_count = thread_hardware_count();
+
+	Thread_Pool_State* state = new Thread_Pool_State;
+	state->thread_count = thread_count;
+	state->threads = new std::thread[thread_count];
+
+	//thread 0 is the caller of thread_pool_run
+	for(i32 i = 1; i < thread_count; i++)
+		state->threads[i] = std::thread(thread_pool_worker, state, i);
+
+	pool->state = state;
+	pool->thread_count = thread_count;
+}
+
+void thread_pool_deinit(Thread_Pool* pool)
+{
+	Thread_Pool_State* state = pool->state;
+	if(state != NULL)
+	{
+		{
+			std::unique_lock<std::mutex> lock(state->mutex);
+			state->quit = true;
+		}
+		state->work_ready.notify_all();
+
+		for(i32 i = 1; i < state->thread_count; i++)
+			state->threads[i].join();
+
+		delete[] state->threads;
+		delete state;
+	}
+
+	memset(pool, 0, sizeof *pool);
+}
+
+void thread_pool_run(Thread_Pool* pool, Thread_Pool_Func func, void* context)
+{
+	Thread_Pool_State* state = pool->state;
+	if(state == NULL || state->thread_count <= 1)
+	{
+		func(context, 0, 1);
+		return;
+	}
+
+	{
+		std::unique_lock<std::mutex> lock(state->mutex);
+		state->func = func;
+		state->context = context;
+		state->perf_scope = perf_get_scope();
+		state->running = state->thread_count - 1;
+		state->generation += 1;
+	}
+	state->work_ready.notify_all();
+
+	func(context, 0, state->thread_count);
+
+	std::unique_lock<std::mutex> lock(state->mutex);
+	state->work_done.wait(lock, [&]{ return state->running == 0; });
+}
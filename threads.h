@@ -0,0 +1,102 @@
+#pragma once
+#include "types.h"
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// This file provides a very simple thread pool.
+//
+// There is no queue of tasks. Instead thread_pool_run runs the given function once
+// on every thread in the pool (including the calling thread which always gets index 0)
+// and returns only once all of them finished. The function itself is responsible for
+// splitting up the work based on the thread index it was given.
+//
+// This is all we need for data parallel stuff like the generation step and it keeps
+// the synchronization to one wake up and one wait per call.
+
+typedef void (*Thread_Pool_Func)(void* context, i32 thread_index, i32 thread_count);
+
+typedef struct Thread_Pool_State Thread_Pool_State;
+
+typedef struct Thread_Pool
+{
+	Thread_Pool_State* state;
+	i32 thread_count;
+} Thread_Pool;
+
+//Starts thread_count - 1 threads (the calling thread is the remaining one).
+//If thread_count <= 0 uses the number of hardware threads.
+void thread_pool_init(Thread_Pool* pool, i32 thread_count);
+void thread_pool_deinit(Thread_Pool* pool);
+
+//Runs func(context, i, thread_count) for all i in [0, thread_count) in parallel. Blocks untill all finish.
+void thread_pool_run(Thread_Pool* pool, Thread_Pool_Func func, void* context);
+
+i32 thread_hardware_count();
+
+//Atomically sets *value to desired if it is equal to expected. Returns true on success.
+static bool atomic_cas32(volatile u32* value, u32 expected, u32 desired)
+{
+	#ifdef _MSC_VER
+	return (u32) _InterlockedCompareExchange((volatile long*) value, (long) desired, (long) expected) == expected;
+	#else
+	return __atomic_compare_exchange_n(value, &expected, desired, false, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED);
+	#endif
+}
+
+//The same for a single byte. Used to claim the tag bytes of the chunk hash when inserting from many threads.
+static bool atomic_cas8(volatile u8* value, u8 expected, u8 desired)
+{
+	#ifdef _MSC_VER
+	return (u8) _InterlockedCompareExchange8((volatile char*) value, (char) desired, (char) expected) == expected;
+	#else
+	return __atomic_compare_exchange_n(value, &expected, desired, false, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED);
+	#endif
+}
+
+//Atomically adds delta to *value. Returns the previous value.
+static i64 atomic_add64(volatile i64* value, i64 delta)
+{
+	#ifdef _MSC_VER
+	return (i64) _InterlockedExchangeAdd64((volatile long long*) value, (long long) delta);
+	#else
+	return __atomic_fetch_add(value, delta, __ATOMIC_RELAXED);
+	#endif
+}
+
+static i64 atomic_load64(volatile i64* value)
+{
+	#ifdef _MSC_VER
+	return (i64) _InterlockedOr64((volatile long long*) value, 0);
+	#else
+	return __atomic_load_n(value, __ATOMIC_RELAXED);
+	#endif
+}
+
+static void atomic_store64(volatile i64* value, i64 to)
+{
+	#ifdef _MSC_VER
+	_InterlockedExchange64((volatile long long*) value, (long long) to);
+	#else
+	__atomic_store_n(value, to, __ATOMIC_RELAXED);
+	#endif
+}
+
+//Atomically sets *value to the maximum of it and to
+static void atomic_max64(volatile i64* value, i64 to)
+{
+	i64 curr = atomic_load64(value);
+	while(curr < to)
+	{
+		#ifdef _MSC_VER
+		i64 found = (i64) _InterlockedCompareExchange64((volatile long long*) value, (long long) to, (long long) curr);
+		if(found == curr)
+			break;
+		curr = found;
+		#else
+		if(__atomic_compare_exchange_n(value, &curr, to, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+			break;
+		#endif
+	}
+}
@@ -1,88 +1,149 @@
 #include "time.h"
 
-#if defined(_WIN32) || defined(_WIN64) || defined(__CYGWIN__)   
+#if defined(_WIN32) || defined(_WIN64) || defined(__CYGWIN__)
 #include <windows.h>
 #include <profileapi.h>
 
-int64_t _query_perf_counter_freq()
+static int64_t _os_counter()
 {
     LARGE_INTEGER ticks = {};
-    (void) QueryPerformanceFrequency(&ticks);
+    (void) QueryPerformanceCounter(&ticks);
     return ticks.QuadPart;
 }
 
-int64_t perf_counter()
+static int64_t _os_counter_freq()
 {
-    LARGE_INTEGER ticks = {};
-    (void) QueryPerformanceCounter(&ticks);
-    return ticks.QuadPart;
+    static int64_t freq = 0; //doesnt change so we can cache it
+    if(freq == 0)
+    {
+        LARGE_INTEGER ticks = {};
+        (void) QueryPerformanceFrequency(&ticks);
+        freq = ticks.QuadPart;
+    }
+    return freq;
 }
+#else
+#include <time.h>
 
-int64_t* _perf_counter_base()
+static int64_t _os_counter()
 {
-    static int64_t base = perf_counter();
-    return &base;
+    struct timespec ts;
+    (void) clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t) ts.tv_sec * 1'000'000'000 + ts.tv_nsec;
 }
 
-int64_t perf_counter_freq()
+static int64_t _os_counter_freq()
 {
-    static int64_t freq = _query_perf_counter_freq(); //doesnt change so we can cache it
-    return freq;
+    return 1'000'000'000;
 }
-    
-double _double_perf_counter_freq()
+#endif
+
+#ifdef TIME_HAS_TSC
+#ifndef _MSC_VER
+#include <cpuid.h>
+#endif
+
+//The TSC is only usable as a clock when it ticks at a constant rate regardless of the power state of the core
+//(CPUID.80000007H:EDX[8]). All x86 CPUs of the last decade have it.
+static bool _has_invariant_tsc()
 {
-    static double freq = (double) _query_perf_counter_freq();
-    return freq;
+    #ifdef _MSC_VER
+    int regs[4] = {0};
+    __cpuid(regs, 0x80000000);
+    if((unsigned) regs[0] < 0x80000007)
+        return false;
+    __cpuid(regs, 0x80000007);
+    return (regs[3] & (1 << 8)) != 0;
+    #else
+    unsigned eax = 0, ebx = 0, ecx = 0, edx = 0;
+    if(__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx) == 0)
+        return false;
+    return (edx & (1 << 8)) != 0;
+    #endif
 }
+#endif
 
-int64_t clock_ns()
+Perf_Counter_Source _perf_counter_source = PERF_COUNTER_SOURCE_UNKNOWN;
+
+Perf_Counter_Source perf_counter_source()
 {
-    int64_t freq = perf_counter_freq();
-    int64_t counter = perf_counter() - *_perf_counter_base();
+    if(_perf_counter_source == PERF_COUNTER_SOURCE_UNKNOWN)
+    {
+        //Races are fine since everyone arrives at the same result
+        #ifdef TIME_HAS_TSC
+        _perf_counter_source = _has_invariant_tsc() ? PERF_COUNTER_SOURCE_TSC : PERF_COUNTER_SOURCE_OS;
+        #else
+        _perf_counter_source = PERF_COUNTER_SOURCE_OS;
+        #endif
+    }
+    return _perf_counter_source;
+}
 
+//Only called when the source is not the TSC (or not yet known)
+int64_t _perf_counter_slow()
+{
+    if(perf_counter_source() == PERF_COUNTER_SOURCE_OS)
+        return _os_counter();
+    return perf_counter();
+}
+
+//Converts ticks of a clock with freq to nanoseconds without overflowing (ticks * 1e9 would after a few seconds)
+static int64_t _ticks_to_ns(int64_t ticks, int64_t freq)
+{
     int64_t sec_to_nanosec = 1'000'000'000;
-    //We assume _perf_counter_base is set to some reasonable thing so this will not overflow
-    // (with this we are only able to represent 1e12 secons (A LOT) without overflowing)
-    return counter * sec_to_nanosec / freq;
+    return ticks / freq * sec_to_nanosec + ticks % freq * sec_to_nanosec / freq;
 }
 
-//We might be rightfully scared that after some ammount of time the clock_s will get sufficiently large and
-// we will start loosing pression. This is however not a problem. If we assume the _perf_counter_freq is equal to 
-// 10Mhz = 1e7 (which is very common) then we would like the clock_s to have enough precision to represent
-// 1 / 10Mhz = 1e-7. This precission is held up untill 1e9 secons have passed which is roughly 31 years. 
-// => Please dont run your program for more than 31 years or you will loose precision
-double clock_s()
+typedef struct Time_Reference
+{
+    int64_t counter; //perf_counter
+    int64_t os_ns;
+} Time_Reference;
+
+//Returns the moment the clocks started. Taken on the first call which we make sure happens during startup.
+static Time_Reference _time_startup()
 {
-    double freq = _double_perf_counter_freq();
-    double counter = (double) (perf_counter() - *_perf_counter_base());
-    return counter / freq;
+    static Time_Reference startup = {perf_counter(), _ticks_to_ns(_os_counter(), _os_counter_freq())};
+    return startup;
 }
-#else
-#include <time.h>
 
-int64_t perf_counter()
+static Time_Reference _time_startup_init = _time_startup();
+
+static int64_t _calibrate_perf_counter_freq()
 {
-    struct timespec ts;
-    (void) clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+    if(perf_counter_source() == PERF_COUNTER_SOURCE_OS)
+        return _os_counter_freq();
 
-    return ts.tv_nsec;
+    //Measure how many ticks passed since startup against the os clock (at least TIME_CALIBRATION_MS).
+    //The longer the time the more precise so usually we dont need to wait at all.
+    Time_Reference startup = _time_startup();
+    Time_Reference now = {0};
+    do {
+        now.os_ns = _ticks_to_ns(_os_counter(), _os_counter_freq());
+        now.counter = perf_counter();
+    } while(now.os_ns - startup.os_ns < (int64_t) TIME_CALIBRATION_MS * 1'000'000);
+
+    double ticks = (double) (now.counter - startup.counter);
+    double seconds = (double) (now.os_ns - startup.os_ns) / 1e9;
+    return (int64_t) (ticks / seconds + 0.5);
 }
 
 int64_t perf_counter_freq()
 {
-	return 1'000'000'000;
+    static int64_t freq = _calibrate_perf_counter_freq(); //doesnt change so we can cache it
+    return freq;
 }
 
 int64_t clock_ns()
 {
-    static int64_t base = perf_counter();
-    return _clock_ns() - base;
+    return _ticks_to_ns(_os_counter(), _os_counter_freq()) - _time_startup().os_ns;
 }
-    
+
+//We might be rightfully scared that after some ammount of time the clock_s will get sufficiently large and
+// we will start loosing pression. This is however not a problem. We would like the clock_s to have enough
+// precision to represent 1ns = 1e-9 which a double holds up untill about 9e6 secons have passed (roughly 3 months).
+// Even after 31 years we still have ~100ns precision.
 double clock_s()
 {
     return (double) clock_ns() / 1.0e9;
 }
-#endif
-
@@ -1,7 +1,55 @@
 #pragma once
 #include <stdint.h>
 
-int64_t perf_counter();
+// This file provides clocks.
+//
+// perf_counter is meant for measuring short durations (PERF_COUNTER). On x86 CPUs with an invariant
+// time stamp counter it just reads it (rdtsc) which costs a few cycles instead of a call into the OS.
+// The frequency of the TSC is calibrated against the monotonic clock of the OS over the time between
+// startup and the first call to perf_counter_freq (which waits if less than TIME_CALIBRATION_MS passed).
+// Elsewhere perf_counter falls back to the OS monotonic clock.
+//
+// clock_ns and clock_s return the time since startup from the OS monotonic clock
+// (CLOCK_MONOTONIC or QueryPerformanceCounter). They are slower but never drift.
+
+#define TIME_CALIBRATION_MS 20
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+	#define TIME_HAS_TSC
+	#ifdef _MSC_VER
+		#include <intrin.h>
+	#endif
+#endif
+
+typedef enum Perf_Counter_Source
+{
+	PERF_COUNTER_SOURCE_UNKNOWN = 0,
+	PERF_COUNTER_SOURCE_TSC,
+	PERF_COUNTER_SOURCE_OS,
+} Perf_Counter_Source;
+
+extern Perf_Counter_Source _perf_counter_source;
+int64_t _perf_counter_slow();
+
+//Returns the current value of a monotonic counter ticking perf_counter_freq() times a second
+static inline int64_t perf_counter()
+{
+	#ifdef TIME_HAS_TSC
+	if(_perf_counter_source == PERF_COUNTER_SOURCE_TSC)
+	{
+		#ifdef _MSC_VER
+		return (int64_t) __rdtsc();
+		#else
+		return (int64_t) __builtin_ia32_rdtsc();
+		#endif
+	}
+	#endif
+
+	return _perf_counter_slow();
+}
+
 int64_t perf_counter_freq();
+Perf_Counter_Source perf_counter_source();
+
 int64_t clock_ns();
 double  clock_s();
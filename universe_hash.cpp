@@ -0,0 +1,211 @@
+#include "universe_hash.h"
+#include <string.h>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#define P UNIVERSE_HASH_PRIME
+
+//The base of the rows. Any value from 2 to P - 2 works, this one is just random.
+//The base of the columns is 2 so that every word of a row is directly a digit of the hash.
+static const u64 HASH_Y = (u64) 0x9e3779b97f4a7c15;
+
+//The low 64 bits of a * b and its high 64 bits in high
+static u64 mul_128(u64 a, u64 b, u64* high)
+{
+	#ifdef _MSC_VER
+	return _umul128(a, b, high);
+	#else
+	unsigned __int128 product = (unsigned __int128) a * b;
+	*high = (u64) (product >> 64);
+	return (u64) product;
+	#endif
+}
+
+//high * 2^64 + low modulo P. Because 2^64 = 2^64 - P (mod P) the high part is folded down until there is none.
+static u64 mod_reduce(u64 low, u64 high)
+{
+	while(high != 0)
+	{
+		u64 folded_high = 0;
+		u64 folded = mul_128(high, (u64) 0 - P, &folded_high);
+		low += folded;
+		high = folded_high + (low < folded);
+	}
+
+	return low >= P ? low - P : low;
+}
+
+static u64 mod_add(u64 a, u64 b)
+{
+	u64 out = a + b;
+	return mod_reduce(out, out < a);
+}
+
+static u64 mod_mul(u64 a, u64 b)
+{
+	u64 high = 0;
+	u64 low = mul_128(a, b, &high);
+	return mod_reduce(low, high);
+}
+
+static u64 mod_pow(u64 base, u64 exponent)
+{
+	u64 out = 1;
+	for(; exponent > 0; exponent >>= 1)
+	{
+		if(exponent & 1)
+			out = mod_mul(out, base);
+		base = mod_mul(base, base);
+	}
+	return out;
+}
+
+//base^exponent where base_inverse is the inverse of base (used for negative exponents)
+static u64 mod_pow_signed(u64 base, u64 base_inverse, i64 exponent)
+{
+	if(exponent >= 0)
+		return mod_pow(base, (u64) exponent);
+	else
+		return mod_pow(base_inverse, (u64) -exponent);
+}
+
+typedef struct Hash_Tables
+{
+	//2^(64w - CHUNK_HALO) * Y^y for the word w of the row y. Multiplying a word by it gives the hash of its cells.
+	u64 weights[CHUNK_SIZE][CHUNK_ROW_WORDS];
+	u64 content[CHUNK_ROW_WORDS]; //bits of each word that are cells of the chunk
+
+	u64 x_inverse; //of 2
+	u64 y_inverse;
+	u64 chunk_x; //2^CHUNK_SIZE
+	u64 chunk_y; //Y^CHUNK_SIZE
+	u64 chunk_x_inverse;
+	u64 chunk_y_inverse;
+} Hash_Tables;
+
+static Hash_Tables make_hash_tables()
+{
+	Hash_Tables tables = {0};
+
+	//Fermats little theorem
+	tables.x_inverse = mod_pow(2, P - 2);
+	tables.y_inverse = mod_pow(HASH_Y, P - 2);
+	for(i32 y = 0; y < CHUNK_SIZE; y++)
+		for(i32 w = 0; w < CHUNK_ROW_WORDS; w++)
+			tables.weights[y][w] = mod_mul(mod_pow_signed(2, tables.x_inverse, 64*w - CHUNK_HALO), mod_pow(HASH_Y, (u64) y));
+
+	for(i32 x = 0; x < CHUNK_SIZE; x++)
+		tables.content[(x + CHUNK_HALO) / 64] |= (u64) 1 << ((x + CHUNK_HALO) % 64);
+
+	tables.chunk_x = mod_pow(2, CHUNK_SIZE);
+	tables.chunk_y = mod_pow(HASH_Y, CHUNK_SIZE);
+	tables.chunk_x_inverse = mod_pow(tables.x_inverse, CHUNK_SIZE);
+	tables.chunk_y_inverse = mod_pow(tables.y_inverse, CHUNK_SIZE);
+	return tables;
+}
+
+static const Hash_Tables* get_hash_tables()
+{
+	static Hash_Tables tables = make_hash_tables();
+	return &tables;
+}
+
+u64 universe_hash_chunk(const Chunk* chunk, Vec2i pos)
+{
+	const Hash_Tables* tables = get_hash_tables();
+
+	//The products are summed as a 192 bit number and reduced only once
+	u64 low = 0;
+	u64 middle = 0;
+	u64 high = 0;
+	for(i32 y = 0; y < CHUNK_SIZE; y++)
+	{
+		const u64* row = chunk_row(chunk, y);
+		for(i32 w = 0; w < CHUNK_ROW_WORDS; w++)
+		{
+			u64 product_high = 0;
+			u64 product = mul_128(row[w] & tables->content[w], tables->weights[y][w], &product_high);
+
+			//product_high is at most 2^64 - 2 so adding the carry cannot overflow
+			low += product;
+			u64 carried = product_high + (low < product);
+			middle += carried;
+			high += middle < carried;
+		}
+	}
+
+	//(high * 2^64 + middle) * 2^64 + low
+	u64 hash = mod_reduce(low, mod_reduce(middle, high));
+	if(hash == 0)
+		return 0;
+
+	u64 key_x = mod_pow_signed(tables->chunk_x, tables->chunk_x_inverse, pos.x);
+	u64 key_y = mod_pow_signed(tables->chunk_y, tables->chunk_y_inverse, pos.y);
+	return mod_mul(hash, mod_mul(key_x, key_y));
+}
+
+u64 universe_hash(const Chunk_Hash* chunk_hash)
+{
+	u64 hash = 0;
+	for(i32 i = 0; i < chunk_hash->chunk_size; i++)
+		hash = mod_add(hash, universe_hash_chunk(&chunk_hash->chunks[i], chunk_hash->positions[i]));
+
+	return hash;
+}
+
+u64 universe_hash_add(u64 a, u64 b)
+{
+	return mod_add(a, b);
+}
+
+u64 universe_hash_normalize(u64 hash, Vec2i min)
+{
+	const Hash_Tables* tables = get_hash_tables();
+	u64 move_x = mod_pow_signed(tables->x_inverse, 2, min.x);
+	u64 move_y = mod_pow_signed(tables->y_inverse, HASH_Y, min.y);
+	return mod_mul(hash, mod_mul(move_x, move_y));
+}
+
+void cycle_detector_clear(Cycle_Detector* detector)
+{
+	memset(detector, 0, sizeof *detector);
+}
+
+bool cycle_detector_push(Cycle_Detector* detector, i64 generation, const Step_Stats* stats, i64 max_period)
+{
+	Universe_State state = {0};
+	state.generation = generation;
+	state.population = stats->population;
+	if(stats->population > 0)
+	{
+		state.normalized_hash = universe_hash_normalize(stats->hash, stats->min);
+		state.min = stats->min;
+		state.size = vec_sub(stats->max, stats->min);
+	}
+
+	//From the newest so that the shortest period is found
+	for(i32 i = 1; i <= detector->count && detector->found == false; i++)
+	{
+		const Universe_State* before = &detector->history[(detector->next - i + UNIVERSE_HISTORY) % UNIVERSE_HISTORY];
+		assert(before->generation < generation);
+		if(generation - before->generation > max_period)
+			break;
+
+		if(before->population == state.population && before->normalized_hash == state.normalized_hash && vec_equal(before->size, state.size))
+		{
+			detector->found = true;
+			detector->period = generation - before->generation;
+			detector->generation = generation;
+			detector->offset = vec_sub(state.min, before->min);
+		}
+	}
+
+	detector->history[detector->next] = state;
+	detector->next = (detector->next + 1) % UNIVERSE_HISTORY;
+	if(detector->count < UNIVERSE_HISTORY)
+		detector->count += 1;
+
+	return detector->found;
+}
@@ -0,0 +1,65 @@
+#pragma once
+#include "step.h"
+
+// This file provides a hash of the whole universe and detection of universes that repeat themselves.
+//
+// The hash is the sum of 2^x * Y^y over all alive cells (x, y) modulo the prime 2^64 - 59 (a 2D polynomial hash).
+// With 2 as the base of the columns every word of a row is just a digit of the hash so hashing costs a multiply per word.
+// Because it is a sum the order of the chunks does not matter: every chunk adds the hash of its data keyed
+// by its position (universe_hash_chunk) and empty chunks add 0. That lets the step compute it chunk by chunk
+// right after each chunk is computed instead of another pass over the universe (see Step_Stats::hash).
+//
+// Moving the universe by (dx, dy) multiplies its hash by 2^dx * Y^dy. Dividing the hash by 2^min.x * Y^min.y
+// of the bounding box of the alive cells (universe_hash_normalize) so gives the same value for the same pattern
+// anywhere. That is how Cycle_Detector finds spaceships and not just still lifes and oscillators.
+//
+// Cycle_Detector keeps the normalized hashes of the last UNIVERSE_HISTORY steps in a ring. Once the universe
+// after a step has the same population, the same size of the bounding box and the same normalized hash as one of them
+// it is (with overwhelming probability) the same pattern again and stays periodic forever. The caller can then stop.
+// A universe that also sends something away (a glider escaping a stable soup) never repeats as a whole so it is not found.
+
+#define UNIVERSE_HASH_PRIME	((u64) 0xffffffffffffffc5) /* 2^64 - 59, 2 is its primitive root */
+#define UNIVERSE_HISTORY	64 /* steps remembered by Cycle_Detector */
+
+//Hash of the alive cells of a chunk at pos. Only its content is hashed (not the halo). Is 0 for an empty chunk.
+u64 universe_hash_chunk(const Chunk* chunk, Vec2i pos);
+
+//Hash of all chunks of chunk_hash
+u64 universe_hash(const Chunk_Hash* chunk_hash);
+
+//Hash of the union of two universes with disjoint alive cells (for example two disjoint sets of chunks)
+u64 universe_hash_add(u64 a, u64 b);
+
+//Hash of the universe moved so that min (the top left corner of its bounding box) is at (0, 0)
+u64 universe_hash_normalize(u64 hash, Vec2i min);
+
+//A universe after some step as remembered by Cycle_Detector
+typedef struct Universe_State
+{
+	i64 generation;
+	i64 population;
+	u64 normalized_hash;
+	Vec2i min; //of the bounding box (only valid when population > 0)
+	Vec2i size;
+} Universe_State;
+
+typedef struct Cycle_Detector
+{
+	Universe_State history[UNIVERSE_HISTORY]; //ring of the last steps
+	i32 count; //valid states in history
+	i32 next; //index into history where the next state goes
+
+	//Filled once a cycle is found. The universe of generation is the same as the one from period generations
+	//before moved by offset cells. Period 1 with offset (0, 0) is a still life (or an empty universe).
+	//When stepping by several generations at once period is a multiple of the real one.
+	bool found;
+	i64 period;
+	i64 generation;
+	Vec2i offset;
+} Cycle_Detector;
+
+void cycle_detector_clear(Cycle_Detector* detector);
+
+//Remembers the universe of generation described by the stats of the step that made it and returns true once it is the same as
+//(a translation of) one of the remembered universes at most max_period generations before. Generations have to increase.
+bool cycle_detector_push(Cycle_Detector* detector, i64 generation, const Step_Stats* stats, i64 max_period);
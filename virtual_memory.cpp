@@ -0,0 +1,85 @@
+#include "virtual_memory.h"
+
+#if defined(_WIN32) || defined(_WIN64) || defined(__CYGWIN__)
+#include <windows.h>
+
+isize virtual_memory_page_size()
+{
+	static isize page_size = 0;
+	if(page_size == 0)
+	{
+		SYSTEM_INFO info = {};
+		GetSystemInfo(&info);
+		page_size = (isize) info.dwPageSize;
+	}
+	return page_size;
+}
+
+void* virtual_memory_reserve(isize size, bool huge_pages)
+{
+	//Large pages on Windows need special privileges and cannot be committed gradually so we ignore the hint
+	(void) huge_pages;
+	return VirtualAlloc(NULL, (SIZE_T) size, MEM_RESERVE, PAGE_NOACCESS);
+}
+
+bool virtual_memory_commit(void* at, isize size)
+{
+	if(size <= 0)
+		return true;
+	return VirtualAlloc(at, (SIZE_T) size, MEM_COMMIT, PAGE_READWRITE) != NULL;
+}
+
+void virtual_memory_release(void* reserved, isize size)
+{
+	(void) size;
+	if(reserved != NULL)
+		VirtualFree(reserved, 0, MEM_RELEASE);
+}
+
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#include <stdint.h>
+
+isize virtual_memory_page_size()
+{
+	static isize page_size = 0;
+	if(page_size == 0)
+		page_size = (isize) sysconf(_SC_PAGESIZE);
+	return page_size;
+}
+
+void* virtual_memory_reserve(isize size, bool huge_pages)
+{
+	void* reserved = mmap(NULL, (size_t) size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+	if(reserved == MAP_FAILED)
+		return NULL;
+
+	#ifdef MADV_HUGEPAGE
+	if(huge_pages)
+		madvise(reserved, (size_t) size, MADV_HUGEPAGE);
+	#else
+	(void) huge_pages;
+	#endif
+
+	return reserved;
+}
+
+bool virtual_memory_commit(void* at, isize size)
+{
+	if(size <= 0)
+		return true;
+
+	//mprotect needs page aligned start
+	isize page_size = virtual_memory_page_size();
+	uintptr_t from = (uintptr_t) at / page_size * page_size;
+	uintptr_t to = (uintptr_t) at + (uintptr_t) size;
+	return mprotect((void*) from, (size_t) (to - from), PROT_READ | PROT_WRITE) == 0;
+}
+
+void virtual_memory_release(void* reserved, isize size)
+{
+	if(reserved != NULL)
+		munmap(reserved, (size_t) size);
+}
+#endif
@@ -0,0 +1,21 @@
+#pragma once
+#include "types.h"
+
+// This file provides reserving address space and committing memory in it straight from the OS.
+//
+// Reserving only claims a range of addresses, it does not use any memory. Committing makes (page aligned)
+// parts of the range usable. Because the range never moves arrays living in it can grow without
+// copying by just committing more of it.
+
+isize virtual_memory_page_size();
+
+//Reserves size bytes of address space. If huge_pages asks the OS to back it with huge pages
+//when possible (only a hint, Linux transparent huge pages). Returns NULL on failure.
+void* virtual_memory_reserve(isize size, bool huge_pages);
+
+//Commits the pages overlapping [at, at + size) of a reserved range. Committed memory is zeroed.
+//Committing already committed pages is fine (they keep their content). Returns false if out of memory.
+bool virtual_memory_commit(void* at, isize size);
+
+//Releases the whole range obtained from virtual_memory_reserve
+void virtual_memory_release(void* reserved, isize size);